@@ -0,0 +1,482 @@
+#include <benchmark/benchmark.h>
+#include <cuda_fp16.h>
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cub/cub.cuh>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "detect/detector.h"
+#include "utils/cuda_check.h"
+
+using namespace radar;
+using namespace radar::detect;
+
+namespace {
+
+constexpr int kInputSize = 640;
+constexpr int kAnchors = 8400;
+constexpr int kClasses = 12;
+constexpr int kChannels = 4 + kClasses;
+constexpr int kAttrs = sizeof(Detection) / sizeof(float);
+constexpr int kTopK = 1024;
+
+/**
+ * @brief A buffer in device memory.
+ *
+ */
+template <typename T>
+class DeviceBuffer {
+   public:
+    explicit DeviceBuffer(size_t size) : size_(size) {
+        CUDA_CHECK(cudaMalloc(&data_, std::max<size_t>(size, 1) * sizeof(T)));
+    }
+
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+    ~DeviceBuffer() { cudaFree(data_); }
+
+    inline T* data() const noexcept { return data_; }
+
+    inline size_t size() const noexcept { return size_; }
+
+    void upload(const std::vector<T>& values) {
+        CUDA_CHECK(cudaMemcpy(data_, values.data(), values.size() * sizeof(T),
+                              cudaMemcpyHostToDevice));
+    }
+
+   private:
+    T* data_{nullptr};
+    size_t size_;
+};
+
+/**
+ * @brief Times the kernels launched on the default stream between `start` and
+ * `stop` with CUDA events, which excludes the time of the host waiting.
+ *
+ */
+class CudaTimer {
+   public:
+    CudaTimer() {
+        CUDA_CHECK(cudaEventCreate(&start_));
+        CUDA_CHECK(cudaEventCreate(&stop_));
+    }
+
+    ~CudaTimer() {
+        cudaEventDestroy(start_);
+        cudaEventDestroy(stop_);
+    }
+
+    inline void start() { CUDA_CHECK(cudaEventRecord(start_)); }
+
+    /**
+     * @brief Waits for the kernels and gets their time.
+     *
+     * @return The time in seconds.
+     */
+    double stop() {
+        CUDA_CHECK(cudaGetLastError());
+        CUDA_CHECK(cudaEventRecord(stop_));
+        CUDA_CHECK(cudaEventSynchronize(stop_));
+        float ms{0.0f};
+        CUDA_CHECK(cudaEventElapsedTime(&ms, start_, stop_));
+        return ms * 1e-3;
+    }
+
+   private:
+    cudaEvent_t start_;
+    cudaEvent_t stop_;
+};
+
+template <typename T>
+std::vector<T> randomValues(size_t size, T low, T high) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(low, high);
+    std::vector<T> values(size);
+    std::generate(values.begin(), values.end(),
+                  [&] { return static_cast<T>(dist(gen)); });
+    return values;
+}
+
+/**
+ * @brief Decoded detections of a batch, of which about a third pass the score
+ * threshold and overlap others of the same label.
+ *
+ */
+std::vector<float> randomDetections(int batch_size) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> position(0.0f, 600.0f);
+    std::uniform_real_distribution<float> jitter(-8.0f, 8.0f);
+    std::uniform_real_distribution<float> score(0.0f, 1.0f);
+    std::uniform_int_distribution<int> label(0, 1);
+
+    std::vector<float> detections(static_cast<size_t>(batch_size) * kAnchors *
+                                  kAttrs);
+    float x{0.0f}, y{0.0f};
+    for (size_t i = 0; i < detections.size() / kAttrs; ++i) {
+        // Anchors come in groups around the same object, as they do for a
+        // real network
+        if (i % 16 == 0) {
+            x = position(gen);
+            y = position(gen);
+        }
+        float* detection = detections.data() + i * kAttrs;
+        detection[0] = x + jitter(gen);
+        detection[1] = y + jitter(gen);
+        detection[2] = 40.0f + jitter(gen);
+        detection[3] = 40.0f + jitter(gen);
+        detection[4] = static_cast<float>(label(gen));
+        detection[5] = score(gen) * score(gen) * score(gen);
+    }
+    return detections;
+}
+
+void setImageCounters(benchmark::State& state, int64_t pixels) {
+    state.SetItemsProcessed(state.iterations() * pixels);
+    state.counters["pixels"] = static_cast<double>(pixels);
+}
+
+// The sizes of source images, from a VGA camera to the camera of the radar
+constexpr int kImageSizes[][2] = {{640, 480}, {1280, 1024}, {2592, 2048}};
+
+void imageSizes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"width", "height"});
+    for (const auto& [width, height] : kImageSizes) {
+        bench->Args({width, height});
+    }
+}
+
+void letterboxSizes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"width", "height", "batch", "half"});
+    for (const auto& [width, height] : kImageSizes) {
+        for (int batch_size : {1, 4, 16}) {
+            for (int half : {0, 1}) {
+                bench->Args({width, height, batch_size, half});
+            }
+        }
+    }
+}
+
+}  // namespace
+
+static void BM_Resize(benchmark::State& state) {
+    const int src_w = state.range(0), src_h = state.range(1);
+    const PreParam pparam(cv::Size(src_w, src_h),
+                          cv::Size(kInputSize, kInputSize));
+    const int dst_w = static_cast<int>(src_w / pparam.ratio);
+    const int dst_h = static_cast<int>(src_h / pparam.ratio);
+    DeviceBuffer<unsigned char> src(static_cast<size_t>(src_w) * src_h * 3);
+    DeviceBuffer<unsigned char> dst(static_cast<size_t>(dst_w) * dst_h * 3);
+    src.upload(randomValues<unsigned char>(src.size(), 0, 255));
+
+    const dim3 block_size(16, 16);
+    const dim3 grid_size((dst_w + block_size.x - 1) / block_size.x,
+                         (dst_h + block_size.y - 1) / block_size.y);
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        resizeKernel<<<grid_size, block_size>>>(src.data(), dst.data(), 3,
+                                                src_w, src_h, dst_w, dst_h);
+        state.SetIterationTime(timer.stop());
+    }
+    setImageCounters(state, static_cast<int64_t>(dst_w) * dst_h);
+}
+BENCHMARK(BM_Resize)->Apply(imageSizes)->UseManualTime();
+
+static void BM_CopyMakeBorder(benchmark::State& state) {
+    const int src_w = state.range(0), src_h = state.range(1);
+    const PreParam pparam(cv::Size(src_w, src_h),
+                          cv::Size(kInputSize, kInputSize));
+    const int resized_w = static_cast<int>(src_w / pparam.ratio);
+    const int resized_h = static_cast<int>(src_h / pparam.ratio);
+    const int top = static_cast<int>(std::round(pparam.dh - 0.1));
+    const int bottom = kInputSize - resized_h - top;
+    const int left = static_cast<int>(std::round(pparam.dw - 0.1));
+    const int right = kInputSize - resized_w - left;
+    DeviceBuffer<unsigned char> src(static_cast<size_t>(resized_w) *
+                                    resized_h * 3);
+    DeviceBuffer<unsigned char> dst(kInputSize * kInputSize * 3);
+    src.upload(randomValues<unsigned char>(src.size(), 0, 255));
+
+    const dim3 block_size(16, 16);
+    const dim3 grid_size((kInputSize + block_size.x - 1) / block_size.x,
+                         (kInputSize + block_size.y - 1) / block_size.y);
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        copyMakeBorderKernel<<<grid_size, block_size>>>(
+            src.data(), dst.data(), 3, resized_w, resized_h, top, bottom, left,
+            right);
+        state.SetIterationTime(timer.stop());
+    }
+    setImageCounters(state, kInputSize * kInputSize);
+}
+BENCHMARK(BM_CopyMakeBorder)->Apply(imageSizes)->UseManualTime();
+
+static void BM_Blob(benchmark::State& state) {
+    DeviceBuffer<unsigned char> src(kInputSize * kInputSize * 3);
+    DeviceBuffer<float> dst(kInputSize * kInputSize * 3);
+    src.upload(randomValues<unsigned char>(src.size(), 0, 255));
+
+    const dim3 block_size(16, 16);
+    const dim3 grid_size((kInputSize + block_size.x - 1) / block_size.x,
+                         (kInputSize + block_size.y - 1) / block_size.y);
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        blobKernel<<<grid_size, block_size>>>(src.data(), dst.data(),
+                                              kInputSize, kInputSize, 3,
+                                              1 / 255.f);
+        state.SetIterationTime(timer.stop());
+    }
+    setImageCounters(state, kInputSize * kInputSize);
+}
+BENCHMARK(BM_Blob)->UseManualTime();
+
+static void BM_Letterbox(benchmark::State& state) {
+    const int src_w = state.range(0), src_h = state.range(1);
+    const int batch_size = state.range(2);
+    const bool half = state.range(3) != 0;
+    DeviceBuffer<unsigned char> src(static_cast<size_t>(src_w) * src_h * 3);
+    src.upload(randomValues<unsigned char>(src.size(), 0, 255));
+    const DeviceImage image{.data = src.data(),
+                            .width = src_w,
+                            .height = src_h,
+                            .channels = 3,
+                            .step = src_w * 3};
+
+    // Every region of a batch is a different part of the image, as the cars
+    // of a frame are when their armors are detected
+    std::vector<LetterboxParam> params;
+    for (int i = 0; i < batch_size; ++i) {
+        const cv::Rect roi =
+            batch_size == 1
+                ? cv::Rect(0, 0, src_w, src_h)
+                : cv::Rect(i * (src_w / batch_size), 0, src_w / batch_size,
+                           src_h / 2);
+        params.emplace_back(image, roi,
+                            PreParam(roi.size(), cv::Size(kInputSize,
+                                                          kInputSize)));
+    }
+    DeviceBuffer<LetterboxParam> dev_params(batch_size);
+    dev_params.upload(params);
+    DeviceBuffer<float> dst(static_cast<size_t>(batch_size) * kInputSize *
+                            kInputSize * 3);
+
+    const dim3 block_size(16, 16);
+    const dim3 grid_size((kInputSize + block_size.x - 1) / block_size.x,
+                         (kInputSize + block_size.y - 1) / block_size.y,
+                         batch_size);
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        letterboxKernel<<<grid_size, block_size>>>(
+            dev_params.data(), dst.data(), kInputSize, kInputSize, 3,
+            1 / 255.f, half);
+        state.SetIterationTime(timer.stop());
+    }
+    setImageCounters(
+        state, static_cast<int64_t>(batch_size) * kInputSize * kInputSize);
+}
+BENCHMARK(BM_Letterbox)->Apply(letterboxSizes)->UseManualTime();
+
+static void BM_TransposeDecode(benchmark::State& state) {
+    const int batch_size = state.range(0);
+    const size_t output_size = static_cast<size_t>(kChannels) * kAnchors;
+    DeviceBuffer<float> output(batch_size * output_size);
+    DeviceBuffer<float> transposed(batch_size * output_size);
+    DeviceBuffer<float> decoded(static_cast<size_t>(batch_size) * kAnchors *
+                                kAttrs);
+    output.upload(randomValues<float>(output.size(), 0.0f, 1.0f));
+
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        for (int i = 0; i < batch_size; ++i) {
+            dim3 block_size(32, 32);
+            dim3 grid_size((kAnchors + block_size.x - 1) / block_size.x,
+                           (kChannels + block_size.y - 1) / block_size.y);
+            transposeKernel<<<grid_size, block_size>>>(
+                output.data() + i * output_size,
+                transposed.data() + i * output_size, kChannels, kAnchors);
+
+            block_size = dim3(32);
+            grid_size = dim3((kAnchors + block_size.x - 1) / block_size.x);
+            decodeKernel<<<grid_size, block_size>>>(
+                transposed.data() + i * output_size,
+                decoded.data() + static_cast<size_t>(i) * kAnchors * kAttrs,
+                kChannels, kAnchors, kClasses);
+        }
+        state.SetIterationTime(timer.stop());
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size * kAnchors);
+}
+BENCHMARK(BM_TransposeDecode)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->ArgName("batch")
+    ->UseManualTime();
+
+/**
+ * @brief The buffers of non-maximum suppression of a batch, with the
+ * candidates already gathered and sorted as `Detector::postprocess` does.
+ *
+ */
+class NMSFixture : public benchmark::Fixture {
+   public:
+    void SetUp(const benchmark::State& state) override {
+        batch_size = state.range(0);
+        const int items = batch_size * kAnchors;
+        words = (kTopK + 63) / 64;
+        decoded = std::make_unique<DeviceBuffer<float>>(
+            static_cast<size_t>(items) * kAttrs);
+        keys = std::make_unique<DeviceBuffer<float>>(items);
+        sorted_keys = std::make_unique<DeviceBuffer<float>>(items);
+        indices = std::make_unique<DeviceBuffer<int>>(items);
+        sorted_indices = std::make_unique<DeviceBuffer<int>>(items);
+        begins = std::make_unique<DeviceBuffer<int>>(batch_size);
+        ends = std::make_unique<DeviceBuffer<int>>(batch_size);
+        masks = std::make_unique<DeviceBuffer<unsigned long long>>(
+            static_cast<size_t>(batch_size) * kTopK * words);
+        output = std::make_unique<DeviceBuffer<float>>(
+            static_cast<size_t>(batch_size) * kTopK * kAttrs);
+        counts = std::make_unique<DeviceBuffer<int>>(batch_size);
+
+        decoded->upload(randomDetections(batch_size));
+        std::vector<int> offsets(batch_size);
+        for (int i = 0; i < batch_size; ++i) {
+            offsets[i] = i * kAnchors;
+        }
+        begins->upload(offsets);
+        prefilter();
+
+        size_t bytes{0};
+        CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+            nullptr, bytes, keys->data(), sorted_keys->data(), indices->data(),
+            sorted_indices->data(), items, batch_size, begins->data(),
+            ends->data()));
+        storage = std::make_unique<DeviceBuffer<unsigned char>>(bytes);
+        sort();
+        mask();
+        CUDA_CHECK(cudaDeviceSynchronize());
+    }
+
+    void TearDown(const benchmark::State&) override {
+        decoded.reset();
+        keys.reset();
+        sorted_keys.reset();
+        indices.reset();
+        sorted_indices.reset();
+        begins.reset();
+        ends.reset();
+        masks.reset();
+        output.reset();
+        counts.reset();
+        storage.reset();
+    }
+
+    void prefilter() {
+        CUDA_CHECK(cudaMemcpyAsync(ends->data(), begins->data(),
+                                   batch_size * sizeof(int),
+                                   cudaMemcpyDeviceToDevice));
+        const dim3 grid_size((kAnchors + 255) / 256, batch_size);
+        prefilterKernel<<<grid_size, 256>>>(decoded->data(), keys->data(),
+                                            indices->data(), ends->data(),
+                                            kAnchors, 0.25f);
+    }
+
+    void sort() {
+        size_t bytes{storage->size()};
+        CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+            storage->data(), bytes, keys->data(), sorted_keys->data(),
+            indices->data(), sorted_indices->data(), batch_size * kAnchors,
+            batch_size, begins->data(), ends->data()));
+    }
+
+    void mask() {
+        NMSMaskKernel<<<dim3(words, words, batch_size), 64>>>(
+            decoded->data(), sorted_indices->data(), begins->data(),
+            ends->data(), masks->data(), kAnchors, kTopK, 0.65f);
+    }
+
+    void select() {
+        NMSSelectKernel<<<batch_size, 64, words * sizeof(unsigned long long)>>>(
+            decoded->data(), sorted_indices->data(), begins->data(),
+            ends->data(), masks->data(), output->data(), counts->data(),
+            kAnchors, kTopK);
+    }
+
+    int batch_size{0};
+    int words{0};
+    std::unique_ptr<DeviceBuffer<float>> decoded, keys, sorted_keys, output;
+    std::unique_ptr<DeviceBuffer<int>> indices, sorted_indices, begins, ends,
+        counts;
+    std::unique_ptr<DeviceBuffer<unsigned long long>> masks;
+    std::unique_ptr<DeviceBuffer<unsigned char>> storage;
+};
+
+BENCHMARK_DEFINE_F(NMSFixture, Prefilter)(benchmark::State& state) {
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        prefilter();
+        state.SetIterationTime(timer.stop());
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size * kAnchors);
+}
+BENCHMARK_REGISTER_F(NMSFixture, Prefilter)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->ArgName("batch")
+    ->UseManualTime();
+
+BENCHMARK_DEFINE_F(NMSFixture, Sort)(benchmark::State& state) {
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        sort();
+        state.SetIterationTime(timer.stop());
+    }
+}
+BENCHMARK_REGISTER_F(NMSFixture, Sort)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->ArgName("batch")
+    ->UseManualTime();
+
+BENCHMARK_DEFINE_F(NMSFixture, Mask)(benchmark::State& state) {
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        mask();
+        state.SetIterationTime(timer.stop());
+    }
+}
+BENCHMARK_REGISTER_F(NMSFixture, Mask)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->ArgName("batch")
+    ->UseManualTime();
+
+BENCHMARK_DEFINE_F(NMSFixture, Select)(benchmark::State& state) {
+    CudaTimer timer;
+    for (auto _ : state) {
+        timer.start();
+        select();
+        state.SetIterationTime(timer.stop());
+    }
+}
+BENCHMARK_REGISTER_F(NMSFixture, Select)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->ArgName("batch")
+    ->UseManualTime();
@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "detect/detector.h"
+
+namespace {
+
+/**
+ * @brief A model whose FP16 and INT8 engines are compared, with the images
+ * they are calibrated and evaluated on.
+ *
+ */
+struct Model {
+    std::string_view engine_path;
+    int classes;
+    std::string_view image_dir;
+};
+
+const std::vector<Model> kModels{
+    {"../test/detect/yolov8n.engine", 80, "../test/detect"},
+    {"../models/car.engine", 1, "../assets/images"},
+    {"../models/armor.engine", 12, "../assets/images"}};
+
+std::vector<cv::Mat> readImages(std::string_view dir) {
+    std::vector<cv::Mat> images;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".jpg") {
+            images.emplace_back(cv::imread(entry.path().string()));
+        }
+    }
+    return images;
+}
+
+/**
+ * @brief Constructs the detector of a model, which is built in INT8 if
+ * `int8` is `true`, otherwise in FP16. The engines are kept in the engine
+ * cache, so only the first run builds them.
+ *
+ */
+std::unique_ptr<radar::Detector> makeDetector(const Model& model, bool int8) {
+    if (!int8) {
+        return std::make_unique<radar::Detector>(model.engine_path,
+                                                 model.classes, 1);
+    }
+    radar::detect::Int8Config int8_config{
+        .image_dir = std::string(model.image_dir),
+        .cache_path = std::filesystem::path(model.engine_path)
+                          .replace_extension(".calib")
+                          .string()};
+    return std::make_unique<radar::Detector>(
+        model.engine_path, model.classes, 1, std::nullopt, 1 << 24, 0.65f,
+        0.25f, 640, 640, "images", 3, 3, 2, false, false, 1024, int8_config);
+}
+
+/**
+ * @brief Computes the ratio of the reference detections recalled by others,
+ * each of which is recalled if a detection of the same label overlaps it by
+ * an IoU above 0.5.
+ *
+ */
+double recall(const std::vector<std::vector<radar::Detection>>& references,
+              const std::vector<std::vector<radar::Detection>>& detections) {
+    int total{0}, recalled{0};
+    for (size_t i = 0; i < references.size(); ++i) {
+        for (const auto& truth : references[i]) {
+            ++total;
+            cv::Rect2f truth_rect(truth.x, truth.y, truth.width, truth.height);
+            recalled += std::ranges::any_of(
+                detections[i], [&](const radar::Detection& detection) {
+                    cv::Rect2f rect(detection.x, detection.y,
+                                    detection.width, detection.height);
+                    float inter{(truth_rect & rect).area()};
+                    float uni{truth_rect.area() + rect.area() - inter};
+                    return detection.label == truth.label && uni > 0 &&
+                           inter / uni > 0.5f;
+                });
+        }
+    }
+    return total > 0 ? static_cast<double>(recalled) / total : 1.0;
+}
+
+void modelArgs(benchmark::internal::Benchmark* bench) {
+    for (int model = 0; model < static_cast<int>(kModels.size()); ++model) {
+        for (int int8 : {0, 1}) {
+            bench->Args({model, int8});
+        }
+    }
+}
+
+}  // namespace
+
+/**
+ * @brief Times the detection of the images of a model in FP16 or INT8, and
+ * reports the recall of INT8 detections against FP16 ones as the counter
+ * `recall`. Models whose onnx files do not exist are skipped, as well as
+ * those with an engine file, which would be loaded in both precisions.
+ *
+ */
+static void BM_DetectPrecision(benchmark::State& state) {
+    const auto& model = kModels[state.range(0)];
+    const bool int8 = state.range(1) != 0;
+    auto onnx_path{std::filesystem::path(model.engine_path)
+                       .replace_extension(".onnx")};
+    if (!std::filesystem::exists(onnx_path)) {
+        state.SkipWithError((onnx_path.string() + " does not exist").c_str());
+        return;
+    }
+    if (std::filesystem::exists(model.engine_path)) {
+        state.SkipWithError(
+            (std::string(model.engine_path) + " is loaded directly").c_str());
+        return;
+    }
+    const auto images = readImages(model.image_dir);
+    if (images.empty()) {
+        state.SkipWithError("no images");
+        return;
+    }
+    auto detector{makeDetector(model, int8)};
+
+    std::vector<std::vector<radar::Detection>> detections;
+    for (const auto& image : images) {
+        detections.emplace_back(detector->detect(image));
+    }
+    if (int8) {
+        auto reference{makeDetector(model, false)};
+        std::vector<std::vector<radar::Detection>> references;
+        for (const auto& image : images) {
+            references.emplace_back(reference->detect(image));
+        }
+        state.counters["recall"] = recall(references, detections);
+    }
+
+    for (auto _ : state) {
+        for (const auto& image : images) {
+            benchmark::DoNotOptimize(detector->detect(image));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(images.size()));
+}
+BENCHMARK(BM_DetectPrecision)
+    ->Apply(modelArgs)
+    ->ArgNames({"model", "int8"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,174 @@
+#include <benchmark/benchmark.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <filesystem>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "locate/locator.h"
+
+using namespace radar;
+
+namespace {
+
+// The calibration of the camera and the lidar recording the assets
+const cv::Size image_size(2592, 2048);
+const cv::Matx33f intrinsic(1685.51538398561, 0, 1278.99324114319, 0,
+                            1685.26471848220, 1037.21273138299, 0, 0, 1);
+const cv::Matx44f lidar_to_camera(0, -1, 0, 0.85443, 0, 0, -1, -37.6845, 1, 0,
+                                  0, 12.2631, 0.0, 0.0, 0.0, 1.0);
+const cv::Matx44f world_to_camera(0.05975021, 0.99807031, 0.01689906,
+                                  -7179.65399136, 0.28962566, -0.00113262,
+                                  -0.95713933, -4671.34956587, -0.9552732,
+                                  0.06208368, -0.28913445, 28286.8920291, 0.0,
+                                  0.0, 0.0, 1.0);
+
+using CloudPtr = pcl::PointCloud<pcl::PointXYZ>::Ptr;
+
+CloudPtr readCloud(const std::filesystem::path& path) {
+    CloudPtr cloud(new pcl::PointCloud<pcl::PointXYZ>());
+    if (pcl::io::loadPCDFile(path.string(), *cloud) != 0) {
+        throw std::runtime_error("failed to read " + path.string());
+    }
+    return cloud;
+}
+
+/**
+ * @brief The clouds of the assets, which are read once for all benchmarks.
+ *
+ */
+struct Clouds {
+    Clouds() {
+        const std::filesystem::path folder{RADAR_ASSETS_DIR "/clouds"};
+        for (int i = 0; std::filesystem::exists(
+                 folder / (std::to_string(i) + ".pcd"));
+             ++i) {
+            frames.emplace_back(
+                readCloud(folder / (std::to_string(i) + ".pcd")));
+        }
+        background = readCloud(folder / "background.pcd");
+    }
+
+    static const Clouds& instance() {
+        static const Clouds clouds;
+        return clouds;
+    }
+
+    std::vector<CloudPtr> frames;
+    CloudPtr background;
+};
+
+/**
+ * @brief Constructs a locator whose background is built from the background
+ * cloud of the assets, with the parameters of the samples.
+ *
+ * @param zoom_factor The zoom factor of the depth images.
+ * @param use_cuda Whether to project and difference on the GPU.
+ * @param cluster_method The method of clustering.
+ */
+std::unique_ptr<Locator> makeLocator(float zoom_factor, bool use_cuda,
+                                     ClusterMethod cluster_method) {
+    auto locator = std::make_unique<Locator>(
+        image_size.width, image_size.height, intrinsic, lidar_to_camera,
+        world_to_camera, zoom_factor, 3, 500, 4000, 400, 8, 1000, 29300,
+        use_cuda, cluster_method);
+    locator->accumulateBackground(Clouds::instance().background);
+    locator->freezeBackground(1, 0);
+    return locator;
+}
+
+// Zoom factors are given in percent, as arguments are integers
+constexpr int kZoomPercents[] = {25, 50, 100};
+
+void updateArgs(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"zoom", "cuda"});
+    for (int zoom : kZoomPercents) {
+        for (int cuda : {0, 1}) {
+            bench->Args({zoom, cuda});
+        }
+    }
+}
+
+void clusterArgs(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"zoom", "method"});
+    for (int zoom : kZoomPercents) {
+        for (auto method : {ClusterMethod::Euclidean, ClusterMethod::Grid,
+                            ClusterMethod::Voxel}) {
+            bench->Args({zoom, static_cast<int>(method)});
+        }
+    }
+}
+
+}  // namespace
+
+static void BM_LocatorUpdate(benchmark::State& state) {
+    const auto& clouds = Clouds::instance().frames;
+    auto locator = makeLocator(state.range(0) / 100.0f, state.range(1) != 0,
+                               ClusterMethod::Grid);
+    size_t index{0};
+    size_t points{0};
+    for (auto _ : state) {
+        const auto& cloud = clouds[index++ % clouds.size()];
+        locator->update(cloud);
+        points += cloud->size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(points));
+}
+BENCHMARK(BM_LocatorUpdate)
+    ->Apply(updateArgs)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+static void BM_LocatorUpdatePoints(benchmark::State& state) {
+    // The clouds are converted to structure of arrays before, as the lidar
+    // driver fills them, so only the update without PCL is timed
+    std::vector<std::vector<float>> xs, ys, zs;
+    for (const auto& cloud : Clouds::instance().frames) {
+        auto& x = xs.emplace_back();
+        auto& y = ys.emplace_back();
+        auto& z = zs.emplace_back();
+        for (const auto& point : *cloud) {
+            x.emplace_back(point.x);
+            y.emplace_back(point.y);
+            z.emplace_back(point.z);
+        }
+    }
+    auto locator = makeLocator(state.range(0) / 100.0f, state.range(1) != 0,
+                               ClusterMethod::Grid);
+    size_t index{0};
+    size_t points{0};
+    for (auto _ : state) {
+        const size_t i = index++ % xs.size();
+        locator->update(xs[i], ys[i], zs[i]);
+        points += xs[i].size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(points));
+}
+BENCHMARK(BM_LocatorUpdatePoints)
+    ->Apply(updateArgs)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+static void BM_LocatorCluster(benchmark::State& state) {
+    const auto& clouds = Clouds::instance().frames;
+    auto locator = makeLocator(state.range(0) / 100.0f, false,
+                               static_cast<ClusterMethod>(state.range(1)));
+    size_t index{0};
+    for (auto _ : state) {
+        // The depth images of each cloud are made before clustering it, which
+        // is not timed
+        state.PauseTiming();
+        locator->update(clouds[index++ % clouds.size()]);
+        state.ResumeTiming();
+        locator->cluster();
+    }
+}
+BENCHMARK(BM_LocatorCluster)
+    ->Apply(clusterArgs)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
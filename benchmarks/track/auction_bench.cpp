@@ -0,0 +1,92 @@
+#include "track/auction.h"
+
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+using namespace radar::track;
+
+namespace {
+
+constexpr int kMaxIter = 100;
+
+/**
+ * @brief Values of a frame, where each agent is gated with about a quarter of
+ * the tasks, as tracks usually are with the robots nearby.
+ *
+ */
+Eigen::MatrixXf randomValues(int num_agents, int num_tasks) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    Eigen::MatrixXf values = Eigen::MatrixXf::Zero(num_agents, num_tasks);
+    for (int agent = 0; agent < num_agents; ++agent) {
+        for (int task = 0; task < num_tasks; ++task) {
+            if (dist(gen) < 0.25f) {
+                values(agent, task) = dist(gen);
+            }
+        }
+    }
+    return values;
+}
+
+void sparseValues(const Eigen::MatrixXf& values,
+                  SparseValueMatrix& value_matrix) {
+    value_matrix.reset(values.cols());
+    for (int agent = 0; agent < values.rows(); ++agent) {
+        value_matrix.addRow();
+        for (int task = 0; task < values.cols(); ++task) {
+            if (values(agent, task) > 0) {
+                value_matrix.add(task, values(agent, task));
+            }
+        }
+    }
+}
+
+// Agents and tasks from 2x2 to 64x64
+void assignmentSizes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"agents", "tasks"})
+        ->RangeMultiplier(2)
+        ->Ranges({{2, 64}, {2, 64}});
+}
+
+}  // namespace
+
+static void BM_Auction(benchmark::State& state) {
+    const auto values = randomValues(state.range(0), state.range(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(auction(values, kMaxIter));
+    }
+    state.SetComplexityN(state.range(0) * state.range(1));
+}
+BENCHMARK(BM_Auction)->Apply(assignmentSizes);
+
+static void BM_AuctionSolverCold(benchmark::State& state) {
+    const auto values = randomValues(state.range(0), state.range(1));
+    SparseValueMatrix value_matrix;
+    sparseValues(values, value_matrix);
+    AuctionSolver solver(kMaxIter, 1e-3f);
+    std::vector<float> prices(values.cols());
+    for (auto _ : state) {
+        std::fill(prices.begin(), prices.end(), 0.0f);
+        benchmark::DoNotOptimize(solver.solve(value_matrix, prices));
+    }
+    state.counters["iterations"] = solver.iterations();
+}
+BENCHMARK(BM_AuctionSolverCold)->Apply(assignmentSizes);
+
+// Prices are kept between solves, as they are between frames by the tracker
+static void BM_AuctionSolverWarm(benchmark::State& state) {
+    const auto values = randomValues(state.range(0), state.range(1));
+    SparseValueMatrix value_matrix;
+    sparseValues(values, value_matrix);
+    AuctionSolver solver(kMaxIter, 1e-3f);
+    std::vector<float> prices(values.cols(), 0.0f);
+    solver.solve(value_matrix, prices);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(solver.solve(value_matrix, prices));
+    }
+    state.counters["iterations"] = solver.iterations();
+}
+BENCHMARK(BM_AuctionSolverWarm)->Apply(assignmentSizes);
@@ -0,0 +1,80 @@
+#include "track/features.h"
+
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+using namespace radar::track;
+
+namespace {
+
+constexpr int kClassNum = 12;
+
+template <int Rows>
+std::vector<typename BasicFeatures<Rows>::Vector> randomFeatures(
+    size_t size) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<typename BasicFeatures<Rows>::Vector> features(size);
+    for (auto& feature : features) {
+        feature.resize(kClassNum);
+        for (int i = 0; i < kClassNum; ++i) {
+            feature(i) = dist(gen);
+        }
+    }
+    return features;
+}
+
+// The history of a track before the append, without and with a window
+void historySizes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"history", "window"})
+        ->ArgsProduct({benchmark::CreateRange(1, 4096, 8), {0, 64}});
+}
+
+}  // namespace
+
+template <int Rows>
+static void BM_FeaturesPushBack(benchmark::State& state) {
+    const int history = state.range(0);
+    const int window = state.range(1);
+    const auto features = randomFeatures<Rows>(256);
+    BasicFeatures<Rows> collection(kClassNum, 1, window, 0.9f);
+    for (int i = 0; i < history; ++i) {
+        collection.push_back(features[i % features.size()]);
+    }
+    size_t index{0};
+    for (auto _ : state) {
+        // Without a window the history grows during the run, so it is
+        // restored every so often to keep it around the given size
+        if (window == 0 && collection.size() >= 2 * history + 64) {
+            state.PauseTiming();
+            collection.clear();
+            for (int i = 0; i < history; ++i) {
+                collection.push_back(features[i % features.size()]);
+            }
+            state.ResumeTiming();
+        }
+        collection.push_back(features[index++ % features.size()]);
+        benchmark::DoNotOptimize(collection.feature().data());
+    }
+}
+BENCHMARK(BM_FeaturesPushBack<Eigen::Dynamic>)->Apply(historySizes);
+BENCHMARK(BM_FeaturesPushBack<kClassNum>)->Apply(historySizes);
+
+template <int Rows>
+static void BM_FeaturesFeature(benchmark::State& state) {
+    const int history = state.range(0);
+    const auto features = randomFeatures<Rows>(256);
+    BasicFeatures<Rows> collection(kClassNum, 1, state.range(1), 0.9f);
+    for (int i = 0; i < history; ++i) {
+        collection.push_back(features[i % features.size()]);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(collection.feature().data());
+        benchmark::DoNotOptimize(collection.label());
+    }
+}
+BENCHMARK(BM_FeaturesFeature<Eigen::Dynamic>)->Apply(historySizes);
+BENCHMARK(BM_FeaturesFeature<kClassNum>)->Apply(historySizes);
@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Dense>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "track/singer.h"
+#include "track/singer_bank.h"
+#include "utils/thread_pool.h"
+
+using namespace radar;
+using namespace radar::track;
+
+namespace {
+
+constexpr float kMaxA = 2.0f;  // m/s^2
+constexpr float kTau = 1.0f;   // s
+constexpr float kDt = 0.1f;    // s
+
+using State = Eigen::Matrix<float, kStateSize, 1>;
+using Covariance = Eigen::Matrix<float, kStateSize, kStateSize>;
+using Measurement = Eigen::Matrix<float, kMeasurementSize, 1>;
+using ObservationNoise =
+    Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>;
+
+const ObservationNoise observation_noise =
+    ObservationNoise::Identity() * 0.2f;
+
+std::vector<Measurement> randomMeasurements(size_t size) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(0.0f, 28.0f);
+    std::vector<Measurement> measurements(size);
+    for (auto& measurement : measurements) {
+        measurement << dist(gen), dist(gen), dist(gen);
+    }
+    return measurements;
+}
+
+}  // namespace
+
+static void BM_SingerPredict(benchmark::State& state) {
+    SingerEKF filter(State::Zero(), Covariance::Identity() * 0.5f, kMaxA,
+                     kTau, observation_noise);
+    for (auto _ : state) {
+        filter.predict(kDt);
+        benchmark::DoNotOptimize(filter.state());
+    }
+}
+BENCHMARK(BM_SingerPredict);
+
+static void BM_SingerUpdate(benchmark::State& state) {
+    SingerEKF filter(State::Zero(), Covariance::Identity() * 0.5f, kMaxA,
+                     kTau, observation_noise);
+    const auto measurements = randomMeasurements(64);
+    size_t index{0};
+    for (auto _ : state) {
+        filter.predict(kDt);
+        filter.update(measurements[index++ % measurements.size()]);
+        benchmark::DoNotOptimize(filter.state());
+    }
+}
+BENCHMARK(BM_SingerUpdate);
+
+// The bank of filters against the same number of filters predicted one by
+// one, and against predicting them on a thread pool
+static void BM_SingerPredictEach(benchmark::State& state) {
+    std::vector<SingerEKF> filters;
+    for (int i = 0; i < state.range(0); ++i) {
+        filters.emplace_back(State::Zero(), Covariance::Identity() * 0.5f,
+                             kMaxA, kTau, observation_noise);
+    }
+    for (auto _ : state) {
+        for (auto& filter : filters) {
+            filter.predict(kDt);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SingerPredictEach)->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_SingerBankPredict(benchmark::State& state) {
+    const bool parallel = state.range(1) != 0;
+    SingerEKFBank bank(kMaxA, kTau, observation_noise);
+    for (int i = 0; i < state.range(0); ++i) {
+        bank.add(State::Zero(), Covariance::Identity() * 0.5f);
+    }
+    auto pool = parallel ? std::make_unique<ThreadPool>() : nullptr;
+    for (auto _ : state) {
+        bank.predict(kDt, pool.get());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SingerBankPredict)
+    ->ArgNames({"filters", "parallel"})
+    ->ArgsProduct({benchmark::CreateRange(1, 1024, 4), {0, 1}})
+    ->UseRealTime();
@@ -0,0 +1,74 @@
+/**
+ * @file assets.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file reads the images and point clouds of the samples from disk.
+ * @date 2024-04-14
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+inline std::vector<cv::Mat> readImages(std::string_view folder_path) {
+    if (!std::filesystem::exists(folder_path)) {
+        throw std::runtime_error(std::string(folder_path) + " does not exist");
+    }
+
+    std::vector<cv::Mat> images;
+    for (int i = 0; i < 10; ++i) {
+        std::string filename =
+            std::filesystem::path(folder_path) / (std::to_string(i) + ".jpg");
+        if (!std::filesystem::exists(filename)) {
+            throw std::runtime_error(filename + " does not exist");
+        }
+        cv::Mat image = cv::imread(filename);
+        images.emplace_back(image);
+    }
+    return images;
+}
+
+inline auto readClouds(std::string_view folder_path)
+    -> std::pair<pcl::PointCloud<pcl::PointXYZ>::Ptr,
+                 std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>> {
+    if (!std::filesystem::exists(folder_path)) {
+        throw std::runtime_error(std::string(folder_path) + " does not exist");
+    }
+
+    std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds;
+    for (int i = 0; i < 10; ++i) {
+        std::string filename =
+            std::filesystem::path(folder_path) / (std::to_string(i) + ".pcd");
+        if (!std::filesystem::exists(filename)) {
+            throw std::runtime_error(filename + " does not exist");
+        }
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(
+            new pcl::PointCloud<pcl::PointXYZ>());
+        pcl::io::loadPCDFile(filename, *cloud);
+        clouds.emplace_back(cloud);
+    }
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr background_cloud(
+        new pcl::PointCloud<pcl::PointXYZ>());
+    std::string filename =
+        std::filesystem::path(folder_path) / "background.pcd";
+    if (!std::filesystem::exists(filename)) {
+        throw std::runtime_error(filename + " does not exist");
+    }
+    pcl::io::loadPCDFile(filename, *background_cloud);
+
+    return std::make_pair(background_cloud, clouds);
+}
@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "locate/point_file.h"
+#include "recording.h"
+
+constexpr const char* kUsage =
+    "usage: convert_recording <recording>\n"
+    "Writes the clouds of a recording into <recording>/clouds.bin, which is\n"
+    "then replayed through a memory map instead of parsing every PCD file.\n";
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << kUsage;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const Recording recording(argv[1]);
+        const auto path = recording.pointFilePath();
+        if (std::filesystem::exists(path)) {
+            throw std::runtime_error(path.string() + " already exists");
+        }
+
+        // The file is written beside the final one and renamed when it is
+        // complete, so that an interrupted conversion leaves no broken file
+        auto temp_path = path;
+        temp_path += ".tmp";
+        radar::locate::PointFileWriter writer(temp_path.string());
+        std::vector<float> x, y, z;
+        for (size_t i = 0; i < recording.size(); ++i) {
+            const auto frame = recording.load(i);
+            const auto& cloud = *frame.cloud;
+            x.resize(cloud.size());
+            y.resize(cloud.size());
+            z.resize(cloud.size());
+            for (size_t j = 0; j < cloud.size(); ++j) {
+                x[j] = cloud[j].x;
+                y[j] = cloud[j].y;
+                z[j] = cloud[j].z;
+            }
+            writer.append(recording.offset(i).count(),
+                          {.x = x, .y = y, .z = z});
+        }
+        writer.close();
+        std::filesystem::rename(temp_path, path);
+        std::cout << "wrote " << recording.size() << " clouds into " << path
+                  << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
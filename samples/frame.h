@@ -19,6 +19,8 @@
 #include <opencv2/opencv.hpp>
 #include <optional>
 
+#include "locate/point_ring.h"
+
 namespace radar {
 
 /**
@@ -43,6 +45,41 @@ class Frame {
               std::chrono::high_resolution_clock::now())
         : image_(image), point_cloud_(point_cloud), timestamp_(timestamp) {}
 
+    /**
+     * @brief Construct a new Frame object with image, point cloud, and their
+     * timestamps, when the camera and the lidar are not triggered together.
+     *
+     * @param image A cv::Mat image associated with the frame.
+     * @param point_cloud A shared pointer to a pcl::PointCloud of pcl::PointXYZ
+     * points.
+     * @param timestamp A time_point object representing the time the image was
+     * captured.
+     * @param cloud_timestamp A time_point object representing the time the
+     * point cloud was captured.
+     */
+    Frame(const cv::Mat& image, pcl::PointCloud<pcl::PointXYZ>::Ptr point_cloud,
+          std::chrono::high_resolution_clock::time_point timestamp,
+          std::chrono::high_resolution_clock::time_point cloud_timestamp)
+        : image_(image),
+          point_cloud_(point_cloud),
+          timestamp_(timestamp),
+          cloud_timestamp_(cloud_timestamp) {}
+
+    /**
+     * @brief Construct a new Frame object with image, points as structure of
+     * arrays, and optional timestamp.
+     *
+     * @param image A cv::Mat image associated with the frame.
+     * @param points The points, which are not copied and must be kept until
+     * the frame is located, such as the frames of a mapped point file.
+     * @param timestamp A time_point object representing the time the frame was
+     * captured.
+     */
+    Frame(const cv::Mat& image, const locate::PointSpans& points,
+          std::chrono::high_resolution_clock::time_point timestamp =
+              std::chrono::high_resolution_clock::now())
+        : image_(image), points_(points), timestamp_(timestamp) {}
+
     virtual ~Frame() = default;
 
     /**
@@ -65,6 +102,28 @@ class Frame {
         return point_cloud_ ? std::make_optional(point_cloud_) : std::nullopt;
     }
 
+    /**
+     * @brief Get the timestamp of the point cloud of the frame.
+     *
+     * @return An optional containing the timestamp if the point cloud is
+     * captured at another time than the image, std::nullopt otherwise.
+     */
+    inline auto cloud_timestamp() const noexcept {
+        return cloud_timestamp_.time_since_epoch().count() == 0
+                   ? std::nullopt
+                   : std::make_optional(cloud_timestamp_);
+    }
+
+    /**
+     * @brief Get the points associated with the frame as structure of arrays.
+     *
+     * @return An optional containing the points if the frame is constructed
+     * with them, std::nullopt otherwise.
+     */
+    inline std::optional<locate::PointSpans> points() const noexcept {
+        return points_;
+    }
+
     /**
      * @brief Get the timestamp of the frame.
      *
@@ -80,7 +139,9 @@ class Frame {
    protected:
     cv::Mat image_;
     pcl::PointCloud<pcl::PointXYZ>::Ptr point_cloud_;
+    std::optional<locate::PointSpans> points_;
     std::chrono::high_resolution_clock::time_point timestamp_;
+    std::chrono::high_resolution_clock::time_point cloud_timestamp_;
 };
 
 }  // namespace radar
\ No newline at end of file
@@ -4,10 +4,14 @@
 
 #include <chrono>
 #include <filesystem>
+#include <iostream>
 #include <opencv2/opencv.hpp>
 #include <stdexcept>
+#include <thread>
 
+#include "assets.h"
 #include "sample_radar.h"
+#include "utils/metrics.h"
 
 const cv::Size image_size(2592, 2048);
 const cv::Matx33f intrinsic(1685.51538398561, 0, 1278.99324114319, 0,
@@ -21,60 +25,12 @@ const cv::Matx44f world_to_camera(0.05975021, 0.99807031, 0.01689906,
                                   0.0, 0.0, 1.0);
 const cv::Point3f lidar_noise(0.4, 0.4, 0.4);
 
-std::vector<cv::Mat> readImages(std::string_view folder_path) {
-    if (!std::filesystem::exists(folder_path)) {
-        throw std::runtime_error(std::string(folder_path) + " does not exist");
-    }
-
-    std::vector<cv::Mat> images;
-    for (int i = 0; i < 10; ++i) {
-        std::string filename =
-            std::filesystem::path(folder_path) / (std::to_string(i) + ".jpg");
-        if (!std::filesystem::exists(filename)) {
-            throw std::runtime_error(filename + " does not exist");
-        }
-        cv::Mat image = cv::imread(filename);
-        images.emplace_back(image);
-    }
-    return images;
-}
-
-auto readClouds(std::string_view folder_path)
-    -> std::pair<pcl::PointCloud<pcl::PointXYZ>::Ptr,
-                 std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>> {
-    if (!std::filesystem::exists(folder_path)) {
-        throw std::runtime_error(std::string(folder_path) + " does not exist");
-    }
-
-    std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds;
-    for (int i = 0; i < 10; ++i) {
-        std::string filename =
-            std::filesystem::path(folder_path) / (std::to_string(i) + ".pcd");
-        if (!std::filesystem::exists(filename)) {
-            throw std::runtime_error(filename + " does not exist");
-        }
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(
-            new pcl::PointCloud<pcl::PointXYZ>());
-        pcl::io::loadPCDFile(filename, *cloud);
-        clouds.emplace_back(cloud);
-    }
-
-    pcl::PointCloud<pcl::PointXYZ>::Ptr background_cloud(
-        new pcl::PointCloud<pcl::PointXYZ>());
-    std::string filename =
-        std::filesystem::path(folder_path) / "background.pcd";
-    if (!std::filesystem::exists(filename)) {
-        throw std::runtime_error(filename + " does not exist");
-    }
-    pcl::io::loadPCDFile(filename, *background_cloud);
-
-    return std::make_pair(background_cloud, clouds);
-}
-
 int main() {
+    // Frames are read from disk rather than from a camera, so the pipeline
+    // blocks on a full queue instead of dropping frames.
     SampleRadar radar("../models/car.engine", "../models/armor.engine",
                       image_size, intrinsic, lidar_to_camera, world_to_camera,
-                      lidar_noise);
+                      lidar_noise, 2, OverflowPolicy::Block);
 
     auto images = readImages("../assets/images");
     auto [background_cloud, clouds] = readClouds("../assets/clouds");
@@ -84,16 +40,53 @@ int main() {
     const auto start_time = std::chrono::high_resolution_clock::now();
     const auto duration = std::chrono::milliseconds(100);
 
-    radar.updateBackgroundCloud(background_cloud);
+    // The background projected once is saved and loaded on the next start,
+    // and projected again if it is missing or built with another calibration.
+    const std::filesystem::path background_path{"../models/background.depth"};
+    bool background_loaded{false};
+    if (std::filesystem::exists(background_path)) {
+        try {
+            radar.loadBackground(background_path.string());
+            background_loaded = true;
+        } catch (const std::runtime_error& ex) {
+            std::cerr << "failed to load " << background_path << ": "
+                      << ex.what() << ", rebuilding" << std::endl;
+        }
+    }
+    if (!background_loaded) {
+        radar.updateBackgroundCloud(background_cloud);
+        radar.saveBackground(background_path.string());
+    }
+
+#ifdef RADAR_ENABLE_METRICS
+    metrics::setTracing(true);
+#endif
+    radar.start();
+    std::jthread producer([&] {
+        for (size_t i = 0; i < images.size(); ++i) {
+            const auto& image = images[i];
+            const auto& cloud = clouds[i];
+            const auto timestamp = start_time + i * duration;
 
-    for (size_t i = 0; i < images.size(); ++i) {
-        const auto& image = images[i];
-        const auto& cloud = clouds[i];
-        const auto timestamp = start_time + i * duration;
+            radar.submit(Frame(image, cloud, timestamp));
+        }
+        radar.stop();
+    });
 
-        Frame frame(image, cloud, timestamp);
-        radar.runOnce(frame);
+    while (auto result = radar.receive()) {
+        const auto& [frame, robots] = result.value();
+        radar.visualize(frame, robots);
     }
 
+#ifdef RADAR_ENABLE_METRICS
+    // Latencies are printed and saved, and the trace can be opened by Perfetto
+    metrics::StreamSink summary;
+    metrics::report(summary);
+    metrics::CsvSink csv("metrics.csv");
+    metrics::report(csv);
+    metrics::ChromeTraceSink trace("trace.json");
+    metrics::report(trace);
+#endif
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,57 @@
+#include <chrono>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "assets.h"
+#include "multi_camera_radar.h"
+
+const cv::Size image_size(2592, 2048);
+const cv::Matx33f intrinsic(1685.51538398561, 0, 1278.99324114319, 0,
+                            1685.26471848220, 1037.21273138299, 0, 0, 1);
+const cv::Matx44f lidar_to_camera(0, -1, 0, 0.85443, 0, 0, -1, -37.6845, 1, 0,
+                                  0, 12.2631, 0.0, 0.0, 0.0, 1.0);
+const cv::Matx44f world_to_camera(0.05975021, 0.99807031, 0.01689906,
+                                  -7179.65399136, 0.28962566, -0.00113262,
+                                  -0.95713933, -4671.34956587, -0.9552732,
+                                  0.06208368, -0.28913445, 28286.8920291, 0.0,
+                                  0.0, 0.0, 1.0);
+const cv::Point3f lidar_noise(0.4, 0.4, 0.4);
+constexpr int kCameraNum = 2;
+
+int main() {
+    // The assets are recorded by one camera, which is repeated here to stand
+    // for several cameras sharing the same calibration.
+    std::vector<CameraParam> cameras(
+        kCameraNum, CameraParam{.image_size = image_size,
+                                .intrinsic = intrinsic,
+                                .lidar_to_camera = lidar_to_camera,
+                                .world_to_camera = world_to_camera});
+    MultiCameraRadar radar("../models/car.engine", "../models/armor.engine",
+                           cameras, lidar_noise);
+
+    auto images = readImages("../assets/images");
+    auto [background_cloud, clouds] = readClouds("../assets/clouds");
+    if (images.size() != clouds.size()) {
+        throw std::logic_error("sizes do not match");
+    }
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    const auto duration = std::chrono::milliseconds(100);
+
+    for (size_t camera = 0; camera < radar.cameras(); ++camera) {
+        radar.updateBackgroundCloud(camera, background_cloud);
+    }
+
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto timestamp = start_time + i * duration;
+        for (size_t camera = 0; camera < radar.cameras(); ++camera) {
+            radar.submit(camera, Frame(images[i], clouds[i], timestamp));
+        }
+        auto robots = radar.runOnce();
+        std::cout << "frame " << i << ": " << robots.size() << " robots"
+                  << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
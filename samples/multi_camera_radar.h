@@ -0,0 +1,212 @@
+/**
+ * @file multi_camera_radar.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file is a sample detecting, locating and tracking with several
+ * cameras sharing one detector.
+ * @date 2024-04-14
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "frame.h"
+#include "radar.h"
+#include "utils/thread_pool.h"
+
+using namespace radar;
+
+/**
+ * @brief The calibration of one camera.
+ *
+ */
+struct CameraParam {
+    cv::Size image_size;
+    cv::Matx33f intrinsic;
+    // The transform matrix(4x4) from lidar coordinate to camera coordinate.
+    cv::Matx44f lidar_to_camera;
+    // The transform matrix(4x4) from world coordinate to camera coordinate.
+    cv::Matx44f world_to_camera;
+};
+
+/**
+ * @brief A sample class of detecting, locating and tracking with several
+ * cameras.
+ *
+ * Every camera keeps only its latest frame. Each cycle gathers the latest
+ * frames of all cameras, detects cars in them as one batch and armors in the
+ * cars of all cameras as shared batches, so a single detector with one set of
+ * engines, contexts and device buffers serves every camera. The robots of each
+ * camera are located by the locator with its own extrinsics, and the robots of
+ * all cameras are given to one tracker in world coordinate.
+ *
+ */
+class MultiCameraRadar {
+   public:
+    static constexpr int kClassNum = 12;
+    static constexpr int kMaxBatchSize = 20;
+    static constexpr int kOptBatchSize = 4;
+
+    /**
+     * @brief Constructor of the class
+     *
+     * @param car_path Filename of the car TensorRT engine.
+     * @param armor_path Filename of the armor TensorRT engine.
+     * @param cameras The calibration of each camera.
+     * @param lidar_noise The uncertainty of points provided by the lidar(m).
+     * @throws `std::invalid_argument` if no camera is given.
+     */
+    MultiCameraRadar(std::string_view car_path, std::string_view armor_path,
+                     std::span<const CameraParam> cameras,
+                     const cv::Point3f& lidar_noise)
+        : thread_pool_(std::make_unique<ThreadPool>()),
+          tracker_(std::make_unique<BasicTracker<kClassNum>>(
+              lidar_noise, kClassNum)),
+          latest_frames_(cameras.size()) {
+        if (cameras.empty()) {
+            throw std::invalid_argument("no camera is given");
+        }
+        size_t image_size{0};
+        for (const auto& camera : cameras) {
+            image_size = std::max(image_size, camera.image_size.area() * 3UL);
+            locators_.emplace_back(std::make_unique<Locator>(
+                camera.image_size.width, camera.image_size.height,
+                camera.intrinsic, camera.lidar_to_camera,
+                camera.world_to_camera));
+        }
+        detector_ = std::make_unique<RobotDetector>(
+            car_path, armor_path, kClassNum, kMaxBatchSize, kOptBatchSize,
+            0.75f, 0.65f, 0.25f, 0.65f, 0.50f, image_size, 640, 640, "images",
+            3, 5, static_cast<int>(cameras.size()));
+        tracker_->setThreadPool(thread_pool_.get());
+    }
+
+    /**
+     * @brief Gets the number of cameras.
+     *
+     * @return The number of cameras.
+     */
+    inline size_t cameras() const noexcept { return locators_.size(); }
+
+    void submit(size_t camera, Frame frame);
+
+    std::vector<Robot> runOnce();
+
+    void updateBackgroundCloud(
+        size_t camera, const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud);
+
+   private:
+    MultiCameraRadar() = delete;
+
+    std::unique_ptr<ThreadPool> thread_pool_;
+    std::unique_ptr<RobotDetector> detector_;
+    std::vector<std::unique_ptr<Locator>> locators_;
+    std::unique_ptr<BasicTracker<kClassNum>> tracker_;
+    std::vector<std::optional<Frame>> latest_frames_;
+    std::mutex frames_mutex_;
+};
+
+/**
+ * @brief Submits a frame of a camera, which replaces the frame of the camera
+ * not processed yet.
+ *
+ * @param camera The index of the camera.
+ * @param frame A frame object including an image, a point cloud and a time
+ * stamp.
+ * @throws `std::out_of_range` if the index of the camera is out of range.
+ */
+void MultiCameraRadar::submit(size_t camera, Frame frame) {
+    std::lock_guard lock(frames_mutex_);
+    latest_frames_.at(camera) = std::move(frame);
+}
+
+/**
+ * @brief Updates the background depth map of a camera using the input cloud,
+ * which is pre-processed so no depth is rejected in freezing.
+ *
+ * @param camera The index of the camera.
+ * @param cloud The pointer of a point cloud containing the background.
+ * @throws `std::out_of_range` if the index of the camera is out of range.
+ */
+void MultiCameraRadar::updateBackgroundCloud(
+    size_t camera, const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) {
+    auto& locator{*locators_.at(camera)};
+    locator.resetBackground();
+    locator.accumulateBackground(cloud);
+    locator.freezeBackground(1, 0);
+}
+
+/**
+ * @brief The complete task of detecting, locating and tracking on the latest
+ * frames of all cameras.
+ *
+ * Cameras without a new frame since the last cycle are skipped, and the
+ * tracker is updated with the latest time stamp among the gathered frames.
+ *
+ * @return The vector of robots detected by all cameras.
+ */
+std::vector<Robot> MultiCameraRadar::runOnce() {
+    std::vector<size_t> cameras;
+    std::vector<Frame> frames;
+    {
+        std::lock_guard lock(frames_mutex_);
+        for (size_t i = 0; i < latest_frames_.size(); ++i) {
+            auto& frame{latest_frames_[i]};
+            if (frame.has_value() && frame->image().has_value()) {
+                cameras.emplace_back(i);
+                frames.emplace_back(std::move(frame.value()));
+            }
+            frame.reset();
+        }
+    }
+    if (frames.empty()) {
+        return {};
+    }
+
+    std::vector<cv::Mat> images;
+    images.reserve(frames.size());
+    auto timestamp{std::chrono::high_resolution_clock::time_point()};
+    for (const auto& frame : frames) {
+        images.emplace_back(frame.image().value());
+        timestamp = std::max(timestamp, frame.timestamp().value_or(timestamp));
+    }
+    if (timestamp.time_since_epoch().count() == 0) {
+        timestamp = std::chrono::high_resolution_clock::now();
+    }
+
+    auto robots_batch{detector_->detect(images)};
+
+    std::vector<Robot> robots;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        auto& locator{*locators_[cameras[i]]};
+        if (auto points = frames[i].points(); points.has_value()) {
+            locator.update(points->x, points->y, points->z);
+        } else {
+            locator.update(frames[i].point_cloud().value_or(nullptr));
+        }
+        locator.cluster();
+        locator.search(robots_batch[i]);
+        std::move(robots_batch[i].begin(), robots_batch[i].end(),
+                  std::back_inserter(robots));
+    }
+
+    tracker_->update(robots, timestamp);
+    return robots;
+}
@@ -0,0 +1,544 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef RADAR_BENCH_NVML
+#include <cuda_runtime.h>
+#include <nvml.h>
+#endif
+
+#include "recording.h"
+#include "sample_radar.h"
+#include "utils/metrics.h"
+
+const cv::Size image_size(2592, 2048);
+const cv::Matx33f intrinsic(1685.51538398561, 0, 1278.99324114319, 0,
+                            1685.26471848220, 1037.21273138299, 0, 0, 1);
+const cv::Matx44f lidar_to_camera(0, -1, 0, 0.85443, 0, 0, -1, -37.6845, 1, 0,
+                                  0, 12.2631, 0.0, 0.0, 0.0, 1.0);
+const cv::Matx44f world_to_camera(0.05975021, 0.99807031, 0.01689906,
+                                  -7179.65399136, 0.28962566, -0.00113262,
+                                  -0.95713933, -4671.34956587, -0.9552732,
+                                  0.06208368, -0.28913445, 28286.8920291, 0.0,
+                                  0.0, 0.0, 1.0);
+const cv::Point3f lidar_noise(0.4, 0.4, 0.4);
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr std::string_view kUsage =
+    "usage: radar_bench <recording> [--car <engine>] [--armor <engine>]\n"
+    "                   [--realtime] [--frames <n>] [--warmup <n>]\n"
+    "                   [--prefetch <n>] [--config <key=value,...>]...\n"
+    "\n"
+    "  --realtime   submit frames at their recorded times and drop the oldest\n"
+    "               frame when the pipeline falls behind, instead of\n"
+    "               submitting them as fast as the pipeline takes them\n"
+    "  --frames     the number of measured frames, replaying the recording\n"
+    "               from the start if it has fewer (default: its size)\n"
+    "  --warmup     the number of frames run before measuring (default: 5)\n"
+    "  --prefetch   read at most <n> frames ahead on a thread instead of\n"
+    "               loading every frame before running (default: 0)\n"
+    "  --config     a configuration to compare, of the keys zoom, cluster\n"
+    "               (grid, voxel or euclidean), cuda (0 or 1), max_batch and\n"
+    "               opt_batch, e.g. zoom=0.5,cluster=voxel,max_batch=8\n";
+
+/**
+ * @brief A configuration of the pipeline compared by the benchmark.
+ *
+ */
+struct BenchConfig {
+    float zoom_factor = 0.5f;
+    ClusterMethod cluster_method = ClusterMethod::Grid;
+    bool use_cuda = false;
+    int max_batch_size = kMaxBatchSize;
+    int opt_batch_size = kOptBatchSize;
+};
+
+/**
+ * @brief The options given on the command line.
+ *
+ */
+struct BenchOptions {
+    std::string recording_path;
+    std::string car_path = "../models/car.engine";
+    std::string armor_path = "../models/armor.engine";
+    bool realtime = false;
+    size_t frames = 0;
+    size_t warmup = 5;
+    size_t prefetch = 0;
+    std::vector<BenchConfig> configs;
+};
+
+/**
+ * @brief The measurements of running one configuration.
+ *
+ */
+struct BenchResult {
+    size_t frames;
+    size_t dropped;
+    double fps;
+    double p50;   // ms
+    double p99;   // ms
+    double max;   // ms
+    double cpu;   // percent of one core
+    std::optional<double> gpu;  // percent
+};
+
+/**
+ * @brief Parses a number, rejecting anything following it.
+ *
+ * @param text The text of the number.
+ * @return The number.
+ * @throws `std::invalid_argument` if the text is not a number.
+ */
+template <typename T>
+static T parseNumber(std::string_view text) {
+    T value{};
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("invalid number: " + std::string(text));
+    }
+    return value;
+}
+
+/**
+ * @brief Parses a configuration such as `zoom=0.5,cluster=voxel`, whose keys
+ * not given keep their defaults.
+ *
+ * @param text The text of the configuration.
+ * @return The configuration.
+ * @throws `std::invalid_argument` if a key or a value is invalid.
+ */
+static BenchConfig parseConfig(std::string_view text) {
+    BenchConfig config;
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        const auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view()
+                                               : text.substr(comma + 1);
+
+        const auto equal = item.find('=');
+        if (equal == std::string_view::npos) {
+            throw std::invalid_argument("invalid config item: " +
+                                        std::string(item));
+        }
+        const auto key = item.substr(0, equal);
+        const auto value = item.substr(equal + 1);
+        if (key == "zoom") {
+            config.zoom_factor = parseNumber<float>(value);
+        } else if (key == "cluster") {
+            if (value == "grid") {
+                config.cluster_method = ClusterMethod::Grid;
+            } else if (value == "voxel") {
+                config.cluster_method = ClusterMethod::Voxel;
+            } else if (value == "euclidean") {
+                config.cluster_method = ClusterMethod::Euclidean;
+            } else {
+                throw std::invalid_argument("invalid cluster method: " +
+                                            std::string(value));
+            }
+        } else if (key == "cuda") {
+            config.use_cuda = parseNumber<int>(value) != 0;
+        } else if (key == "max_batch") {
+            config.max_batch_size = parseNumber<int>(value);
+        } else if (key == "opt_batch") {
+            config.opt_batch_size = parseNumber<int>(value);
+        } else {
+            throw std::invalid_argument("invalid config key: " +
+                                        std::string(key));
+        }
+    }
+    return config;
+}
+
+/**
+ * @brief Describes a configuration in the same format as it is given.
+ *
+ * @param config The configuration.
+ * @return The description of the configuration.
+ */
+static std::string describe(const BenchConfig& config) {
+    const char* cluster = config.cluster_method == ClusterMethod::Grid ? "grid"
+                          : config.cluster_method == ClusterMethod::Voxel
+                              ? "voxel"
+                              : "euclidean";
+    return cv::format("zoom=%.2f,cluster=%s,cuda=%d,max_batch=%d,opt_batch=%d",
+                      config.zoom_factor, cluster, config.use_cuda ? 1 : 0,
+                      config.max_batch_size, config.opt_batch_size);
+}
+
+/**
+ * @brief Parses the command line.
+ *
+ * @return The options, with the default configuration if none is given.
+ * @throws `std::invalid_argument` if an option is invalid.
+ */
+static BenchOptions parseOptions(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string_view {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(std::string(arg) +
+                                            " requires a value");
+            }
+            return argv[++i];
+        };
+        if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--car") {
+            options.car_path = value();
+        } else if (arg == "--armor") {
+            options.armor_path = value();
+        } else if (arg == "--frames") {
+            options.frames = parseNumber<size_t>(value());
+        } else if (arg == "--warmup") {
+            options.warmup = parseNumber<size_t>(value());
+        } else if (arg == "--prefetch") {
+            options.prefetch = parseNumber<size_t>(value());
+        } else if (arg == "--config") {
+            options.configs.emplace_back(parseConfig(value()));
+        } else if (arg.starts_with("--") || !options.recording_path.empty()) {
+            throw std::invalid_argument("invalid argument: " +
+                                        std::string(arg));
+        } else {
+            options.recording_path = arg;
+        }
+    }
+    if (options.recording_path.empty()) {
+        throw std::invalid_argument("no recording is given");
+    }
+    if (options.configs.empty()) {
+        options.configs.emplace_back();
+    }
+    return options;
+}
+
+/**
+ * @brief Gets the CPU time used by all threads of the process.
+ *
+ * @return The user and system time in seconds.
+ */
+static double cpuSeconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval& time) {
+        return static_cast<double>(time.tv_sec) + time.tv_usec * 1e-6;
+    };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+/**
+ * @brief Samples the utilization of the current GPU on a thread, which is only
+ * available when built with NVML.
+ *
+ */
+class GpuSampler {
+   public:
+    GpuSampler() {
+#ifdef RADAR_BENCH_NVML
+        int device_id{0};
+        char bus_id[32]{};
+        if (nvmlInit_v2() != NVML_SUCCESS) {
+            return;
+        }
+        initialized_ = true;
+        if (cudaGetDevice(&device_id) != cudaSuccess ||
+            cudaDeviceGetPCIBusId(bus_id, sizeof(bus_id), device_id) !=
+                cudaSuccess ||
+            nvmlDeviceGetHandleByPciBusId_v2(bus_id, &device_) !=
+                NVML_SUCCESS) {
+            return;
+        }
+        thread_ = std::jthread([this](std::stop_token stop) {
+            while (!stop.stop_requested()) {
+                nvmlUtilization_t utilization;
+                if (nvmlDeviceGetUtilizationRates(device_, &utilization) ==
+                    NVML_SUCCESS) {
+                    sum_ += utilization.gpu;
+                    ++count_;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        });
+#endif
+    }
+
+    GpuSampler(const GpuSampler&) = delete;
+    GpuSampler& operator=(const GpuSampler&) = delete;
+
+    ~GpuSampler() {
+#ifdef RADAR_BENCH_NVML
+        stop();
+        if (initialized_) {
+            nvmlShutdown();
+        }
+#endif
+    }
+
+    /**
+     * @brief Stops sampling.
+     *
+     * @return The mean utilization in percent, or `std::nullopt` if it is not
+     * available.
+     */
+    std::optional<double> stop() {
+#ifdef RADAR_BENCH_NVML
+        if (thread_.joinable()) {
+            thread_.request_stop();
+            thread_.join();
+        }
+        if (count_ > 0) {
+            return sum_ / count_;
+        }
+#endif
+        return std::nullopt;
+    }
+
+#ifdef RADAR_BENCH_NVML
+   private:
+    bool initialized_{false};
+    nvmlDevice_t device_{};
+    double sum_{0.0};
+    size_t count_{0};
+    std::jthread thread_;
+#endif
+};
+
+/**
+ * @brief Gets a percentile of sorted values by the nearest rank.
+ *
+ * @param sorted The values in ascending order.
+ * @param percent The percentile.
+ * @return The percentile, or 0 if there is no value.
+ */
+static double percentile(const std::vector<double>& sorted, double percent) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto rank = static_cast<size_t>(
+        std::ceil(percent / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+/**
+ * @brief Runs the pipeline with one configuration over the recording.
+ *
+ * The pipeline is warmed up by running the first frames synchronously, so
+ * that engines, CUDA contexts and allocations are ready. The other frames are
+ * then submitted to the pipeline, and the latency of each frame is the time
+ * from submitting it to receiving its result.
+ *
+ * @param options The options of the benchmark.
+ * @param config The configuration of the pipeline.
+ * @param recording The recording replayed.
+ * @param preloaded The frames loaded before, or empty to read them during the
+ * run with a prefetcher.
+ * @param background The background point cloud.
+ * @return The measurements of the run.
+ */
+static BenchResult run(const BenchOptions& options, const BenchConfig& config,
+                       const Recording& recording,
+                       const std::vector<RecordedFrame>& preloaded,
+                       const pcl::PointCloud<pcl::PointXYZ>::Ptr& background) {
+    SampleRadar radar(
+        options.car_path, options.armor_path, image_size, intrinsic,
+        lidar_to_camera, world_to_camera, lidar_noise, 2,
+        options.realtime ? OverflowPolicy::DropOldest : OverflowPolicy::Block,
+        config.zoom_factor, config.cluster_method, config.use_cuda,
+        config.max_batch_size, config.opt_batch_size);
+    radar.updateBackgroundCloud(background);
+
+    const size_t begin = options.warmup;
+    const size_t end = begin + options.frames;
+    auto frameAt = [&](size_t index) {
+        return preloaded.empty() ? recording.load(index)
+                                 : preloaded[index % recording.size()];
+    };
+
+    // Frames keep their recorded spacing, so the tracker sees the same time
+    // increments whether or not they are replayed in real time
+    const auto stamp_base = Clock::now();
+    std::unordered_map<Clock::rep, size_t> indices;
+    for (size_t i = begin; i < end; ++i) {
+        indices.emplace((stamp_base + recording.offset(i)).time_since_epoch()
+                            .count(),
+                        i);
+    }
+
+    for (size_t i = 0; i < begin; ++i) {
+        const auto frame = frameAt(i);
+        radar.runOnce(frame.toFrame(stamp_base + recording.offset(i)));
+    }
+#ifdef RADAR_ENABLE_METRICS
+    metrics::reset();
+#endif
+
+    std::optional<RecordingPrefetcher> prefetcher;
+    if (preloaded.empty()) {
+        prefetcher.emplace(recording, begin, end, options.prefetch);
+    }
+    std::vector<Clock::time_point> submit_times(end);
+    std::vector<double> latencies;
+    latencies.reserve(options.frames);
+
+    GpuSampler gpu;
+    const double cpu_begin = cpuSeconds();
+    const auto wall_begin = Clock::now();
+    radar.start();
+
+    std::exception_ptr error;
+    std::jthread producer([&] {
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                RecordedFrame frame;
+                if (prefetcher.has_value()) {
+                    auto next = prefetcher->next();
+                    if (!next.has_value()) {
+                        break;
+                    }
+                    frame = std::move(next.value());
+                } else {
+                    frame = preloaded[i % recording.size()];
+                }
+                if (options.realtime) {
+                    std::this_thread::sleep_until(
+                        wall_begin + recording.offset(i) -
+                        recording.offset(begin));
+                }
+                // Read by the receiver after the frame passes through the
+                // queues of the pipeline, which order the write before it
+                submit_times[i] = Clock::now();
+                radar.submit(frame.toFrame(stamp_base + recording.offset(i)));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        radar.stop();
+    });
+
+    while (auto result = radar.receive()) {
+        const auto received = Clock::now();
+        const auto& frame = result.value().first;
+        const auto index =
+            indices.at(frame.timestamp().value().time_since_epoch().count());
+        latencies.emplace_back(std::chrono::duration<double, std::milli>(
+                                   received - submit_times[index])
+                                   .count());
+    }
+    producer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    const double wall =
+        std::chrono::duration<double>(Clock::now() - wall_begin).count();
+    const double cpu = cpuSeconds() - cpu_begin;
+    std::sort(latencies.begin(), latencies.end());
+
+    return BenchResult{
+        .frames = latencies.size(),
+        .dropped = options.frames - latencies.size(),
+        .fps = static_cast<double>(latencies.size()) / wall,
+        .p50 = percentile(latencies, 50.0),
+        .p99 = percentile(latencies, 99.0),
+        .max = latencies.empty() ? 0.0 : latencies.back(),
+        .cpu = cpu / wall * 100.0,
+        .gpu = gpu.stop(),
+    };
+}
+
+/**
+ * @brief Prints the measurements of the configurations as a table.
+ *
+ * @param configs The configurations.
+ * @param results The measurements of each configuration.
+ */
+static void printResults(const std::vector<BenchConfig>& configs,
+                         const std::vector<BenchResult>& results) {
+    std::cout << std::left << std::setw(56) << "config" << std::right
+              << std::setw(8) << "frames" << std::setw(9) << "dropped"
+              << std::setw(9) << "fps" << std::setw(10) << "p50(ms)"
+              << std::setw(10) << "p99(ms)" << std::setw(10) << "max(ms)"
+              << std::setw(9) << "cpu(%)" << std::setw(9) << "gpu(%)"
+              << '\n';
+    std::cout << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        std::cout << std::left << std::setw(56) << describe(configs[i])
+                  << std::right << std::setw(8) << result.frames
+                  << std::setw(9) << result.dropped << std::setw(9)
+                  << result.fps << std::setw(10) << result.p50
+                  << std::setw(10) << result.p99 << std::setw(10)
+                  << result.max << std::setw(9) << result.cpu << std::setw(9);
+        if (result.gpu.has_value()) {
+            std::cout << result.gpu.value();
+        } else {
+            std::cout << "-";
+        }
+        std::cout << '\n';
+    }
+    std::cout << std::defaultfloat << std::flush;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n\n" << kUsage;
+        return EXIT_FAILURE;
+    }
+
+    const Recording recording(options.recording_path);
+    if (options.frames == 0) {
+        options.frames = recording.size();
+    }
+    const auto background = recording.loadBackground();
+
+    // Every frame is read once and shared by all configurations, so disk
+    // reads are not measured unless prefetching is asked for
+    std::vector<RecordedFrame> preloaded;
+    if (options.prefetch == 0) {
+        const size_t count =
+            std::min(recording.size(), options.warmup + options.frames);
+        preloaded.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            preloaded.emplace_back(recording.load(i));
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (size_t i = 0; i < options.configs.size(); ++i) {
+        const auto& config = options.configs[i];
+        std::cout << "running " << describe(config) << std::endl;
+        results.emplace_back(
+            run(options, config, recording, preloaded, background));
+#ifdef RADAR_ENABLE_METRICS
+        // Latencies of each stage, which are cleared by the next run
+        metrics::StreamSink summary;
+        metrics::report(summary);
+        metrics::CsvSink csv("metrics_" + std::to_string(i) + ".csv");
+        metrics::report(csv);
+#endif
+    }
+
+    std::cout << '\n';
+    printResults(options.configs, results);
+    return EXIT_SUCCESS;
+}
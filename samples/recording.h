@@ -0,0 +1,298 @@
+/**
+ * @file recording.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file reads the frames of a recorded match from disk, either all
+ * at once or ahead of time on a thread, for replaying them to the pipeline.
+ * @date 2024-05-16
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+#include "locate/point_file.h"
+#include "utils/bounded_queue.h"
+
+/**
+ * @brief The image and the point cloud of one recorded frame.
+ *
+ * The point cloud is either read into `cloud`, or viewed as `points` in the
+ * mapped point file of the recording.
+ *
+ */
+struct RecordedFrame {
+    cv::Mat image;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+    std::optional<radar::locate::PointSpans> points;
+
+    /**
+     * @brief Makes a frame of the pipeline from the recorded frame.
+     *
+     * @param timestamp The time stamp of the frame.
+     * @return The frame, which shares the image and the points.
+     */
+    radar::Frame toFrame(
+        std::chrono::high_resolution_clock::time_point timestamp) const {
+        return points.has_value() ? radar::Frame(image, *points, timestamp)
+                                  : radar::Frame(image, cloud, timestamp);
+    }
+};
+
+/**
+ * @brief A recorded match on disk.
+ *
+ * The folder has the same layout as the assets of the samples, which are
+ * `images/<i>.jpg`, `clouds/<i>.pcd` and `clouds/background.pcd` with `i`
+ * counting from 0. The optional `timestamps.txt` has the capture time of each
+ * frame in nanoseconds on its own line, and frames are 100ms apart without
+ * it. Replaying more frames than recorded starts over from the first frame,
+ * continuing the time stamps.
+ *
+ * If `clouds.bin`, a point file written by `convert_recording`, exists, the
+ * clouds of the frames are viewed in its memory map instead of being read
+ * from `clouds/<i>.pcd`, and its time stamps are used without
+ * `timestamps.txt`.
+ *
+ */
+class Recording {
+   public:
+    /**
+     * @brief Opens a recording and counts its frames.
+     *
+     * @param folder_path The folder of the recording.
+     * @throws `std::runtime_error` if the folder, a point cloud of a frame or
+     * a time stamp is missing, the point file is invalid, or no frame is
+     * recorded.
+     */
+    explicit Recording(std::string_view folder_path) : folder_(folder_path) {
+        if (!std::filesystem::exists(folder_)) {
+            throw std::runtime_error(folder_.string() + " does not exist");
+        }
+        if (std::filesystem::exists(pointFilePath())) {
+            points_ = std::make_unique<radar::locate::PointFile>(
+                pointFilePath().string());
+        }
+        while (std::filesystem::exists(imagePath(size_))) {
+            if (!points_ && !std::filesystem::exists(cloudPath(size_))) {
+                throw std::runtime_error(cloudPath(size_).string() +
+                                         " does not exist");
+            }
+            ++size_;
+        }
+        if (size_ == 0) {
+            throw std::runtime_error("no frame is recorded in " +
+                                     folder_.string());
+        }
+        if (points_ && points_->size() < size_) {
+            throw std::runtime_error("missing clouds in " +
+                                     pointFilePath().string());
+        }
+
+        offsets_.reserve(size_);
+        std::ifstream timestamps(folder_ / "timestamps.txt");
+        if (!timestamps.is_open()) {
+            for (size_t i = 0; i < size_; ++i) {
+                offsets_.emplace_back(points_ ? std::chrono::nanoseconds(
+                                                    points_->timestamp(i) -
+                                                    points_->timestamp(0))
+                                              : i * kDefaultPeriod);
+            }
+        } else {
+            int64_t first{0};
+            for (int64_t timestamp; offsets_.size() < size_ &&
+                                    timestamps >> timestamp;) {
+                if (offsets_.empty()) {
+                    first = timestamp;
+                }
+                offsets_.emplace_back(timestamp - first);
+            }
+            if (offsets_.size() < size_) {
+                throw std::runtime_error("missing time stamps in " +
+                                         folder_.string());
+            }
+        }
+        period_ = size_ > 1 ? (offsets_.back() - offsets_.front()) /
+                                  static_cast<int64_t>(size_ - 1)
+                            : kDefaultPeriod;
+    }
+
+    /**
+     * @brief Gets the number of recorded frames.
+     *
+     * @return The number of recorded frames.
+     */
+    inline size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Gets the time of a replayed frame since the first one.
+     *
+     * @param index The index of the replayed frame, which may be larger than
+     * the number of recorded frames.
+     * @return The time since the first frame.
+     */
+    inline std::chrono::nanoseconds offset(size_t index) const noexcept {
+        const auto loop = static_cast<int64_t>(index / size_);
+        return offsets_[index % size_] +
+               loop * (offsets_.back() + period_ - offsets_.front());
+    }
+
+    /**
+     * @brief Reads a frame from disk.
+     *
+     * @param index The index of the replayed frame, which may be larger than
+     * the number of recorded frames.
+     * @return The image and the point cloud of the frame, whose points are
+     * valid as long as the recording if they are in the point file.
+     * @throws `std::runtime_error` if the image or the cloud can not be read.
+     */
+    RecordedFrame load(size_t index) const {
+        index %= size_;
+        RecordedFrame frame{.image = cv::imread(imagePath(index).string())};
+        if (frame.image.empty()) {
+            throw std::runtime_error("failed to read " +
+                                     imagePath(index).string());
+        }
+        if (points_) {
+            frame.points = points_->points(index);
+        } else {
+            frame.cloud = readCloud(cloudPath(index));
+        }
+        return frame;
+    }
+
+    /**
+     * @brief Gets the path of the point file of the recording.
+     *
+     * @return The path of the point file, which may not exist.
+     */
+    inline std::filesystem::path pointFilePath() const {
+        return folder_ / "clouds.bin";
+    }
+
+    /**
+     * @brief Reads the background point cloud from disk.
+     *
+     * @return The pointer of the background point cloud.
+     * @throws `std::runtime_error` if the cloud does not exist or can not be
+     * read.
+     */
+    pcl::PointCloud<pcl::PointXYZ>::Ptr loadBackground() const {
+        const auto path = folder_ / "clouds" / "background.pcd";
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error(path.string() + " does not exist");
+        }
+        return readCloud(path);
+    }
+
+   private:
+    static constexpr std::chrono::nanoseconds kDefaultPeriod =
+        std::chrono::milliseconds(100);
+
+    inline std::filesystem::path imagePath(size_t index) const {
+        return folder_ / "images" / (std::to_string(index) + ".jpg");
+    }
+
+    inline std::filesystem::path cloudPath(size_t index) const {
+        return folder_ / "clouds" / (std::to_string(index) + ".pcd");
+    }
+
+    static pcl::PointCloud<pcl::PointXYZ>::Ptr readCloud(
+        const std::filesystem::path& path) {
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(
+            new pcl::PointCloud<pcl::PointXYZ>());
+        if (pcl::io::loadPCDFile(path.string(), *cloud) != 0) {
+            throw std::runtime_error("failed to read " + path.string());
+        }
+        return cloud;
+    }
+
+    std::filesystem::path folder_;
+    size_t size_{0};
+    std::vector<std::chrono::nanoseconds> offsets_;
+    std::chrono::nanoseconds period_{kDefaultPeriod};
+    std::unique_ptr<radar::locate::PointFile> points_;
+};
+
+/**
+ * @brief Reads the frames of a recording in order on a thread, keeping a
+ * limited number of them ahead of the reader.
+ *
+ * When the recording is too large to be held in memory, this keeps disk reads
+ * out of the replay as long as the disk is faster than the pipeline.
+ *
+ */
+class RecordingPrefetcher {
+   public:
+    /**
+     * @brief Starts reading frames.
+     *
+     * @param recording The recording, which must outlive the prefetcher.
+     * @param begin The index of the first replayed frame.
+     * @param end One past the index of the last replayed frame.
+     * @param depth The maximum number of frames read ahead.
+     */
+    RecordingPrefetcher(const Recording& recording, size_t begin, size_t end,
+                        size_t depth)
+        : queue_(depth) {
+        thread_ = std::jthread([this, &recording, begin, end] {
+            try {
+                for (size_t i = begin; i < end; ++i) {
+                    if (!queue_.push(recording.load(i))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+            queue_.close();
+        });
+    }
+
+    RecordingPrefetcher(const RecordingPrefetcher&) = delete;
+    RecordingPrefetcher& operator=(const RecordingPrefetcher&) = delete;
+
+    ~RecordingPrefetcher() { queue_.close(); }
+
+    /**
+     * @brief Takes the next frame, waiting until it is read.
+     *
+     * @return The next frame, or `std::nullopt` if every frame has been taken.
+     * @throws The exception thrown in reading a frame, after the frames read
+     * before it are taken.
+     */
+    std::optional<RecordedFrame> next() {
+        auto frame = queue_.pop();
+        if (!frame.has_value() && error_) {
+            std::rethrow_exception(error_);
+        }
+        return frame;
+    }
+
+   private:
+    BoundedQueue<RecordedFrame> queue_;
+    // Written before the queue is closed, which orders it before `next` sees
+    // the end of the queue.
+    std::exception_ptr error_;
+    std::jthread thread_;
+};
@@ -19,24 +19,64 @@
 #include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "frame.h"
 #include "radar.h"
+#include "utils/bounded_queue.h"
+#include "utils/sensor_synchronizer.h"
+#include "utils/thread_pool.h"
 
 using namespace radar;
 
 static constexpr int kClassNum = 12;
 static constexpr int kMaxBatchSize = 20;
 static constexpr int kOptBatchSize = 4;
+// The maximum difference between the capture times of an image and the point
+// cloud fused with it, which is half the period of a lidar at 10Hz.
+static constexpr std::chrono::milliseconds kMaxSyncOffset{50};
+// The maximum time an image waits for a later point cloud.
+static constexpr std::chrono::milliseconds kMaxSyncWait{20};
+// The maximum number of crops around predicted robots whose cars are detected
+// as one batch in adaptive detection.
+static constexpr int kMaxCrops = 4;
+// The half edge of the box around a predicted robot projected into the image,
+// in meters like the predicted locations.
+static constexpr float kRobotRadius = 0.4f;
+
+/**
+ * @brief The result of one frame, which is the input frame and the robots
+ * detected, located and tracked in it.
+ *
+ */
+using RadarResult = std::pair<Frame, std::vector<Robot>>;
 
 /**
  * @brief A sample class of using provided libraries for detecting, locating
  * and tracking.
  *
+ * Frames can be processed either synchronously by `runOnce`, or through a
+ * pipeline of persistent stage threads started by `start`. In the pipeline,
+ * the detect stage hands every frame to the locate stage before running
+ * inference, so that projecting and clustering the point cloud of frame N
+ * overlaps with detecting frame N, and searching and tracking frame N overlaps
+ * with detecting frame N+1. Throughput is then bounded by the slowest stage
+ * instead of the sum of all stages.
+ *
+ * When the camera and the lidar are not triggered together, images and point
+ * clouds can instead be given separately by `submitImage` and `submitCloud`
+ * with their own capture times. A synchronizing stage pairs every image with
+ * the nearest point cloud, so the camera runs at its own rate rather than the
+ * rate of the lidar, and the tracker compensates the motion between the two
+ * capture times.
+ *
  */
 class SampleRadar {
    public:
@@ -53,32 +93,160 @@ class SampleRadar {
      * camera coordinate.
      * @param lidar_noise The uncertainty of points provided by the lidar(m).
      * are the same.
+     * @param pipeline_depth The capacity of each queue between pipeline stages.
+     * @param overflow_policy The policy applied when the input or output queue
+     * of the pipeline is full.
+     * @param zoom_factor The zoom factor of the depth images of the locator.
+     * @param cluster_method The method of clustering the foreground points.
+     * @param use_cuda Whether the locator projects and differences depth
+     * images with CUDA.
+     * @param max_batch_size The maximum number of cars whose armors are
+     * detected as one batch.
+     * @param opt_batch_size The batch size the armor engine is optimized for.
      */
     SampleRadar(std::string_view car_path, std::string_view armor_path,
                 cv::Size image_size, const cv::Matx33f& intrinsic,
                 const cv::Matx44f lidar_to_camera,
                 const cv::Matx44f& world_to_camera,
-                const cv::Point3f& lidar_noise)
-        : detector_(std::make_unique<RobotDetector>(
-              car_path, armor_path, kClassNum, kMaxBatchSize, kOptBatchSize)),
-          locator_(std::make_unique<Locator>(image_size.width,
-                                             image_size.height, intrinsic,
-                                             lidar_to_camera, world_to_camera)),
-          tracker_(std::make_unique<Tracker>(lidar_noise, kClassNum)) {}
+                const cv::Point3f& lidar_noise, size_t pipeline_depth = 2,
+                OverflowPolicy overflow_policy = OverflowPolicy::DropOldest,
+                float zoom_factor = 0.5f,
+                ClusterMethod cluster_method = ClusterMethod::Grid,
+                bool use_cuda = false, int max_batch_size = kMaxBatchSize,
+                int opt_batch_size = kOptBatchSize)
+        : thread_pool_(std::make_unique<ThreadPool>()),
+          detector_(std::make_unique<RobotDetector>(
+              car_path, armor_path, kClassNum, max_batch_size, opt_batch_size,
+              0.75f, 0.65f, 0.25f, 0.65f, 0.50f, image_size.area() * 3UL, 640,
+              640, "images", 3, 5, 1, kMaxCrops)),
+          locator_(std::make_unique<Locator>(
+              image_size.width, image_size.height, intrinsic, lidar_to_camera,
+              world_to_camera, zoom_factor, 3, 500, 4000, 400, 8, 1000, 29300,
+              use_cuda, cluster_method)),
+          tracker_(std::make_unique<BasicTracker<kClassNum>>(
+              lidar_noise, kClassNum)),
+          input_queue_(pipeline_depth, overflow_policy),
+          locate_queue_(pipeline_depth),
+          detect_queue_(pipeline_depth),
+          track_queue_(pipeline_depth),
+          output_queue_(pipeline_depth, overflow_policy),
+          synchronizer_(pipeline_depth, kMaxSyncOffset, kMaxSyncWait) {
+        tracker_->setThreadPool(thread_pool_.get());
+    }
+
+    ~SampleRadar() {
+        // Results which have not been received are discarded, so that the
+        // track stage never waits on a full output queue during destruction.
+        output_queue_.close();
+        stop();
+    }
 
     std::vector<Robot> runOnce(const Frame& frame);
 
+    void start();
+
+    void stop();
+
+    bool submit(Frame frame);
+
+    bool submitImage(const cv::Mat& image,
+                     std::chrono::high_resolution_clock::time_point timestamp);
+
+    bool submitCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+                     std::chrono::high_resolution_clock::time_point timestamp);
+
+    std::optional<RadarResult> receive();
+
+    /**
+     * @brief Gets the number of frames discarded at the input of the pipeline
+     * because the downstream stages could not keep up.
+     *
+     * @return The number of dropped frames.
+     */
+    inline size_t dropped() const {
+        return input_queue_.dropped() + synchronizer_.dropped();
+    }
+
+    /**
+     * @brief Enables adaptive detection, in which cars are detected in crops
+     * around the confirmed tracks projected into the image between passes
+     * over the whole image.
+     *
+     * @param full_frame_period The maximum number of frames from one pass over
+     * the whole image to the next one.
+     * @throws `std::invalid_argument` if the period is not positive.
+     * @note This must not be called while the pipeline is running.
+     */
+    inline void setAdaptive(int full_frame_period) {
+        detector_->setAdaptive(full_frame_period);
+    }
+
     void visualize(const Frame& frame, const std::vector<Robot>& robots);
 
     void updateBackgroundCloud(
         const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud);
 
+    /**
+     * @brief Loads the background depth map saved before.
+     *
+     * @param path The path of the background file.
+     * @throws `std::runtime_error` if the file can not be loaded, or it is
+     * built for another image size or calibration.
+     */
+    inline void loadBackground(std::string_view path) {
+        locator_->loadBackground(path);
+    }
+
+    /**
+     * @brief Saves the background depth map, which is loaded on next start
+     * instead of projecting the background point cloud again.
+     *
+     * @param path The path of the background file.
+     * @throws `std::logic_error` if the background is not built.
+     * @throws `std::runtime_error` if the file can not be written.
+     */
+    inline void saveBackground(std::string_view path) const {
+        locator_->saveBackground(path);
+    }
+
    private:
     SampleRadar() = delete;
 
+    std::vector<Robot> detect(const Frame& frame);
+
+    void locate(const Frame& frame);
+
+    void search(std::vector<Robot>& robots);
+
+    void track(const Frame& frame, std::vector<Robot>& robots);
+
+    void detectLoop();
+
+    void locateLoop();
+
+    void trackLoop();
+
+    void syncLoop();
+
+    std::unique_ptr<ThreadPool> thread_pool_;
     std::unique_ptr<RobotDetector> detector_;
     std::unique_ptr<Locator> locator_;
-    std::unique_ptr<Tracker> tracker_;
+    std::unique_ptr<BasicTracker<kClassNum>> tracker_;
+    // Guards the tracker, which is predicted by the detect stage while the
+    // track stage updates it.
+    std::mutex tracker_mutex_;
+    BoundedQueue<Frame> input_queue_;
+    BoundedQueue<Frame> locate_queue_;
+    BoundedQueue<std::vector<Robot>> detect_queue_;
+    BoundedQueue<RadarResult> track_queue_;
+    BoundedQueue<RadarResult> output_queue_;
+    std::vector<std::jthread> stage_threads_;
+    SensorSynchronizer<cv::Mat, pcl::PointCloud<pcl::PointXYZ>::Ptr>
+        synchronizer_;
+    std::jthread sync_thread_;
+    // The capture time of the latest point cloud given to the locator.
+    std::optional<std::chrono::high_resolution_clock::time_point>
+        located_cloud_timestamp_;
 };
 
 /**
@@ -86,43 +254,290 @@ class SampleRadar {
  *
  * @note This function is only used for demonstration using pre-processed
  * background point cloud stored on disk. Actually the acquisition of background
- * is accumulated by the input clouds.
+ * is accumulated by the input clouds. As the cloud is already dense and
+ * filtered, no depth is rejected in freezing.
  *
  * @param cloud The pointer of a point cloud containing the background.
  */
 void SampleRadar::updateBackgroundCloud(
     const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) {
-    locator_->update(cloud);
+    locator_->resetBackground();
+    locator_->accumulateBackground(cloud);
+    locator_->freezeBackground(1, 0);
 }
 
 /**
- * @brief The complete task of detecting, locating and tracking.
+ * @brief Detects robots in the image of the frame.
+ *
+ * If adaptive detection is enabled, the confirmed tracks are predicted to the
+ * time stamp of the frame and projected into the image, around which the
+ * detector looks for their cars.
  *
  * @param frame A frame object including an image, a point cloud and a time
  * stamp.
  * @return The vector of robots detected.
  */
-std::vector<Robot> SampleRadar::runOnce(const Frame& frame) {
-    auto future_locate = std::async(std::launch::async, [&] {
+std::vector<Robot> SampleRadar::detect(const Frame& frame) {
+    if (!detector_->adaptive()) {
+        return detector_->detect(frame.image().value_or(cv::Mat()));
+    }
+
+    const auto timestamp =
+        frame.timestamp().value_or(std::chrono::high_resolution_clock::now());
+    std::vector<cv::Point3f> locations;
+    {
+        std::lock_guard lock(tracker_mutex_);
+        locations = tracker_->predict(timestamp);
+    }
+    std::vector<cv::Rect> predictions;
+    predictions.reserve(locations.size());
+    for (const auto& location : locations) {
+        if (auto rect = locator_->project(location, kRobotRadius);
+            rect.has_value()) {
+            predictions.emplace_back(rect.value());
+        }
+    }
+    return detector_->detect(frame.image().value_or(cv::Mat()), predictions);
+}
+
+/**
+ * @brief Updates the locator with the point cloud of the frame and clusters
+ * the foreground points.
+ *
+ * A point cloud paired with several images by the synchronizer is only given
+ * with the first of them, since the window of the locator counts point clouds
+ * and the clusters of the others are the same.
+ *
+ * @param frame A frame object including an image, a point cloud and a time
+ * stamp.
+ */
+void SampleRadar::locate(const Frame& frame) {
+    if (auto cloud_timestamp = frame.cloud_timestamp();
+        cloud_timestamp.has_value()) {
+        if (cloud_timestamp == located_cloud_timestamp_) {
+            return;
+        }
+        located_cloud_timestamp_ = cloud_timestamp;
+    }
+    if (auto points = frame.points(); points.has_value()) {
+        locator_->update(points->x, points->y, points->z);
+    } else {
         locator_->update(frame.point_cloud().value_or(nullptr));
-        locator_->cluster();
-    });
+    }
+    locator_->cluster();
+}
 
-    auto future_detect = std::async(std::launch::async, [&] {
-        return detector_->detect(frame.image().value_or(cv::Mat()));
-    });
+/**
+ * @brief Searches the location of robots in the clusters of the latest point
+ * cloud given to `locate`.
+ *
+ * @param robots The vector of robots detected in the same frame.
+ */
+void SampleRadar::search(std::vector<Robot>& robots) {
+    locator_->search(robots);
+}
 
+/**
+ * @brief Updates the tracker with the located robots of the frame.
+ *
+ * Tracks are predicted to the capture time of the image, and the locations
+ * measured from a point cloud captured at another time are compensated by the
+ * tracker.
+ *
+ * @param frame A frame object including an image, a point cloud and a time
+ * stamp.
+ * @param robots The vector of robots detected and located in the frame.
+ */
+void SampleRadar::track(const Frame& frame, std::vector<Robot>& robots) {
+    const auto timestamp =
+        frame.timestamp().value_or(std::chrono::high_resolution_clock::now());
+    std::lock_guard lock(tracker_mutex_);
+    tracker_->update(robots, timestamp,
+                     frame.cloud_timestamp().value_or(timestamp));
+}
+
+/**
+ * @brief The complete task of detecting, locating and tracking, which returns
+ * once the frame is done. The point cloud is located on another thread while
+ * the image is detected on the calling thread.
+ *
+ * @param frame A frame object including an image, a point cloud and a time
+ * stamp.
+ * @return The vector of robots detected.
+ * @note This function shares the detector, locator and tracker with the
+ * pipeline, so it must not be called while the pipeline is running.
+ */
+std::vector<Robot> SampleRadar::runOnce(const Frame& frame) {
+    // Locates the point cloud while the image is detected, and waits for it
+    // before searching the robots in the clusters
+    auto future_locate =
+        std::async(std::launch::async, [&] { locate(frame); });
+    auto robots = detect(frame);
     future_locate.get();
+    search(robots);
+    track(frame, robots);
+    return robots;
+}
 
-    auto robots = future_detect.get();
-    locator_->search(robots);
+/**
+ * @brief Starts the stage threads of the pipeline. Frames are then given by
+ * `submit` and results are taken by `receive`.
+ *
+ * @note Calling `start` on a running pipeline has no effect.
+ */
+void SampleRadar::start() {
+    if (!stage_threads_.empty()) {
+        return;
+    }
+    input_queue_.reset();
+    locate_queue_.reset();
+    detect_queue_.reset();
+    track_queue_.reset();
+    output_queue_.reset();
+    synchronizer_.reset();
+    // Forgets the cloud located in the last run, so that a cloud of this run
+    // with the same timestamp is not skipped as already located
+    located_cloud_timestamp_.reset();
 
-    tracker_->update(robots, frame.timestamp().value_or(
-                                 std::chrono::high_resolution_clock::now()));
+    stage_threads_.emplace_back([this] { detectLoop(); });
+    stage_threads_.emplace_back([this] { locateLoop(); });
+    stage_threads_.emplace_back([this] { trackLoop(); });
+    sync_thread_ = std::jthread([this] { syncLoop(); });
+}
 
-    visualize(frame, robots);
+/**
+ * @brief Stops the pipeline. Frames already submitted are processed before the
+ * stage threads exit, and their results can still be taken by `receive`.
+ *
+ * @note With the `Block` policy, results must be taken by `receive` on another
+ * thread while stopping, otherwise the track stage waits for room in the
+ * output queue.
+ */
+void SampleRadar::stop() {
+    // Images waiting in the synchronizer are submitted before the input queue
+    // is closed
+    synchronizer_.close();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+    }
+    input_queue_.close();
+    stage_threads_.clear();  // joins the stage threads in order
+}
 
-    return robots;
+/**
+ * @brief Submits a frame to the pipeline.
+ *
+ * @param frame A frame object including an image, a point cloud and a time
+ * stamp.
+ * @return `true` if the frame is accepted, `false` if the pipeline is stopped.
+ * @note When the input queue is full and the policy is `DropOldest`, the
+ * oldest frame waiting for detection is discarded.
+ */
+bool SampleRadar::submit(Frame frame) {
+    return input_queue_.push(std::move(frame));
+}
+
+/**
+ * @brief Submits an image captured independently of the point clouds, which
+ * is paired with the nearest point cloud before entering the pipeline.
+ *
+ * @param image The image.
+ * @param timestamp The capture time of the image, which must not be earlier
+ * than those of the images submitted before.
+ * @return `true` if the image is accepted, `false` if the pipeline is stopped.
+ * @note When images are submitted faster than they are paired, the oldest
+ * image waiting is discarded.
+ */
+bool SampleRadar::submitImage(
+    const cv::Mat& image,
+    std::chrono::high_resolution_clock::time_point timestamp) {
+    return synchronizer_.pushImage(image, timestamp);
+}
+
+/**
+ * @brief Submits a point cloud captured independently of the images.
+ *
+ * @param cloud The point cloud.
+ * @param timestamp The capture time of the point cloud, which must not be
+ * earlier than those of the point clouds submitted before.
+ * @return `true` if the point cloud is accepted, `false` if the pipeline is
+ * stopped.
+ */
+bool SampleRadar::submitCloud(
+    const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+    std::chrono::high_resolution_clock::time_point timestamp) {
+    return synchronizer_.pushCloud(cloud, timestamp);
+}
+
+/**
+ * @brief Takes the result of the oldest processed frame, waiting until one is
+ * available.
+ *
+ * @return The frame and its robots, or `std::nullopt` if the pipeline is
+ * stopped and every result has been taken.
+ */
+std::optional<RadarResult> SampleRadar::receive() {
+    return output_queue_.pop();
+}
+
+/**
+ * @brief The loop of the detect stage. Each frame is handed to the locate
+ * stage before inference so that both stages work on it at the same time.
+ */
+void SampleRadar::detectLoop() {
+    while (auto frame = input_queue_.pop()) {
+        locate_queue_.push(frame.value());
+        detect_queue_.push(detect(frame.value()));
+    }
+    locate_queue_.close();
+    detect_queue_.close();
+}
+
+/**
+ * @brief The loop of the locate stage. Since the locator keeps the state of the
+ * latest point cloud, searching frame N must finish before the point cloud of
+ * frame N+1 is given, so updating, clustering and searching run in order here.
+ */
+void SampleRadar::locateLoop() {
+    while (auto frame = locate_queue_.pop()) {
+        locate(frame.value());
+        auto robots = detect_queue_.pop();
+        if (!robots.has_value()) {
+            break;
+        }
+        search(robots.value());
+        track_queue_.push(std::make_pair(std::move(frame.value()),
+                                         std::move(robots.value())));
+    }
+    track_queue_.close();
+}
+
+/**
+ * @brief The loop of the track stage.
+ */
+void SampleRadar::trackLoop() {
+    while (auto result = track_queue_.pop()) {
+        auto& [frame, robots] = result.value();
+        track(frame, robots);
+        output_queue_.push(std::move(result.value()));
+    }
+    output_queue_.close();
+}
+
+/**
+ * @brief The loop of the synchronizing stage, which submits every image with
+ * its nearest point cloud as a frame.
+ */
+void SampleRadar::syncLoop() {
+    while (auto pair = synchronizer_.pop()) {
+        auto& [image, image_timestamp, cloud, cloud_timestamp] = pair.value();
+        if (cloud.has_value()) {
+            submit(Frame(image, cloud.value(), image_timestamp,
+                         cloud_timestamp));
+        } else {
+            submit(Frame(image, nullptr, image_timestamp));
+        }
+    }
 }
 
 /**
@@ -0,0 +1,186 @@
+/**
+ * @file calibrator.cu
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file contains the definition of the entropy calibrator used in
+ * building INT8 engines.
+ * @date 2024-04-11
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#include "calibrator.h"
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <opencv2/opencv.hpp>
+
+#include "detector.h"
+
+namespace radar::detect {
+
+/**
+ * @brief Constructs an Int8Calibrator object.
+ *
+ * @param config The configuration of INT8 building.
+ * @param input_width The input width of the network.
+ * @param input_height The input height of the network.
+ * @param input_channels The number of channels of the network.
+ * @throws `std::invalid_argument` if the batch size is not positive.
+ * @throws `std::runtime_error` if there are problems in CUDA operations.
+ * @note If there is no calibration cache, the image directory must contain
+ * images, which are sorted by their paths.
+ */
+Int8Calibrator::Int8Calibrator(const Int8Config& config, int input_width,
+                               int input_height, int input_channels)
+    : config_{config},
+      input_width_{input_width},
+      input_height_{input_height},
+      input_channels_{input_channels} {
+    if (config_.batch_size < 1) {
+        throw std::invalid_argument("batch size must be positive");
+    }
+    if (std::filesystem::is_directory(config_.image_dir)) {
+        for (const auto& entry :
+             std::filesystem::directory_iterator(config_.image_dir)) {
+            auto extension{entry.path().extension().string()};
+            if (entry.is_regular_file() &&
+                (extension == ".jpg" || extension == ".png" ||
+                 extension == ".bmp")) {
+                image_paths_.emplace_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(image_paths_.begin(), image_paths_.end());
+    if (static_cast<int>(image_paths_.size()) > config_.max_images) {
+        image_paths_.resize(config_.max_images);
+    }
+
+    CUDA_CHECK(cudaMalloc(&dev_input_ptr_, config_.batch_size * input_width_ *
+                                               input_height_ * input_channels_ *
+                                               sizeof(float)));
+    CUDA_CHECK(cudaMalloc(&dev_letterbox_ptr_, sizeof(LetterboxParam)));
+}
+
+Int8Calibrator::~Int8Calibrator() {
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_input_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_image_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_letterbox_ptr_));
+}
+
+int32_t Int8Calibrator::getBatchSize() const noexcept {
+    return config_.batch_size;
+}
+
+/**
+ * @brief Gets the next calibration batch in device memory.
+ *
+ * Each image is uploaded and letterboxed by the same kernel as detection, so
+ * the calibration data matches the inputs seen at runtime. Unreadable images
+ * are skipped.
+ *
+ * @param bindings The device pointers of the input bindings to be set.
+ * @param names The names of the input bindings.
+ * @param nb_bindings The number of input bindings.
+ * @return `true` if a full batch is ready, otherwise `false` which ends the
+ * calibration.
+ */
+bool Int8Calibrator::getBatch(void* bindings[], const char* names[],
+                              int32_t nb_bindings) noexcept {
+    if (nb_bindings != 1) {
+        std::cerr << "calibration only supports networks with one input"
+                  << std::endl;
+        return false;
+    }
+
+    int batch{0};
+    size_t input_size{static_cast<size_t>(input_width_) * input_height_ *
+                      input_channels_};
+    while (batch < config_.batch_size && next_image_ < image_paths_.size()) {
+        cv::Mat image{
+            cv::imread(image_paths_[next_image_++], cv::IMREAD_COLOR)};
+        if (image.empty() || image.channels() != input_channels_) {
+            continue;
+        }
+        if (!image.isContinuous()) {
+            image = image.clone();
+        }
+
+        size_t bytes{image.total() * image.elemSize()};
+        if (bytes > image_capacity_) {
+            CUDA_CHECK_NOEXCEPT(cudaFree(dev_image_ptr_));
+            CUDA_CHECK_NOEXCEPT(cudaMalloc(&dev_image_ptr_, bytes));
+            image_capacity_ = bytes;
+        }
+        CUDA_CHECK_NOEXCEPT(cudaMemcpy(dev_image_ptr_, image.data, bytes,
+                                       cudaMemcpyHostToDevice));
+
+        DeviceImage device_image{dev_image_ptr_, image.cols, image.rows,
+                                 image.channels(),
+                                 static_cast<int>(image.step)};
+        PreParam pparam(image.size(), cv::Size(input_width_, input_height_));
+        LetterboxParam param(device_image,
+                             cv::Rect(0, 0, image.cols, image.rows), pparam);
+        CUDA_CHECK_NOEXCEPT(cudaMemcpy(dev_letterbox_ptr_, &param,
+                                       sizeof(LetterboxParam),
+                                       cudaMemcpyHostToDevice));
+
+        dim3 block_size(16, 16);
+        dim3 grid_size((input_width_ + block_size.x - 1) / block_size.x,
+                       (input_height_ + block_size.y - 1) / block_size.y);
+        letterboxKernel<<<grid_size, block_size>>>(
+            dev_letterbox_ptr_, dev_input_ptr_ + batch * input_size,
+            input_width_, input_height_, input_channels_, 1 / 255.f, false);
+        CUDA_CHECK_NOEXCEPT(cudaDeviceSynchronize());
+        ++batch;
+    }
+    if (batch < config_.batch_size) {
+        return false;
+    }
+
+    bindings[0] = dev_input_ptr_;
+    return true;
+}
+
+/**
+ * @brief Reads the calibration cache if it exists.
+ *
+ * @param length The length of the cache, which is set to zero if there is no
+ * cache.
+ * @return The pointer to the cache, or `nullptr` if there is no cache.
+ */
+const void* Int8Calibrator::readCalibrationCache(size_t& length) noexcept {
+    cache_.clear();
+    std::ifstream ifs(config_.cache_path, std::ios::binary);
+    if (ifs) {
+        cache_.assign(std::istreambuf_iterator<char>(ifs),
+                      std::istreambuf_iterator<char>());
+    }
+    length = cache_.size();
+    return cache_.empty() ? nullptr : cache_.data();
+}
+
+/**
+ * @brief Writes the calibration cache, so that later builds skip calibration.
+ *
+ * @param cache The pointer to the cache.
+ * @param length The length of the cache.
+ */
+void Int8Calibrator::writeCalibrationCache(const void* cache,
+                                           size_t length) noexcept {
+    std::ofstream ofs(config_.cache_path, std::ios::binary);
+    if (!ofs) {
+        std::cerr << "failed to write calibration cache " << config_.cache_path
+                  << std::endl;
+        return;
+    }
+    ofs.write(static_cast<const char*>(cache), length);
+}
+
+}  // namespace radar::detect
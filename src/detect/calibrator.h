@@ -0,0 +1,113 @@
+/**
+ * @file calibrator.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file contains the declaration of the INT8 configuration and the
+ * entropy calibrator used in building INT8 engines.
+ * @date 2024-04-11
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <NvInfer.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine_cache.h"
+#include "preparam.h"
+
+namespace radar::detect {
+
+/**
+ * @brief The configuration of building an INT8 engine.
+ *
+ */
+struct Int8Config {
+    // The directory of representative images used in calibration.
+    std::string image_dir;
+    // The path of the calibration cache, which is read instead of calibrating
+    // again if it exists.
+    std::string cache_path;
+    // The number of images in one calibration batch.
+    int batch_size{1};
+    // The maximum number of images used in calibration.
+    int max_images{500};
+    // Layers whose names contain any of these patterns run in FP16.
+    std::vector<std::string> fp16_layers;
+};
+
+/**
+ * @brief Computes the hash of an INT8 configuration used in the engine cache
+ * key.
+ *
+ * The content of the calibration cache is hashed if it exists, since it is
+ * read instead of calibrating, so a new cache never reuses an engine built
+ * with another one.
+ *
+ * @param config The configuration of building an INT8 engine.
+ * @return The hash of the configuration.
+ * @throws `std::runtime_error` if the calibration cache exists but can not be
+ * opened.
+ * @note The calibration images are only identified by their directory, so
+ * the calibration cache must be removed after changing them.
+ */
+inline uint64_t hashInt8Config(const Int8Config& config) {
+    uint64_t hash{fnv1a(config.image_dir)};
+    hash = fnv1a(";" + std::to_string(config.batch_size) + ";" +
+                     std::to_string(config.max_images),
+                 hash);
+    for (const auto& layer : config.fp16_layers) {
+        hash = fnv1a(";" + layer, hash);
+    }
+    if (std::filesystem::exists(config.cache_path)) {
+        hash = fnv1a(";cache=" + std::to_string(hashFile(config.cache_path)),
+                     hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief An entropy calibrator which reads images from a directory and feeds
+ * them to TensorRT through the letterbox preprocessing of the detector.
+ *
+ */
+class Int8Calibrator : public nvinfer1::IInt8EntropyCalibrator2 {
+   public:
+    Int8Calibrator(const Int8Config& config, int input_width, int input_height,
+                   int input_channels);
+
+    ~Int8Calibrator() override;
+
+    Int8Calibrator(const Int8Calibrator&) = delete;
+    Int8Calibrator& operator=(const Int8Calibrator&) = delete;
+
+    int32_t getBatchSize() const noexcept override;
+
+    bool getBatch(void* bindings[], const char* names[],
+                  int32_t nb_bindings) noexcept override;
+
+    const void* readCalibrationCache(size_t& length) noexcept override;
+
+    void writeCalibrationCache(const void* cache,
+                               size_t length) noexcept override;
+
+   private:
+    Int8Config config_;
+    int input_width_, input_height_, input_channels_;
+    std::vector<std::string> image_paths_;
+    size_t next_image_{0};
+    std::vector<char> cache_;
+    float* dev_input_ptr_{nullptr};
+    unsigned char* dev_image_ptr_{nullptr};
+    size_t image_capacity_{0};
+    LetterboxParam* dev_letterbox_ptr_{nullptr};
+};
+
+}  // namespace radar::detect
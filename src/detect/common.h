@@ -17,49 +17,7 @@
 
 #include <stdexcept>
 
-/**
- * @brief Ensures that a CUDA call returns success.
- *
- * This macro wraps a CUDA API function call and checks its return value. If the
- * return value indicates that an error has occurred, it throws a
- * `std::runtime_error` with a message that includes the CUDA error string.
- *
- * @param call The CUDA API function call to check.
- * @throws std::runtime_error If the CUDA API call does not return cudaSuccess.
- * @note This macro is intended for use in functions that allow exceptions.
- */
-#define CUDA_CHECK(call)                                            \
-    do {                                                            \
-        const cudaError_t error_code = call;                        \
-        if (error_code != cudaSuccess) {                            \
-            std::stringstream ss;                                   \
-            ss << "CUDA Error: " << cudaGetErrorString(error_code); \
-            throw std::runtime_error(ss.str());                     \
-        }                                                           \
-    } while (0)
-
-/**
- * @brief Ensures that a CUDA call returns success without throwing exceptions.
- *
- * Similar to `CUDA_CHECK`, this macro wraps a CUDA API function call and checks
- * its return value. However, if the return value indicates that an error has
- * occurred, it writes an error message to `std::cerr` and then calls
- * `std::abort` to terminate the program.
- *
- * @param call The CUDA API function call to check.
- *
- * @note This macro is intended for use in functions that do not allow
- * exceptions (e.g., noexcept).
- */
-#define CUDA_CHECK_NOEXCEPT(call)                                         \
-    do {                                                                  \
-        const cudaError_t error_code = call;                              \
-        if (error_code != cudaSuccess) {                                  \
-            std::cerr << "CUDA Error: " << cudaGetErrorString(error_code) \
-                      << std::endl;                                       \
-            std::abort();                                                 \
-        }                                                                 \
-    } while (0)
+#include "utils/cuda_check.h"
 
 namespace radar::detect {
 
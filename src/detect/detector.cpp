@@ -15,16 +15,22 @@
 #include <NvInferPlugin.h>
 #include <NvOnnxParser.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <execution>
 #include <filesystem>
 #include <fstream>
 #include <future>
+#include <mutex>
 #include <optional>
 #include <ranges>
 #include <span>
 #include <stdexcept>
 #include <string_view>
 
+#include "utils/metrics.h"
+
 namespace radar {
 
 using namespace radar::detect;
@@ -35,138 +41,785 @@ using namespace radar::detect;
  * @param classes The number of classes in detection.
  * @param max_batch_size The maximum batch size.
  * @param opt_barch_size The optimized batch size of `std::optional<int>` type.
- * @param image_size The size of input image or images as bytes.
+ * @param image_size The initial bytes of the input image or images of a
+ * batch, which grow when a larger batch is given.
  * @param nms_thresh The threshold in nms suppression.
  * @param input_width The input width.
  * @param input_height The input height.
  * @param input_name The input name.
  * @param input_channels The number of channels.
  * @param opt_level The optimization level from 0 to 5.
- * @throws `std::invalid_argument` if engine file does not exist and given
- * engine filename does not contain delimeter "."
+ * @param num_slots The number of inference slots, which is the maximum number
+ * of batches in flight.
+ * @param fp16_input Whether the input of the engine is in half precision when
+ * it is built from the onnx file. The preprocessing always follows the input
+ * type of the loaded engine.
+ * @param use_graph Whether the device work of each batch size is captured into
+ * a CUDA graph and replayed, which cuts the launch overhead of small batches.
+ * @param top_k The maximum number of candidates of each image going through
+ * NMS, which are the ones with the highest confidence. It is also the maximum
+ * number of detections of each image.
+ * @param int8 The configuration of building the engine in INT8 with FP16
+ * fallback, or `std::nullopt` to build it in FP16.
+ * @throws `std::invalid_argument` if given engine filename does not contain
+ * delimeter ".", the number of slots or top-k is not positive, or INT8 is used
+ * with half precision input or a calibration batch size out of the profile.
+ * @throws `std::runtime_error` if neither the engine file nor the onnx file
+ * exists, or the engine can not be deserialized.
+ * @note If the engine file exists, it is loaded directly without being
+ * validated, and the INT8 configuration is ignored. Otherwise, or if it can
+ * not be loaded, the engine built from the onnx file with the same name is
+ * cached as `<name>.<key>.engine` in the same directory, where the key is
+ * computed from the onnx file, the device, the version of TensorRT and the
+ * build configuration, and building uses a timing cache shared in the
+ * directory.
  */
 Detector::Detector(std::string_view engine_path, int classes,
                    int max_batch_size, std::optional<int> opt_batch_size,
                    size_t image_size, float nms_thresh, float conf_thresh,
                    int input_width, int input_height,
                    std::string_view input_name, int input_channels,
-                   int opt_level)
+                   int opt_level, int num_slots, bool fp16_input,
+                   bool use_graph, int top_k,
+                   std::optional<Int8Config> int8)
     : input_width_{input_width},
       input_height_{input_height},
       input_channels_{input_channels},
+      max_batch_size_{max_batch_size},
       input_name_{input_name},
       classes_{classes},
       nms_thresh_{nms_thresh},
-      conf_thresh_{conf_thresh} {
+      conf_thresh_{conf_thresh},
+      use_graph_{use_graph},
+      top_k_{top_k},
+      int8_{std::move(int8)} {
+    if (num_slots < 1) {
+        throw std::invalid_argument("number of slots must be positive");
+    }
+    if (top_k < 1) {
+        throw std::invalid_argument("top-k must be positive");
+    }
+    if (int8_ && fp16_input) {
+        throw std::invalid_argument("INT8 does not support half input");
+    }
+    if (int8_ &&
+        (int8_->batch_size < 1 || int8_->batch_size > max_batch_size)) {
+        throw std::invalid_argument("invalid calibration batch size");
+    }
     CUDA_CHECK(cudaSetDevice(0));
     initLibNvInferPlugins(&logger_, "radar");
 
-    for (int i = 0; i < max_batch_size; ++i) {
-        cudaStream_t stream;
-        cudaStreamCreate(&stream);
-        streams_.push_back(stream);
-    }
-
-    std::shared_ptr<char[]> model{nullptr};
-    size_t size{0};
-    // If the engine file does not exist, the data will be fetched through
-    // serializing the onnx file with the same name.
-    if (!std::filesystem::exists(engine_path)) {
-        std::cout << engine_path << " does not exist" << std::endl;
-        // Derives the onnx path based on the engine path, assuming that
-        // *.engine and *.onnx are in the same directory
-        auto pos = engine_path.find_last_of('.');
-        if (pos == std::string_view::npos) {
-            throw std::invalid_argument(
-                "missing delimeter \".\" in engine path");
+    runtime_ = std::unique_ptr<nvinfer1::IRuntime>(
+        nvinfer1::createInferRuntime(logger_));
+
+    // Derives the onnx path based on the engine path, assuming that *.engine
+    // and *.onnx are in the same directory
+    auto pos = engine_path.find_last_of('.');
+    if (pos == std::string_view::npos) {
+        throw std::invalid_argument("missing delimeter \".\" in engine path");
+    }
+    auto onnx_path = std::string(engine_path.substr(0, pos)) + ".onnx";
+    if (!std::filesystem::exists(engine_path) &&
+        !std::filesystem::exists(onnx_path)) {
+        throw std::runtime_error("neither engine nor onnx file exists");
+    }
+
+    // An existing engine file given explicitly is always used, which can not
+    // be validated against the model and its build configuration.
+    if (engine_path != onnx_path && std::filesystem::exists(engine_path)) {
+        std::cout << "loading " << engine_path << " directly" << std::endl;
+        if (int8_) {
+            std::cerr << "INT8 configuration is ignored by loading "
+                      << engine_path << std::endl;
         }
-        auto onnx_path = std::string(engine_path.substr(0, pos)) + ".onnx";
-        std::cout << "onnx path should be " << onnx_path << std::endl;
-        std::tie(model, size) = serializeEngine(
-            onnx_path, opt_batch_size.value_or(std::max(max_batch_size / 2, 1)),
-            max_batch_size, opt_level);
-        // Writes the serialized model to disk
-        try {
-            writeToFile(std::span(model.get(), size), engine_path);
-        } catch (const std::ios_base::failure& ex) {
-            std::cerr << "exception in writing model: " << ex.what()
+        engine_ = deserializeEngine(loadFromFile(engine_path));
+        if (!engine_ && std::filesystem::exists(onnx_path)) {
+            std::cerr << "failed to load " << engine_path
+                      << ", using the engine cache of " << onnx_path
+                      << std::endl;
+        }
+    }
+    // Otherwise, if the onnx file exists, the engine is looked up in the cache
+    // by a key of the model, platform and build configuration, and built and
+    // cached if missing or unloadable, so that stale engines are never used.
+    if (!engine_ && std::filesystem::exists(onnx_path)) {
+        EngineProfile profile{.min_batch_size = 1,
+                              .opt_batch_size = opt_batch_size.value_or(
+                                  std::max(max_batch_size / 2, 1)),
+                              .max_batch_size = max_batch_size,
+                              .input_channels = input_channels,
+                              .input_width = input_width,
+                              .input_height = input_height,
+                              .fp16 = true,
+                              .fp16_input = fp16_input,
+                              .opt_level = opt_level,
+                              .int8 = int8_.has_value(),
+                              .calibration =
+                                  int8_ ? hashInt8Config(*int8_) : 0,
+                              .input_name = std::string(input_name)};
+        auto cached_path{
+            cachedEnginePath(engine_path, engineKey(onnx_path, profile))};
+        if (std::filesystem::exists(cached_path)) {
+            engine_ = deserializeEngine(loadFromFile(cached_path));
+            if (!engine_) {
+                std::cerr << "failed to load cached engine " << cached_path
+                          << ", rebuilding" << std::endl;
+            }
+        }
+        if (!engine_) {
+            std::cout << "building " << cached_path << " from " << onnx_path
                       << std::endl;
+            auto model{serializeEngine(onnx_path, profile,
+                                       timingCachePath(engine_path))};
+            // Calibrating writes the calibration cache, which the engine is
+            // keyed by from now on
+            if (int8_) {
+                profile.calibration = hashInt8Config(*int8_);
+                cached_path = cachedEnginePath(engine_path,
+                                               engineKey(onnx_path, profile));
+            }
+            // Writes the serialized model to the cache
+            try {
+                writeToFile(std::span(model.first.get(), model.second),
+                            cached_path);
+            } catch (const std::ios_base::failure& ex) {
+                std::cerr << "exception in writing model: " << ex.what()
+                          << std::endl;
+            }
+            engine_ = deserializeEngine(model);
         }
     }
-    // Otherwise, it will be directly read from the engine file.
-    else {
-        std::tie(model, size) = loadFromFile(engine_path);
+    if (!engine_) {
+        throw std::runtime_error(
+            "failed to deserialize engine, which may be built by another "
+            "version of TensorRT or for another device");
     }
 
-    // Creates execution context of TensorRT
-    runtime_ = std::unique_ptr<nvinfer1::IRuntime>(
-        nvinfer1::createInferRuntime(logger_));
-    engine_ = std::unique_ptr<nvinfer1::ICudaEngine>(
-        runtime_->deserializeCudaEngine(static_cast<void*>(model.get()), size));
-    context_ = std::unique_ptr<nvinfer1::IExecutionContext>(
-        engine_->createExecutionContext());
-
-    // Sets tensor addresses for input and output tensors in the execution
-    // context
-    for (int i = 0; i < engine_->getNbIOTensors(); ++i) {
-        auto name = engine_->getIOTensorName(i);
-        auto mode = engine_->getTensorIOMode(name);
-        if (mode == nvinfer1::TensorIOMode::kINPUT) {
-            auto dims = engine_->getProfileShape(
-                name, 0, nvinfer1::OptProfileSelector::kMAX);
-            auto dtype = engine_->getTensorDataType(name);
-            input_tensor_ = Tensor(dims, dtype, name, max_batch_size);
-        } else if (mode == nvinfer1::TensorIOMode::kOUTPUT) {
-            auto dims = context_->getTensorShape(name);
-            auto dtype = engine_->getTensorDataType(name);
-            output_tensor_ = Tensor(dims, dtype, name, max_batch_size);
-        } else {
-            continue;
+#ifdef RADAR_ENABLE_METRICS
+    // Registers the sites here, so that reporting never allocates or throws
+    timing_sites_ = {metrics::registerSite("detect.gpu.letterbox"),
+                     metrics::registerSite("detect.gpu.infer"),
+                     metrics::registerSite("detect.gpu.postprocess")};
+#endif
+
+    for (int i = 0; i < num_slots; ++i) {
+        auto slot{std::make_unique<Slot>()};
+        // Each slot has its own execution context, since a context can not be
+        // enqueued again before the previous enqueue has finished
+        slot->context = std::unique_ptr<nvinfer1::IExecutionContext>(
+            engine_->createExecutionContext());
+
+        // Sets tensor addresses for input and output tensors in the execution
+        // context
+        for (int j = 0; j < engine_->getNbIOTensors(); ++j) {
+            auto name = engine_->getIOTensorName(j);
+            auto mode = engine_->getTensorIOMode(name);
+            if (mode == nvinfer1::TensorIOMode::kINPUT) {
+                auto dims = engine_->getProfileShape(
+                    name, 0, nvinfer1::OptProfileSelector::kMAX);
+                auto dtype = engine_->getTensorDataType(name);
+                slot->input_tensor = Tensor(dims, dtype, name, max_batch_size);
+            } else if (mode == nvinfer1::TensorIOMode::kOUTPUT) {
+                auto dims = slot->context->getTensorShape(name);
+                auto dtype = engine_->getTensorDataType(name);
+                slot->output_tensor = Tensor(dims, dtype, name, max_batch_size);
+            } else {
+                continue;
+            }
+        }
+        slot->context->setTensorAddress(slot->input_tensor.name(),
+                                        slot->input_tensor.data());
+        slot->context->setTensorAddress(slot->output_tensor.name(),
+                                        slot->output_tensor.data());
+        output_channels_ = slot->output_tensor.dims().d[1];
+        output_anchors_ = slot->output_tensor.dims().d[2];
+
+        for (int j = 0; j < max_batch_size; ++j) {
+            cudaStream_t stream;
+            CUDA_CHECK(cudaStreamCreate(&stream));
+            slot->streams.push_back(stream);
+            cudaEvent_t event;
+            CUDA_CHECK(
+                cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+            slot->join_events.push_back(event);
+        }
+        CUDA_CHECK(cudaEventCreateWithFlags(&slot->infer_event,
+                                            cudaEventDisableTiming));
+        CUDA_CHECK(cudaEventCreateWithFlags(&slot->done_event,
+                                            cudaEventDisableTiming));
+#ifdef RADAR_ENABLE_METRICS
+        for (auto& event : slot->timing_events) {
+            CUDA_CHECK(cudaEventCreate(&event));
         }
+#endif
+        slot->graphs.resize(max_batch_size + 1, nullptr);
+
+        // Allocate host and device memory
+        CUDA_CHECK(cudaHostAlloc(&slot->image_ptr, image_size,
+                                 cudaHostAllocDefault));
+        CUDA_CHECK(cudaMalloc(&slot->dev_image_ptr, image_size));
+        slot->image_capacity = image_size;
+        CUDA_CHECK(cudaHostAlloc(&slot->letterbox_ptr,
+                                 max_batch_size * sizeof(LetterboxParam),
+                                 cudaHostAllocDefault));
+        CUDA_CHECK(cudaMalloc(&slot->dev_letterbox_ptr,
+                              max_batch_size * sizeof(LetterboxParam)));
+        CUDA_CHECK(cudaMalloc(&slot->dev_transpose_ptr,
+                              output_channels_ * output_anchors_ *
+                                  max_batch_size * sizeof(float)));
+        CUDA_CHECK(cudaMalloc(
+            &slot->dev_decode_ptr,
+            output_anchors_ * max_batch_size * sizeof(Detection)));
+        size_t candidates{static_cast<size_t>(output_anchors_) *
+                          max_batch_size};
+        CUDA_CHECK(cudaMalloc(&slot->dev_key_ptr, candidates * sizeof(float)));
+        CUDA_CHECK(
+            cudaMalloc(&slot->dev_sorted_key_ptr, candidates * sizeof(float)));
+        CUDA_CHECK(cudaMalloc(&slot->dev_index_ptr, candidates * sizeof(int)));
+        CUDA_CHECK(
+            cudaMalloc(&slot->dev_sorted_index_ptr, candidates * sizeof(int)));
+        // The segment of each image begins at a fixed offset in the candidate
+        // arrays
+        std::vector<int> begins(max_batch_size);
+        for (int j = 0; j < max_batch_size; ++j) {
+            begins[j] = j * output_anchors_;
+        }
+        CUDA_CHECK(
+            cudaMalloc(&slot->dev_begin_ptr, max_batch_size * sizeof(int)));
+        CUDA_CHECK(cudaMemcpy(slot->dev_begin_ptr, begins.data(),
+                              max_batch_size * sizeof(int),
+                              cudaMemcpyHostToDevice));
+        CUDA_CHECK(
+            cudaMalloc(&slot->dev_end_ptr, max_batch_size * sizeof(int)));
+        slot->sort_storage_bytes =
+            sortStorageBytes(candidates, max_batch_size);
+        CUDA_CHECK(cudaMalloc(&slot->dev_sort_storage_ptr,
+                              slot->sort_storage_bytes));
+        size_t words{(static_cast<size_t>(top_k) + 63) / 64};
+        CUDA_CHECK(cudaMalloc(&slot->dev_mask_ptr,
+                              words * top_k * max_batch_size *
+                                  sizeof(unsigned long long)));
+        CUDA_CHECK(
+            cudaMalloc(&slot->dev_count_ptr, max_batch_size * sizeof(int)));
+        CUDA_CHECK(cudaHostAlloc(&slot->count_ptr, max_batch_size * sizeof(int),
+                                 cudaHostAllocDefault));
+        // The survivors of NMS are written by the GPU straight into mapped
+        // memory, so that only they cross PCIe
+        CUDA_CHECK(cudaHostAlloc(&slot->output_ptr,
+                                 top_k * max_batch_size * sizeof(Detection),
+                                 cudaHostAllocMapped));
+
+        slots_.emplace_back(std::move(slot));
     }
-    context_->setTensorAddress(input_tensor_.name(), input_tensor_.data());
-    context_->setTensorAddress(output_tensor_.name(), output_tensor_.data());
-    output_channels_ = output_tensor_.dims().d[1];
-    output_anchors_ = output_tensor_.dims().d[2];
-
-    // Allocate host and device memory
-    CUDA_CHECK(cudaHostAlloc(&image_ptr_, image_size, cudaHostAllocMapped));
-    CUDA_CHECK(cudaMalloc(&dev_resize_ptr_,
-                          input_height * input_width * input_channels *
-                              max_batch_size * sizeof(unsigned char)));
-    CUDA_CHECK(cudaMalloc(&dev_border_ptr_,
-                          input_height * input_width * input_channels *
-                              max_batch_size * sizeof(unsigned char)));
-    CUDA_CHECK(cudaMalloc(
-        &dev_transpose_ptr_,
-        output_channels_ * output_anchors_ * max_batch_size * sizeof(float)));
-    CUDA_CHECK(cudaMalloc(&dev_decode_ptr_, output_anchors_ * max_batch_size *
-                                                sizeof(Detection)));
-    CUDA_CHECK(cudaHostAlloc(
-        &nms_ptr_, output_anchors_ * max_batch_size * sizeof(Detection),
-        cudaHostAllocDefault));
 }
 
 Detector::~Detector() {
-    CUDA_CHECK_NOEXCEPT(cudaFree(dev_border_ptr_));
-    CUDA_CHECK_NOEXCEPT(cudaFree(dev_resize_ptr_));
-    CUDA_CHECK_NOEXCEPT(cudaFree(dev_transpose_ptr_));
-    CUDA_CHECK_NOEXCEPT(cudaFree(dev_decode_ptr_));
-    CUDA_CHECK_NOEXCEPT(cudaFreeHost(image_ptr_));
-    CUDA_CHECK_NOEXCEPT(cudaFreeHost(nms_ptr_));
-    for (auto&& stream : streams_) {
-        CUDA_CHECK_NOEXCEPT(cudaStreamDestroy(stream));
+    for (auto&& slot : slots_) {
+        CUDA_CHECK_NOEXCEPT(cudaEventSynchronize(slot->done_event));
+        for (auto&& graph_exec : slot->graphs) {
+            if (graph_exec) {
+                CUDA_CHECK_NOEXCEPT(cudaGraphExecDestroy(graph_exec));
+            }
+        }
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_image_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_letterbox_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFreeHost(slot->letterbox_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_transpose_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_decode_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFreeHost(slot->image_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_key_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_sorted_key_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_index_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_sorted_index_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_begin_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_end_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_sort_storage_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_mask_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFree(slot->dev_count_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFreeHost(slot->count_ptr));
+        CUDA_CHECK_NOEXCEPT(cudaFreeHost(slot->output_ptr));
+        for (auto&& event : slot->join_events) {
+            CUDA_CHECK_NOEXCEPT(cudaEventDestroy(event));
+        }
+        CUDA_CHECK_NOEXCEPT(cudaEventDestroy(slot->infer_event));
+        CUDA_CHECK_NOEXCEPT(cudaEventDestroy(slot->done_event));
+        for (auto&& event : slot->timing_events) {
+            if (event) {
+                CUDA_CHECK_NOEXCEPT(cudaEventDestroy(event));
+            }
+        }
+        for (auto&& stream : slot->streams) {
+            CUDA_CHECK_NOEXCEPT(cudaStreamDestroy(stream));
+        }
+    }
+}
+
+/**
+ * @brief Enqueues detection on regions of an image which is already in device
+ * memory without waiting for the result.
+ *
+ * Every region is cropped and letterboxed into one input of the batch by a
+ * single kernel reading the device image, so the image does not cross PCIe
+ * again and no host copy of the regions is made. A typical source is the
+ * image of another ticket, obtained by `DetectionTicket::image`.
+ *
+ * @param image The image in device memory, whose number of channels must be
+ * equal to `input_channels_`.
+ * @param rois The regions of the image forming the batch, each of which lies
+ * in the image and is nonempty.
+ * @return `DetectionTicket` The ticket used to wait for the detections, whose
+ * detections are relative to the top-left corner of each region.
+ * @throws `std::invalid_argument` if the number of regions is zero or exceeds
+ * the maximum batch size, or a region is empty or out of the image, or the
+ * image has a different number of channels.
+ * @throws `std::runtime_error` if every slot is occupied by a ticket.
+ * @note The image must stay valid and unmodified until the returned ticket has
+ * finished, and the operations writing it must have finished before calling.
+ */
+DetectionTicket Detector::enqueue(const DeviceImage& image,
+                                  std::span<const cv::Rect> rois) {
+    std::vector<Region> regions;
+    regions.reserve(rois.size());
+    for (const auto& roi : rois) {
+        regions.emplace_back(Region{.image = image, .rect = roi});
+    }
+    return enqueue(regions);
+}
+
+/**
+ * @brief Enqueues detection on regions of images which are already in device
+ * memory without waiting for the result.
+ *
+ * This is the same as enqueuing regions of one image, except that every region
+ * names its own image, so the regions of several images, such as the frames of
+ * several cameras, are detected as one batch.
+ *
+ * @param regions The regions forming the batch, each of which lies in its
+ * image, and the number of channels of every image must be equal to
+ * `input_channels_`.
+ * @return `DetectionTicket` The ticket used to wait for the detections, whose
+ * detections are relative to the top-left corner of each region.
+ * @throws `std::invalid_argument` if the number of regions is zero or exceeds
+ * the maximum batch size, or a region is empty or out of its image, or an
+ * image has a different number of channels.
+ * @throws `std::runtime_error` if every slot is occupied by a ticket.
+ * @note The images must stay valid and unmodified until the returned ticket
+ * has finished, and the operations writing them must have finished before
+ * calling.
+ */
+DetectionTicket Detector::enqueue(std::span<const Region> regions) {
+    if (regions.empty() || static_cast<int>(regions.size()) > max_batch_size_) {
+        throw std::invalid_argument("invalid number of regions");
+    }
+    if (std::ranges::any_of(regions, [&](const Region& region) {
+            const cv::Rect bounds(0, 0, region.image.width,
+                                  region.image.height);
+            return region.rect.empty() ||
+                   (region.rect & bounds) != region.rect ||
+                   region.image.channels != input_channels_;
+        })) {
+        throw std::invalid_argument("region is empty or out of image");
+    }
+
+    int index{acquire()};
+    auto& slot{*slots_[index]};
+    slot.pparams = preprocess(slot, regions);
+    launch(slot);
+    return DetectionTicket(this, index);
+}
+
+/**
+ * @brief Enqueues detection on crops of host images without waiting for the
+ * result.
+ *
+ * The images are uploaded as a batch of whole images is, and stay in device
+ * memory as the images of the ticket, while only the crops are letterboxed
+ * into the batch. Detecting a few crops around known objects costs a batch of
+ * their number instead of whole images, and a crop no larger than the input
+ * of the network keeps its full resolution.
+ *
+ * @param images The images, the number of channels of every one of which must
+ * be equal to `input_channels_`.
+ * @param crops The crops forming the batch, each of which names one of the
+ * images and lies in it.
+ * @return `DetectionTicket` The ticket used to wait for the detections, whose
+ * detections are relative to the top-left corner of each crop, and whose
+ * images are the uploaded images in order.
+ * @throws `std::invalid_argument` if the number of crops is zero or exceeds
+ * the maximum batch size, or a crop names no image, or is empty or out of its
+ * image, or an image has a different number of channels.
+ * @throws `std::runtime_error` if every slot is occupied by a ticket.
+ * @note Images uploaded from page-locked memory must not be modified or freed
+ * until the ticket is waited for or released.
+ */
+DetectionTicket Detector::enqueue(std::span<const cv::Mat> images,
+                                  std::span<const Crop> crops) {
+    if (crops.empty() || static_cast<int>(crops.size()) > max_batch_size_) {
+        throw std::invalid_argument("invalid number of crops");
+    }
+    if (std::ranges::any_of(images, [&](const cv::Mat& image) {
+            return image.channels() != input_channels_;
+        })) {
+        throw std::invalid_argument("invalid number of channels");
+    }
+    if (std::ranges::any_of(crops, [&](const Crop& crop) {
+            if (crop.image < 0 ||
+                crop.image >= static_cast<int>(images.size())) {
+                return true;
+            }
+            const auto& image{images[crop.image]};
+            const cv::Rect bounds(0, 0, image.cols, image.rows);
+            return crop.rect.empty() || (crop.rect & bounds) != crop.rect;
+        })) {
+        throw std::invalid_argument("crop is empty or out of image");
+    }
+
+    int index{acquire()};
+    auto& slot{*slots_[index]};
+    slot.pparams = preprocess(slot, images, crops);
+    launch(slot);
+    return DetectionTicket(this, index);
+}
+
+/**
+ * @brief Acquires a free inference slot.
+ *
+ * @return The index of the slot.
+ * @throws `std::runtime_error` if every slot is occupied by a ticket.
+ */
+int Detector::acquire() {
+    std::lock_guard lock(slots_mutex_);
+    auto iter = std::ranges::find_if(
+        slots_, [](const auto& slot) { return !slot->busy; });
+    if (iter == slots_.end()) {
+        throw std::runtime_error("no free inference slot");
+    }
+    (*iter)->busy = true;
+    return iter - slots_.begin();
+}
+
+/**
+ * @brief Releases an inference slot after the operations enqueued on it have
+ * finished.
+ *
+ * @param index The index of the slot.
+ */
+void Detector::release(int index) noexcept {
+    auto& slot{*slots_[index]};
+    CUDA_CHECK_NOEXCEPT(cudaEventSynchronize(slot.done_event));
+    std::lock_guard lock(slots_mutex_);
+    slot.busy = false;
+}
+
+/**
+ * @brief Grows the image buffers of a slot to hold a batch of images.
+ *
+ * @param slot The inference slot, which is acquired, so no operation of its
+ * previous batches is pending.
+ * @param bytes The bytes of the images of the batch.
+ * @note This function will call `std::abort()` if the buffers can not be
+ * allocated.
+ */
+void Detector::reserveImages(Slot& slot, size_t bytes) noexcept {
+    if (bytes <= slot.image_capacity) {
+        return;
+    }
+    CUDA_CHECK_NOEXCEPT(cudaFreeHost(slot.image_ptr));
+    CUDA_CHECK_NOEXCEPT(cudaFree(slot.dev_image_ptr));
+    CUDA_CHECK_NOEXCEPT(
+        cudaHostAlloc(&slot.image_ptr, bytes, cudaHostAllocDefault));
+    CUDA_CHECK_NOEXCEPT(cudaMalloc(&slot.dev_image_ptr, bytes));
+    slot.image_capacity = bytes;
+}
+
+/**
+ * @brief Allocates page-locked frame buffers, into which images are captured
+ * and then detected without being copied on the host.
+ *
+ * The image buffers of every slot are also grown to a full batch of such
+ * images, so that no allocation happens during detection.
+ *
+ * @param size The size of the images.
+ * @param count The number of buffers.
+ * @throws `std::invalid_argument` if the size or the number is not positive.
+ * @throws `std::runtime_error` if the buffers can not be allocated.
+ * @note This must not be called during detection, and the buffers borrowed
+ * before are invalidated.
+ */
+void Detector::reserveFrameBuffers(cv::Size size, int count) {
+    frame_buffers_ = std::make_unique<FrameBufferPool>(
+        size, CV_8UC(input_channels_), count);
+    const size_t bytes{static_cast<size_t>(size.area()) * input_channels_ *
+                       max_batch_size_};
+    for (auto&& slot : slots_) {
+        reserveImages(*slot, bytes);
+    }
+}
+
+/**
+ * @brief Borrows a frame buffer allocated by `reserveFrameBuffers`.
+ *
+ * @return The frame buffer, which is kept until the detection of its image is
+ * waited for.
+ * @throws `std::logic_error` if no frame buffer is allocated.
+ * @throws `std::runtime_error` if every frame buffer is borrowed.
+ */
+FrameBuffer Detector::acquireFrameBuffer() {
+    if (!frame_buffers_) {
+        throw std::logic_error("frame buffers are not reserved");
+    }
+    return frame_buffers_->acquire();
+}
+
+/**
+ * @brief Makes the first stream of the slot wait for all the other streams
+ * used by the current batch.
+ *
+ * @param slot The inference slot.
+ */
+void Detector::joinStreams(Slot& slot) noexcept {
+    for (int i = 1; i < slot.batch_size; ++i) {
+        CUDA_CHECK_NOEXCEPT(
+            cudaEventRecord(slot.join_events[i], slot.streams[i]));
+        CUDA_CHECK_NOEXCEPT(
+            cudaStreamWaitEvent(slot.streams[0], slot.join_events[i]));
+    }
+}
+
+/**
+ * @brief Makes all the other streams used by the current batch wait for an
+ * event recorded on the first stream of the slot.
+ *
+ * @param slot The inference slot.
+ * @param event The event to record on the first stream.
+ */
+void Detector::forkStreams(Slot& slot, cudaEvent_t event) noexcept {
+    CUDA_CHECK_NOEXCEPT(cudaEventRecord(event, slot.streams[0]));
+    for (int i = 1; i < slot.batch_size; ++i) {
+        CUDA_CHECK_NOEXCEPT(cudaStreamWaitEvent(slot.streams[i], event));
+    }
+}
+
+/**
+ * @brief Enqueues inference of the current batch after preprocessing on the
+ * first stream of the slot, and forks the other streams for postprocessing.
+ *
+ * @param slot The inference slot.
+ */
+void Detector::infer(Slot& slot) noexcept {
+    slot.context->enqueueV3(slot.streams[0]);
+    recordTiming(slot, 2);
+    forkStreams(slot, slot.infer_event);
+}
+
+/**
+ * @brief Records a timing event on the first stream of the slot if metrics
+ * are enabled, which is also captured into the graph of the batch.
+ *
+ * @note A plain event record in a stream being captured only creates a
+ * dependency and no node, so replays of the graph would never record it.
+ * Records in a capture are therefore external, which become event record
+ * nodes recording the event on every launch.
+ *
+ * @param slot The inference slot.
+ * @param stage The index of the timing event, where 0 is before letterboxing,
+ * 1 before inference, 2 before postprocessing and 3 after postprocessing.
+ */
+void Detector::recordTiming([[maybe_unused]] Slot& slot,
+                            [[maybe_unused]] int stage) noexcept {
+#ifdef RADAR_ENABLE_METRICS
+    cudaStreamCaptureStatus status{cudaStreamCaptureStatusNone};
+    CUDA_CHECK_NOEXCEPT(cudaStreamIsCapturing(slot.streams[0], &status));
+    CUDA_CHECK_NOEXCEPT(cudaEventRecordWithFlags(
+        slot.timing_events[stage], slot.streams[0],
+        status == cudaStreamCaptureStatusActive ? cudaEventRecordExternal
+                                                : cudaEventRecordDefault));
+#endif
+}
+
+/**
+ * @brief Records the device time of letterboxing, inference and postprocessing
+ * of the finished batch of the slot into the metrics, if they are enabled.
+ *
+ * @param slot The inference slot, whose operations must have finished.
+ */
+void Detector::reportTiming([[maybe_unused]] Slot& slot) noexcept {
+#ifdef RADAR_ENABLE_METRICS
+    for (size_t i = 0; i < timing_sites_.size(); ++i) {
+        float milliseconds{0.0f};
+        const cudaError_t error_code = cudaEventElapsedTime(
+            &milliseconds, slot.timing_events[i], slot.timing_events[i + 1]);
+        if (error_code == cudaSuccess) {
+            metrics::record(timing_sites_[i],
+                            std::chrono::nanoseconds(
+                                static_cast<int64_t>(milliseconds * 1e6f)));
+        } else {
+            // Clears the error, which is not sticky, and drops the sample
+            cudaGetLastError();
+            std::cerr << "failed to time device stage " << i << ": "
+                      << cudaGetErrorString(error_code) << std::endl;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Enqueues all device work of the prepared batch, which is
+ * letterboxing, inference and postprocessing.
+ *
+ * @param slot The inference slot.
+ */
+void Detector::execute(Slot& slot) noexcept {
+    recordTiming(slot, 0);
+    letterbox(slot);
+    recordTiming(slot, 1);
+    infer(slot);
+    postprocess(slot);
+    recordTiming(slot, 3);
+}
+
+/**
+ * @brief Captures the device work of the prepared batch into an executable
+ * CUDA graph.
+ *
+ * Nothing is executed by capturing. Every node of the graph reads and writes
+ * buffers of the slot at fixed addresses, and the letterbox parameters are
+ * copied from pinned memory by a node of the graph, so the graph is valid for
+ * every later batch of the same size on this slot.
+ *
+ * @param slot The inference slot.
+ * @return The executable graph, or `nullptr` if the work is not capturable.
+ */
+cudaGraphExec_t Detector::capture(Slot& slot) noexcept {
+    auto& stream{slot.streams[0]};
+    if (cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal) !=
+        cudaSuccess) {
+        cudaGetLastError();
+        return nullptr;
+    }
+    execute(slot);
+
+    cudaGraph_t graph{nullptr};
+    cudaGraphExec_t graph_exec{nullptr};
+    if (cudaStreamEndCapture(stream, &graph) == cudaSuccess) {
+        if (cudaGraphInstantiate(&graph_exec, graph, 0) != cudaSuccess) {
+            graph_exec = nullptr;
+        }
+        CUDA_CHECK_NOEXCEPT(cudaGraphDestroy(graph));
+    }
+    // Clears the error of a failed capture, which is not sticky
+    cudaGetLastError();
+    return graph_exec;
+}
+
+/**
+ * @brief Launches the prepared batch and records the done event of the slot.
+ *
+ * If graphs are enabled, the device work of each batch size is captured into a
+ * graph the first time the size is seen on the slot, and later batches of the
+ * size replay the graph with a single launch. The first batch is executed
+ * directly, which also warms up the execution context before capturing as
+ * TensorRT requires. If capturing fails, graphs are disabled for the detector.
+ *
+ * @param slot The inference slot, whose batch has been preprocessed.
+ */
+void Detector::launch(Slot& slot) noexcept {
+    slot.context->setInputShape(
+        slot.input_tensor.name(),
+        nvinfer1::Dims4(slot.batch_size, input_channels_, input_width_,
+                        input_height_));
+
+    auto& graph_exec{slot.graphs[slot.batch_size]};
+    if (use_graph_ && graph_exec) {
+        CUDA_CHECK_NOEXCEPT(cudaGraphLaunch(graph_exec, slot.streams[0]));
+    } else {
+        execute(slot);
+        if (use_graph_) {
+            graph_exec = capture(slot);
+            if (!graph_exec) {
+                std::cerr << "failed to capture detection graph, falling back "
+                             "to stream launches"
+                          << std::endl;
+                use_graph_ = false;
+            }
+        }
+    }
+    CUDA_CHECK_NOEXCEPT(cudaEventRecord(slot.done_event, slot.streams[0]));
+}
+
+/**
+ * @brief Checks if the detections of the ticket are ready without blocking.
+ *
+ * @return `true` if all operations of the ticket have finished, otherwise
+ * `false`.
+ */
+bool DetectionTicket::ready() const noexcept {
+    if (!valid()) {
+        return false;
+    }
+    return cudaEventQuery(detector_->slots_[slot_]->done_event) == cudaSuccess;
+}
+
+/**
+ * @brief Waits for the detections of the ticket.
+ *
+ * @return `std::vector<std::vector<Detection>>` A batch-sized vector of vectors
+ * containing the detections, which is empty if the ticket is invalid.
+ * @note The slot of the ticket is not released until the ticket is destroyed,
+ * so that buffers of the batch stay valid while the ticket is alive.
+ */
+std::vector<std::vector<Detection>> DetectionTicket::wait() noexcept {
+    if (!valid()) {
+        return {};
+    }
+    auto& slot{*detector_->slots_[slot_]};
+    {
+        RADAR_PROFILE_SCOPE("detect.wait");
+        CUDA_CHECK_NOEXCEPT(cudaEventSynchronize(slot.done_event));
+    }
+    detector_->reportTiming(slot);
+    return detector_->collect(slot);
+}
+
+/**
+ * @brief Gets an input image of the ticket in device memory.
+ *
+ * The image is valid until the ticket is destroyed, and has been uploaded once
+ * the detections of the ticket are ready.
+ *
+ * @param index The index of the image in the batch.
+ * @return The device image, which is empty if the ticket is invalid or the
+ * ticket is enqueued on regions of another image.
+ */
+DeviceImage DetectionTicket::image(int index) const noexcept {
+    if (!valid()) {
+        return {};
+    }
+    const auto& images{detector_->slots_[slot_]->images};
+    return index < static_cast<int>(images.size()) ? images[index]
+                                                   : DeviceImage{};
+}
+
+/**
+ * @brief Releases the slot of the ticket, waiting for its operations to finish.
+ */
+void DetectionTicket::release() noexcept {
+    if (valid()) {
+        detector_->release(slot_);
+        detector_ = nullptr;
     }
 }
 
 /**
  * @brief Serialize the TensorRT engine from an ONNX model file.
  *
+ * The timing cache is loaded before building if it exists, and saved after
+ * building, so that layers already timed on this platform are not timed again.
+ *
  * @param onnx_path The path to the ONNX model file.
- * @param engine_path The path where the serialized engine will be saved.
- * @param opt_batch_size The optimized batch size for the engine.
- * @param max_batch_size The maximum batch size supported by the engine.
- * @param opt_level The level of optimization ranging from 0 to 5.
+ * @param profile The build configuration of the engine, including the batch
+ * profile and the level of optimization ranging from 0 to 5.
+ * @param timing_cache_path The path of the timing cache.
  * @return The serialized engine model as a `std::pair<std::shared_ptr<char[]>,
  * size_t>`.
  * @throws `std::invalid_argument` if the batch size is invalid.
@@ -174,9 +827,11 @@ Detector::~Detector() {
  * error in the process.
  */
 std::pair<std::shared_ptr<char[]>, size_t> Detector::serializeEngine(
-    std::string_view onnx_path, int opt_batch_size, int max_batch_size,
-    int opt_level) {
-    if (max_batch_size < opt_batch_size || opt_batch_size < 1) {
+    std::string_view onnx_path, const EngineProfile& profile,
+    std::string_view timing_cache_path) {
+    if (profile.max_batch_size < profile.opt_batch_size ||
+        profile.opt_batch_size < profile.min_batch_size ||
+        profile.min_batch_size < 1) {
         throw std::invalid_argument("invalid batch size");
     }
     if (!std::filesystem::exists(onnx_path)) {
@@ -204,30 +859,108 @@ std::pair<std::shared_ptr<char[]>, size_t> Detector::serializeEngine(
         throw std::runtime_error("failed to parse file");
     }
 
-    constexpr int min_batch_size{1};
-    auto profile{builder->createOptimizationProfile()};
-    profile->setDimensions(input_name_.data(),
-                           nvinfer1::OptProfileSelector::kMIN,
-                           nvinfer1::Dims4(min_batch_size, input_channels_,
-                                           input_width_, input_height_));
-    profile->setDimensions(input_name_.data(),
-                           nvinfer1::OptProfileSelector::kOPT,
-                           nvinfer1::Dims4(opt_batch_size, input_channels_,
-                                           input_width_, input_height_));
-    profile->setDimensions(input_name_.data(),
-                           nvinfer1::OptProfileSelector::kMAX,
-                           nvinfer1::Dims4(max_batch_size, input_channels_,
-                                           input_width_, input_height_));
+    auto opt_profile{builder->createOptimizationProfile()};
+    opt_profile->setDimensions(
+        input_name_.data(), nvinfer1::OptProfileSelector::kMIN,
+        nvinfer1::Dims4(profile.min_batch_size, input_channels_, input_width_,
+                        input_height_));
+    opt_profile->setDimensions(
+        input_name_.data(), nvinfer1::OptProfileSelector::kOPT,
+        nvinfer1::Dims4(profile.opt_batch_size, input_channels_, input_width_,
+                        input_height_));
+    opt_profile->setDimensions(
+        input_name_.data(), nvinfer1::OptProfileSelector::kMAX,
+        nvinfer1::Dims4(profile.max_batch_size, input_channels_, input_width_,
+                        input_height_));
+
+    // The preprocessing kernel writes half precision directly, which halves
+    // the size of the input tensor and saves the cast inside the engine
+    if (profile.fp16_input) {
+        network->getInput(0)->setType(nvinfer1::DataType::kHALF);
+    }
 
     std::unique_ptr<nvinfer1::IBuilderConfig> config{
         builder->createBuilderConfig()};
-    config->setBuilderOptimizationLevel(opt_level);
-    config->setFlag(nvinfer1::BuilderFlag::kFP16);
-    config->addOptimizationProfile(profile);
+    config->setBuilderOptimizationLevel(profile.opt_level);
+    if (profile.fp16) {
+        config->setFlag(nvinfer1::BuilderFlag::kFP16);
+    }
+    config->addOptimizationProfile(opt_profile);
+
+    // The calibrator is used during building, so it lives until the end
+    std::unique_ptr<Int8Calibrator> calibrator{nullptr};
+    if (profile.int8 && int8_) {
+        if (!builder->platformHasFastInt8()) {
+            std::cerr << "platform has no fast INT8, building anyway"
+                      << std::endl;
+        }
+        config->setFlag(nvinfer1::BuilderFlag::kINT8);
+        calibrator = std::make_unique<Int8Calibrator>(
+            *int8_, input_width_, input_height_, input_channels_);
+        config->setInt8Calibrator(calibrator.get());
+
+        // Calibration runs on a fixed batch size
+        auto calib_profile{builder->createOptimizationProfile()};
+        auto calib_dims{nvinfer1::Dims4(int8_->batch_size, input_channels_,
+                                        input_width_, input_height_)};
+        for (auto selector : {nvinfer1::OptProfileSelector::kMIN,
+                              nvinfer1::OptProfileSelector::kOPT,
+                              nvinfer1::OptProfileSelector::kMAX}) {
+            calib_profile->setDimensions(input_name_.data(), selector,
+                                         calib_dims);
+        }
+        config->setCalibrationProfile(calib_profile);
+
+        // Layers sensitive to quantization fall back to FP16
+        bool constrained{false};
+        for (int i = 0; i < network->getNbLayers(); ++i) {
+            auto layer{network->getLayer(i)};
+            std::string_view name{layer->getName()};
+            if (std::ranges::any_of(int8_->fp16_layers,
+                                    [&](const std::string& pattern) {
+                                        return name.find(pattern) !=
+                                               std::string_view::npos;
+                                    })) {
+                layer->setPrecision(nvinfer1::DataType::kHALF);
+                constrained = true;
+            }
+        }
+        if (constrained) {
+            config->setFlag(
+                nvinfer1::BuilderFlag::kPREFER_PRECISION_CONSTRAINTS);
+        }
+    }
+
+    std::pair<std::shared_ptr<char[]>, size_t> timing_data{nullptr, 0};
+    if (std::filesystem::exists(timing_cache_path)) {
+        timing_data = loadFromFile(timing_cache_path);
+    }
+    std::unique_ptr<nvinfer1::ITimingCache> timing_cache{
+        config->createTimingCache(timing_data.first.get(), timing_data.second)};
+    if (!timing_cache ||
+        !config->setTimingCache(*timing_cache, /* ignoreMismatch */ false)) {
+        std::cerr << "failed to use timing cache " << timing_cache_path
+                  << std::endl;
+    }
 
     std::cout << "Building network..." << std::endl;
     std::shared_ptr<nvinfer1::IHostMemory> model{
         builder->buildSerializedNetwork(*network, *config)};
+    if (!model) {
+        throw std::runtime_error("failed to build network");
+    }
+
+    if (auto cache = config->getTimingCache(); cache) {
+        std::unique_ptr<nvinfer1::IHostMemory> cache_data{cache->serialize()};
+        try {
+            writeToFile(std::span(static_cast<const char*>(cache_data->data()),
+                                  cache_data->size()),
+                        timing_cache_path);
+        } catch (const std::ios_base::failure& ex) {
+            std::cerr << "exception in writing timing cache: " << ex.what()
+                      << std::endl;
+        }
+    }
 
     auto deleter = [model](char*) mutable {
         // Here, there is nothing that needs to be done, as the destructor of
@@ -241,6 +974,20 @@ std::pair<std::shared_ptr<char[]>, size_t> Detector::serializeEngine(
         model->size());
 }
 
+/**
+ * @brief Deserializes an engine from serialized data.
+ *
+ * @param model The serialized engine and its size.
+ * @return The engine, or `nullptr` if the data can not be deserialized, such
+ * as an engine built by another version of TensorRT or for another device.
+ */
+std::unique_ptr<nvinfer1::ICudaEngine> Detector::deserializeEngine(
+    const std::pair<std::shared_ptr<char[]>, size_t>& model) {
+    return std::unique_ptr<nvinfer1::ICudaEngine>(
+        runtime_->deserializeCudaEngine(static_cast<void*>(model.first.get()),
+                                        model.second));
+}
+
 /**
  * @brief Restores the detection scaling and translation to the original image
  * dimensions.
@@ -309,44 +1056,6 @@ auto Detector::loadFromFile(std::string_view path)
     return std::make_pair(buffer, size);
 }
 
-/**
- * @brief Computes the Intersection over Union (IoU) of two rectangles.
- *
- * The IoU is a measure used in object detection to quantify the accuracy of
- * an object detector on a particular dataset. It calculates the ratio of
- * intersection area to the union area of two rectangles.
- *
- * @param rect1 The first rectangle as a cv::Rect2f.
- * @param rect2 The second rectangle as a cv::Rect2f.
- * @return The IoU ratio as a float. Returns 0.0 if the union area is zero.
- */
-static float computeIoU(const cv::Rect2f& rect1, const cv::Rect2f& rect2) {
-    float x1, y1, x2, y2;
-    cv::Rect2f intersectionRect, unionRect;
-
-    x1 = std::max(rect1.x, rect2.x);
-    y1 = std::max(rect1.y, rect2.y);
-    x2 = std::min(rect1.x + rect1.width, rect2.x + rect2.width);
-    y2 = std::min(rect1.y + rect1.height, rect2.y + rect2.height);
-    intersectionRect = x1 < x2 && y1 < y2 ? cv::Rect2f(x1, y1, x2 - x1, y2 - y1)
-                                          : cv::Rect2f(0, 0, 0, 0);
-
-    x1 = std::min(rect1.x, rect2.x);
-    y1 = std::min(rect1.y, rect2.y);
-    x2 = std::max(rect1.x + rect1.width, rect2.x + rect2.width);
-    y2 = std::max(rect1.y + rect1.height, rect2.y + rect2.height);
-    unionRect = cv::Rect2f(x1, y1, x2 - x1, y2 - y1);
-
-    float intersectionArea = intersectionRect.width * intersectionRect.height;
-    float unionArea = unionRect.width * unionRect.height;
-
-    if (unionArea > 0) {
-        return intersectionArea / unionArea;
-    } else {
-        return 0.0;
-    }
-}
-
 /**
  * @brief Constructs a RobotDetector object.
  *
@@ -366,12 +1075,19 @@ static float computeIoU(const cv::Rect2f& rect1, const cv::Rect2f& rect2) {
  * @param armor_nms_thresh The Non-Maximum Suppression (NMS) threshold for armor
  * detection.
  * @param armor_conf_thresh The confidence threshold for armor detection.
- * @param image_size The size of the input images.
+ * @param image_size The initial bytes of an input image, which grow when a
+ * larger image is given.
  * @param input_width The width of the input images.
  * @param input_height The height of the input images.
  * @param input_name The name of the input node in the detection engine.
  * @param input_channels The number of channels in the input images.
  * @param opt_level The optimization level for the detection engine.
+ * @param max_cameras The maximum number of cameras whose images are detected
+ * as one batch, which is the optimized batch size of the car detector. The car
+ * detector reserves `image_size` bytes for each camera.
+ * @param max_crops The maximum number of crops detected as one batch in
+ * adaptive detection, with which the maximum batch size of the car detector is
+ * the larger of it and `max_cameras`.
  */
 RobotDetector::RobotDetector(std::string_view car_engine_path,
                              std::string_view armor_engine_path,
@@ -381,12 +1097,15 @@ RobotDetector::RobotDetector(std::string_view car_engine_path,
                              float armor_conf_thresh, size_t image_size,
                              float input_width, float input_height,
                              std::string_view input_name, int input_channels,
-                             int opt_level)
+                             int opt_level, int max_cameras, int max_crops)
     : iou_thresh_(iou_thresh),
+      max_cameras_(max_cameras),
+      car_input_size_(static_cast<int>(input_width),
+                      static_cast<int>(input_height)),
       car_detector_(std::make_unique<Detector>(
-          car_engine_path, 1, 1, std::nullopt, image_size, car_nms_thresh,
-          car_conf_thresh, input_width, input_height, input_name,
-          input_channels, opt_level)),
+          car_engine_path, 1, std::max(max_cameras, max_crops), max_cameras,
+          image_size * max_cameras, car_nms_thresh, car_conf_thresh,
+          input_width, input_height, input_name, input_channels, opt_level)),
       armor_detector_(std::make_unique<Detector>(
           armor_engine_path, armor_classes, max_cars, opt_cars, image_size,
           armor_nms_thresh, armor_conf_thresh, input_width, input_height,
@@ -396,12 +1115,7 @@ RobotDetector::RobotDetector(std::string_view car_engine_path,
  * @brief Detects robots within an image using separate detectors for cars and
  * armor.
  *
- * This function first uses a car detector to identify potential car locations
- * in an image. For each detected car, a sub-image is extracted and these images
- * are then passed to an armor detector. It constructs a collection of Robot
- * objects based on the detections from both detectors. It also handles
- * overlapping detections by using an IoU threshold to determine whether two
- * detections are referring to the same object.
+ * This function is equivalent to detecting a batch of one image.
  *
  * @param image The input image in which to detect robots.
  *
@@ -410,46 +1124,240 @@ RobotDetector::RobotDetector(std::string_view car_engine_path,
  * armor detections.
  */
 std::vector<Robot> RobotDetector::detect(const cv::Mat& image) {
-    car_images_.clear();
-    auto car_detections = car_detector_->detect(image);
-
-    std::for_each(std::execution::seq, car_detections.begin(),
-                  car_detections.end(), [&](const Detection& detection) {
-                      cv::Mat car_image =
-                          image(cv::Rect(detection.x, detection.y,
-                                         detection.width, detection.height))
-                              .clone();
-                      car_images_.emplace_back(std::move(car_image));
-                  });
-    auto armor_detections_batch = armor_detector_->detect(car_images_);
+    return std::move(detect(std::span(&image, 1))[0]);
+}
+
+/**
+ * @brief Detects robots within images of several cameras using separate
+ * detectors for cars and armor.
+ *
+ * This function first uses a car detector to identify potential car locations
+ * in all images as one batch. The car regions of every image are then cropped
+ * directly from the images already uploaded by the car detector and passed to
+ * the armor detector in batches mixing regions of different images, so every
+ * image crosses PCIe only once and the engines, contexts and device buffers
+ * are shared by all cameras. The detections are routed back to the image they
+ * come from, and robots are constructed and deduplicated for each image.
+ *
+ * @param images The input images, the number of which is at most
+ * `maxCameras()`.
+ * @return A `std::vector<std::vector<Robot>>` containing the robots detected in
+ * each image, in the order of the images.
+ * @throws `std::invalid_argument` if the number of images is zero or exceeds
+ * the maximum number of cameras.
+ */
+std::vector<std::vector<Robot>> RobotDetector::detect(
+    std::span<const cv::Mat> images) {
+    if (images.empty() ||
+        static_cast<int>(images.size()) > max_cameras_) {
+        throw std::invalid_argument("invalid number of images");
+    }
+
+    // The car ticket keeps the uploaded images alive until armor detection
+    // ends
+    auto car_ticket{car_detector_->enqueue(images)};
+    auto car_detections{car_ticket.wait()};
+    return detectArmors(car_ticket, images, car_detections);
+}
+
+/**
+ * @brief Detects robots within an image, whose cars may be detected in crops
+ * around the boxes predicted for them.
+ *
+ * This function is equivalent to detecting a batch of one image.
+ *
+ * @param image The input image in which to detect robots.
+ * @param predictions The boxes of the robots predicted in the image.
+ * @return A `std::vector<Robot>` containing all detected robots.
+ */
+std::vector<Robot> RobotDetector::detect(
+    const cv::Mat& image, const std::vector<cv::Rect>& predictions) {
+    return std::move(
+        detect(std::span(&image, 1), std::span(&predictions, 1))[0]);
+}
+
+/**
+ * @brief Detects robots within images of several cameras, whose cars may be
+ * detected in crops around the boxes predicted for them.
+ *
+ * Unless adaptive detection is enabled by `setAdaptive`, this is the same as
+ * detecting the images alone. Otherwise the scheduler decides whether the
+ * frame is detected in whole images, or the car detector only runs on a batch
+ * of crops covering the predicted boxes, in which every car keeps the
+ * resolution of the image. Armors are then detected in the cars as they are
+ * after a full pass, from the images uploaded with the crops.
+ *
+ * @param images The input images, the number of which is at most
+ * `maxCameras()`.
+ * @param predictions The boxes of the robots predicted in each image, which
+ * are usually the confirmed tracks projected into the images.
+ * @return A `std::vector<std::vector<Robot>>` containing the robots detected in
+ * each image, in the order of the images.
+ * @throws `std::invalid_argument` if the number of images is zero or exceeds
+ * the maximum number of cameras, or the numbers of images and predictions
+ * differ.
+ */
+std::vector<std::vector<Robot>> RobotDetector::detect(
+    std::span<const cv::Mat> images,
+    std::span<const std::vector<cv::Rect>> predictions) {
+    if (images.size() != predictions.size()) {
+        throw std::invalid_argument("invalid number of predictions");
+    }
+    if (!scheduler_.has_value()) {
+        return detect(images);
+    }
+    if (images.empty() ||
+        static_cast<int>(images.size()) > max_cameras_) {
+        throw std::invalid_argument("invalid number of images");
+    }
 
+    std::vector<cv::Size> image_sizes;
+    image_sizes.reserve(images.size());
+    for (const auto& image : images) {
+        image_sizes.emplace_back(image.size());
+    }
+    auto crops{scheduler_->plan(image_sizes, predictions)};
+    if (!crops.has_value()) {
+        return detect(images);
+    }
+
+    DetectionTicket car_ticket;
+    auto car_detections{detectCrops(images, crops.value(), car_ticket)};
+    return detectArmors(car_ticket, images, car_detections);
+}
+
+/**
+ * @brief Detects cars in crops of images and restores them to the coordinates
+ * of the images.
+ *
+ * Cars seen in several overlapping crops are kept once, with the most
+ * confident detection. If a crop has no car, the robot predicted in it is
+ * lost, and the next frame is detected in whole images to find it again.
+ *
+ * @param images The input images.
+ * @param crops The crops of the images, the number of which is at most the
+ * maximum batch size of the car detector.
+ * @param ticket The ticket of the car detection, which keeps the uploaded
+ * images for detecting armors.
+ * @return The car detections of each image.
+ */
+std::vector<std::vector<Detection>> RobotDetector::detectCrops(
+    std::span<const cv::Mat> images, std::span<const Crop> crops,
+    DetectionTicket& ticket) {
+    ticket = car_detector_->enqueue(images, crops);
+    auto crop_detections{ticket.wait()};
+    if (std::ranges::any_of(crop_detections,
+                            [](const auto& d) { return d.empty(); })) {
+        scheduler_->requestFullFrame();
+    }
+    return restoreCrops(crops, crop_detections, images.size(), iou_thresh_);
+}
+
+/**
+ * @brief Detects armors in the cars of images already uploaded by the car
+ * detector, and constructs the robots of each image.
+ *
+ * The car regions of every image are cropped directly from the images of the
+ * car ticket and passed to the armor detector in batches mixing regions of
+ * different images. The detections are routed back to the image they come
+ * from, and robots are constructed and deduplicated for each image.
+ *
+ * @param car_ticket The ticket of the car detection, whose images are the
+ * input images in device memory.
+ * @param images The input images.
+ * @param car_detections The car detections of each image.
+ * @return The robots detected in each image, in the order of the images.
+ */
+std::vector<std::vector<Robot>> RobotDetector::detectArmors(
+    const DetectionTicket& car_ticket, std::span<const cv::Mat> images,
+    const std::vector<std::vector<Detection>>& car_detections) {
+    // Regions clipped to nothing are skipped and have no armor detections
+    car_regions_.clear();
+    car_indices_.clear();
+    std::vector<std::vector<std::vector<Detection>>> armor_detections(
+        images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto device_image{car_ticket.image(static_cast<int>(i))};
+        const cv::Rect bounds(0, 0, images[i].cols, images[i].rows);
+        armor_detections[i].resize(car_detections[i].size());
+        for (size_t j = 0; j < car_detections[i].size(); ++j) {
+            const auto& detection{car_detections[i][j]};
+            cv::Rect roi{cv::Rect(detection.x, detection.y, detection.width,
+                                  detection.height) &
+                         bounds};
+            if (!roi.empty()) {
+                car_regions_.emplace_back(
+                    Region{.image = device_image, .rect = roi});
+                car_indices_.emplace_back(i, j);
+            }
+        }
+    }
+
+    const size_t max_batch_size = armor_detector_->maxBatchSize();
+    for (size_t begin = 0; begin < car_regions_.size();
+         begin += max_batch_size) {
+        size_t count{std::min(max_batch_size, car_regions_.size() - begin)};
+        auto batch{
+            armor_detector_
+                ->enqueue(std::span(car_regions_).subspan(begin, count))
+                .wait()};
+        for (size_t k = 0; k < count; ++k) {
+            const auto [i, j]{car_indices_[begin + k]};
+            armor_detections[i][j] = std::move(batch[k]);
+        }
+    }
+
+    std::vector<std::vector<Robot>> robots;
+    robots.reserve(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        robots.emplace_back(merge(car_detections[i], armor_detections[i]));
+    }
+    return robots;
+}
+
+/**
+ * @brief Constructs the robots of one image from the car detections and the
+ * armor detections inside each car.
+ *
+ * It handles overlapping detections by using an IoU threshold to determine
+ * whether two detections are referring to the same object.
+ *
+ * @param car_detections The car detections of the image.
+ * @param armor_detections The armor detections of each car.
+ * @return A `std::vector<Robot>` containing all robots of the image.
+ */
+std::vector<Robot> RobotDetector::merge(
+    const std::vector<Detection>& car_detections,
+    const std::vector<std::vector<Detection>>& armor_detections) const {
     std::vector<Robot> robots;
     robots.reserve(car_detections.size());
 
-    std::map<int, Robot> robots_map;
+    // Robots are kept by label, and the labels of detected robots are always
+    // within `[0, Robot::kClassNum)`
+    std::array<std::optional<Robot>, Robot::kClassNum> labeled_robots;
     for (size_t i = 0; i < car_detections.size(); ++i) {
-        Robot robot(car_detections[i], armor_detections_batch[i]);
+        Robot robot(car_detections[i], armor_detections[i]);
         if (!robot.isDetected()) {
             robots.emplace_back(robot);
             continue;
         }
-        int label = robot.label().value();
-        if (!robots_map.contains(label)) {
-            robots_map.emplace(label, robot);
-        } else {
-            auto& exist_robot = robots_map.at(label);
-            if (computeIoU(exist_robot.rect().value(), robot.rect().value()) >
-                iou_thresh_) {
-                continue;
-            } else if (exist_robot.confidence().value() <
-                       robot.confidence().value()) {
-                std::swap(exist_robot, robot);
-            }
+        auto& exist_robot = labeled_robots[robot.label().value()];
+        if (!exist_robot.has_value()) {
+            exist_robot = robot;
+        } else if (computeIoU(exist_robot->rect().value(),
+                              robot.rect().value()) > iou_thresh_) {
+            continue;
+        } else if (exist_robot->confidence().value() <
+                   robot.confidence().value()) {
+            exist_robot = robot;
         }
     }
 
-    std::for_each(robots_map.begin(), robots_map.end(),
-                  [&](const auto& pair) { robots.emplace_back(pair.second); });
+    for (const auto& robot : labeled_robots) {
+        if (robot.has_value()) {
+            robots.emplace_back(robot.value());
+        }
+    }
     return robots;
 }
 
@@ -10,13 +10,17 @@
  *
  */
 
+#include <cub/cub.cuh>
+#include <cuda_fp16.h>
 #include <cuda_runtime.h>
 
+#include <algorithm>
 #include <execution>
 #include <opencv2/opencv.hpp>
 #include <ranges>
 
 #include "detector.h"
+#include "utils/metrics.h"
 
 namespace radar::detect {
 
@@ -170,6 +174,92 @@ __global__ void blobKernel(const unsigned char* src, float* dst, int width,
     }
 }
 
+/**
+ * @brief Letterboxes regions of images into a batch of scaled planar inputs in
+ * a single pass.
+ *
+ * This CUDA kernel fuses cropping, resizing, making border and blobbing for a
+ * batch of regions, where `blockIdx.z` is the index of the region in the batch.
+ * Every output pixel is sampled bilinearly from its source image in global
+ * memory and written to the planar input directly, so no intermediate image is
+ * written. The result of each pixel is identical to running `resizeKernel`,
+ * `copyMakeBorderKernel` and `blobKernel` on the region in turn.
+ *
+ * @param params Pointer to the letterbox parameters of each region in global
+ * memory.
+ * @param dst Pointer to the destination batch of inputs in global memory, whose
+ * elements are `__half` if `half` is `true`, otherwise `float`.
+ * @param width Width of each input.
+ * @param height Height of each input.
+ * @param channels Number of channels in the source images and the inputs.
+ * @param scale Scaling factor to apply to each pixel's value.
+ * @param half Whether the inputs are in half precision.
+ */
+__global__ void letterboxKernel(const LetterboxParam* params, void* dst,
+                                int width, int height, int channels,
+                                float scale, bool half) {
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+    if (x >= width || y >= height) {
+        return;
+    }
+
+    const LetterboxParam param = params[blockIdx.z];
+    int plane = width * height;
+    size_t offset =
+        static_cast<size_t>(blockIdx.z) * plane * channels + y * width + x;
+    auto store = [&](int c, float value) {
+        if (half) {
+            static_cast<__half*>(dst)[offset + plane * c] =
+                __float2half(value);
+        } else {
+            static_cast<float*>(dst)[offset + plane * c] = value;
+        }
+    };
+
+    int resized_x = x - param.left;
+    int resized_y = y - param.top;
+    if (resized_x < 0 || resized_x >= param.resized_width || resized_y < 0 ||
+        resized_y >= param.resized_height) {
+        for (int c = 0; c < channels; ++c) {
+            store(c, 128 * scale);
+        }
+        return;
+    }
+
+    float src_y =
+        resized_y * static_cast<float>(param.height) / param.resized_height;
+    float src_x =
+        resized_x * static_cast<float>(param.width) / param.resized_width;
+
+    int src_y_low = static_cast<int>(src_y);
+    int src_y_high = min(src_y_low + 1, param.height - 1);
+    int src_x_low = static_cast<int>(src_x);
+    int src_x_high = min(src_x_low + 1, param.width - 1);
+
+    float ly = src_y - src_y_low;
+    float lx = src_x - src_x_low;
+    float hy = 1.f - ly;
+    float hx = 1.f - lx;
+
+    const unsigned char* row_low =
+        param.src + (param.y + src_y_low) * param.src_step +
+        param.x * channels;
+    const unsigned char* row_high =
+        param.src + (param.y + src_y_high) * param.src_step +
+        param.x * channels;
+
+    for (int c = 0; c < channels; ++c) {
+        float value = row_low[src_x_low * channels + c] * hy * hx +
+                      row_low[src_x_high * channels + c] * hy * lx +
+                      row_high[src_x_low * channels + c] * ly * hx +
+                      row_high[src_x_high * channels + c] * ly * lx;
+        // Channels are reordered from BGR to RGB as `blobKernel` does
+        store(c < 3 ? 2 - c : c, static_cast<unsigned char>(value) * scale);
+    }
+}
+
 /**
  * @brief Transposes a batch of matrices using CUDA parallelization.
  *
@@ -293,69 +383,175 @@ __host__ __device__ float IoU(float x1, float y1, float width1, float height1,
 }
 
 /**
- * @brief Non-Maximum Suppression (NMS) kernel for object detection.
- *
- * This CUDA kernel performs NMS on detection results to eliminate redundant
- * overlapping bounding boxes based on their Intersection over Union (IoU)
- * value. If the confidence score of a detection is below the score threshold,
- * its label is set to NaN. For each detection, it compares with all other
- * detections and if the IoU is above the NMS threshold and the confidence score
- * of the compared detection is higher, the label of the current detection is
- * set to NaN.
- *
- * @param dev Pointer to the device memory where detections are stored. Each
- * detection has the following format: [x, y, width, height, label,
- * confidence].
- * @param nms_thresh The IoU threshold for determining when to suppress
- * overlapping detections.
+ * @brief Gathers the candidates of non-maximum suppression whose confidence
+ * reaches the score threshold.
+ *
+ * Each thread checks one anchor of the image `blockIdx.y`, and the candidates
+ * are appended to the segment of the image through an atomic end offset, with
+ * the confidence as the key and the anchor index as the value for sorting.
+ *
+ * @param src Pointer to the decoded detections of the batch, each of which has
+ * the format [x, y, width, height, label, confidence].
+ * @param keys Pointer to the confidences of the candidates.
+ * @param indices Pointer to the anchor indices of the candidates.
+ * @param ends Pointer to the end offsets of the segments of each image, which
+ * must be equal to the begin offsets `image * anchors` before launching.
+ * @param anchors The number of anchors of each image.
  * @param score_thresh The minimum confidence score required to keep a
  * detection.
- * @param anchors The total number of detections (anchors).
  */
-__global__ void NMSKernel(float* dev, float nms_thresh, float score_thresh,
-                          int anchors) {
-    const int block_size = blockDim.x;
-    const int thread_id = threadIdx.x;
-    const int row = blockIdx.y;
-    const int col = blockIdx.x;
+__global__ void prefilterKernel(const float* src, float* keys, int* indices,
+                                int* ends, int anchors, float score_thresh) {
+    int index = blockDim.x * blockIdx.x + threadIdx.x;
+    int image = blockIdx.y;
     constexpr int num_attrs = sizeof(Detection) / sizeof(float);
+    if (index >= anchors) {
+        return;
+    }
 
-    const int rows = min(anchors - row * block_size, block_size);
-    const int cols = min(anchors - col * block_size, block_size);
-
-    extern __shared__ float shared_data[];
+    float confidence = src[(image * anchors + index) * num_attrs + 5];
+    if (!(confidence >= score_thresh)) {
+        return;
+    }
+    int position = atomicAdd(ends + image, 1);
+    keys[position] = confidence;
+    indices[position] = index;
+}
 
-    for (int i = thread_id; i < cols * num_attrs; i += block_size) {
-        int col_offset = block_size * col * num_attrs;
-        shared_data[i] = dev[col_offset + i];
+/**
+ * @brief Computes the suppression bitmask matrix of the sorted candidates.
+ *
+ * Candidates of the image `blockIdx.z` are sorted by confidence in descending
+ * order, of which at most `top_k` are considered. Each block compares 64 rows
+ * with 64 columns of candidates, where the bit j of the mask of row i is set
+ * if candidate j comes after i, has the same label and overlaps i with an IoU
+ * above the threshold.
+ *
+ * @param src Pointer to the decoded detections of the batch.
+ * @param indices Pointer to the anchor indices of the sorted candidates.
+ * @param begins Pointer to the begin offsets of the segments of each image.
+ * @param ends Pointer to the end offsets of the segments of each image.
+ * @param masks Pointer to the masks, which has `top_k` rows of
+ * `ceil(top_k / 64)` words for each image.
+ * @param anchors The number of anchors of each image.
+ * @param top_k The maximum number of candidates of each image.
+ * @param nms_thresh The IoU threshold for determining when to suppress
+ * overlapping detections.
+ */
+__global__ void NMSMaskKernel(const float* src, const int* indices,
+                              const int* begins, const int* ends,
+                              unsigned long long* masks, int anchors,
+                              int top_k, float nms_thresh) {
+    constexpr int block_size = 64;
+    constexpr int num_attrs = sizeof(Detection) / sizeof(float);
+    const int image = blockIdx.z;
+    const int count = min(ends[image] - begins[image], top_k);
+    const int row_start = blockIdx.y * block_size;
+    const int col_start = blockIdx.x * block_size;
+    if (row_start >= count || col_start >= count) {
+        return;
+    }
+    const int rows = min(count - row_start, block_size);
+    const int cols = min(count - col_start, block_size);
+    const int words = (top_k + block_size - 1) / block_size;
+    const float* image_src = src + image * anchors * num_attrs;
+    const int* image_indices = indices + begins[image];
+
+    __shared__ float shared_boxes[block_size][5];
+    if (threadIdx.x < cols) {
+        const float* box =
+            image_src + image_indices[col_start + threadIdx.x] * num_attrs;
+#pragma unroll
+        for (int k = 0; k < 5; ++k) {
+            shared_boxes[threadIdx.x][k] = box[k];
+        }
     }
     __syncthreads();
 
-    if (thread_id < rows) {
-        int row_index = (block_size * row + thread_id) * num_attrs;
-        float row_bbox[4] = {dev[row_index], dev[row_index + 1],
-                             dev[row_index + 2], dev[row_index + 3]};
-        float row_label = dev[row_index + 4];
-        float row_conf = dev[row_index + 5];
-
-        if (row_conf < score_thresh) {
-            dev[row_index + 4] = NAN;
-            return;
+    if (threadIdx.x < rows) {
+        const int row = row_start + threadIdx.x;
+        const float* box = image_src + image_indices[row] * num_attrs;
+        unsigned long long bits = 0;
+        for (int j = 0; j < cols; ++j) {
+            const float* comp_box = shared_boxes[j];
+            if (col_start + j > row && comp_box[4] == box[4] &&
+                IoU(box[0], box[1], box[2], box[3], comp_box[0], comp_box[1],
+                    comp_box[2], comp_box[3]) > nms_thresh) {
+                bits |= 1ULL << j;
+            }
         }
+        masks[(static_cast<size_t>(image) * top_k + row) * words +
+              blockIdx.x] = bits;
+    }
+}
 
-        for (int i = 0; i < cols; ++i) {
-            float* comp_bbox = &shared_data[i * num_attrs];
-            float comp_label = comp_bbox[4];
-            float comp_conf = comp_bbox[5];
-            if (comp_label == row_label && comp_conf > row_conf) {
-                if (IoU(row_bbox[0], row_bbox[1], row_bbox[2], row_bbox[3],
-                        comp_bbox[0], comp_bbox[1], comp_bbox[2],
-                        comp_bbox[3]) > nms_thresh) {
-                    dev[row_index + 4] = NAN;
-                    return;
+/**
+ * @brief Selects the detections kept by greedy non-maximum suppression.
+ *
+ * One block walks the sorted candidates of the image `blockIdx.x` in order,
+ * keeping a candidate if no kept candidate has suppressed it, while the
+ * threads of the block merge the mask of each kept candidate into the shared
+ * suppression words. Kept detections are written densely in descending order
+ * of confidence.
+ *
+ * @param src Pointer to the decoded detections of the batch.
+ * @param indices Pointer to the anchor indices of the sorted candidates.
+ * @param begins Pointer to the begin offsets of the segments of each image.
+ * @param ends Pointer to the end offsets of the segments of each image.
+ * @param masks Pointer to the masks computed by `NMSMaskKernel`.
+ * @param dst Pointer to the kept detections, which has `top_k` detections for
+ * each image and may be mapped host memory.
+ * @param counts Pointer to the number of kept detections of each image.
+ * @param anchors The number of anchors of each image.
+ * @param top_k The maximum number of candidates of each image.
+ * @note The dynamic shared memory must hold `ceil(top_k / 64)` words.
+ */
+__global__ void NMSSelectKernel(const float* src, const int* indices,
+                                const int* begins, const int* ends,
+                                const unsigned long long* masks, float* dst,
+                                int* counts, int anchors, int top_k) {
+    constexpr int block_size = 64;
+    constexpr int num_attrs = sizeof(Detection) / sizeof(float);
+    const int image = blockIdx.x;
+    const int count = min(ends[image] - begins[image], top_k);
+    const int words = (top_k + block_size - 1) / block_size;
+    const int used_words = (count + block_size - 1) / block_size;
+    const float* image_src = src + image * anchors * num_attrs;
+    const int* image_indices = indices + begins[image];
+    const unsigned long long* image_masks =
+        masks + static_cast<size_t>(image) * top_k * words;
+    float* image_dst = dst + static_cast<size_t>(image) * top_k * num_attrs;
+
+    extern __shared__ unsigned long long removed[];
+    for (int w = threadIdx.x; w < used_words; w += blockDim.x) {
+        removed[w] = 0;
+    }
+    __syncthreads();
+
+    int kept = 0;
+    for (int i = 0; i < count; ++i) {
+        bool keep = !((removed[i / block_size] >> (i % block_size)) & 1ULL);
+        __syncthreads();
+        if (keep) {
+            const unsigned long long* row = image_masks + i * words;
+            for (int w = threadIdx.x; w < used_words; w += blockDim.x) {
+                removed[w] |= row[w];
+            }
+            if (threadIdx.x == 0) {
+                const float* detection =
+                    image_src + image_indices[i] * num_attrs;
+#pragma unroll
+                for (int k = 0; k < num_attrs; ++k) {
+                    image_dst[kept * num_attrs + k] = detection[k];
                 }
             }
+            ++kept;
         }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0) {
+        counts[image] = kept;
     }
 }
 
@@ -369,210 +565,342 @@ using namespace radar::detect;
  * @brief Preprocesses a single image using the Detector class.
  *
  * This function preprocesses a single image using the provided Detector class.
- * It performs several operations including resizing, padding, and normalization
- * to prepare the image for further processing.
+ * It uploads the image and prepares the letterbox parameters, with which
+ * resizing, padding, and normalization are performed in a single kernel when
+ * the batch is launched.
  *
+ * @param slot The inference slot whose buffers and streams are used.
  * @param image The input image to be preprocessed.
  * @return A vector of preprocessed image parameters with only a single element.
  * @note The number of channels of input image must be equal to
  * `input_channels_` or it will trigger assertion failure.
  */
-std::vector<PreParam> Detector::preprocess(const cv::Mat& image) noexcept {
-    assert(image.channels() == input_channels_);
-
-    dim3 block_size(16, 16);
-    dim3 grid_size;
-
-    batch_size_ = 1;
-
-    std::memcpy(image_ptr_, image.data,
-                image.total() * image.elemSize() * sizeof(unsigned char));
-
-    auto& stream{streams_[0]};
-
-    PreParam pparam(image.size(), cv::Size(input_width_, input_height_));
-    float padding_width{pparam.width / pparam.ratio};
-    float padding_height{pparam.height / pparam.ratio};
-    grid_size = dim3((padding_width + block_size.x - 1) / block_size.x,
-                     (padding_height + block_size.y - 1) / block_size.y);
-    resizeKernel<<<grid_size, block_size, 0, stream>>>(
-        image_ptr_, dev_resize_ptr_, input_channels_, pparam.width,
-        pparam.height, padding_width, padding_height);
-
-    int top{static_cast<int>(std::round(pparam.dh - 0.1))};
-    int bottom{static_cast<int>(std::round(pparam.dh + 0.1))};
-    int left{static_cast<int>(std::round(pparam.dw - 0.1))};
-    int right{static_cast<int>(std::round(pparam.dw + 0.1))};
-    grid_size = dim3((input_width_ + block_size.x - 1) / block_size.x,
-                     (input_height_ + block_size.y - 1) / block_size.y);
-    copyMakeBorderKernel<<<grid_size, block_size, 0, stream>>>(
-        dev_resize_ptr_, dev_border_ptr_, input_channels_, padding_width,
-        padding_height, top, bottom, left, right);
-
-    blobKernel<<<grid_size, block_size, 0, stream>>>(
-        dev_border_ptr_, static_cast<float*>(input_tensor_.data()),
-        input_width_, input_height_, input_channels_, 1 / 255.f);
-
-    context_->setInputShape(input_tensor_.name(),
-                            nvinfer1::Dims4(batch_size_, input_channels_,
-                                            input_width_, input_height_));
-
-    return std::vector<PreParam>{pparam};
+std::vector<PreParam> Detector::preprocess(Slot& slot,
+                                           const cv::Mat& image) noexcept {
+    return preprocess(slot, std::span(&image, 1));
 }
 
 /**
  * @brief Preprocesses a batch of images using the Detector class.
  *
- * This function preprocesses a batch of images using the provided Detector
- * class. It performs several operations including resizing, padding, and
- * normalization for each image in the batch, and returns the preprocessed image
- * parameters for each image.
+ * This function uploads the batch of images into device memory by `upload`,
+ * where they are kept as the images of the slot. Resizing, padding, and
+ * normalization of every image are then performed by a single kernel when the
+ * batch is launched, and the preprocessed image parameters for each image are
+ * returned.
  *
- * @param first Iterator pointing to the first image in the batch.
- * @param last Iterator pointing to the position after the last image in the
- * batch.
+ * @param slot The inference slot whose buffers and streams are used.
+ * @param images The batch of images.
  * @return A vector of preprocessed image parameters for each image in the
  * batch.
  * @note The number of channels of each input image must be equal to
  * `input_channels_` or it will trigger assertion failure.
  */
 std::vector<PreParam> Detector::preprocess(
-    const std::span<cv::Mat> images) noexcept {
-    dim3 block_size(16, 16);
-    dim3 grid_size;
+    Slot& slot, std::span<const cv::Mat> images) noexcept {
+    RADAR_PROFILE_SCOPE("detect.preprocess");
+    upload(slot, images);
+    slot.batch_size = images.size();
+
+    std::vector<PreParam> pparams;
+    pparams.reserve(slot.batch_size);
+    for (int i = 0; i < slot.batch_size; ++i) {
+        const auto& device_image{slot.images[i]};
+        PreParam pparam(images[i].size(),
+                        cv::Size(input_width_, input_height_));
+        slot.letterbox_ptr[i] = LetterboxParam(
+            device_image, cv::Rect(0, 0, images[i].cols, images[i].rows),
+            pparam);
+        pparams.emplace_back(pparam);
+    }
+    return pparams;
+}
 
-    batch_size_ = images.size();
+/**
+ * @brief Preprocesses crops of a group of images as a batch.
+ *
+ * The images are uploaded by `upload` as a batch of whole images is, and are
+ * kept as the images of the slot, while the inputs of the batch are only the
+ * crops letterboxed from them. A crop smaller than the input of the network is
+ * therefore detected in its full resolution instead of being scaled down with
+ * the whole image.
+ *
+ * @param slot The inference slot whose buffers and streams are used.
+ * @param images The images, each of which is uploaded once however many crops
+ * it has.
+ * @param crops The crops forming the batch, each of which lies in its image.
+ * @return A vector of preprocessed image parameters for each crop, which
+ * restore the detections to the coordinates of the crop.
+ * @note The number of channels of each input image must be equal to
+ * `input_channels_` or it will trigger assertion failure.
+ */
+std::vector<PreParam> Detector::preprocess(
+    Slot& slot, std::span<const cv::Mat> images,
+    std::span<const Crop> crops) noexcept {
+    RADAR_PROFILE_SCOPE("detect.preprocess");
+    upload(slot, images);
+    slot.batch_size = crops.size();
 
     std::vector<PreParam> pparams;
-    pparams.reserve(batch_size_);
+    pparams.reserve(slot.batch_size);
+    for (int i = 0; i < slot.batch_size; ++i) {
+        const auto& [image, rect]{crops[i]};
+        PreParam pparam(rect.size(), cv::Size(input_width_, input_height_));
+        slot.letterbox_ptr[i] =
+            LetterboxParam(slot.images[image], rect, pparam);
+        pparams.emplace_back(pparam);
+    }
+    return pparams;
+}
 
-    size_t offset_image{0}, offset_resize{0}, offset_input{0};
+/**
+ * @brief Uploads images into the device memory of a slot, where they are kept
+ * as the images of the slot.
+ *
+ * Continuous images in page-locked memory are uploaded straight from it, while
+ * the others are copied into the pinned memory of the slot and uploaded
+ * together.
+ *
+ * @param slot The inference slot whose buffers and streams are used.
+ * @param images The images.
+ * @note The number of channels of each input image must be equal to
+ * `input_channels_` or it will trigger assertion failure.
+ */
+void Detector::upload(Slot& slot, std::span<const cv::Mat> images) noexcept {
+    slot.images.clear();
 
-    for (size_t i = 0; i < batch_size_; ++i) {
-        cv::Mat& image = images[i];
+    size_t bytes{0};
+    for (const auto& image : images) {
+        bytes += image.total() * image.elemSize();
+    }
+    reserveImages(slot, bytes);
+
+    // Images staged one after another are uploaded with a single copy, where
+    // they are at the same offsets as in device memory
+    size_t offset_image{0}, offset_staged{0};
+    auto upload_staged = [&] {
+        if (offset_image > offset_staged) {
+            CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(
+                slot.dev_image_ptr + offset_staged,
+                slot.image_ptr + offset_staged, offset_image - offset_staged,
+                cudaMemcpyHostToDevice, slot.streams[0]));
+        }
+    };
+    for (const auto& image : images) {
+        const size_t image_bytes{image.total() * image.elemSize()};
 
         assert(image.channels() == input_channels_);
 
-        std::memcpy(image_ptr_ + offset_image, image.data,
-                    image.total() * image.elemSize() * sizeof(unsigned char));
-
-        PreParam pparam(image.size(), cv::Size(input_width_, input_height_));
-
-        float padding_width{pparam.width / pparam.ratio};
-        float padding_height{pparam.height / pparam.ratio};
-        grid_size = dim3((padding_width + block_size.x - 1) / block_size.x,
-                         (padding_height + block_size.y - 1) / block_size.y);
-        resizeKernel<<<grid_size, block_size, 0, streams_[i]>>>(
-            image_ptr_ + offset_image, dev_resize_ptr_ + offset_resize,
-            input_channels_, pparam.width, pparam.height, padding_width,
-            padding_height);
-
-        int top{static_cast<int>(std::round(pparam.dh - 0.1))};
-        int bottom{static_cast<int>(std::round(pparam.dh + 0.1))};
-        int left{static_cast<int>(std::round(pparam.dw - 0.1))};
-        int right{static_cast<int>(std::round(pparam.dw + 0.1))};
-        grid_size = dim3((input_width_ + block_size.x - 1) / block_size.x,
-                         (input_height_ + block_size.y - 1) / block_size.y);
-        copyMakeBorderKernel<<<grid_size, block_size, 0, streams_[i]>>>(
-            dev_resize_ptr_ + offset_resize, dev_border_ptr_ + offset_input,
-            input_channels_, padding_width, padding_height, top, bottom, left,
-            right);
-
-        blobKernel<<<grid_size, block_size, 0, streams_[i]>>>(
-            dev_border_ptr_ + offset_input,
-            static_cast<float*>(input_tensor_.data()) + offset_input,
-            input_width_, input_height_, input_channels_, 1 / 255.f);
-
-        offset_image += image.total() * image.elemSize();
-        offset_resize += padding_height * padding_width * input_channels_;
-        offset_input += input_width_ * input_height_ * input_channels_;
+        if (image.isContinuous() && isPinned(image.data)) {
+            upload_staged();
+            CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(
+                slot.dev_image_ptr + offset_image, image.data, image_bytes,
+                cudaMemcpyHostToDevice, slot.streams[0]));
+            offset_staged = offset_image + image_bytes;
+        } else {
+            // Copying through a header keeps non-continuous images dense
+            cv::Mat staging(image.size(), image.type(),
+                            slot.image_ptr + offset_image);
+            image.copyTo(staging);
+        }
 
-        pparams.emplace_back(pparam);
+        slot.images.emplace_back(DeviceImage{
+            slot.dev_image_ptr + offset_image, image.cols, image.rows,
+            image.channels(), static_cast<int>(image.cols * image.elemSize())});
+
+        offset_image += image_bytes;
     }
 
-    context_->setInputShape(input_tensor_.name(),
-                            nvinfer1::Dims4(batch_size_, input_channels_,
-                                            input_width_, input_height_));
+    // The images are uploaded once, so that the kernel and other regions of
+    // interest read them from device memory instead of going through PCIe
+    upload_staged();
+}
+
+/**
+ * @brief Preprocesses regions of images in device memory as a batch.
+ *
+ * This function prepares the same kernel as preprocessing host images, whose
+ * letterbox parameters describe the regions of the device images instead of
+ * whole images. The images themselves are never copied.
+ *
+ * @param slot The inference slot whose buffers and streams are used.
+ * @param regions The regions forming the batch, each of which lies in its
+ * image.
+ * @return A vector of preprocessed image parameters for each region, which
+ * restore the detections to the coordinates of the region.
+ * @note The number of channels of every image must be equal to
+ * `input_channels_` or it will trigger assertion failure.
+ */
+std::vector<PreParam> Detector::preprocess(
+    Slot& slot, std::span<const Region> regions) noexcept {
+    RADAR_PROFILE_SCOPE("detect.preprocess");
+    slot.batch_size = regions.size();
+    slot.images.clear();
 
-    std::for_each_n(streams_.begin(), batch_size_, [this](auto&& stream) {
-        CUDA_CHECK_NOEXCEPT(cudaStreamSynchronize(stream));
-    });
+    std::vector<PreParam> pparams;
+    pparams.reserve(slot.batch_size);
+    for (int i = 0; i < slot.batch_size; ++i) {
+        const auto& [image, rect]{regions[i]};
+        assert(image.channels == input_channels_);
+        PreParam pparam(rect.size(), cv::Size(input_width_, input_height_));
+        slot.letterbox_ptr[i] = LetterboxParam(image, rect, pparam);
+        pparams.emplace_back(pparam);
+    }
 
     return pparams;
 }
 
 /**
- * @brief Post-process the detections using CUDA kernels.
- *
- * This function post-processes the raw output of a detection model using CUDA.
- * It consists of transposing the output matrix, decoding the detections,
- * applying non-maximum suppression (NMS), sorting the detections, and filtering
- * them based on a confidence threshold. The results are copied back to the host
- * and returned as a vector of Detection objects. Each Detection object is
- * restored with corresponding `PreParam` data before being added to the
- * results.
- *
- * @param pparams A `std::span` of PreParam objects that contain pre-processing
- * parameters.
- * @return `std::vector<std::vector<Detection>>` A batch-sized vector of vectors
- * containing the detections.
+ * @brief Enqueues letterboxing of the current batch into the input tensor.
+ *
+ * The letterbox parameters in pinned memory are uploaded with a single copy,
+ * and one kernel writes the whole batch on the first stream of the slot, in
+ * half precision if the input tensor of the engine is.
+ *
+ * @param slot The inference slot, whose letterbox parameters of the batch
+ * have been filled.
+ */
+void Detector::letterbox(Slot& slot) noexcept {
+    // The pinned parameters are free to overwrite, since the previous batch of
+    // the slot has finished when the slot was released
+    auto& stream{slot.streams[0]};
+    CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(
+        slot.dev_letterbox_ptr, slot.letterbox_ptr,
+        slot.batch_size * sizeof(LetterboxParam), cudaMemcpyHostToDevice,
+        stream));
+
+    dim3 block_size(16, 16);
+    dim3 grid_size((input_width_ + block_size.x - 1) / block_size.x,
+                   (input_height_ + block_size.y - 1) / block_size.y,
+                   slot.batch_size);
+    letterboxKernel<<<grid_size, block_size, 0, stream>>>(
+        slot.dev_letterbox_ptr, slot.input_tensor.data(), input_width_,
+        input_height_, input_channels_, 1 / 255.f,
+        slot.input_tensor.dtype() == nvinfer1::DataType::kHALF);
+}
+
+/**
+ * @brief Enqueues post-processing of the detections using CUDA kernels.
+ *
+ * This function enqueues the post-processing of the raw output of a detection
+ * model using CUDA. It consists of transposing the output matrix, decoding the
+ * detections on the stream of each image, which waits for inference to finish
+ * through an event. After all streams are joined into the first one,
+ * non-maximum suppression (NMS) of the batch is applied there: anchors below
+ * the score threshold are filtered out, the candidates of each image are
+ * sorted by confidence with a segmented radix sort, and at most `top_k_` of
+ * them go through a class-aware bitmask NMS. The kept detections are written
+ * straight into the mapped output buffer, and only the counts are copied back
+ * to the host.
+ *
+ * @param slot The inference slot whose buffers and streams are used.
  * @note This function will call `std::abort()` if problems have been
- * encountered in CUDA operations or memory allocation.
+ * encountered in CUDA operations.
  */
-std::vector<std::vector<Detection>> Detector::postprocess(
-    std::span<PreParam> pparams) noexcept {
+void Detector::postprocess(Slot& slot) noexcept {
     size_t offset_output{0}, offset_decode{0};
 
     dim3 block_size, grid_size;
-    for (int i = 0; i < batch_size_; ++i) {
+    for (int i = 0; i < slot.batch_size; ++i) {
         block_size = dim3(32, 32);
         grid_size = dim3((output_anchors_ + block_size.x - 1) / block_size.x,
                          (output_channels_ + block_size.y - 1) / block_size.y);
-        transposeKernel<<<grid_size, block_size, 0, streams_[i]>>>(
-            static_cast<float*>(output_tensor_.data()) + offset_output,
-            dev_transpose_ptr_ + offset_output, output_channels_,
+        transposeKernel<<<grid_size, block_size, 0, slot.streams[i]>>>(
+            static_cast<float*>(slot.output_tensor.data()) + offset_output,
+            slot.dev_transpose_ptr + offset_output, output_channels_,
             output_anchors_);
 
         block_size = dim3(32);
         grid_size = dim3((output_anchors_ + block_size.x - 1) / block_size.x);
-        decodeKernel<<<grid_size, block_size, 0, streams_[i]>>>(
-            dev_transpose_ptr_ + offset_output, dev_decode_ptr_ + offset_decode,
-            output_channels_, output_anchors_, classes_);
-
-        block_size = dim3(16 * 16);
-        grid_size = dim3((output_anchors_ + block_size.x - 1) / block_size.x,
-                         (output_anchors_ + block_size.x - 1) / block_size.x);
-        NMSKernel<<<grid_size, block_size, block_size.x * sizeof(Detection),
-                    streams_[i]>>>(dev_decode_ptr_ + offset_decode, nms_thresh_,
-                                   conf_thresh_, output_anchors_);
-
-        cudaMemcpyAsync(nms_ptr_, dev_decode_ptr_,
-                        output_anchors_ * batch_size_ * sizeof(Detection),
-                        cudaMemcpyDeviceToHost, streams_[i]);
+        decodeKernel<<<grid_size, block_size, 0, slot.streams[i]>>>(
+            slot.dev_transpose_ptr + offset_output,
+            slot.dev_decode_ptr + offset_decode, output_channels_,
+            output_anchors_, classes_);
 
         offset_output += output_channels_ * output_anchors_;
         offset_decode += sizeof(Detection) / sizeof(float) * output_anchors_;
     }
+    joinStreams(slot);
+
+    // NMS of the whole batch runs on the first stream, where each image is a
+    // segment of the candidate arrays
+    auto& stream{slot.streams[0]};
+    CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(
+        slot.dev_end_ptr, slot.dev_begin_ptr, slot.batch_size * sizeof(int),
+        cudaMemcpyDeviceToDevice, stream));
+    block_size = dim3(256);
+    grid_size = dim3((output_anchors_ + block_size.x - 1) / block_size.x,
+                     slot.batch_size);
+    prefilterKernel<<<grid_size, block_size, 0, stream>>>(
+        slot.dev_decode_ptr, slot.dev_key_ptr, slot.dev_index_ptr,
+        slot.dev_end_ptr, output_anchors_, conf_thresh_);
+
+    CUDA_CHECK_NOEXCEPT(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+        slot.dev_sort_storage_ptr, slot.sort_storage_bytes, slot.dev_key_ptr,
+        slot.dev_sorted_key_ptr, slot.dev_index_ptr, slot.dev_sorted_index_ptr,
+        slot.batch_size * output_anchors_, slot.batch_size, slot.dev_begin_ptr,
+        slot.dev_end_ptr, 0, sizeof(float) * 8, stream));
+
+    constexpr int nms_block_size{64};
+    int words{(top_k_ + nms_block_size - 1) / nms_block_size};
+    NMSMaskKernel<<<dim3(words, words, slot.batch_size), nms_block_size, 0,
+                    stream>>>(slot.dev_decode_ptr, slot.dev_sorted_index_ptr,
+                              slot.dev_begin_ptr, slot.dev_end_ptr,
+                              slot.dev_mask_ptr, output_anchors_, top_k_,
+                              nms_thresh_);
+    NMSSelectKernel<<<slot.batch_size, nms_block_size,
+                      words * sizeof(unsigned long long), stream>>>(
+        slot.dev_decode_ptr, slot.dev_sorted_index_ptr, slot.dev_begin_ptr,
+        slot.dev_end_ptr, slot.dev_mask_ptr,
+        reinterpret_cast<float*>(slot.output_ptr), slot.dev_count_ptr,
+        output_anchors_, top_k_);
+    CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(slot.count_ptr, slot.dev_count_ptr,
+                                        slot.batch_size * sizeof(int),
+                                        cudaMemcpyDeviceToHost, stream));
+}
 
-    std::for_each_n(streams_.begin(), batch_size_, [this](auto&& stream) {
-        CUDA_CHECK_NOEXCEPT(cudaStreamSynchronize(stream));
-    });
+/**
+ * @brief Computes the bytes of temporary storage for sorting the candidates
+ * of NMS.
+ *
+ * @param num_items The maximum number of candidates of a batch.
+ * @param num_segments The maximum number of images of a batch.
+ * @return The bytes of temporary storage.
+ */
+size_t Detector::sortStorageBytes(int num_items, int num_segments) {
+    size_t bytes{0};
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+        nullptr, bytes, static_cast<const float*>(nullptr),
+        static_cast<float*>(nullptr), static_cast<const int*>(nullptr),
+        static_cast<int*>(nullptr), num_items, num_segments,
+        static_cast<const int*>(nullptr), static_cast<const int*>(nullptr)));
+    return bytes;
+}
 
-    std::vector<std::vector<Detection>> results(batch_size_);
+/**
+ * @brief Collects the detections of a finished batch from the host buffer.
+ *
+ * Only the kept detections of each image are read, which are in descending
+ * order of confidence, and each of them is restored with corresponding
+ * `PreParam` data before being added to the results.
+ *
+ * @param slot The inference slot, whose operations must have finished.
+ * @return `std::vector<std::vector<Detection>>` A batch-sized vector of vectors
+ * containing the detections.
+ */
+std::vector<std::vector<Detection>> Detector::collect(Slot& slot) noexcept {
+    RADAR_PROFILE_SCOPE("detect.collect");
+    std::vector<std::vector<Detection>> results(slot.batch_size);
     std::for_each(
         std::execution::par_unseq, results.begin(), results.end(),
         [&](std::vector<Detection>& result) {
             int i = &result - &results[0];
-            std::span<Detection> detections(
-                reinterpret_cast<Detection*>(nms_ptr_) + output_anchors_ * i,
-                output_anchors_);
-            auto nan_filtered_detections =
-                detections | std::views::filter([](const auto& detection) {
-                    return !std::isnan(detection.label);
-                });
-
-            const auto& pparam{pparams[i]};
-            for (auto& detection : nan_filtered_detections) {
+            std::span<const Detection> detections(
+                slot.output_ptr + i * top_k_, slot.count_ptr[i]);
+
+            const auto& pparam{slot.pparams[i]};
+            result.reserve(detections.size());
+            for (auto detection : detections) {
                 restoreDetection(detection, pparam);
                 result.emplace_back(detection);
             }
@@ -15,7 +15,10 @@
 #include <NvInfer.h>
 #include <cuda_runtime.h>
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <optional>
 #include <span>
@@ -23,9 +26,13 @@
 #include <type_traits>
 #include <vector>
 
+#include "calibrator.h"
 #include "common.h"
 #include "detection.h"
+#include "engine_cache.h"
+#include "frame_buffer.h"
 #include "preparam.h"
+#include "roi_scheduler.h"
 #include "robot/robot.h"
 #include "tensor.h"
 #include "trt_logger.h"
@@ -46,14 +53,28 @@ __global__ void copyMakeBorderKernel(const unsigned char* src,
 __global__ void blobKernel(const unsigned char* src, float* dst, int width,
                            int height, int channels, float scale);
 
+__global__ void letterboxKernel(const LetterboxParam* params, void* dst,
+                                int width, int height, int channels,
+                                float scale, bool half);
+
 __global__ void transposeKernel(const float* src, float* dst, int rows,
                                 int cols);
 
 __global__ void decodeKernel(const float* src, float* dst, int channels,
                              int anchors, int classes);
 
-__global__ void NMSKernel(float* dev, float nms_thresh, float score_thresh,
-                          int anchors);
+__global__ void prefilterKernel(const float* src, float* keys, int* indices,
+                                int* ends, int anchors, float score_thresh);
+
+__global__ void NMSMaskKernel(const float* src, const int* indices,
+                              const int* begins, const int* ends,
+                              unsigned long long* masks, int anchors,
+                              int top_k, float nms_thresh);
+
+__global__ void NMSSelectKernel(const float* src, const int* indices,
+                                const int* begins, const int* ends,
+                                const unsigned long long* masks, float* dst,
+                                int* counts, int anchors, int top_k);
 
 }  // namespace detect
 
@@ -76,10 +97,74 @@ concept ImageOrImages =
         std::is_same_v<typename std::decay_t<T>::value_type, cv::Mat>;
     };
 
+class Detector;
+
+/**
+ * @brief A handle of detections enqueued by `Detector::enqueue`, which are
+ * still being computed on the GPU.
+ *
+ * The ticket occupies one inference slot of the detector, whose buffers are
+ * released when the ticket is destroyed. Results are obtained by `wait`, which
+ * blocks on a CUDA event recorded after the last operation of the slot, so the
+ * caller is free to do other work between enqueueing and waiting.
+ */
+class DetectionTicket {
+   public:
+    DetectionTicket() = default;
+
+    DetectionTicket(DetectionTicket&& rhs) noexcept
+        : detector_{rhs.detector_}, slot_{rhs.slot_} {
+        rhs.detector_ = nullptr;
+    }
+
+    DetectionTicket& operator=(DetectionTicket&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            detector_ = rhs.detector_;
+            slot_ = rhs.slot_;
+            rhs.detector_ = nullptr;
+        }
+        return *this;
+    }
+
+    DetectionTicket(const DetectionTicket&) = delete;
+    DetectionTicket& operator=(const DetectionTicket&) = delete;
+
+    ~DetectionTicket() { release(); }
+
+    /**
+     * @brief Checks if the ticket refers to an enqueued detection.
+     *
+     * @return `true` if the ticket is valid, otherwise `false`.
+     */
+    inline bool valid() const noexcept { return detector_ != nullptr; }
+
+    bool ready() const noexcept;
+
+    std::vector<std::vector<Detection>> wait() noexcept;
+
+    detect::DeviceImage image(int index = 0) const noexcept;
+
+   private:
+    friend class Detector;
+
+    DetectionTicket(Detector* detector, int slot)
+        : detector_{detector}, slot_{slot} {}
+
+    void release() noexcept;
+
+    Detector* detector_{nullptr};
+    int slot_{0};
+};
+
 /**
  * @brief The Detector class provides functionality for object detection
  * using a pre-trained model.
  *
+ * The detector owns a fixed number of inference slots, each of which has its
+ * own execution context, streams and device buffers. Every call of `enqueue`
+ * occupies one slot until its ticket is released, so up to `num_slots` batches
+ * can be in flight at the same time.
  */
 class Detector {
    public:
@@ -91,18 +176,62 @@ class Detector {
                       float conf_thresh = 0.25, int input_width = 640,
                       int input_height = 640,
                       std::string_view input_name = "images",
-                      int input_channels = 3, int opt_level = 3);
+                      int input_channels = 3, int opt_level = 3,
+                      int num_slots = 2, bool fp16_input = false,
+                      bool use_graph = false, int top_k = 1024,
+                      std::optional<detect::Int8Config> int8 = std::nullopt);
     ~Detector();
 
+    /**
+     * @brief Enqueues detection on an input image or images without waiting
+     * for the result.
+     *
+     * The input is uploaded to the device buffer of a free slot, and then
+     * preprocessing, inference and postprocessing are enqueued on the streams
+     * of the slot. Continuous images in page-locked memory, such as those of
+     * frame buffers, are uploaded straight from it, and the other images are
+     * copied into the pinned buffer of the slot first. Streams of a batch are
+     * joined by CUDA events, so the host never waits on the GPU in this
+     * function.
+     *
+     * @tparam ImageOrImages A type satisfying a single `cv::Mat` or a container
+     * of `cv::Mat` objects.
+     * @param input A universal reference to the input image or images to be
+     * processed.
+     * @return `DetectionTicket` The ticket used to wait for the detections.
+     * @throws `std::runtime_error` if every slot is occupied by a ticket.
+     * @note Images uploaded from page-locked memory must not be modified or
+     * freed until the ticket is waited for or released.
+     * @note If the function encounters a problem in CUDA checking, it will
+     * call `std::abort()` directly.
+     */
+    template <ImageOrImages T>
+    DetectionTicket enqueue(T&& input) {
+        int index{acquire()};
+        auto& slot{*slots_[index]};
+        if constexpr (std::is_same_v<std::decay_t<T>, cv::Mat>) {
+            slot.pparams = preprocess(slot, input);
+        } else {
+            slot.pparams = preprocess(slot, std::span<const cv::Mat>(input));
+        }
+        launch(slot);
+        return DetectionTicket(this, index);
+    }
+
+    DetectionTicket enqueue(const detect::DeviceImage& image,
+                            std::span<const cv::Rect> rois);
+
+    DetectionTicket enqueue(std::span<const detect::Region> regions);
+
+    DetectionTicket enqueue(std::span<const cv::Mat> images,
+                            std::span<const detect::Crop> crops);
+
     /**
      * @brief Performs detection on an input image or images.
      *
      * This function processes an input, which can be either a single image or a
-     * collection of images, and performs object detection. The detection
-     * pipeline consists of preprocessing the input, running inference using
-     * TensorRT's context (`context_`), and postprocessing to obtain the final
-     * detection results. If the input is not a single `cv::Mat`, the CUDA
-     * stream is synchronized after inference to ensure correct operation order.
+     * collection of images, and performs object detection. It is equivalent to
+     * `enqueue` followed by waiting on the returned ticket.
      *
      * @tparam ImageOrImages A type satisfying a single `cv::Mat` or a container
      * of `cv::Mat` objects.
@@ -111,21 +240,13 @@ class Detector {
      * @return `std::vector<Detection>` or `std::vector<std::vector<Detection>>`
      * A vector of detections if input is a single image, or a batch-sized
      * vector of vectors containing the detections.
-     * @exception `noexcept` This function is declared to not throw exceptions.
-     * However, if the function encounters a problem in CUDA checking, it will
+     * @throws `std::runtime_error` if every slot is occupied by a ticket.
+     * @note If the function encounters a problem in CUDA checking, it will
      * call `std::abort()` directly.
      */
     template <ImageOrImages T>
-    auto detect(T&& input) noexcept {
-        std::vector<detect::PreParam> pparams{
-            preprocess(std::forward<T>(input))};
-
-        context_->enqueueV3(streams_[0]);
-        if constexpr (!std::is_same_v<std::decay_t<T>, cv::Mat>) {
-            CUDA_CHECK_NOEXCEPT(cudaStreamSynchronize(streams_[0]));
-        }
-
-        auto detections{postprocess(pparams)};
+    auto detect(T&& input) {
+        auto detections{enqueue(std::forward<T>(input)).wait()};
 
         if constexpr (std::is_same_v<std::decay_t<T>, cv::Mat>) {
             return detections[0];
@@ -134,15 +255,98 @@ class Detector {
         }
     }
 
+    /**
+     * @brief Gets the number of inference slots, which is the maximum number
+     * of batches in flight.
+     *
+     * @return The number of slots.
+     */
+    inline int numSlots() const noexcept { return slots_.size(); }
+
+    /**
+     * @brief Gets the maximum number of images or regions in one batch.
+     *
+     * @return The maximum batch size.
+     */
+    inline int maxBatchSize() const noexcept { return max_batch_size_; }
+
+    void reserveFrameBuffers(cv::Size size, int count);
+
+    detect::FrameBuffer acquireFrameBuffer();
+
    private:
-    std::vector<detect::PreParam> preprocess(const cv::Mat& image) noexcept;
+    friend class DetectionTicket;
+
+    /**
+     * @brief Resources of one batch in flight.
+     *
+     */
+    struct Slot {
+        std::unique_ptr<nvinfer1::IExecutionContext> context{nullptr};
+        detect::Tensor input_tensor, output_tensor;
+        std::vector<cudaStream_t> streams;
+        std::vector<cudaEvent_t> join_events;
+        cudaEvent_t infer_event{nullptr};
+        cudaEvent_t done_event{nullptr};
+        // Events bounding letterboxing, inference and postprocessing, which
+        // are only created when metrics are enabled.
+        std::array<cudaEvent_t, 4> timing_events{};
+        std::vector<cudaGraphExec_t> graphs;
+        unsigned char* image_ptr{nullptr};
+        unsigned char* dev_image_ptr{nullptr};
+        size_t image_capacity{0};
+        detect::LetterboxParam* letterbox_ptr{nullptr};
+        detect::LetterboxParam* dev_letterbox_ptr{nullptr};
+        float* dev_transpose_ptr{nullptr};
+        float* dev_decode_ptr{nullptr};
+        float* dev_key_ptr{nullptr};
+        float* dev_sorted_key_ptr{nullptr};
+        int* dev_index_ptr{nullptr};
+        int* dev_sorted_index_ptr{nullptr};
+        int* dev_begin_ptr{nullptr};
+        int* dev_end_ptr{nullptr};
+        void* dev_sort_storage_ptr{nullptr};
+        size_t sort_storage_bytes{0};
+        unsigned long long* dev_mask_ptr{nullptr};
+        int* dev_count_ptr{nullptr};
+        int* count_ptr{nullptr};
+        Detection* output_ptr{nullptr};
+        std::vector<detect::PreParam> pparams;
+        std::vector<detect::DeviceImage> images;
+        int batch_size{0};
+        bool busy{false};
+    };
+
+    std::vector<detect::PreParam> preprocess(Slot& slot,
+                                             const cv::Mat& image) noexcept;
+    std::vector<detect::PreParam> preprocess(
+        Slot& slot, std::span<const cv::Mat> images) noexcept;
     std::vector<detect::PreParam> preprocess(
-        const std::span<cv::Mat> images) noexcept;
-    std::vector<std::vector<Detection>> postprocess(
-        std::span<detect::PreParam> pparams) noexcept;
+        Slot& slot, std::span<const detect::Region> regions) noexcept;
+    std::vector<detect::PreParam> preprocess(
+        Slot& slot, std::span<const cv::Mat> images,
+        std::span<const detect::Crop> crops) noexcept;
+    void upload(Slot& slot, std::span<const cv::Mat> images) noexcept;
+    void letterbox(Slot& slot) noexcept;
+    void infer(Slot& slot) noexcept;
+    void execute(Slot& slot) noexcept;
+    cudaGraphExec_t capture(Slot& slot) noexcept;
+    void launch(Slot& slot) noexcept;
+    void postprocess(Slot& slot) noexcept;
+    std::vector<std::vector<Detection>> collect(Slot& slot) noexcept;
+    void joinStreams(Slot& slot) noexcept;
+    void forkStreams(Slot& slot, cudaEvent_t event) noexcept;
+    void recordTiming(Slot& slot, int stage) noexcept;
+    void reportTiming(Slot& slot) noexcept;
+    int acquire();
+    void release(int index) noexcept;
+    void reserveImages(Slot& slot, size_t bytes) noexcept;
     std::pair<std::shared_ptr<char[]>, size_t> serializeEngine(
-        std::string_view onnx_path, int opt_batch_size, int max_batch_size,
-        int opt_level);
+        std::string_view onnx_path, const detect::EngineProfile& profile,
+        std::string_view timing_cache_path);
+    std::unique_ptr<nvinfer1::ICudaEngine> deserializeEngine(
+        const std::pair<std::shared_ptr<char[]>, size_t>& model);
+    static size_t sortStorageBytes(int num_items, int num_segments);
     void restoreDetection(Detection& detection,
                           const detect::PreParam& pparam) const noexcept;
     static void writeToFile(std::span<const char> data, std::string_view path);
@@ -150,23 +354,23 @@ class Detector {
         std::string_view path);
     std::unique_ptr<nvinfer1::IRuntime> runtime_{nullptr};
     std::unique_ptr<nvinfer1::ICudaEngine> engine_{nullptr};
-    std::unique_ptr<nvinfer1::IExecutionContext> context_{nullptr};
     int input_width_, input_height_, input_channels_;
+    int max_batch_size_;
     std::string_view input_name_;
     int classes_;
     float nms_thresh_, conf_thresh_;
+    std::atomic<bool> use_graph_;
+    int top_k_;
+    std::optional<detect::Int8Config> int8_;
     detect::Logger logger_;
-    detect::Tensor input_tensor_, output_tensor_;
-    std::vector<cudaStream_t> streams_;
-    unsigned char* image_ptr_{nullptr};
-    unsigned char* dev_resize_ptr_{nullptr};
-    unsigned char* dev_border_ptr_{nullptr};
-    float* dev_transpose_ptr_{nullptr};
-    float* dev_decode_ptr_{nullptr};
-    float* nms_ptr_{nullptr};
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::mutex slots_mutex_;
+    std::unique_ptr<detect::FrameBufferPool> frame_buffers_{nullptr};
     int output_channels_{0};
     int output_anchors_{0};
-    int batch_size_{0};
+    // Metric sites of letterboxing, inference and postprocessing on the
+    // device, which are registered with the detector if metrics are enabled.
+    std::array<int, 3> timing_sites_{};
 };
 
 class RobotDetector {
@@ -178,16 +382,114 @@ class RobotDetector {
         float armor_nms_thresh = 0.65f, float armor_conf_thresh = 0.50f,
         size_t image_size = 1 << 24, float input_width = 640,
         float input_height = 640, std::string_view input_name = "images",
-        int input_channels = 3, int opt_level = 5);
+        int input_channels = 3, int opt_level = 5, int max_cameras = 1,
+        int max_crops = 0);
 
     RobotDetector() = delete;
 
     std::vector<Robot> detect(const cv::Mat& image);
 
+    std::vector<std::vector<Robot>> detect(std::span<const cv::Mat> images);
+
+    std::vector<Robot> detect(const cv::Mat& image,
+                              const std::vector<cv::Rect>& predictions);
+
+    std::vector<std::vector<Robot>> detect(
+        std::span<const cv::Mat> images,
+        std::span<const std::vector<cv::Rect>> predictions);
+
+    /**
+     * @brief Enables adaptive detection, in which cars are detected in crops
+     * around the predicted boxes given to `detect` between periodic passes
+     * over whole images.
+     *
+     * @param full_frame_period The maximum number of frames from one pass over
+     * whole images to the next one.
+     * @param crop_size The minimum size of the crops, which keeps the input
+     * resolution of the car detector by default.
+     * @throws `std::invalid_argument` if the period or the size is not
+     * positive.
+     * @note The number of crops of a frame is bounded by the maximum batch
+     * size of the car detector, which is the larger of `max_cameras` and
+     * `max_crops` given at construction. This must not be called during
+     * detection.
+     */
+    inline void setAdaptive(int full_frame_period,
+                            std::optional<cv::Size> crop_size = std::nullopt) {
+        scheduler_.emplace(full_frame_period,
+                           crop_size.value_or(car_input_size_),
+                           car_detector_->maxBatchSize());
+    }
+
+    /**
+     * @brief Disables adaptive detection, so that every frame is detected in
+     * whole images.
+     *
+     */
+    inline void resetAdaptive() noexcept { scheduler_.reset(); }
+
+    /**
+     * @brief Checks if adaptive detection is enabled.
+     *
+     * @return `true` if adaptive detection is enabled, otherwise `false`.
+     */
+    inline bool adaptive() const noexcept { return scheduler_.has_value(); }
+
+    /**
+     * @brief Allocates page-locked frame buffers for the images of cameras,
+     * which are detected without being copied on the host.
+     *
+     * @param size The size of the images of the cameras.
+     * @param count The number of buffers.
+     * @throws `std::invalid_argument` if the size or the number is not
+     * positive.
+     * @note This must not be called during detection.
+     */
+    inline void reserveFrameBuffers(cv::Size size, int count) {
+        car_detector_->reserveFrameBuffers(size, count);
+    }
+
+    /**
+     * @brief Borrows a frame buffer allocated by `reserveFrameBuffers`.
+     *
+     * @return The frame buffer.
+     * @throws `std::logic_error` if no frame buffer is allocated.
+     * @throws `std::runtime_error` if every frame buffer is borrowed.
+     */
+    inline detect::FrameBuffer acquireFrameBuffer() {
+        return car_detector_->acquireFrameBuffer();
+    }
+
+    /**
+     * @brief Gets the maximum number of images detected as one batch, which
+     * is `max_cameras` given at construction.
+     *
+     * @return The maximum number of cameras.
+     * @note The car detector may take larger batches of crops, and its memory
+     * for images is only reserved for this number of cameras.
+     */
+    inline int maxCameras() const noexcept { return max_cameras_; }
+
    private:
+    std::vector<std::vector<Detection>> detectCrops(
+        std::span<const cv::Mat> images, std::span<const detect::Crop> crops,
+        DetectionTicket& ticket);
+
+    std::vector<std::vector<Robot>> detectArmors(
+        const DetectionTicket& car_ticket, std::span<const cv::Mat> images,
+        const std::vector<std::vector<Detection>>& car_detections);
+
+    std::vector<Robot> merge(
+        const std::vector<Detection>& car_detections,
+        const std::vector<std::vector<Detection>>& armor_detections) const;
+
     float iou_thresh_;
+    int max_cameras_;
+    cv::Size car_input_size_;
     std::unique_ptr<Detector> car_detector_, armor_detector_;
-    std::vector<cv::Mat> car_images_;
+    std::optional<detect::RoiScheduler> scheduler_;
+    std::vector<detect::Region> car_regions_;
+    std::vector<std::pair<size_t, size_t>> car_indices_;
 };
 
 }  // namespace radar
\ No newline at end of file
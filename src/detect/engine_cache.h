@@ -0,0 +1,209 @@
+/**
+ * @file engine_cache.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements the keys and paths of the TensorRT engine cache,
+ * which identify an engine by its model, device, TensorRT version and build
+ * configuration.
+ * @date 2024-04-11
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <NvInferVersion.h>
+#include <cuda_runtime.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.h"
+
+namespace radar::detect {
+
+/**
+ * @brief The build configuration of an engine, all of which affect the
+ * serialized engine.
+ *
+ */
+struct EngineProfile {
+    int min_batch_size;
+    int opt_batch_size;
+    int max_batch_size;
+    int input_channels;
+    int input_width;
+    int input_height;
+    bool fp16;
+    bool fp16_input;
+    int opt_level;
+    bool int8{false};
+    uint64_t calibration{0};
+    std::string input_name{};
+};
+
+/**
+ * @brief Accumulates bytes into a 64-bit FNV-1a hash.
+ *
+ * @param data The bytes to hash.
+ * @param hash The hash of the previous bytes.
+ * @return The hash of the previous bytes followed by `data`.
+ */
+constexpr inline uint64_t fnv1a(
+    std::string_view data, uint64_t hash = 0xcbf29ce484222325ULL) noexcept {
+    for (unsigned char byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of the content of a file.
+ *
+ * @param path The path of the file.
+ * @return The hash of the file content.
+ * @throws `std::runtime_error` if the file can not be opened.
+ */
+inline uint64_t hashFile(std::string_view path) {
+    std::ifstream ifs{std::string(path), std::ios::binary};
+    if (!ifs) {
+        throw std::runtime_error("failed to open file");
+    }
+    uint64_t hash{fnv1a({})};
+    std::string buffer(1 << 20, '\0');
+    while (ifs.read(buffer.data(), buffer.size()) || ifs.gcount() > 0) {
+        hash = fnv1a(std::string_view(buffer.data(), ifs.gcount()), hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief Computes the hash of the content of a file like `hashFile`, which is
+ * cached by the path, size and modification time of the file, so that a file
+ * is only read again after it changes.
+ *
+ * @param path The path of the file.
+ * @return The hash of the file content.
+ * @throws `std::runtime_error` if the file can not be opened.
+ */
+inline uint64_t cachedHashFile(std::string_view path) {
+    struct Entry {
+        std::filesystem::file_time_type mtime;
+        uintmax_t size;
+        uint64_t hash;
+    };
+    static std::mutex mutex;
+    static std::unordered_map<std::string, Entry> entries;
+
+    std::error_code error;
+    const auto mtime{std::filesystem::last_write_time(path, error)};
+    const auto size{error ? 0 : std::filesystem::file_size(path, error)};
+    if (error) {
+        throw std::runtime_error("failed to open file");
+    }
+    std::lock_guard lock(mutex);
+    auto iter{entries.find(std::string(path))};
+    if (iter != entries.end() && iter->second.mtime == mtime &&
+        iter->second.size == size) {
+        return iter->second.hash;
+    }
+    const uint64_t hash{hashFile(path)};
+    entries.insert_or_assign(std::string(path),
+                             Entry{.mtime = mtime, .size = size, .hash = hash});
+    return hash;
+}
+
+/**
+ * @brief Describes the current device and TensorRT version, which an engine
+ * is bound to.
+ *
+ * @return A string with the compute capability of the current device and the
+ * version of TensorRT.
+ */
+inline std::string platformDescription() {
+    int device{0};
+    CUDA_CHECK(cudaGetDevice(&device));
+    cudaDeviceProp prop;
+    CUDA_CHECK(cudaGetDeviceProperties(&prop, device));
+    std::stringstream ss;
+    ss << "sm" << prop.major << prop.minor << "-trt" << NV_TENSORRT_MAJOR << "."
+       << NV_TENSORRT_MINOR << "." << NV_TENSORRT_PATCH;
+    return ss.str();
+}
+
+/**
+ * @brief Computes the cache key of an engine.
+ *
+ * The key combines the hash of the onnx file, the compute capability of the
+ * current device, the version of TensorRT and the build configuration, so an
+ * engine is only reused when all of them are the same. The hash of the onnx
+ * file is cached until the file changes.
+ *
+ * @param onnx_path The path of the onnx file.
+ * @param profile The build configuration of the engine.
+ * @return The key as 16 hexadecimal digits.
+ * @throws `std::runtime_error` if the onnx file can not be opened.
+ */
+inline std::string engineKey(std::string_view onnx_path,
+                             const EngineProfile& profile) {
+    std::stringstream ss;
+    ss << "onnx=" << cachedHashFile(onnx_path)
+       << ";platform=" << platformDescription()
+       << ";batch=" << profile.min_batch_size << "/" << profile.opt_batch_size
+       << "/" << profile.max_batch_size
+       << ";input=" << profile.input_channels << "x" << profile.input_width
+       << "x" << profile.input_height << ";fp16=" << profile.fp16
+       << ";fp16_input=" << profile.fp16_input
+       << ";opt=" << profile.opt_level << ";int8=" << profile.int8
+       << ";calibration=" << profile.calibration
+       << ";input_name=" << profile.input_name;
+
+    std::stringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << fnv1a(ss.str());
+    return key.str();
+}
+
+/**
+ * @brief Gets the path of the cached engine with the given key, which is next
+ * to the given engine path.
+ *
+ * For example, the cached engine of `models/car.engine` with key `0123` is
+ * `models/car.0123.engine`.
+ *
+ * @param engine_path The path of the engine given by the user.
+ * @param key The cache key of the engine.
+ * @return The path of the cached engine.
+ */
+inline std::string cachedEnginePath(std::string_view engine_path,
+                                    std::string_view key) {
+    std::filesystem::path path{engine_path};
+    auto cached{path.parent_path() /
+                (path.stem().string() + "." + std::string(key) + ".engine")};
+    return cached.string();
+}
+
+/**
+ * @brief Gets the path of the timing cache shared by all engines in the
+ * directory of the given engine path which are built on the current platform.
+ *
+ * @param engine_path The path of the engine given by the user.
+ * @return The path of the timing cache.
+ */
+inline std::string timingCachePath(std::string_view engine_path) {
+    std::filesystem::path path{engine_path};
+    auto cache{path.parent_path() /
+               ("timing." + platformDescription() + ".cache")};
+    return cache.string();
+}
+
+}  // namespace radar::detect
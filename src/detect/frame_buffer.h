@@ -0,0 +1,252 @@
+/**
+ * @file frame_buffer.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements page-locked frame buffers, into which cameras
+ * capture images that the detector uploads without copying them on the host.
+ * @date 2024-05-17
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/cuda_check.h"
+
+namespace radar::detect {
+
+/**
+ * @brief Checks if host memory is page-locked, which is either allocated by
+ * `cudaHostAlloc` or registered by `cudaHostRegister`.
+ *
+ * @param ptr The pointer to the memory.
+ * @return `true` if the memory is page-locked, otherwise `false`.
+ */
+inline bool isPinned(const void* ptr) noexcept {
+    cudaPointerAttributes attributes;
+    if (cudaPointerGetAttributes(&attributes, ptr) != cudaSuccess) {
+        // Clears the error, which is returned for unknown pointers by old
+        // versions of CUDA
+        cudaGetLastError();
+        return false;
+    }
+    return attributes.type == cudaMemoryTypeHost;
+}
+
+class FrameBufferPool;
+
+/**
+ * @brief A frame buffer borrowed from a `FrameBufferPool`, which is returned
+ * to the pool when the buffer is destroyed.
+ *
+ */
+class FrameBuffer {
+   public:
+    FrameBuffer() = default;
+
+    FrameBuffer(FrameBuffer&& rhs) noexcept
+        : pool_{rhs.pool_}, index_{rhs.index_}, image_{std::move(rhs.image_)} {
+        rhs.pool_ = nullptr;
+    }
+
+    FrameBuffer& operator=(FrameBuffer&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            pool_ = rhs.pool_;
+            index_ = rhs.index_;
+            image_ = std::move(rhs.image_);
+            rhs.pool_ = nullptr;
+        }
+        return *this;
+    }
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    ~FrameBuffer() { release(); }
+
+    /**
+     * @brief Checks if the buffer is borrowed from a pool.
+     *
+     * @return `true` if the buffer is valid, otherwise `false`.
+     */
+    inline bool valid() const noexcept { return pool_ != nullptr; }
+
+    /**
+     * @brief Gets the image over the buffer, into which a frame is captured
+     * or decoded.
+     *
+     * @return The header of the image, which does not own the buffer.
+     */
+    inline const cv::Mat& image() const noexcept { return image_; }
+
+    void release() noexcept;
+
+   private:
+    friend class FrameBufferPool;
+
+    FrameBuffer(FrameBufferPool* pool, int index, const cv::Mat& image)
+        : pool_{pool}, index_{index}, image_{image} {}
+
+    FrameBufferPool* pool_{nullptr};
+    int index_{0};
+    cv::Mat image_;
+};
+
+/**
+ * @brief A fixed number of page-locked buffers of images in the resolution of
+ * a camera.
+ *
+ * Images in the buffers are uploaded by the detector with one DMA transfer,
+ * while other images are first copied into its own page-locked memory. As
+ * the upload is asynchronous, a buffer must be kept until the detection of
+ * its image is waited for.
+ *
+ */
+class FrameBufferPool {
+   public:
+    /**
+     * @brief Allocates the buffers.
+     *
+     * @param size The size of the images.
+     * @param type The type of the images, such as `CV_8UC3`.
+     * @param count The number of buffers.
+     * @throws `std::invalid_argument` if the size or the number is not
+     * positive.
+     * @throws `std::runtime_error` if the buffers can not be allocated.
+     */
+    FrameBufferPool(cv::Size size, int type, int count)
+        : size_{size}, type_{type}, borrowed_(std::max(count, 0), false) {
+        if (size.width <= 0 || size.height <= 0 || count <= 0) {
+            throw std::invalid_argument("invalid size of frame buffers");
+        }
+        const size_t bytes{static_cast<size_t>(size.area()) *
+                           CV_ELEM_SIZE(type)};
+        buffers_.reserve(count);
+        try {
+            for (int i = 0; i < count; ++i) {
+                void* buffer{nullptr};
+                CUDA_CHECK(
+                    cudaHostAlloc(&buffer, bytes, cudaHostAllocPortable));
+                buffers_.emplace_back(static_cast<unsigned char*>(buffer));
+            }
+        } catch (...) {
+            // The destructor is not called if the constructor throws
+            for (auto buffer : buffers_) {
+                CUDA_CHECK_NOEXCEPT(cudaFreeHost(buffer));
+            }
+            throw;
+        }
+    }
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    /**
+     * @brief Frees the buffers, all of which must have been returned.
+     *
+     */
+    ~FrameBufferPool() {
+        for (auto buffer : buffers_) {
+            CUDA_CHECK_NOEXCEPT(cudaFreeHost(buffer));
+        }
+    }
+
+    /**
+     * @brief Borrows a free buffer.
+     *
+     * @return The buffer.
+     * @throws `std::runtime_error` if every buffer is borrowed.
+     */
+    FrameBuffer acquire() {
+        std::lock_guard lock(mutex_);
+        auto iter = std::ranges::find(borrowed_, false);
+        if (iter == borrowed_.end()) {
+            throw std::runtime_error("no free frame buffer");
+        }
+        *iter = true;
+        const int index = iter - borrowed_.begin();
+        return FrameBuffer(this, index, cv::Mat(size_, type_, buffers_[index]));
+    }
+
+    /**
+     * @brief Gets the number of buffers.
+     *
+     * @return The number of buffers.
+     */
+    inline int size() const noexcept { return buffers_.size(); }
+
+    /**
+     * @brief Gets the size of the images in the buffers.
+     *
+     * @return The size of the images.
+     */
+    inline cv::Size imageSize() const noexcept { return size_; }
+
+   private:
+    friend class FrameBuffer;
+
+    void release(int index) noexcept {
+        std::lock_guard lock(mutex_);
+        borrowed_[index] = false;
+    }
+
+    cv::Size size_;
+    int type_;
+    std::vector<unsigned char*> buffers_;
+    std::vector<bool> borrowed_;
+    std::mutex mutex_;
+};
+
+/**
+ * @brief Returns the buffer to its pool.
+ *
+ */
+inline void FrameBuffer::release() noexcept {
+    if (valid()) {
+        pool_->release(index_);
+        pool_ = nullptr;
+        image_.release();
+    }
+}
+
+/**
+ * @brief Page-locks host memory allocated elsewhere, such as the buffers of a
+ * camera driver, for as long as the object lives.
+ *
+ * Images in the memory are then uploaded by the detector as images in a
+ * `FrameBufferPool` are.
+ *
+ */
+class HostRegistration {
+   public:
+    /**
+     * @brief Page-locks the memory.
+     *
+     * @param ptr The pointer to the memory.
+     * @param bytes The size of the memory.
+     * @throws `std::runtime_error` if the memory can not be registered.
+     */
+    HostRegistration(void* ptr, size_t bytes) : ptr_{ptr} {
+        CUDA_CHECK(cudaHostRegister(ptr, bytes, cudaHostRegisterPortable));
+    }
+
+    HostRegistration(const HostRegistration&) = delete;
+    HostRegistration& operator=(const HostRegistration&) = delete;
+
+    ~HostRegistration() { CUDA_CHECK_NOEXCEPT(cudaHostUnregister(ptr_)); }
+
+   private:
+    void* ptr_;
+};
+
+}  // namespace radar::detect
@@ -3,7 +3,7 @@
  * @author zmsbruce (zmsbruce@163.com)
  * @brief This file defines the preprocess parameters which are generated in
  * preprocessing to store image transformation and used in postprocessing to
- * restore the image.
+ * restore the image, as well as the parameters read by preprocessing kernels.
  * @date 2024-04-11
  *
  * @copyright (c) 2024 HITCRT
@@ -58,4 +58,83 @@ struct PreParam {
     float dh;
 };
 
+/**
+ * @brief An image stored in device memory, which is an interleaved 8-bit image
+ * with `channels` channels and `step` bytes per row.
+ *
+ */
+struct DeviceImage {
+    const unsigned char* data{nullptr};
+    int width{0};
+    int height{0};
+    int channels{0};
+    int step{0};
+};
+
+/**
+ * @brief A region of an image in device memory, which forms one input of a
+ * batch. Regions of a batch may come from different images.
+ *
+ */
+struct Region {
+    DeviceImage image;
+    cv::Rect rect;
+};
+
+/**
+ * @brief A region of one of the host images uploaded with a batch, which
+ * forms one input of the batch instead of the whole image.
+ *
+ */
+struct Crop {
+    int image;
+    cv::Rect rect;
+};
+
+/**
+ * @brief Parameters of letterboxing a region of a device image into one input
+ * of the network, which are read by the preprocessing kernels on the device.
+ *
+ * The region [x, x + width) * [y, y + height) of the source image is resized
+ * to `resized_width` * `resized_height` and placed at (`left`, `top`) of the
+ * input, while the rest of the input is filled with the border value.
+ */
+struct LetterboxParam {
+    LetterboxParam() = default;
+
+    /**
+     * @brief Constructs the parameters of letterboxing a region of an image.
+     *
+     * @param image The source image in device memory.
+     * @param roi The region of the source image, which must be inside it.
+     * @param pparam The preprocess parameters computed from the size of the
+     * region and the size of the input.
+     */
+    LetterboxParam(const DeviceImage& image, const cv::Rect& roi,
+                   const PreParam& pparam)
+        : src{image.data},
+          src_step{image.step},
+          x{roi.x},
+          y{roi.y},
+          width{roi.width},
+          height{roi.height},
+          // Matches the truncation and rounding of the resizing and border
+          // kernels, so that the result is identical to running them in turn
+          resized_width{static_cast<int>(pparam.width / pparam.ratio)},
+          resized_height{static_cast<int>(pparam.height / pparam.ratio)},
+          left{static_cast<int>(std::round(pparam.dw - 0.1))},
+          top{static_cast<int>(std::round(pparam.dh - 0.1))} {}
+
+    const unsigned char* src{nullptr};
+    int src_step{0};
+    int x{0};
+    int y{0};
+    int width{0};
+    int height{0};
+    int resized_width{0};
+    int resized_height{0};
+    int left{0};
+    int top{0};
+};
+
 }  // namespace radar::detect
\ No newline at end of file
@@ -0,0 +1,244 @@
+/**
+ * @file roi_scheduler.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements the scheduling of adaptive car detection, which
+ * detects cars in crops around their predicted boxes between periodic passes
+ * over whole images, and the restoration of the detections in crops.
+ * @date 2024-05-20
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <opencv2/opencv.hpp>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "detection.h"
+#include "preparam.h"
+
+namespace radar::detect {
+
+/**
+ * @brief Decides for every frame whether cars are detected in whole images or
+ * only in crops around the boxes predicted from confirmed tracks.
+ *
+ * Whole images are scaled down to the input of the network, so far robots
+ * lose most of their pixels, while a crop of the size of the input keeps its
+ * full resolution and a batch of a few crops costs less than the images. New
+ * robots only appear in whole images, which are therefore detected at least
+ * once every `full_frame_period` frames, and whenever nothing is predicted,
+ * more crops than `max_crops` are needed, or a full pass is requested after a
+ * predicted robot is not found in its crop.
+ *
+ */
+class RoiScheduler {
+   public:
+    /**
+     * @brief Constructs a scheduler, whose first frame is a full pass.
+     *
+     * @param full_frame_period The maximum number of frames from one full pass
+     * to the next one, with 1 detecting every frame in whole.
+     * @param crop_size The minimum size of the crops, which is usually the
+     * input size of the network.
+     * @param max_crops The maximum number of crops of one frame, which is
+     * usually the maximum batch size of the car detector.
+     * @throws `std::invalid_argument` if any of the parameters is not
+     * positive.
+     */
+    RoiScheduler(int full_frame_period, cv::Size crop_size, int max_crops)
+        : period_{full_frame_period},
+          crop_size_{crop_size},
+          max_crops_{max_crops},
+          frames_{full_frame_period} {
+        if (full_frame_period <= 0 || crop_size.width <= 0 ||
+            crop_size.height <= 0 || max_crops <= 0) {
+            throw std::invalid_argument("invalid parameters of scheduler");
+        }
+    }
+
+    /**
+     * @brief Plans the car detection of a frame.
+     *
+     * Every predicted box is covered by a crop centered on it, which is at
+     * least `crop_size` and shifted into the image, unless the box is already
+     * inside a crop of the same image. Boxes entirely out of their images are
+     * ignored.
+     *
+     * @param image_sizes The size of every image of the frame.
+     * @param predictions The predicted boxes of every image, whose number is
+     * the same as that of the images.
+     * @return The crops of the frame, or `std::nullopt` if the frame is
+     * detected in whole images.
+     * @throws `std::invalid_argument` if the numbers of sizes and predictions
+     * differ.
+     */
+    std::optional<std::vector<Crop>> plan(
+        std::span<const cv::Size> image_sizes,
+        std::span<const std::vector<cv::Rect>> predictions) {
+        if (image_sizes.size() != predictions.size()) {
+            throw std::invalid_argument("invalid number of predictions");
+        }
+        if (++frames_ >= period_) {
+            frames_ = 0;
+            return std::nullopt;
+        }
+
+        std::vector<Crop> crops;
+        for (size_t i = 0; i < image_sizes.size(); ++i) {
+            const cv::Rect bounds({0, 0}, image_sizes[i]);
+            const auto begin = crops.size();
+            for (const auto& prediction : predictions[i]) {
+                const cv::Rect box = prediction & bounds;
+                if (box.empty() ||
+                    std::any_of(crops.begin() + begin, crops.end(),
+                                [&](const Crop& crop) {
+                                    return (crop.rect & box) == box;
+                                })) {
+                    continue;
+                }
+                if (static_cast<int>(crops.size()) == max_crops_) {
+                    frames_ = 0;
+                    return std::nullopt;
+                }
+                crops.push_back(
+                    {.image = static_cast<int>(i), .rect = cover(box, bounds)});
+            }
+        }
+        if (crops.empty()) {
+            frames_ = 0;
+            return std::nullopt;
+        }
+        return crops;
+    }
+
+    /**
+     * @brief Requests the next frame to be detected in whole images.
+     *
+     */
+    inline void requestFullFrame() noexcept { frames_ = period_; }
+
+   private:
+    /**
+     * @brief Gets the crop covering a box, which is at least `crop_size_`,
+     * centered on the box and shifted into the image.
+     *
+     * @param box The box, which lies in the image.
+     * @param bounds The bounds of the image.
+     * @return The crop, which lies in the image.
+     */
+    cv::Rect cover(const cv::Rect& box,
+                   const cv::Rect& bounds) const noexcept {
+        const int width = std::min(std::max(box.width, crop_size_.width),
+                                   bounds.width);
+        const int height = std::min(std::max(box.height, crop_size_.height),
+                                    bounds.height);
+        const int x = std::clamp(box.x + (box.width - width) / 2, 0,
+                                 bounds.width - width);
+        const int y = std::clamp(box.y + (box.height - height) / 2, 0,
+                                 bounds.height - height);
+        return cv::Rect(x, y, width, height);
+    }
+
+    const int period_;
+    const cv::Size crop_size_;
+    const int max_crops_;
+    // The number of frames since the latest full pass.
+    int frames_;
+};
+
+/**
+ * @brief Computes the Intersection over Union (IoU) of two rectangles.
+ *
+ * The IoU is a measure used in object detection to quantify the accuracy of
+ * an object detector on a particular dataset. It calculates the ratio of
+ * intersection area to the union area of two rectangles.
+ *
+ * @param rect1 The first rectangle as a cv::Rect2f.
+ * @param rect2 The second rectangle as a cv::Rect2f.
+ * @return The IoU ratio as a float. Returns 0.0 if the union area is zero.
+ */
+inline float computeIoU(const cv::Rect2f& rect1,
+                        const cv::Rect2f& rect2) noexcept {
+    float x1, y1, x2, y2;
+    cv::Rect2f intersectionRect, unionRect;
+
+    x1 = std::max(rect1.x, rect2.x);
+    y1 = std::max(rect1.y, rect2.y);
+    x2 = std::min(rect1.x + rect1.width, rect2.x + rect2.width);
+    y2 = std::min(rect1.y + rect1.height, rect2.y + rect2.height);
+    intersectionRect = x1 < x2 && y1 < y2 ? cv::Rect2f(x1, y1, x2 - x1, y2 - y1)
+                                          : cv::Rect2f(0, 0, 0, 0);
+
+    x1 = std::min(rect1.x, rect2.x);
+    y1 = std::min(rect1.y, rect2.y);
+    x2 = std::max(rect1.x + rect1.width, rect2.x + rect2.width);
+    y2 = std::max(rect1.y + rect1.height, rect2.y + rect2.height);
+    unionRect = cv::Rect2f(x1, y1, x2 - x1, y2 - y1);
+
+    float intersectionArea = intersectionRect.width * intersectionRect.height;
+    float unionArea = unionRect.width * unionRect.height;
+
+    if (unionArea > 0) {
+        return intersectionArea / unionArea;
+    } else {
+        return 0.0;
+    }
+}
+
+/**
+ * @brief Restores the detections in crops to the coordinates of their images.
+ *
+ * Objects seen in several overlapping crops of an image are kept once, with
+ * the most confident detection of them.
+ *
+ * @param crops The crops of the images.
+ * @param crop_detections The detections of each crop in the coordinates of
+ * the crop, whose number is the same as that of the crops.
+ * @param images The number of images, which are indexed by the crops.
+ * @param iou_thresh The IoU above which two detections of an image are the
+ * same object.
+ * @return The detections of each image.
+ * @throws `std::invalid_argument` if the numbers of crops and detections
+ * differ, or a crop indexes no image.
+ */
+inline std::vector<std::vector<Detection>> restoreCrops(
+    std::span<const Crop> crops,
+    std::span<const std::vector<Detection>> crop_detections, size_t images,
+    float iou_thresh) {
+    if (crops.size() != crop_detections.size()) {
+        throw std::invalid_argument("invalid number of crop detections");
+    }
+    std::vector<std::vector<Detection>> image_detections(images);
+    for (size_t k = 0; k < crops.size(); ++k) {
+        const auto& [image, rect]{crops[k]};
+        if (image < 0 || static_cast<size_t>(image) >= images) {
+            throw std::invalid_argument("invalid image of crop");
+        }
+        auto& detections{image_detections[image]};
+        for (auto detection : crop_detections[k]) {
+            detection.x += rect.x;
+            detection.y += rect.y;
+            const cv::Rect2f box(detection.x, detection.y, detection.width,
+                                 detection.height);
+            auto iter = std::ranges::find_if(detections, [&](const auto& d) {
+                return computeIoU(cv::Rect2f(d.x, d.y, d.width, d.height),
+                                  box) > iou_thresh;
+            });
+            if (iter == detections.end()) {
+                detections.emplace_back(detection);
+            } else if (iter->confidence < detection.confidence) {
+                *iter = detection;
+            }
+        }
+    }
+    return image_detections;
+}
+
+}  // namespace radar::detect
@@ -1,8 +1,8 @@
 /**
  * @file tensor.h
  * @author zmsbruce (zmsbruce@163.com)
- * @brief This file implements the Tensor class including its name, size and
- * allocation of device memory.
+ * @brief This file implements the Tensor class including its name, size, data
+ * type and allocation of device memory.
  * @date 2024-04-11
  *
  * @copyright (c) 2024 HITCRT
@@ -30,9 +30,13 @@ namespace radar::detect {
  */
 class Tensor {
    public:
-    Tensor() : device_ptr_{nullptr} {}
+    Tensor() : dtype_{nvinfer1::DataType::kFLOAT}, device_ptr_{nullptr} {}
 
-    Tensor(Tensor&& rhs) : name_{rhs.name_}, device_ptr_{rhs.device_ptr_} {
+    Tensor(Tensor&& rhs)
+        : name_{rhs.name_},
+          dims_{rhs.dims_},
+          dtype_{rhs.dtype_},
+          device_ptr_{rhs.device_ptr_} {
         // Prevent repeated release of device resources
         rhs.device_ptr_ = nullptr;
     }
@@ -40,6 +44,7 @@ class Tensor {
     Tensor& operator=(Tensor&& rhs) {
         if (this != &rhs) {
             dims_ = rhs.dims_;
+            dtype_ = rhs.dtype_;
             name_ = rhs.name_;
             device_ptr_ = rhs.device_ptr_;
             // Prevent repeated release of device resources
@@ -85,7 +90,7 @@ class Tensor {
      */
     explicit Tensor(const nvinfer1::Dims& dims, nvinfer1::DataType dtype,
                     const char* name, int max_batch_size)
-        : name_{name}, dims_{dims} {
+        : name_{name}, dims_{dims}, dtype_{dtype} {
         if (dims.d[0] != -1 && dims.d[0] != max_batch_size) {
             throw std::logic_error("invalid dims");
         }
@@ -117,9 +122,17 @@ class Tensor {
      */
     inline nvinfer1::Dims dims() const noexcept { return dims_; }
 
+    /**
+     * @brief Get the data type of the tensor.
+     *
+     * @return The data type of the tensor.
+     */
+    inline nvinfer1::DataType dtype() const noexcept { return dtype_; }
+
    private:
     std::string_view name_;
     nvinfer1::Dims dims_;
+    nvinfer1::DataType dtype_;
     void* device_ptr_;
 };
 
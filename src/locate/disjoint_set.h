@@ -0,0 +1,85 @@
+/**
+ * @file disjoint_set.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a disjoint set (union-find) used in clustering
+ * the foreground points.
+ * @date 2024-05-10
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace radar::locate {
+
+/**
+ * @brief A disjoint set of consecutive elements with path halving and union by
+ * size, whose buffers are reused across `reset` calls.
+ *
+ */
+class DisjointSet {
+   public:
+    /**
+     * @brief Resets the set so that each of the elements forms its own subset.
+     *
+     * @param size The number of elements.
+     */
+    void reset(int size) {
+        parents_.resize(size);
+        sizes_.assign(size, 1);
+        std::iota(parents_.begin(), parents_.end(), 0);
+    }
+
+    /**
+     * @brief Finds the representative of the subset containing an element.
+     *
+     * @param element The element.
+     * @return The representative of the subset.
+     */
+    int find(int element) noexcept {
+        while (parents_[element] != element) {
+            parents_[element] = parents_[parents_[element]];
+            element = parents_[element];
+        }
+        return element;
+    }
+
+    /**
+     * @brief Merges the subsets containing two elements.
+     *
+     * @param a One element.
+     * @param b The other element.
+     */
+    void unite(int a, int b) noexcept {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return;
+        }
+        if (sizes_[a] < sizes_[b]) {
+            std::swap(a, b);
+        }
+        parents_[b] = a;
+        sizes_[a] += sizes_[b];
+    }
+
+    /**
+     * @brief Gets the size of the subset of a representative.
+     *
+     * @param root The representative returned by `find`.
+     * @return The number of elements in the subset.
+     */
+    int size(int root) const noexcept { return sizes_[root]; }
+
+   private:
+    std::vector<int> parents_;
+    std::vector<int> sizes_;
+};
+
+}  // namespace radar::locate
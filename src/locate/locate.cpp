@@ -12,15 +12,28 @@
  *
  */
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Eigen/Core>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <execution>
+#include <fstream>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <opencv2/opencv.hpp>
 #include <ranges>
+#include <vector>
 
 #include "locator.h"
+#include "utils/cuda_check.h"
+#include "utils/metrics.h"
 
 namespace radar {
 
@@ -35,10 +48,11 @@ namespace radar {
  * @return The corresponding point in the world coordinate system.
  */
 cv::Point3f Locator::lidarToWorld(const cv::Point3f& point) const noexcept {
-    cv::Matx41f lidar_coor{point.x, point.y, point.z, 1.0f};
-    cv::Matx41f world_coor =
-        camera_to_world_transform_ * lidar_to_camera_transform_ * lidar_coor;
-    return cv::Point3f(world_coor(0), world_coor(1), world_coor(2));
+    const auto& m = lidar_to_world_;
+    return cv::Point3f(
+        m(0, 0) * point.x + m(0, 1) * point.y + m(0, 2) * point.z + m(0, 3),
+        m(1, 0) * point.x + m(1, 1) * point.y + m(1, 2) * point.z + m(1, 3),
+        m(2, 0) * point.x + m(2, 1) * point.y + m(2, 2) * point.z + m(2, 3));
 }
 
 /**
@@ -52,12 +66,12 @@ cv::Point3f Locator::lidarToWorld(const cv::Point3f& point) const noexcept {
  * @return The corresponding point in the Lidar coordinate system.
  */
 cv::Point3f Locator::cameraToLidar(const cv::Point3f& point) const noexcept {
-    cv::Matx31f camera_coor{point.x / zoom_factor_, point.y / zoom_factor_,
-                            1.0f};
-    cv::Matx31f lidar_coor =
-        camera_to_lidar_rotate_ *
-        (intrinsic_inv_ * point.z * camera_coor + camera_to_lidar_translate_);
-    return cv::Point3f(lidar_coor(0), lidar_coor(1), lidar_coor(2));
+    const auto& r = pixel_to_lidar_rotate_;
+    const auto& t = pixel_to_lidar_translate_;
+    return cv::Point3f(
+        point.z * (r(0, 0) * point.x + r(0, 1) * point.y + r(0, 2)) + t(0),
+        point.z * (r(1, 0) * point.x + r(1, 1) * point.y + r(1, 2)) + t(1),
+        point.z * (r(2, 0) * point.x + r(2, 1) * point.y + r(2, 2)) + t(2));
 }
 
 /**
@@ -71,13 +85,160 @@ cv::Point3f Locator::cameraToLidar(const cv::Point3f& point) const noexcept {
  * @return The corresponding point in the camera coordinate system.
  */
 cv::Point3f Locator::lidarToCamera(const cv::Point3f& point) const noexcept {
-    cv::Matx41f lidar_coor{point.x, point.y, point.z, 1.0f};
-    cv::Matx31f camera_coor =
-        intrinsic_ *
-        (lidar_to_camera_transform_ * lidar_coor).get_minor<3, 1>(0, 0);
-    return cv::Point3f(camera_coor(0) * zoom_factor_ / camera_coor(2),
-                       camera_coor(1) * zoom_factor_ / camera_coor(2),
-                       camera_coor(2));
+    const auto& m = lidar_to_pixel_;
+    float d = m(2, 0) * point.x + m(2, 1) * point.y + m(2, 2) * point.z +
+              m(2, 3);
+    return cv::Point3f(
+        (m(0, 0) * point.x + m(0, 1) * point.y + m(0, 2) * point.z + m(0, 3)) /
+            d,
+        (m(1, 0) * point.x + m(1, 1) * point.y + m(1, 2) * point.z + m(1, 3)) /
+            d,
+        d);
+}
+
+/**
+ * @brief Converts points from the camera coordinate system to the Lidar
+ * coordinate system in batch.
+ *
+ * The coordinates are given as structure of arrays, which are mapped as Eigen
+ * arrays so that the conversion is vectorized.
+ *
+ * @param u The x coordinates of the points in the zoomed depth image.
+ * @param v The y coordinates of the points in the zoomed depth image.
+ * @param d The depths of the points.
+ * @param x The output x coordinates in the Lidar coordinate system.
+ * @param y The output y coordinates in the Lidar coordinate system.
+ * @param z The output z coordinates in the Lidar coordinate system.
+ * @note All spans must have the same size, and the outputs must not overlap
+ * the inputs.
+ */
+void Locator::cameraToLidar(std::span<const float> u, std::span<const float> v,
+                            std::span<const float> d, std::span<float> x,
+                            std::span<float> y,
+                            std::span<float> z) const noexcept {
+    const Eigen::Index n = u.size();
+    Eigen::Map<const Eigen::ArrayXf> us(u.data(), n), vs(v.data(), n),
+        ds(d.data(), n);
+    Eigen::Map<Eigen::ArrayXf> xs(x.data(), n), ys(y.data(), n),
+        zs(z.data(), n);
+    const auto& r = pixel_to_lidar_rotate_;
+    const auto& t = pixel_to_lidar_translate_;
+    xs = ds * (r(0, 0) * us + r(0, 1) * vs + r(0, 2)) + t(0);
+    ys = ds * (r(1, 0) * us + r(1, 1) * vs + r(1, 2)) + t(1);
+    zs = ds * (r(2, 0) * us + r(2, 1) * vs + r(2, 2)) + t(2);
+}
+
+/**
+ * @brief Converts points from the Lidar coordinate system to the camera
+ * coordinate system in batch.
+ *
+ * The coordinates are given as structure of arrays, which are mapped as Eigen
+ * arrays so that the conversion is vectorized.
+ *
+ * @param x The x coordinates in the Lidar coordinate system.
+ * @param y The y coordinates in the Lidar coordinate system.
+ * @param z The z coordinates in the Lidar coordinate system.
+ * @param u The output x coordinates of the points in the zoomed depth image.
+ * @param v The output y coordinates of the points in the zoomed depth image.
+ * @param d The output depths of the points.
+ * @note All spans must have the same size, and the outputs must not overlap
+ * the inputs.
+ */
+void Locator::lidarToCamera(std::span<const float> x, std::span<const float> y,
+                            std::span<const float> z, std::span<float> u,
+                            std::span<float> v,
+                            std::span<float> d) const noexcept {
+    const Eigen::Index n = x.size();
+    Eigen::Map<const Eigen::ArrayXf> xs(x.data(), n), ys(y.data(), n),
+        zs(z.data(), n);
+    Eigen::Map<Eigen::ArrayXf> us(u.data(), n), vs(v.data(), n),
+        ds(d.data(), n);
+    const auto& m = lidar_to_pixel_;
+    ds = m(2, 0) * xs + m(2, 1) * ys + m(2, 2) * zs + m(2, 3);
+    us = (m(0, 0) * xs + m(0, 1) * ys + m(0, 2) * zs + m(0, 3)) / ds;
+    vs = (m(1, 0) * xs + m(1, 1) * ys + m(1, 2) * zs + m(1, 3)) / ds;
+}
+
+/**
+ * @brief Sets the extrinsic matrices and updates the transforms composed from
+ * them, which are cached so that converting a point takes a single affine
+ * transform.
+ *
+ * @param lidar_to_camera The transformation matrix from Lidar to camera
+ * coordinates.
+ * @param world_to_camera The transformation matrix from world to camera
+ * coordinates.
+ * @note The background and the depth images in the window are kept, which are
+ * only valid if the lidar has not moved relative to the camera.
+ */
+void Locator::setExtrinsics(const cv::Matx44f& lidar_to_camera,
+                            const cv::Matx44f& world_to_camera) noexcept {
+    // Pixels of the zoomed depth image follow from the camera coordinate by
+    // the intrinsic matrix with the zoom factor applied to its first two rows
+    cv::Matx33f zoom{
+        cv::Matx33f::diag(cv::Vec3f(zoom_factor_, zoom_factor_, 1.0f))};
+    lidar_to_pixel_ =
+        zoom * intrinsic_ * lidar_to_camera.get_minor<3, 4>(0, 0);
+    lidar_to_world_ =
+        (world_to_camera.inv() * lidar_to_camera).get_minor<3, 4>(0, 0);
+    world_to_image_ = intrinsic_ * world_to_camera.get_minor<3, 4>(0, 0);
+
+    cv::Matx44f camera_to_lidar{lidar_to_camera.inv()};
+    pixel_to_lidar_rotate_ = camera_to_lidar.get_minor<3, 3>(0, 0) *
+                             (zoom * intrinsic_).inv();
+    pixel_to_lidar_translate_ = camera_to_lidar.get_minor<3, 1>(0, 3);
+
+    cv::Matx34f projection{intrinsic_ *
+                           lidar_to_camera.get_minor<3, 4>(0, 0)};
+    std::copy(projection.val, projection.val + 12, project_param_.matrix);
+}
+
+/**
+ * @brief Projects a box around a location in the world coordinate system into
+ * the image, such as a robot predicted by the tracker.
+ *
+ * The box is the cube of half edge `radius` centered at the location, whose
+ * corners are projected into the image in its full resolution, so that the
+ * result covers the box whatever the orientations of the axes are. Both are in
+ * meters like the locations of robots and tracks, and are scaled into
+ * millimeters of the world coordinate system.
+ *
+ * @param location The center of the box in the world coordinate system, in
+ * meters.
+ * @param radius The half edge of the box, in meters.
+ * @return The bounding rectangle of the projected corners, which may be
+ * partly or entirely out of the image, or `std::nullopt` if any corner is not
+ * in front of the camera.
+ */
+std::optional<cv::Rect> Locator::project(const cv::Point3f& location,
+                                         float radius) const noexcept {
+    const auto& m = world_to_image_;
+    const cv::Point3f center{location * 1e3f};
+    const float extent{radius * 1e3f};
+    float min_u = std::numeric_limits<float>::max(), min_v = min_u;
+    float max_u = std::numeric_limits<float>::lowest(), max_v = max_u;
+    for (int corner = 0; corner < 8; ++corner) {
+        const cv::Point3f point(center.x + (corner & 1 ? extent : -extent),
+                                center.y + (corner & 2 ? extent : -extent),
+                                center.z + (corner & 4 ? extent : -extent));
+        const float d = m(2, 0) * point.x + m(2, 1) * point.y +
+                        m(2, 2) * point.z + m(2, 3);
+        if (d <= 0) {
+            return std::nullopt;
+        }
+        const float u = (m(0, 0) * point.x + m(0, 1) * point.y +
+                         m(0, 2) * point.z + m(0, 3)) /
+                        d;
+        const float v = (m(1, 0) * point.x + m(1, 1) * point.y +
+                         m(1, 2) * point.z + m(1, 3)) /
+                        d;
+        min_u = std::min(min_u, u);
+        max_u = std::max(max_u, u);
+        min_v = std::min(min_v, v);
+        max_v = std::max(max_v, v);
+    }
+    return cv::Rect(cv::Point(std::floor(min_u), std::floor(min_v)),
+                    cv::Point(std::ceil(max_u), std::ceil(max_v)));
 }
 
 /**
@@ -108,6 +269,10 @@ cv::Point3f Locator::lidarToCamera(const cv::Point3f& point) const noexcept {
  * @param max_cluster_size The maximum cluster size for point cloud clustering.
  * @param max_distance The maximum distance threshold of x-coordinate for point
  * cloud processing.
+ * @param use_cuda Whether to project point clouds and difference depth images
+ * on the GPU, where the queue of depth images and the background are kept.
+ * @param cluster_method The method of clustering the foreground points.
+ * @throws `std::runtime_error` if allocating the device memory fails.
  */
 Locator::Locator(int image_width, int image_height,
                  const cv::Matx33f& intrinsic,
@@ -115,7 +280,8 @@ Locator::Locator(int image_width, int image_height,
                  const cv::Matx44f& world_to_camera, float zoom_factor,
                  size_t queue_size, float min_depth_diff, float max_depth_diff,
                  float cluster_tolerance, int min_cluster_size,
-                 int max_cluster_size, float max_distance)
+                 int max_cluster_size, float max_distance, bool use_cuda,
+                 ClusterMethod cluster_method)
     : image_width_{image_width},
       image_height_{image_height},
       zoom_factor_{zoom_factor},
@@ -123,21 +289,50 @@ Locator::Locator(int image_width, int image_height,
       image_height_zoomed_{static_cast<int>(image_height * zoom_factor)},
       queue_size_{queue_size},
       intrinsic_{intrinsic},
-      lidar_to_camera_transform_{lidar_to_camera},
       min_depth_diff_{min_depth_diff},
       max_depth_diff_{max_depth_diff},
       max_distance_{max_distance},
       kdtree_{new pcl::search::KdTree<pcl::PointXYZ>()},
-      cloud_foreground_{new pcl::PointCloud<pcl::PointXYZ>()} {
-    intrinsic_inv_ = intrinsic.inv();
-    cv::Matx44f camera_to_lidar = lidar_to_camera.inv();
-    camera_to_lidar_rotate_ = camera_to_lidar.get_minor<3, 3>(0, 0);
-    camera_to_lidar_translate_ = camera_to_lidar.get_minor<3, 1>(0, 3);
-    camera_to_world_transform_ = world_to_camera.inv();
-    depth_image_.create(image_height_zoomed_, image_width_zoomed_, CV_32F);
-    background_depth_image_.create(image_height_zoomed_, image_width_zoomed_,
-                                   CV_32F);
-    diff_depth_image_.create(image_height_zoomed_, image_width_zoomed_, CV_32F);
+      cloud_foreground_{new pcl::PointCloud<pcl::PointXYZ>()},
+      use_cuda_{use_cuda},
+      cluster_method_{cluster_method},
+      cluster_tolerance_{cluster_tolerance},
+      min_cluster_size_{min_cluster_size},
+      max_cluster_size_{max_cluster_size} {
+    setExtrinsics(lidar_to_camera, world_to_camera);
+    depth_image_ =
+        cv::Mat::zeros(image_height_zoomed_, image_width_zoomed_, CV_32F);
+    background_depth_image_ =
+        cv::Mat::zeros(image_height_zoomed_, image_width_zoomed_, CV_32F);
+    diff_depth_image_ =
+        cv::Mat::zeros(image_height_zoomed_, image_width_zoomed_, CV_32F);
+    label_image_ = cv::Mat(image_height_zoomed_, image_width_zoomed_, CV_32S,
+                           cv::Scalar(-1));
+    point_image_.create(image_height_zoomed_, image_width_zoomed_, CV_32FC3);
+
+    if (use_cuda_) {
+        project_param_.zoom_factor = zoom_factor_;
+        project_param_.max_distance = max_distance_;
+        project_param_.width = image_width_zoomed_;
+        project_param_.height = image_height_zoomed_;
+
+        const size_t pixels = image_width_zoomed_ * image_height_zoomed_;
+        CUDA_CHECK(cudaStreamCreate(&stream_));
+        CUDA_CHECK(cudaMalloc(&dev_depth_ptr_,
+                              queue_size_ * pixels * sizeof(float)));
+        CUDA_CHECK(cudaMalloc(&dev_background_ptr_, pixels * sizeof(float)));
+        CUDA_CHECK(cudaMemset(dev_background_ptr_, 0, pixels * sizeof(float)));
+        CUDA_CHECK(cudaMalloc(&dev_diff_ptr_, pixels * sizeof(float)));
+        // The host difference image is a header of pinned memory, so that
+        // downloading it each frame is asynchronous and at full bandwidth
+        CUDA_CHECK(cudaMallocHost(&diff_ptr_, pixels * sizeof(float)));
+        diff_depth_image_ = cv::Mat(image_height_zoomed_, image_width_zoomed_,
+                                    CV_32F, diff_ptr_);
+        diff_depth_image_.setTo(0);
+    } else {
+        frame_pixels_.resize(queue_size_);
+        pixel_slots_.assign(image_width_zoomed_ * image_height_zoomed_, -1);
+    }
 
     cluster_extractor_.setClusterTolerance(cluster_tolerance);
     cluster_extractor_.setMinClusterSize(min_cluster_size);
@@ -145,6 +340,23 @@ Locator::Locator(int image_width, int image_height,
     cluster_extractor_.setSearchMethod(kdtree_);
 }
 
+/**
+ * @brief Destructs the Locator and frees the device memory of the CUDA path.
+ *
+ */
+Locator::~Locator() {
+    if (!use_cuda_) {
+        return;
+    }
+    CUDA_CHECK_NOEXCEPT(cudaStreamSynchronize(stream_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_cloud_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_depth_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_background_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFree(dev_diff_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaFreeHost(diff_ptr_));
+    CUDA_CHECK_NOEXCEPT(cudaStreamDestroy(stream_));
+}
+
 /**
  * @brief Updates the Locator with a new point cloud.
  *
@@ -154,69 +366,530 @@ Locator::Locator(int image_width, int image_height,
  * background image and current images stored in a queue.
  *
  * @param cloud The input point cloud.
+ * @note If the CUDA path is enabled and a CUDA call fails, it will call
+ * `std::abort()` directly.
  */
 void Locator::update(
     const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) noexcept {
-    depth_image_.setTo(0);
-    diff_depth_image_.setTo(0);
-
+    RADAR_PROFILE_SCOPE("locate.update");
+    // A missing cloud still enters the window as a frame without points, so
+    // that the depth images of old frames expire in time
+    static const pcl::PointCloud<pcl::PointXYZ> empty_cloud;
     if (!cloud) {
         std::cerr << "cloud is null." << std::endl;
-        return;
+    } else if (cloud->empty()) {
+        std::cerr << "cloud is empty." << std::endl;
     }
+    const auto& points{cloud ? *cloud : empty_cloud};
 
-    if (cloud->empty()) {
+    if (use_cuda_) {
+        updateCuda(points);
+    } else {
+        // Points are projected in batch as structure of arrays
+        const size_t num_points = points.size();
+        for (auto* buffer : {&batch_x_, &batch_y_, &batch_z_}) {
+            buffer->resize(num_points);
+        }
+        for (size_t i = 0; i < num_points; ++i) {
+            batch_x_[i] = points[i].x;
+            batch_y_[i] = points[i].y;
+            batch_z_[i] = points[i].z;
+        }
+        updateCpu(batch_x_, batch_y_, batch_z_);
+    }
+}
+
+/**
+ * @brief Updates the Locator with a new point cloud as structure of arrays.
+ *
+ * This is the same as updating with a PCL point cloud, but takes the
+ * coordinates of the points as they are filled by the lidar driver, such as
+ * the buffers of a `locate::PointRing` or the frames of a
+ * `locate::PointFile`. The points are projected from the arrays directly on
+ * the CPU, or uploaded from them on the GPU, so that no cloud is allocated or
+ * converted.
+ *
+ * @param x The x coordinates of the points.
+ * @param y The y coordinates of the points.
+ * @param z The z coordinates of the points.
+ * @note If the arrays differ in length, only the points in all of them are
+ * used. If the CUDA path is enabled and a CUDA call fails, it will call
+ * `std::abort()` directly.
+ */
+void Locator::update(std::span<const float> x, std::span<const float> y,
+                     std::span<const float> z) noexcept {
+    RADAR_PROFILE_SCOPE("locate.update");
+    const size_t num_points = std::min({x.size(), y.size(), z.size()});
+    if (x.size() != num_points || y.size() != num_points ||
+        z.size() != num_points) {
+        std::cerr << "coordinates of points differ in length." << std::endl;
+    } else if (num_points == 0) {
         std::cerr << "cloud is empty." << std::endl;
-        return;
     }
+    x = x.first(num_points);
+    y = y.first(num_points);
+    z = z.first(num_points);
 
-    std::for_each(
-        std::execution::par_unseq, cloud->begin(), cloud->end(),
-        [this](const pcl::PointXYZ& point) {
-            if (iszero(point.x) && iszero(point.y) && iszero(point.z)) {
-                return;
-            }
-            if (point.x > max_distance_) {
-                return;
-            }
-            auto uvd = lidarToCamera(cv::Point3f(point.x, point.y, point.z));
-            float &u = uvd.x, &v = uvd.y, &d = uvd.z;
-            if (u < 0 || u > image_width_zoomed_ || v < 0 ||
-                v > image_height_zoomed_) {
-                return;
-            }
-            float& background_depth = background_depth_image_.at<float>(v, u);
-            if (d > background_depth) {
-                background_depth = d;
+    if (use_cuda_) {
+        updateCuda(x, y, z);
+    } else {
+        updateCpu(x, y, z);
+    }
+}
+
+/**
+ * @brief Projects a point cloud and updates the depth image of difference
+ * incrementally on the CPU.
+ *
+ * The window of the latest `queue_size_` frames is a ring of the pixels hit by
+ * each frame, and `depth_image_` keeps the latest depth of each pixel within
+ * the window together with the slot of the frame in `pixel_slots_`. Only the
+ * pixels hit by the frame leaving the window and the frame entering it change
+ * their depths, so the work of each frame is proportional to the number of
+ * points in the window rather than `queue_size_` times the size of the image,
+ * and no memory is allocated once the ring and the buffers have grown.
+ *
+ * A pixel of `diff_depth_image_` is the latest depth of the pixel within the
+ * window if its difference from the background is in range, or zero
+ * otherwise. Every pixel with a depth in the window is checked against the
+ * current background, as `diffKernel` does on the GPU, so that a background
+ * changed since the depth entered the window, such as by resetting it, takes
+ * effect at once.
+ *
+ * @param x The x coordinates of the points, which may be empty.
+ * @param y The y coordinates of the points.
+ * @param z The z coordinates of the points.
+ */
+void Locator::updateCpu(std::span<const float> x, std::span<const float> y,
+                        std::span<const float> z) noexcept {
+    const int slot = static_cast<int>(depth_index_);
+    float* depth_ptr = depth_image_.ptr<float>();
+    float* background_ptr = background_depth_image_.ptr<float>();
+    float* diff_ptr = diff_depth_image_.ptr<float>();
+
+    // Pixels whose latest depth comes from the leaving frame have no depth in
+    // the window any more, as every later frame would have taken them over
+    auto& pixels = frame_pixels_[slot];
+    for (int pixel : pixels) {
+        if (pixel_slots_[pixel] == slot) {
+            pixel_slots_[pixel] = -1;
+            depth_ptr[pixel] = 0.0f;
+            diff_ptr[pixel] = 0.0f;
+        }
+    }
+    pixels.clear();
+
+    // Points are projected in batch, while the writes to images are resolved
+    // serially so that pixels hit by several points do not race
+    const size_t num_points = x.size();
+    for (auto* buffer : {&batch_u_, &batch_v_, &batch_d_}) {
+        buffer->resize(num_points);
+    }
+    lidarToCamera(x, y, z, batch_u_, batch_v_, batch_d_);
+
+    for (size_t i = 0; i < num_points; ++i) {
+        if (iszero(x[i]) && iszero(y[i]) && iszero(z[i])) {
+            continue;
+        }
+        const float u = batch_u_[i], v = batch_v_[i], depth = batch_d_[i];
+        if (x[i] > max_distance_ || depth <= 0) {
+            continue;
+        }
+        if (u < 0 || u >= image_width_zoomed_ || v < 0 ||
+            v >= image_height_zoomed_) {
+            continue;
+        }
+        const int pixel =
+            static_cast<int>(v) * image_width_zoomed_ + static_cast<int>(u);
+        if (!background_frozen_) {
+            background_ptr[pixel] = std::max(background_ptr[pixel], depth);
+        }
+        if (pixel_slots_[pixel] != slot) {
+            pixel_slots_[pixel] = slot;
+            depth_ptr[pixel] = depth;
+            pixels.emplace_back(pixel);
+        } else {
+            // The nearest point wins among points of the same frame
+            depth_ptr[pixel] = std::min(depth_ptr[pixel], depth);
+        }
+    }
+
+    // The pixels whose latest depth comes from a frame are in its list
+    for (int frame_slot = 0; frame_slot < static_cast<int>(queue_size_);
+         ++frame_slot) {
+        for (int pixel : frame_pixels_[frame_slot]) {
+            if (pixel_slots_[pixel] != frame_slot) {
+                continue;
             }
-            depth_image_.at<float>(v, u) = d;
-        });
-
-    depth_images_.push_back(depth_image_.clone());
-    if (depth_images_.size() > queue_size_) {
-        depth_images_.pop_front();
-    }
-
-    std::for_each(
-        std::execution::par_unseq, depth_images_.begin(), depth_images_.end(),
-        [this](const cv::Mat& image) {
-            for (int i = 0; i < image.rows; ++i) {
-                const float* depth_row = image.ptr<float>(i);
-                const float* background_row =
-                    background_depth_image_.ptr<float>(i);
-                float* diff_row = diff_depth_image_.ptr<float>(i);
-                for (int j = 0; j < image.cols; ++j) {
-                    const float value = depth_row[j];
-                    if (iszero(value)) {
-                        continue;
-                    }
-                    float diff = background_row[j] - value;
-                    if (diff >= min_depth_diff_ && diff <= max_depth_diff_) {
-                        diff_row[j] = value;
-                    }
-                }
+            const float diff = background_ptr[pixel] - depth_ptr[pixel];
+            diff_ptr[pixel] =
+                diff >= min_depth_diff_ && diff <= max_depth_diff_
+                    ? depth_ptr[pixel]
+                    : 0.0f;
+        }
+    }
+
+    depth_index_ = (depth_index_ + 1) % queue_size_;
+    depth_count_ = std::min(depth_count_ + 1, queue_size_);
+}
+
+/**
+ * @brief Projects a point cloud and differences the queue of depth images with
+ * the background on the GPU.
+ *
+ * The point cloud is uploaded as it is and projected by one kernel into the
+ * oldest depth image of the ring on the device, which then becomes the newest.
+ * Pixel collisions are resolved by atomic operations, where the depth image
+ * keeps the nearest point and the background, unless frozen, keeps the
+ * farthest one. Only the depth image of difference is downloaded, into the
+ * pinned memory of `diff_depth_image_`.
+ *
+ * @param cloud The input point cloud, which may be empty.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly. `depth_image_` and `background_depth_image_` are
+ * not updated in this path.
+ */
+void Locator::updateCuda(const pcl::PointCloud<pcl::PointXYZ>& cloud) noexcept {
+    static_assert(sizeof(pcl::PointXYZ) == sizeof(float4));
+
+    const size_t num_points = cloud.size();
+    reserveCloudCuda(num_points);
+    CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(dev_cloud_ptr_, cloud.points.data(),
+                                        num_points * sizeof(float4),
+                                        cudaMemcpyHostToDevice, stream_));
+
+    float* dev_depth_ptr = beginDepthCuda();
+    locate::projectPoints(dev_cloud_ptr_, static_cast<int>(num_points),
+                          project_param_, dev_depth_ptr,
+                          background_frozen_ ? nullptr : dev_background_ptr_,
+                          stream_);
+    endDepthCuda();
+}
+
+/**
+ * @brief Projects a point cloud as structure of arrays and differences the
+ * queue of depth images with the background on the GPU.
+ *
+ * The arrays are uploaded one after another into the device buffer of the
+ * cloud and projected by the kernel of structure of arrays, which is
+ * otherwise the same as projecting a PCL point cloud.
+ *
+ * @param x The x coordinates of the points, which may be empty.
+ * @param y The y coordinates of the points.
+ * @param z The z coordinates of the points.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void Locator::updateCuda(std::span<const float> x, std::span<const float> y,
+                         std::span<const float> z) noexcept {
+    const size_t num_points = x.size();
+    reserveCloudCuda(num_points);
+    // Three arrays of floats take less room than the points as `float4`
+    float* dev_x_ptr = reinterpret_cast<float*>(dev_cloud_ptr_);
+    float* dev_y_ptr = dev_x_ptr + num_points;
+    float* dev_z_ptr = dev_y_ptr + num_points;
+    for (auto [dst, src] : {std::pair{dev_x_ptr, x}, std::pair{dev_y_ptr, y},
+                            std::pair{dev_z_ptr, z}}) {
+        CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(dst, src.data(), src.size_bytes(),
+                                            cudaMemcpyHostToDevice, stream_));
+    }
+
+    float* dev_depth_ptr = beginDepthCuda();
+    locate::projectPoints(dev_x_ptr, dev_y_ptr, dev_z_ptr,
+                          static_cast<int>(num_points), project_param_,
+                          dev_depth_ptr,
+                          background_frozen_ ? nullptr : dev_background_ptr_,
+                          stream_);
+    endDepthCuda();
+}
+
+/**
+ * @brief Grows the device buffer of the cloud to hold the points as `float4`.
+ *
+ * @param num_points The number of points.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void Locator::reserveCloudCuda(size_t num_points) noexcept {
+    if (num_points > cloud_capacity_) {
+        CUDA_CHECK_NOEXCEPT(cudaFree(dev_cloud_ptr_));
+        cloud_capacity_ = std::max(num_points, cloud_capacity_ * 2);
+        CUDA_CHECK_NOEXCEPT(
+            cudaMalloc(&dev_cloud_ptr_, cloud_capacity_ * sizeof(float4)));
+    }
+}
+
+/**
+ * @brief Clears the oldest depth image of the ring on the device, into which
+ * the points of the new frame are projected.
+ *
+ * @return The depth image in device memory.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+float* Locator::beginDepthCuda() noexcept {
+    const int pixels = image_width_zoomed_ * image_height_zoomed_;
+    float* dev_depth_ptr = dev_depth_ptr_ + depth_index_ * pixels;
+    CUDA_CHECK_NOEXCEPT(cudaMemsetAsync(dev_depth_ptr, locate::kEmptyByte,
+                                        pixels * sizeof(float), stream_));
+    return dev_depth_ptr;
+}
+
+/**
+ * @brief Makes the depth image given by `beginDepthCuda` the newest of the
+ * ring, and differences the ring with the background into the pinned memory
+ * of `diff_depth_image_`.
+ *
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void Locator::endDepthCuda() noexcept {
+    const int pixels = image_width_zoomed_ * image_height_zoomed_;
+    const int newest = static_cast<int>(depth_index_);
+    depth_index_ = (depth_index_ + 1) % queue_size_;
+    depth_count_ = std::min(depth_count_ + 1, queue_size_);
+    locate::diffDepths(dev_depth_ptr_, dev_background_ptr_, dev_diff_ptr_,
+                       pixels, static_cast<int>(depth_count_), newest,
+                       static_cast<int>(queue_size_), min_depth_diff_,
+                       max_depth_diff_, stream_);
+
+    CUDA_CHECK_NOEXCEPT(cudaMemcpyAsync(diff_ptr_, dev_diff_ptr_,
+                                        pixels * sizeof(float),
+                                        cudaMemcpyDeviceToHost, stream_));
+    CUDA_CHECK_NOEXCEPT(cudaStreamSynchronize(stream_));
+}
+
+/**
+ * @brief Accumulates a point cloud into the background being built.
+ *
+ * The largest `kBackgroundSamples` depths and the number of points of each
+ * pixel are kept, from which `freezeBackground` computes a background robust
+ * to outliers. Accumulating does not change the background in use until it is
+ * frozen.
+ *
+ * @param cloud The point cloud of the background.
+ */
+void Locator::accumulateBackground(
+    const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) noexcept {
+    if (background_samples_.empty()) {
+        background_samples_ =
+            cv::Mat::zeros(image_height_zoomed_, image_width_zoomed_,
+                           CV_32FC(kBackgroundSamples));
+        background_hits_ =
+            cv::Mat::zeros(image_height_zoomed_, image_width_zoomed_, CV_32S);
+    }
+    if (!cloud || cloud->empty()) {
+        std::cerr << "background cloud is null or empty." << std::endl;
+        return;
+    }
+
+    const size_t num_points = cloud->size();
+    for (auto* buffer : {&batch_x_, &batch_y_, &batch_z_, &batch_u_, &batch_v_,
+                         &batch_d_}) {
+        buffer->resize(num_points);
+    }
+    for (size_t i = 0; i < num_points; ++i) {
+        batch_x_[i] = (*cloud)[i].x;
+        batch_y_[i] = (*cloud)[i].y;
+        batch_z_[i] = (*cloud)[i].z;
+    }
+    lidarToCamera(batch_x_, batch_y_, batch_z_, batch_u_, batch_v_, batch_d_);
+
+    using Samples = cv::Vec<float, kBackgroundSamples>;
+    for (size_t i = 0; i < num_points; ++i) {
+        const float x = batch_x_[i], y = batch_y_[i], z = batch_z_[i];
+        const float u = batch_u_[i], v = batch_v_[i], depth = batch_d_[i];
+        if ((iszero(x) && iszero(y) && iszero(z)) || x > max_distance_ ||
+            depth <= 0) {
+            continue;
+        }
+        if (u < 0 || u >= image_width_zoomed_ || v < 0 ||
+            v >= image_height_zoomed_) {
+            continue;
+        }
+        const int row = static_cast<int>(v), col = static_cast<int>(u);
+        ++background_hits_.at<int>(row, col);
+
+        // Samples are sorted in descending order, and the smallest is replaced
+        auto& samples = background_samples_.at<Samples>(row, col);
+        float value = depth;
+        for (int k = 0; k < kBackgroundSamples; ++k) {
+            if (value > samples[k]) {
+                std::swap(value, samples[k]);
             }
-        });
+        }
+    }
+}
+
+/**
+ * @brief Freezes the background accumulated by `accumulateBackground`, which
+ * is then used without being changed by updating.
+ *
+ * The background of a pixel is its largest depth after rejecting the
+ * `rejected` largest ones as outliers, or zero if it has fewer than `min_hits`
+ * points, which rejects pixels hit only by noise.
+ *
+ * @param min_hits The minimum number of points of a pixel.
+ * @param rejected The number of the largest depths rejected for each pixel.
+ * @throws `std::invalid_argument` if `rejected` is not less than
+ * `kBackgroundSamples` or negative.
+ * @throws `std::logic_error` if nothing has been accumulated.
+ * @throws `std::runtime_error` if uploading the background fails.
+ */
+void Locator::freezeBackground(int min_hits, int rejected) {
+    if (rejected < 0 || rejected >= kBackgroundSamples) {
+        throw std::invalid_argument("invalid number of rejected depths");
+    }
+    if (background_samples_.empty()) {
+        throw std::logic_error("background is not accumulated");
+    }
+
+    using Samples = cv::Vec<float, kBackgroundSamples>;
+    for (int v = 0; v < image_height_zoomed_; ++v) {
+        const Samples* samples_row = background_samples_.ptr<Samples>(v);
+        const int* hits_row = background_hits_.ptr<int>(v);
+        float* background_row = background_depth_image_.ptr<float>(v);
+        for (int u = 0; u < image_width_zoomed_; ++u) {
+            const int hits = hits_row[u];
+            background_row[u] = hits >= min_hits && hits > rejected
+                                    ? samples_row[u][rejected]
+                                    : 0.0f;
+        }
+    }
+    background_samples_.release();
+    background_hits_.release();
+    uploadBackground();
+    background_frozen_ = true;
+}
+
+/**
+ * @brief Clears the background and the accumulation, after which the
+ * background is built again by accumulating or by the running maximum of
+ * updating.
+ *
+ * @throws `std::runtime_error` if clearing the background on the device fails.
+ */
+void Locator::resetBackground() {
+    background_depth_image_.setTo(0);
+    background_samples_.release();
+    background_hits_.release();
+    uploadBackground();
+    background_frozen_ = false;
+}
+
+/**
+ * @brief Copies the background to the device in the CUDA path.
+ *
+ * @throws `std::runtime_error` if the copy fails.
+ */
+void Locator::uploadBackground() {
+    if (!use_cuda_) {
+        return;
+    }
+    CUDA_CHECK(cudaMemcpy(dev_background_ptr_, background_depth_image_.data,
+                          background_depth_image_.total() * sizeof(float),
+                          cudaMemcpyHostToDevice));
+}
+
+/**
+ * @brief The header of a background file, which is followed by the depths of
+ * the zoomed background image in row-major order.
+ *
+ * The projection from the lidar to the zoomed image is kept with the size, as
+ * the depths are only valid for the intrinsics and extrinsics they are
+ * projected with.
+ */
+struct BackgroundHeader {
+    char magic[4]{'R', 'B', 'G', 'D'};
+    uint32_t version{2};
+    int32_t width{0};
+    int32_t height{0};
+    float zoom_factor{0.0f};
+    float lidar_to_pixel[12]{};
+};
+
+/**
+ * @brief Saves the frozen background as a binary depth map.
+ *
+ * @param path The path of the file.
+ * @throws `std::logic_error` if the background is not frozen.
+ * @throws `std::runtime_error` if the file can not be written.
+ */
+void Locator::saveBackground(std::string_view path) const {
+    if (!background_frozen_) {
+        throw std::logic_error("background is not frozen");
+    }
+    BackgroundHeader header;
+    header.width = image_width_zoomed_;
+    header.height = image_height_zoomed_;
+    header.zoom_factor = zoom_factor_;
+    std::copy(lidar_to_pixel_.val, lidar_to_pixel_.val + 12,
+              header.lidar_to_pixel);
+
+    std::ofstream ofs{std::string(path), std::ios::binary};
+    if (!ofs) {
+        throw std::runtime_error("failed to open file");
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int v = 0; v < image_height_zoomed_; ++v) {
+        ofs.write(background_depth_image_.ptr<char>(v),
+                  image_width_zoomed_ * sizeof(float));
+    }
+    if (!ofs) {
+        throw std::runtime_error("failed to write file");
+    }
+}
+
+/**
+ * @brief Loads and freezes a background saved by `saveBackground`.
+ *
+ * The file is memory-mapped and its depths are copied into the background
+ * directly, so no point cloud is read or projected.
+ *
+ * @param path The path of the file.
+ * @throws `std::runtime_error` if the file can not be read, or it is not a
+ * background of the same size, zoom factor, intrinsics and extrinsics from
+ * the lidar to the camera, in which case it should be built again.
+ */
+void Locator::loadBackground(std::string_view path) {
+    const size_t data_size = background_depth_image_.total() * sizeof(float);
+    int fd = ::open(std::string(path).c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file");
+    }
+    struct stat st;
+    const size_t file_size = sizeof(BackgroundHeader) + data_size;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != file_size) {
+        ::close(fd);
+        throw std::runtime_error("invalid background file");
+    }
+    void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("failed to map file");
+    }
+
+    BackgroundHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    const BackgroundHeader expected;
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version ||
+        header.width != image_width_zoomed_ ||
+        header.height != image_height_zoomed_ ||
+        header.zoom_factor != zoom_factor_ ||
+        !std::equal(lidar_to_pixel_.val, lidar_to_pixel_.val + 12,
+                    header.lidar_to_pixel)) {
+        ::munmap(map, st.st_size);
+        throw std::runtime_error("background does not match the locator");
+    }
+    std::memcpy(background_depth_image_.data,
+                static_cast<const char*>(map) + sizeof(header), data_size);
+    ::munmap(map, st.st_size);
+
+    background_samples_.release();
+    background_hits_.release();
+    uploadBackground();
+    background_frozen_ = true;
 }
 
 /**
@@ -225,51 +898,266 @@ void Locator::update(
  * This method iterates over the differential depth image stored in
  * `diff_depth_image_` and collects non-zero points into a vector. Each point
  * contains the column (x), the row (y), and the depth value (z) from the depth
- * image. These points are then clustered using the DBSCAN algorithm and then
- * stored in an image.
+ * image. These points are then clustered by `cluster_method_`, and clusters
+ * whose sizes are out of [`min_cluster_size`, `max_cluster_size`] are
+ * discarded. The label of each point is written to `label_image_` and its
+ * coordinate to `point_image_` for searching.
  */
 void Locator::cluster() noexcept {
-    point_index_map_.clear();
-    index_cluster_map_.clear();
+    RADAR_PROFILE_SCOPE("locate.cluster");
+    // Only the pixels labeled in the last frame need to be cleared
+    for (int v = 0; v + 1 < static_cast<int>(row_offsets_.size()); ++v) {
+        int* label_row = label_image_.ptr<int>(v);
+        for (int i = row_offsets_[v]; i < row_offsets_[v + 1]; ++i) {
+            label_row[point_columns_[i]] = -1;
+        }
+    }
     clusters_.clear();
     cloud_foreground_->clear();
+    row_offsets_.clear();
+    point_columns_.clear();
 
+    // Pixels are collected first and converted in batch as structure of
+    // arrays
+    batch_u_.clear();
+    batch_v_.clear();
+    batch_d_.clear();
     for (int i = 0; i < diff_depth_image_.rows; ++i) {
+        row_offsets_.emplace_back(point_columns_.size());
         const float* image_row = diff_depth_image_.ptr<float>(i);
         for (int j = 0; j < diff_depth_image_.cols; ++j) {
             float value = image_row[j];
             if (iszero(value)) {
                 continue;
             }
-            cv::Point3f lidar_point = cameraToLidar(cv::Point3f(j, i, value));
-            cloud_foreground_->emplace_back(lidar_point.x, lidar_point.y,
-                                            lidar_point.z);
-            point_index_map_.emplace(cv::Point2i(j, i),
-                                     cloud_foreground_->size() - 1);
+            batch_u_.emplace_back(j);
+            batch_v_.emplace_back(i);
+            batch_d_.emplace_back(value);
+            point_columns_.emplace_back(j);
         }
     }
+    row_offsets_.emplace_back(point_columns_.size());
+
+    const size_t num_points = point_columns_.size();
+    for (auto* buffer : {&batch_x_, &batch_y_, &batch_z_}) {
+        buffer->resize(num_points);
+    }
+    cameraToLidar(batch_u_, batch_v_, batch_d_, batch_x_, batch_y_, batch_z_);
+    cloud_foreground_->resize(num_points);
+    for (size_t i = 0; i < num_points; ++i) {
+        auto& point = (*cloud_foreground_)[i];
+        point.x = batch_x_[i];
+        point.y = batch_y_[i];
+        point.z = batch_z_[i];
+        point_image_.at<cv::Vec3f>(static_cast<int>(batch_v_[i]),
+                                   static_cast<int>(batch_u_[i])) =
+            cv::Vec3f(point.x, point.y, point.z);
+    }
 
     if (cloud_foreground_->empty()) {
         return;
     }
-    kdtree_->setInputCloud(cloud_foreground_);
-    cluster_extractor_.setInputCloud(cloud_foreground_);
-    cluster_extractor_.extract(clusters_);
+    switch (cluster_method_) {
+        case ClusterMethod::Euclidean:
+            kdtree_->setInputCloud(cloud_foreground_);
+            cluster_extractor_.setInputCloud(cloud_foreground_);
+            cluster_extractor_.extract(clusters_);
+            break;
+        case ClusterMethod::Grid:
+            clusterGrid();
+            break;
+        case ClusterMethod::Voxel:
+            clusterVoxel();
+            break;
+    }
+    labelClusters();
+}
 
+/**
+ * @brief Writes the label of each foreground point to `label_image_`.
+ *
+ * Points of the i-th cluster are labeled i, and points not belonging to any
+ * cluster are labeled `clusters_.size()`, while pixels without a point stay -1.
+ */
+void Locator::labelClusters() noexcept {
+    const int noise_label = clusters_.size();
+    cluster_ids_.assign(cloud_foreground_->size(), noise_label);
     for (size_t i = 0; i < clusters_.size(); ++i) {
         for (int index : clusters_[i].indices) {
-            index_cluster_map_.emplace(index, i);
+            cluster_ids_[index] = i;
+        }
+    }
+    for (int v = 0; v + 1 < static_cast<int>(row_offsets_.size()); ++v) {
+        int* label_row = label_image_.ptr<int>(v);
+        for (int i = row_offsets_[v]; i < row_offsets_[v + 1]; ++i) {
+            label_row[point_columns_[i]] = cluster_ids_[i];
         }
     }
 }
 
+/**
+ * @brief Clusters the foreground points by connected components over the
+ * zoomed depth image.
+ *
+ * For two points p and q closer than the tolerance t, the pixel distance of
+ * them in u is at most zoom * t * (fx + |u_p / zoom - cx|) / (z_p - t), and
+ * similarly in v, where z_p is the depth of p. Each point therefore only
+ * compares with the points after it within that window, which are found by
+ * binary search in the sorted columns of each row, and unites with those
+ * closer than the tolerance. The result is the same as Euclidean cluster
+ * extraction without building a KD-tree.
+ *
+ * @note The intrinsic matrix is assumed to have no skew.
+ */
+void Locator::clusterGrid() noexcept {
+    const int num_points = cloud_foreground_->size();
+    const int rows = diff_depth_image_.rows, cols = diff_depth_image_.cols;
+    const float fx = intrinsic_(0, 0), fy = intrinsic_(1, 1);
+    const float cx = intrinsic_(0, 2), cy = intrinsic_(1, 2);
+    const float tolerance_sq = cluster_tolerance_ * cluster_tolerance_;
+    const auto& points = cloud_foreground_->points;
+
+    disjoint_set_.reset(num_points);
+    for (int v = 0; v < rows; ++v) {
+        for (int i = row_offsets_[v]; i < row_offsets_[v + 1]; ++i) {
+            const int u = point_columns_[i];
+            const float depth = diff_depth_image_.at<float>(v, u);
+            const float nearest = depth - cluster_tolerance_;
+            auto radius = [&](float f, float c, float coord, int limit) {
+                if (nearest <= 0) {
+                    return limit;
+                }
+                float r{std::ceil(zoom_factor_ * cluster_tolerance_ *
+                                  (f + std::abs(coord / zoom_factor_ - c)) /
+                                  nearest)};
+                return static_cast<int>(std::min(r, static_cast<float>(limit)));
+            };
+            const int radius_u = radius(fx, cx, u, cols);
+            const int radius_v = radius(fy, cy, v, rows);
+
+            const int last_row = std::min(v + radius_v, rows - 1);
+            for (int row = v; row <= last_row; ++row) {
+                auto begin = point_columns_.begin() + row_offsets_[row];
+                auto end = point_columns_.begin() + row_offsets_[row + 1];
+                begin = row == v ? point_columns_.begin() + i + 1
+                                 : std::lower_bound(begin, end, u - radius_u);
+                for (auto it = begin; it != end && *it <= u + radius_u; ++it) {
+                    const int j = it - point_columns_.begin();
+                    const auto& p = points[i];
+                    const auto& q = points[j];
+                    const float dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+                    if (dx * dx + dy * dy + dz * dz <= tolerance_sq) {
+                        disjoint_set_.unite(i, j);
+                    }
+                }
+            }
+        }
+    }
+    collectClusters();
+}
+
+/**
+ * @brief Clusters the foreground points by connected components over a voxel
+ * grid whose cell size is the tolerance.
+ *
+ * Points are sorted by the keys of their voxels, so the points of a voxel are
+ * found by binary search. Each point compares with the points after it in its
+ * own voxel and the 26 voxels around, and unites with those closer than the
+ * tolerance.
+ */
+void Locator::clusterVoxel() noexcept {
+    constexpr int kBits = 21;
+    constexpr int64_t kOffset = int64_t{1} << (kBits - 1);
+    const int num_points = cloud_foreground_->size();
+    const float tolerance_sq = cluster_tolerance_ * cluster_tolerance_;
+    const auto& points = cloud_foreground_->points;
+
+    auto cell = [&](float value) {
+        return static_cast<int64_t>(std::floor(value / cluster_tolerance_));
+    };
+    auto key = [&](int64_t x, int64_t y, int64_t z) {
+        constexpr uint64_t kMask = (uint64_t{1} << kBits) - 1;
+        return ((static_cast<uint64_t>(x + kOffset) & kMask) << (2 * kBits)) |
+               ((static_cast<uint64_t>(y + kOffset) & kMask) << kBits) |
+               (static_cast<uint64_t>(z + kOffset) & kMask);
+    };
+
+    voxels_.resize(num_points);
+    for (int i = 0; i < num_points; ++i) {
+        const auto& p = points[i];
+        voxels_[i] = std::make_pair(key(cell(p.x), cell(p.y), cell(p.z)), i);
+    }
+    std::sort(voxels_.begin(), voxels_.end());
+
+    disjoint_set_.reset(num_points);
+    for (int i = 0; i < num_points; ++i) {
+        const auto& p = points[i];
+        const int64_t x = cell(p.x), y = cell(p.y), z = cell(p.z);
+        for (int64_t dx = -1; dx <= 1; ++dx) {
+            for (int64_t dy = -1; dy <= 1; ++dy) {
+                for (int64_t dz = -1; dz <= 1; ++dz) {
+                    auto [begin, end] = std::equal_range(
+                        voxels_.begin(), voxels_.end(),
+                        std::make_pair(key(x + dx, y + dy, z + dz), 0),
+                        [](const auto& a, const auto& b) {
+                            return a.first < b.first;
+                        });
+                    for (auto it = begin; it != end; ++it) {
+                        const int j = it->second;
+                        if (j <= i) {
+                            continue;
+                        }
+                        const auto& q = points[j];
+                        const float ex = p.x - q.x, ey = p.y - q.y,
+                                    ez = p.z - q.z;
+                        if (ex * ex + ey * ey + ez * ez <= tolerance_sq) {
+                            disjoint_set_.unite(i, j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    collectClusters();
+}
+
+/**
+ * @brief Collects the subsets of `disjoint_set_` into `clusters_`.
+ *
+ * Clusters whose sizes are out of [`min_cluster_size_`, `max_cluster_size_`]
+ * are discarded, and the rest are sorted by size in descending order, which is
+ * the same as the Euclidean cluster extraction of PCL.
+ */
+void Locator::collectClusters() noexcept {
+    const int num_points = cloud_foreground_->size();
+    cluster_ids_.assign(num_points, -1);
+    for (int i = 0; i < num_points; ++i) {
+        const int root = disjoint_set_.find(i);
+        const int size = disjoint_set_.size(root);
+        if (size < min_cluster_size_ || size > max_cluster_size_) {
+            continue;
+        }
+        if (cluster_ids_[root] < 0) {
+            cluster_ids_[root] = clusters_.size();
+            clusters_.emplace_back();
+            clusters_.back().indices.reserve(size);
+        }
+        clusters_[cluster_ids_[root]].indices.emplace_back(i);
+    }
+    std::stable_sort(clusters_.begin(), clusters_.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.indices.size() > b.indices.size();
+                     });
+}
+
 /**
  * @brief Searches for the robot within the specified region of interest.
  *
  * This method searches for the robot within the specified region of interest
- * (ROI) by analyzing the differencing depth image. It identifies candidate
- * points within the ROI, associates them with clusters, and determines the
- * location of the robot based on the largest cluster of points.
+ * (ROI) by analyzing the differencing depth image. It counts the points of
+ * each cluster within the ROI by reading `label_image_`, and determines the
+ * location of the robot as the mean of the points of the largest cluster
+ * within the ROI, which are read from `point_image_`.
  *
  * @param robot The robot object.
  */
@@ -278,35 +1166,40 @@ void Locator::search(Robot& robot) const noexcept {
         return;
     }
 
-    std::map<int, std::vector<cv::Point3f>> candidates;
+    // The histogram is reused by each thread, so searching allocates nothing
+    // once it has grown to the number of clusters
+    thread_local std::vector<int> counts;
+    thread_local std::vector<cv::Point3f> sums;
+    const int noise_label = clusters_.size();
+    counts.assign(noise_label + 1, 0);
+    sums.assign(noise_label + 1, cv::Point3f(0.0f, 0.0f, 0.0f));
 
     auto rect{zoom(robot.rect().value())};
     for (int v = rect.y; v < rect.y + rect.height; ++v) {
-        const float* image_row = diff_depth_image_.ptr<float>(v);
+        const int* label_row = label_image_.ptr<int>(v);
+        const cv::Vec3f* point_row = point_image_.ptr<cv::Vec3f>(v);
         for (int u = rect.x; u < rect.x + rect.width; ++u) {
-            float depth = image_row[u];
-            if (iszero(depth)) {
+            const int label = label_row[u];
+            if (label < 0) {
                 continue;
             }
-            int index = point_index_map_.at(cv::Point2i(u, v));
-            int cluster_id = index_cluster_map_.contains(index)
-                                 ? index_cluster_map_.at(index)
-                                 : -1;
-            candidates[cluster_id].emplace_back(
-                cameraToLidar(cv::Point3f(u, v, depth)));
+            ++counts[label];
+            sums[label] += cv::Point3f(point_row[u]);
         }
     }
 
-    if (candidates.empty()) {
+    // Points of no cluster come first, and the first label of the most points
+    // wins the ties
+    int best = noise_label;
+    for (int label = 0; label < noise_label; ++label) {
+        if (counts[label] > counts[best]) {
+            best = label;
+        }
+    }
+    if (counts[best] == 0) {
         return;
     }
-    auto& points =
-        std::ranges::max_element(candidates, [](auto&& pair_a, auto&& pair_b) {
-            return pair_a.second.size() < pair_b.second.size();
-        })->second;
-    auto location = std::accumulate(points.begin(), points.end(),
-                                    cv::Point3f(0.0f, 0.0f, 0.0f)) /
-                    static_cast<float>(points.size());
+    auto location = sums[best] / static_cast<float>(counts[best]);
     robot.setLocation(lidarToWorld(location));
 }
 
@@ -321,7 +1214,8 @@ void Locator::search(Robot& robot) const noexcept {
  * @param robots The vector of Robot objects to search for.
  */
 void Locator::search(std::vector<Robot>& robots) const noexcept {
-    std::for_each(std::execution::par_unseq, robots.begin(), robots.end(),
+    RADAR_PROFILE_SCOPE("locate.search");
+    std::for_each(std::execution::par, robots.begin(), robots.end(),
                   [this](Robot& robot) { search(robot); });
 }
 
@@ -0,0 +1,244 @@
+/**
+ * @file locate.cu
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief The file implements the CUDA kernels of the `Locator`, which project
+ * point clouds onto depth images and difference them with the background on
+ * the GPU.
+ * @date 2024-05-08
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#include <cuda_runtime.h>
+
+#include "projection.h"
+#include "utils/cuda_check.h"
+
+namespace radar::locate {
+
+/**
+ * @brief Projects a lidar point onto the depth image of the current frame and
+ * the background depth image.
+ *
+ * Points projected onto the same pixel are resolved by atomic operations on
+ * the bits of the depths, which preserve the order of non-negative floats: the
+ * depth image keeps the nearest point and the background keeps the farthest
+ * one.
+ *
+ * @param point The point.
+ * @param param The parameters of projecting.
+ * @param depth The depth image of the current frame, which is cleared to
+ * `kEmptyBits` before.
+ * @param background The background depth image, or `nullptr` if it is frozen.
+ * @note Points at the origin, farther than `max_distance` or behind the camera
+ * are ignored.
+ */
+__device__ void projectPoint(float3 point, const ProjectParam& param,
+                             float* depth, float* background) {
+    if (point.x == 0.0f && point.y == 0.0f && point.z == 0.0f) {
+        return;
+    }
+    if (point.x > param.max_distance) {
+        return;
+    }
+
+    const float* m = param.matrix;
+    float x = m[0] * point.x + m[1] * point.y + m[2] * point.z + m[3];
+    float y = m[4] * point.x + m[5] * point.y + m[6] * point.z + m[7];
+    float d = m[8] * point.x + m[9] * point.y + m[10] * point.z + m[11];
+    if (d <= 0.0f) {
+        return;
+    }
+    float u = x * param.zoom_factor / d;
+    float v = y * param.zoom_factor / d;
+    if (u < 0 || u >= param.width || v < 0 || v >= param.height) {
+        return;
+    }
+
+    int pixel = static_cast<int>(v) * param.width + static_cast<int>(u);
+    atomicMin(reinterpret_cast<int*>(depth + pixel), __float_as_int(d));
+    if (background != nullptr) {
+        atomicMax(reinterpret_cast<int*>(background + pixel),
+                  __float_as_int(d));
+    }
+}
+
+/**
+ * @brief Projects lidar points onto the depth image of the current frame and
+ * the background depth image, with one thread for each point.
+ *
+ * @param points The points, whose layout is the same as `pcl::PointXYZ`.
+ * @param num_points The number of points.
+ * @param param The parameters of projecting.
+ * @param depth The depth image of the current frame, which is cleared to
+ * `kEmptyBits` before.
+ * @param background The background depth image, or `nullptr` if it is frozen.
+ */
+__global__ void projectKernel(const float4* points, int num_points,
+                              ProjectParam param, float* depth,
+                              float* background) {
+    int index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= num_points) {
+        return;
+    }
+    const float4 point = points[index];
+    projectPoint(make_float3(point.x, point.y, point.z), param, depth,
+                 background);
+}
+
+/**
+ * @brief Projects lidar points as structure of arrays onto the depth image of
+ * the current frame and the background depth image, with one thread for each
+ * point.
+ *
+ * @param xs The x coordinates of the points.
+ * @param ys The y coordinates of the points.
+ * @param zs The z coordinates of the points.
+ * @param num_points The number of points.
+ * @param param The parameters of projecting.
+ * @param depth The depth image of the current frame, which is cleared to
+ * `kEmptyBits` before.
+ * @param background The background depth image, or `nullptr` if it is frozen.
+ */
+__global__ void projectSoaKernel(const float* xs, const float* ys,
+                                 const float* zs, int num_points,
+                                 ProjectParam param, float* depth,
+                                 float* background) {
+    int index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= num_points) {
+        return;
+    }
+    projectPoint(make_float3(xs[index], ys[index], zs[index]), param, depth,
+                 background);
+}
+
+/**
+ * @brief Differences the queue of depth images with the background depth
+ * image.
+ *
+ * Each thread computes one pixel, which takes the latest depth of the pixel in
+ * the queue if its difference from the background is within the range, or
+ * zero otherwise. This is the same as the incremental update on the CPU.
+ *
+ * @param depths The queue of depth images as a ring.
+ * @param background The background depth image.
+ * @param diff The output depth image of difference.
+ * @param pixels The number of pixels of each image.
+ * @param count The number of depth images in the queue.
+ * @param newest The index of the newest depth image in the ring.
+ * @param queue_size The capacity of the ring.
+ * @param min_depth_diff The minimum depth difference.
+ * @param max_depth_diff The maximum depth difference.
+ */
+__global__ void diffKernel(const float* depths, const float* background,
+                           float* diff, int pixels, int count, int newest,
+                           int queue_size, float min_depth_diff,
+                           float max_depth_diff) {
+    int index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= pixels) {
+        return;
+    }
+
+    const float background_depth = background[index];
+    float result = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        int slot = (newest - i + queue_size) % queue_size;
+        float value = depths[slot * pixels + index];
+        if (__float_as_uint(value) == kEmptyBits) {
+            continue;
+        }
+        float depth_diff = background_depth - value;
+        if (depth_diff >= min_depth_diff && depth_diff <= max_depth_diff) {
+            result = value;
+        }
+        break;
+    }
+    diff[index] = result;
+}
+
+/**
+ * @brief Launches `projectKernel` with one thread for each point.
+ *
+ * @param points The points in device memory, whose layout is the same as
+ * `pcl::PointXYZ`.
+ * @param num_points The number of points.
+ * @param param The parameters of projecting.
+ * @param depth The depth image of the current frame in device memory, which is
+ * cleared to `kEmptyBits` before.
+ * @param background The background depth image in device memory, or `nullptr`
+ * if it is frozen.
+ * @param stream The stream on which the kernel runs.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void projectPoints(const float4* points, int num_points,
+                   const ProjectParam& param, float* depth, float* background,
+                   cudaStream_t stream) {
+    constexpr int kBlockSize = 256;
+    if (num_points == 0) {
+        return;
+    }
+    projectKernel<<<(num_points + kBlockSize - 1) / kBlockSize, kBlockSize, 0,
+                    stream>>>(points, num_points, param, depth, background);
+    CUDA_CHECK_NOEXCEPT(cudaGetLastError());
+}
+
+/**
+ * @brief Launches `projectSoaKernel` with one thread for each point.
+ *
+ * @param xs The x coordinates of the points in device memory.
+ * @param ys The y coordinates of the points in device memory.
+ * @param zs The z coordinates of the points in device memory.
+ * @param num_points The number of points.
+ * @param param The parameters of projecting.
+ * @param depth The depth image of the current frame in device memory, which is
+ * cleared to `kEmptyBits` before.
+ * @param background The background depth image in device memory, or `nullptr`
+ * if it is frozen.
+ * @param stream The stream on which the kernel runs.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void projectPoints(const float* xs, const float* ys, const float* zs,
+                   int num_points, const ProjectParam& param, float* depth,
+                   float* background, cudaStream_t stream) {
+    constexpr int kBlockSize = 256;
+    if (num_points == 0) {
+        return;
+    }
+    projectSoaKernel<<<(num_points + kBlockSize - 1) / kBlockSize, kBlockSize,
+                       0, stream>>>(xs, ys, zs, num_points, param, depth,
+                                    background);
+    CUDA_CHECK_NOEXCEPT(cudaGetLastError());
+}
+
+/**
+ * @brief Launches `diffKernel` with one thread for each pixel.
+ *
+ * @param depths The queue of depth images as a ring in device memory.
+ * @param background The background depth image in device memory.
+ * @param diff The output depth image of difference in device memory.
+ * @param pixels The number of pixels of each image.
+ * @param count The number of depth images in the queue.
+ * @param newest The index of the newest depth image in the ring.
+ * @param queue_size The capacity of the ring.
+ * @param min_depth_diff The minimum depth difference.
+ * @param max_depth_diff The maximum depth difference.
+ * @param stream The stream on which the kernel runs.
+ * @note If the function encounters a problem in CUDA checking, it will call
+ * `std::abort()` directly.
+ */
+void diffDepths(const float* depths, const float* background, float* diff,
+                int pixels, int count, int newest, int queue_size,
+                float min_depth_diff, float max_depth_diff,
+                cudaStream_t stream) {
+    constexpr int kBlockSize = 256;
+    diffKernel<<<(pixels + kBlockSize - 1) / kBlockSize, kBlockSize, 0,
+                 stream>>>(depths, background, diff, pixels, count, newest,
+                           queue_size, min_depth_diff, max_depth_diff);
+    CUDA_CHECK_NOEXCEPT(cudaGetLastError());
+}
+
+}  // namespace radar::locate
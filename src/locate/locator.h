@@ -19,29 +19,33 @@
 #include <pcl/point_types.h>
 #include <pcl/segmentation/extract_clusters.h>
 
-#include <deque>
-#include <functional>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
-#include <unordered_map>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <utility>
+#include <vector>
 
+#include "disjoint_set.h"
+#include "projection.h"
 #include "robot/robot.h"
 
 namespace radar {
 
 /**
- * @brief Hash function for `cv::Point2i`.
+ * @brief Methods of clustering the foreground points, all of which group points
+ * closer than the cluster tolerance into the same cluster.
  *
- * This struct defines a hash function for `cv::Point2i` objects. It combines
- * the hash values of the point's x and y using the XOR (^) operator.
+ * - `Euclidean`: The Euclidean cluster extraction of PCL on a KD-tree built in
+ * each frame.
+ * - `Grid`: Connected components over the zoomed depth image, where the
+ * neighbors of a point are searched in a window of pixels bounded by the
+ * tolerance and its depth.
+ * - `Voxel`: Connected components over a voxel grid whose cell size is the
+ * tolerance, which does not rely on the structure of the image.
  */
-struct CvPoint2iHash {
-    std::size_t operator()(const cv::Point2i& pt) const {
-        std::size_t hx = std::hash<int>{}(pt.x);
-        std::size_t hy = std::hash<int>{}(pt.y);
-        return hx ^ hy;
-    }
-};
+enum class ClusterMethod { Euclidean, Grid, Voxel };
 
 /**
  * @brief Class for robot localization using sensor fusion of point cloud data.
@@ -62,39 +66,117 @@ class Locator {
             size_t queue_size = 3, float min_depth_diff = 500,
             float max_depth_diff = 4000, float cluster_tolerance = 400,
             int min_cluster_size = 8, int max_cluster_size = 1000,
-            float max_distance = 29300);
+            float max_distance = 29300, bool use_cuda = false,
+            ClusterMethod cluster_method = ClusterMethod::Grid);
+
+    ~Locator();
+
+    Locator(const Locator&) = delete;
+    Locator& operator=(const Locator&) = delete;
 
     void update(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) noexcept;
 
+    void update(std::span<const float> x, std::span<const float> y,
+                std::span<const float> z) noexcept;
+
     void cluster() noexcept;
 
     void search(std::vector<Robot>& robot) const noexcept;
 
+    std::optional<cv::Rect> project(const cv::Point3f& location,
+                                    float radius) const noexcept;
+
+    void setExtrinsics(const cv::Matx44f& lidar_to_camera,
+                       const cv::Matx44f& world_to_camera) noexcept;
+
+    void accumulateBackground(
+        const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) noexcept;
+
+    void freezeBackground(int min_hits = 2, int rejected = 1);
+
+    void resetBackground();
+
+    void saveBackground(std::string_view path) const;
+
+    void loadBackground(std::string_view path);
+
+    /**
+     * @brief Gets whether the background is frozen, in which case updating
+     * does not change it.
+     *
+     * @return `true` if the background is frozen.
+     */
+    inline bool backgroundFrozen() const noexcept { return background_frozen_; }
+
+    // The number of the largest depths kept for each pixel when accumulating
+    // the background.
+    static constexpr int kBackgroundSamples = 3;
+
    private:
+    void uploadBackground();
     cv::Point3f cameraToLidar(const cv::Point3f& point) const noexcept;
     cv::Point3f lidarToWorld(const cv::Point3f& point) const noexcept;
     cv::Point3f lidarToCamera(const cv::Point3f& point) const noexcept;
+    void cameraToLidar(std::span<const float> u, std::span<const float> v,
+                       std::span<const float> d, std::span<float> x,
+                       std::span<float> y, std::span<float> z) const noexcept;
+    void lidarToCamera(std::span<const float> x, std::span<const float> y,
+                       std::span<const float> z, std::span<float> u,
+                       std::span<float> v, std::span<float> d) const noexcept;
     void search(Robot& robot) const noexcept;
+    void updateCpu(std::span<const float> x, std::span<const float> y,
+                   std::span<const float> z) noexcept;
+    void updateCuda(const pcl::PointCloud<pcl::PointXYZ>& cloud) noexcept;
+    void updateCuda(std::span<const float> x, std::span<const float> y,
+                    std::span<const float> z) noexcept;
+    void reserveCloudCuda(size_t num_points) noexcept;
+    float* beginDepthCuda() noexcept;
+    void endDepthCuda() noexcept;
+    void clusterGrid() noexcept;
+    void clusterVoxel() noexcept;
+    void collectClusters() noexcept;
+    void labelClusters() noexcept;
     cv::Rect zoom(const cv::Rect& rect) const noexcept;
     int image_width_, image_height_;
     float zoom_factor_;
     int image_width_zoomed_, image_height_zoomed_;
     size_t queue_size_;
-    cv::Matx33f intrinsic_, intrinsic_inv_;
-    cv::Matx44f lidar_to_camera_transform_;
-    cv::Matx31f camera_to_lidar_translate_;
-    cv::Matx33f camera_to_lidar_rotate_;
-    cv::Matx44f camera_to_world_transform_;
+    cv::Matx33f intrinsic_;
+    cv::Matx34f lidar_to_pixel_, lidar_to_world_, world_to_image_;
+    cv::Matx33f pixel_to_lidar_rotate_;
+    cv::Vec3f pixel_to_lidar_translate_;
     float min_depth_diff_, max_depth_diff_;
     float max_distance_;
     cv::Mat depth_image_, background_depth_image_, diff_depth_image_;
-    std::deque<cv::Mat> depth_images_;
+    bool background_frozen_{false};
+    cv::Mat background_samples_, background_hits_;
+    std::vector<std::vector<int>> frame_pixels_;
+    std::vector<int> pixel_slots_;
+    std::vector<float> batch_x_, batch_y_, batch_z_;
+    std::vector<float> batch_u_, batch_v_, batch_d_;
+    ClusterMethod cluster_method_;
+    float cluster_tolerance_;
+    int min_cluster_size_, max_cluster_size_;
     pcl::EuclideanClusterExtraction<pcl::PointXYZ> cluster_extractor_;
     pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree_;
-    std::unordered_map<cv::Point2i, int, CvPoint2iHash> point_index_map_;
-    std::map<int, int> index_cluster_map_;
+    cv::Mat label_image_, point_image_;
     std::vector<pcl::PointIndices> clusters_;
+    std::vector<int> row_offsets_, point_columns_;
+    std::vector<std::pair<uint64_t, int>> voxels_;
+    locate::DisjointSet disjoint_set_;
+    std::vector<int> cluster_ids_;
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_foreground_;
+    bool use_cuda_;
+    locate::ProjectParam project_param_;
+    cudaStream_t stream_{nullptr};
+    float4* dev_cloud_ptr_{nullptr};
+    size_t cloud_capacity_{0};
+    float* dev_depth_ptr_{nullptr};
+    float* dev_background_ptr_{nullptr};
+    float* dev_diff_ptr_{nullptr};
+    float* diff_ptr_{nullptr};
+    size_t depth_index_{0};
+    size_t depth_count_{0};
 };
 
 }  // namespace radar
\ No newline at end of file
@@ -0,0 +1,285 @@
+/**
+ * @file point_file.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a binary format of recorded point clouds, which
+ * is written frame by frame and read back through a memory map, so that
+ * replayed clouds are neither parsed nor copied.
+ * @date 2024-05-18
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "point_ring.h"
+
+namespace radar::locate {
+
+/**
+ * @brief The header at the beginning of a point file.
+ *
+ * A point file is laid out in the native byte order as the header, the points
+ * of every frame and the index of the frames. The points of a frame are its
+ * `x`, `y` and `z` arrays one after another, starting at a multiple of
+ * `kPointFileAlignment` bytes, and the index has a `PointFileEntry` of each
+ * frame.
+ *
+ */
+struct PointFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t frames;
+    uint64_t index_offset;
+};
+
+/**
+ * @brief The entry of a frame in the index of a point file.
+ *
+ */
+struct PointFileEntry {
+    int64_t timestamp;
+    uint64_t offset;
+    uint64_t count;
+};
+
+constexpr char kPointFileMagic[8] = {'R', 'A', 'D', 'A', 'R', 'P', 'T', 'S'};
+constexpr uint32_t kPointFileVersion = 1;
+constexpr size_t kPointFileAlignment = 64;
+
+/**
+ * @brief Writes point clouds into a point file frame by frame.
+ *
+ * Frames are streamed to disk as they are appended, and the index and the
+ * header are written when the writer is closed.
+ *
+ */
+class PointFileWriter {
+   public:
+    /**
+     * @brief Creates the file.
+     *
+     * @param path The path of the file.
+     * @throws `std::runtime_error` if the file can not be created.
+     */
+    explicit PointFileWriter(std::string_view path)
+        : ofs_(std::string(path), std::ios::binary | std::ios::trunc) {
+        if (!ofs_.is_open()) {
+            throw std::runtime_error("failed to create " + std::string(path));
+        }
+        PointFileHeader header{};
+        write(&header, sizeof(header));
+    }
+
+    PointFileWriter(const PointFileWriter&) = delete;
+    PointFileWriter& operator=(const PointFileWriter&) = delete;
+
+    /**
+     * @brief Closes the file if it is not closed yet, ignoring any error.
+     *
+     */
+    ~PointFileWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    /**
+     * @brief Appends a frame.
+     *
+     * @param timestamp The time stamp of the frame, which is usually the
+     * capture time in nanoseconds.
+     * @param points The points of the frame.
+     * @throws `std::invalid_argument` if the arrays of the points differ in
+     * length.
+     * @throws `std::runtime_error` if the file is closed or can not be written.
+     */
+    void append(int64_t timestamp, const PointSpans& points) {
+        if (points.y.size() != points.size() ||
+            points.z.size() != points.size()) {
+            throw std::invalid_argument("points differ in length");
+        }
+        if (!ofs_.is_open()) {
+            throw std::runtime_error("point file is closed");
+        }
+        pad();
+        entries_.push_back({.timestamp = timestamp,
+                            .offset = offset_,
+                            .count = points.size()});
+        for (auto coordinates : {points.x, points.y, points.z}) {
+            write(coordinates.data(), coordinates.size_bytes());
+        }
+    }
+
+    /**
+     * @brief Writes the index and the header, and closes the file.
+     *
+     * @throws `std::runtime_error` if the file can not be written.
+     */
+    void close() {
+        if (!ofs_.is_open()) {
+            return;
+        }
+        pad();
+        PointFileHeader header{};
+        std::memcpy(header.magic, kPointFileMagic, sizeof(header.magic));
+        header.version = kPointFileVersion;
+        header.frames = entries_.size();
+        header.index_offset = offset_;
+        write(entries_.data(), entries_.size() * sizeof(PointFileEntry));
+        ofs_.seekp(0);
+        write(&header, sizeof(header));
+        ofs_.close();
+    }
+
+   private:
+    void write(const void* data, size_t bytes) {
+        ofs_.write(static_cast<const char*>(data),
+                   static_cast<std::streamsize>(bytes));
+        if (!ofs_) {
+            throw std::runtime_error("failed to write point file");
+        }
+        offset_ += bytes;
+    }
+
+    void pad() {
+        static constexpr char kZeros[kPointFileAlignment]{};
+        write(kZeros, (kPointFileAlignment - offset_ % kPointFileAlignment) %
+                          kPointFileAlignment);
+    }
+
+    std::ofstream ofs_;
+    uint64_t offset_{0};
+    std::vector<PointFileEntry> entries_;
+};
+
+/**
+ * @brief Reads a point file through a read-only memory map.
+ *
+ * The points of a frame are returned as views into the map, so reading a
+ * frame neither parses nor copies it, and the pages are only read from disk
+ * when they are touched.
+ *
+ */
+class PointFile {
+   public:
+    /**
+     * @brief Maps the file and checks its header and index.
+     *
+     * @param path The path of the file.
+     * @throws `std::runtime_error` if the file can not be mapped, or is not a
+     * valid point file.
+     */
+    explicit PointFile(std::string_view path) {
+        const std::string path_str(path);
+        const int fd = ::open(path_str.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open " + path_str);
+        }
+        struct stat status;
+        if (::fstat(fd, &status) != 0 ||
+            static_cast<size_t>(status.st_size) < sizeof(PointFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error(path_str + " is not a point file");
+        }
+        bytes_ = status.st_size;
+        void* data = ::mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("failed to map " + path_str);
+        }
+        data_ = static_cast<const unsigned char*>(data);
+        ::madvise(data, bytes_, MADV_SEQUENTIAL);
+
+        try {
+            validate();
+        } catch (const std::runtime_error&) {
+            ::munmap(const_cast<unsigned char*>(data_), bytes_);
+            throw std::runtime_error(path_str + " is not a valid point file");
+        }
+    }
+
+    PointFile(const PointFile&) = delete;
+    PointFile& operator=(const PointFile&) = delete;
+
+    ~PointFile() { ::munmap(const_cast<unsigned char*>(data_), bytes_); }
+
+    /**
+     * @brief Gets the number of frames.
+     *
+     * @return The number of frames.
+     */
+    inline size_t size() const noexcept { return entries_.size(); }
+
+    /**
+     * @brief Gets the time stamp of a frame.
+     *
+     * @param index The index of the frame, which must be less than `size()`.
+     * @return The time stamp of the frame.
+     */
+    inline int64_t timestamp(size_t index) const noexcept {
+        return entries_[index].timestamp;
+    }
+
+    /**
+     * @brief Gets the points of a frame.
+     *
+     * @param index The index of the frame, which must be less than `size()`.
+     * @return The views of the points into the map, which are valid as long as
+     * the file.
+     */
+    inline PointSpans points(size_t index) const noexcept {
+        const auto& entry = entries_[index];
+        const auto* x = reinterpret_cast<const float*>(data_ + entry.offset);
+        return {.x = std::span(x, entry.count),
+                .y = std::span(x + entry.count, entry.count),
+                .z = std::span(x + 2 * entry.count, entry.count)};
+    }
+
+   private:
+    void validate() {
+        const auto* header = reinterpret_cast<const PointFileHeader*>(data_);
+        if (std::memcmp(header->magic, kPointFileMagic,
+                        sizeof(kPointFileMagic)) != 0 ||
+            header->version != kPointFileVersion ||
+            header->index_offset > bytes_ ||
+            header->frames > (bytes_ - header->index_offset) /
+                                 sizeof(PointFileEntry)) {
+            throw std::runtime_error("invalid header");
+        }
+        entries_ = std::span(reinterpret_cast<const PointFileEntry*>(
+                                 data_ + header->index_offset),
+                             header->frames);
+        for (const auto& entry : entries_) {
+            if (entry.offset % kPointFileAlignment != 0 ||
+                entry.offset > header->index_offset ||
+                entry.count > (header->index_offset - entry.offset) /
+                                  (3 * sizeof(float))) {
+                throw std::runtime_error("invalid entry");
+            }
+        }
+    }
+
+    const unsigned char* data_{nullptr};
+    size_t bytes_{0};
+    std::span<const PointFileEntry> entries_;
+};
+
+}  // namespace radar::locate
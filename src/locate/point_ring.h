@@ -0,0 +1,194 @@
+/**
+ * @file point_ring.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a lock-free ring of preallocated point buffers,
+ * through which the lidar driver thread hands point clouds to the locating
+ * thread without allocating or converting them.
+ * @date 2024-05-18
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace radar::locate {
+
+/**
+ * @brief A point cloud as structure of arrays, which is the layout taken by
+ * `Locator::update` without PCL.
+ *
+ */
+struct PointSpans {
+    std::span<const float> x, y, z;
+
+    /**
+     * @brief Gets the number of points.
+     *
+     * @return The number of points.
+     */
+    inline size_t size() const noexcept { return x.size(); }
+};
+
+/**
+ * @brief A preallocated buffer of points in a `PointRing`.
+ *
+ * The writer fills the first points of `x`, `y` and `z`, whose capacity never
+ * changes, and sets `size` and `timestamp` before publishing it.
+ *
+ */
+struct PointBuffer {
+    std::vector<float> x, y, z;
+    size_t size{0};
+    int64_t timestamp{0};
+
+    /**
+     * @brief Gets the points written into the buffer.
+     *
+     * @return The first `size` points of the buffer.
+     */
+    inline PointSpans points() const noexcept {
+        return {.x = std::span(x).first(size),
+                .y = std::span(y).first(size),
+                .z = std::span(z).first(size)};
+    }
+
+    /**
+     * @brief Gets the maximum number of points of the buffer.
+     *
+     * @return The maximum number of points.
+     */
+    inline size_t capacity() const noexcept { return x.size(); }
+};
+
+/**
+ * @brief A single-producer single-consumer ring of point buffers.
+ *
+ * Every buffer is allocated at construction, so that neither side allocates
+ * afterwards. The writer claims the next free buffer, fills it in place and
+ * publishes it, while the reader borrows the oldest published buffer and
+ * gives it back when the points are no longer used. The two sides only
+ * synchronize on one atomic index each, so neither of them ever blocks.
+ *
+ * If the reader falls behind, the writer finds no free buffer and the cloud
+ * is dropped, which the driver should prefer to stalling its thread.
+ *
+ */
+class PointRing {
+   public:
+    /**
+     * @brief Allocates the buffers.
+     *
+     * @param buffers The number of buffers.
+     * @param max_points The maximum number of points of each buffer.
+     * @throws `std::invalid_argument` if either number is zero.
+     */
+    PointRing(size_t buffers, size_t max_points) : buffers_(buffers) {
+        if (buffers == 0 || max_points == 0) {
+            throw std::invalid_argument("invalid size of point ring");
+        }
+        for (auto& buffer : buffers_) {
+            buffer.x.resize(max_points);
+            buffer.y.resize(max_points);
+            buffer.z.resize(max_points);
+        }
+    }
+
+    PointRing(const PointRing&) = delete;
+    PointRing& operator=(const PointRing&) = delete;
+
+    /**
+     * @brief Claims the next free buffer for writing, which must be published
+     * before another one is claimed.
+     *
+     * @return The buffer, or `nullptr` if every buffer is published and not yet
+     * given back by the reader, in which case the cloud is counted as dropped.
+     * @note This must only be called by the writer.
+     */
+    PointBuffer* beginWrite() noexcept {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == buffers_.size()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &buffers_[tail % buffers_.size()];
+    }
+
+    /**
+     * @brief Publishes the buffer claimed by `beginWrite` to the reader.
+     *
+     * @note This must only be called by the writer.
+     */
+    void endWrite() noexcept {
+        tail_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Borrows the oldest published buffer for reading, which must be
+     * given back before another one is borrowed.
+     *
+     * @return The buffer, or `nullptr` if no buffer is published.
+     * @note This must only be called by the reader.
+     */
+    const PointBuffer* beginRead() const noexcept {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &buffers_[head % buffers_.size()];
+    }
+
+    /**
+     * @brief Gives the buffer borrowed by `beginRead` back to the writer.
+     *
+     * @note This must only be called by the reader.
+     */
+    void endRead() noexcept { head_.fetch_add(1, std::memory_order_release); }
+
+    /**
+     * @brief Gets the number of published buffers not yet given back.
+     *
+     * @return The number of buffers, which may be stale when it is returned.
+     */
+    inline size_t size() const noexcept {
+        // The head is loaded first, so that it is never ahead of the tail
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    /**
+     * @brief Gets the number of buffers.
+     *
+     * @return The number of buffers.
+     */
+    inline size_t capacity() const noexcept { return buffers_.size(); }
+
+    /**
+     * @brief Gets the number of clouds dropped because the ring was full.
+     *
+     * @return The number of dropped clouds.
+     */
+    inline size_t dropped() const noexcept {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    // The indices only grow, and are kept on their own cache lines so that
+    // the writer and the reader do not invalidate each other
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<PointBuffer> buffers_;
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    alignas(kCacheLine) std::atomic<size_t> dropped_{0};
+};
+
+}  // namespace radar::locate
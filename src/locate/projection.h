@@ -0,0 +1,72 @@
+/**
+ * @file projection.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file declares the CUDA kernels of the `Locator`, which project
+ * point clouds onto depth images and difference them with the background on
+ * the GPU.
+ * @date 2024-05-08
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <cuda_runtime.h>
+
+namespace radar::locate {
+
+/**
+ * @brief The bits of pixels of a depth image without any point, which is a
+ * float larger than any depth so that the nearest point of a pixel wins.
+ *
+ * Every byte of it is `kEmptyByte`, so that depth images can be cleared by
+ * `cudaMemset`.
+ */
+constexpr unsigned char kEmptyByte = 0x7f;
+constexpr unsigned int kEmptyBits = 0x7f7f7f7fu;
+
+/**
+ * @brief Parameters of projecting lidar points onto the zoomed depth image,
+ * which are passed to the projecting kernel by value.
+ *
+ */
+struct ProjectParam {
+    // The row-major 3x4 matrix from lidar coordinate to homogeneous pixel
+    // coordinate, which is the intrinsic matrix times the extrinsic matrix.
+    float matrix[12];
+    float zoom_factor;
+    float max_distance;
+    int width;
+    int height;
+};
+
+__global__ void projectKernel(const float4* points, int num_points,
+                              ProjectParam param, float* depth,
+                              float* background);
+
+__global__ void projectSoaKernel(const float* xs, const float* ys,
+                                 const float* zs, int num_points,
+                                 ProjectParam param, float* depth,
+                                 float* background);
+
+__global__ void diffKernel(const float* depths, const float* background,
+                           float* diff, int pixels, int count, int newest,
+                           int queue_size, float min_depth_diff,
+                           float max_depth_diff);
+
+void projectPoints(const float4* points, int num_points,
+                   const ProjectParam& param, float* depth, float* background,
+                   cudaStream_t stream);
+
+void projectPoints(const float* xs, const float* ys, const float* zs,
+                   int num_points, const ProjectParam& param, float* depth,
+                   float* background, cudaStream_t stream);
+
+void diffDepths(const float* depths, const float* background, float* diff,
+                int pixels, int count, int newest, int queue_size,
+                float min_depth_diff, float max_depth_diff,
+                cudaStream_t stream);
+
+}  // namespace radar::locate
@@ -11,8 +11,10 @@
 
 #include "robot.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
-#include <map>
+#include <numeric>
 
 #include "track/track.h"
 
@@ -26,7 +28,7 @@ namespace radar {
  * @param car The detected car information.
  * @param armors Vector of detected armor infomation.
  */
-Robot::Robot(const Detection& car, const std::vector<Detection>& armors) {
+Robot::Robot(const Detection& car, std::span<const Detection> armors) {
     setDetection(car, armors);
 }
 
@@ -37,90 +39,59 @@ Robot::Robot(const Detection& car, const std::vector<Detection>& armors) {
  *
  * @param car The detected car information.
  * @param armors Vector of detected armor infomation.
+ * @note Armors whose labels are out of `[0, kClassNum)` are ignored, and only
+ * the first `kMaxArmors` armors are kept.
  */
 void Robot::setDetection(const Detection& car,
-                         const std::vector<Detection>& armors) noexcept {
+                         std::span<const Detection> armors) noexcept {
     // Sets the bbox of car
     rect_ = cv::Rect2f(car.x, car.y, car.width, car.height);
 
-    // If the armors are empty, sets empty label, confidence and return
-    if (armors.empty()) {
+    // Sums the scores and counts the armors of each label
+    Feature scores = Feature::Zero();
+    std::array<int, kClassNum> counts{};
+    for (const auto& armor : armors) {
+        const int label = static_cast<int>(armor.label);
+        if (label < 0 || label >= kClassNum) {
+            continue;
+        }
+        scores(label) += armor.confidence;
+        ++counts[label];
+    }
+
+    // If no armor is valid, sets empty label, confidence and return
+    const int total = std::accumulate(counts.begin(), counts.end(), 0);
+    if (total == 0) {
         return;
     }
 
     // Calculates the highest score and its label, calculating the confidence of
     // the robot
-    std::map<int, float> score_map;
-    for (const auto& armor : armors) {
-        score_map[armor.label] += armor.confidence;
-    }
-    auto [label, confidence] = *std::ranges::max_element(
-        score_map, [&score_map](auto&& pair_a, auto&& pair_b) {
-            return pair_a.second < pair_b.second;
-        });
-    confidence /= std::count_if(
-        armors.begin(), armors.end(),
-        [&](const Detection& armor) { return armor.label == label; });
+    int label;
+    scores.maxCoeff(&label);
     label_ = label;
-    confidence_ = confidence;
+    confidence_ = scores(label) / counts[label];
+
+    // Normalizes the scores as the feature
+    const float sum = scores.sum();
+    feature_ = iszero(sum) ? scores : Feature(scores / sum);
 
     // Sets the armor bboxes, adjusting their positions based on the position of
     // the car
-    armors_ = armors;
-    for (auto& armor : armors_.value()) {
-        armor.x += car.x;
-        armor.y += car.y;
-    }
-}
-
-/**
- * @brief Sets the track state and the filtered location of the robot.
- *
- * @param track The track of the robot.
- */
-void Robot::setTrack(const Track& track) noexcept {
-    track_state_ = track.state();
-    if (track.isConfirmed()) {
-        label_ = track.label();
-        location_ = track.location();
-    } else {  // track is tentative
-        if (!label_.has_value()) {
-            label_ = track.label();
-        }
-        if (!location_.has_value()) {
-            location_ = track.location();
+    armors_.emplace();
+    for (const auto& armor : armors) {
+        const int armor_label = static_cast<int>(armor.label);
+        if (armor_label < 0 || armor_label >= kClassNum ||
+            armors_->size() == Armors::capacity()) {
+            continue;
         }
+        Detection adjusted{armor};
+        adjusted.x += car.x;
+        adjusted.y += car.y;
+        armors_->push_back(adjusted);
     }
 }
 
-/**
- * @brief Gets the feature of the robot, which is a vector containing
- * confidence of each class.
- *
- * @return The feature vector.
- */
-Eigen::VectorXf Robot::feature(int class_num) const noexcept {
-    // Returns average if it is not detected
-    Eigen::VectorXf feature(class_num);
-    feature.setZero();
-    if (!isDetected()) {
-        return feature;
-    }
-
-    // Iterates through all armors and sets the feature vector based on the
-    // label and confidence of each armor
-    for (const auto& armor : armors_.value()) {
-        feature(static_cast<int>(armor.label)) += armor.confidence;
-    }
-
-    // Normalize the vector
-    float sum = feature.sum();
-    if (iszero(sum)) {  // avoid division by zero
-        return feature;
-    }
-    return feature / sum;
-}
-
 std::ostream& operator<<(std::ostream& os, const Robot& robot) {
     os << "Robot: { ";
     os << "Label: "
@@ -15,11 +15,12 @@
 #include <opencv2/opencv.hpp>
 #include <optional>
 #include <ostream>
+#include <span>
 #include <utility>
-#include <vector>
 
 #include "detect/detection.h"
 #include "track/track.h"
+#include "utils/inline_vector.h"
 
 namespace radar {
 
@@ -48,11 +49,19 @@ enum Label {
  * @brief Class representing a robot.
  *
  * The Robot class encapsulates information about a robot, including its
- * detections, tracking state, location, and other attributes.
+ * detections, tracking state, location, and other attributes. The armors and
+ * the feature are stored inline, so constructing and copying a robot does not
+ * allocate.
  */
 class Robot {
    public:
-    Robot(const Detection& car, const std::vector<Detection>& armors);
+    static constexpr int kClassNum = 12;
+    static constexpr int kMaxArmors = 8;
+
+    using Feature = Eigen::Matrix<float, kClassNum, 1>;
+    using Armors = InlineVector<Detection, kMaxArmors>;
+
+    Robot(const Detection& car, std::span<const Detection> armors);
 
     Robot() = default;
 
@@ -81,9 +90,28 @@ class Robot {
     inline bool isTracked() const noexcept { return track_state_.has_value(); }
 
     void setDetection(const Detection& car,
-                      const std::vector<Detection>& armors) noexcept;
+                      std::span<const Detection> armors) noexcept;
 
-    void setTrack(const Track& track) noexcept;
+    /**
+     * @brief Sets the track state and the filtered location of the robot.
+     *
+     * @param track The track of the robot.
+     */
+    template <int ClassNum>
+    void setTrack(const BasicTrack<ClassNum>& track) noexcept {
+        track_state_ = track.state();
+        if (track.isConfirmed()) {
+            label_ = track.label();
+            location_ = track.location();
+        } else {  // track is tentative
+            if (!label_.has_value()) {
+                label_ = track.label();
+            }
+            if (!location_.has_value()) {
+                location_ = track.location();
+            }
+        }
+    }
 
     /**
      * @brief Sets the location of the robot.
@@ -100,7 +128,9 @@ class Robot {
      *
      * @return The `std::optional` value of the label.
      */
-    inline std::optional<int> label() const noexcept { return label_; }
+    inline const std::optional<int>& label() const noexcept {
+        return label_;
+    }
 
     /**
      * @brief Gets the detection bbox of the robot. If the robot has not been
@@ -116,7 +146,7 @@ class Robot {
      *
      * @return The `std::optional` value of the detection confidence.
      */
-    inline std::optional<float> confidence() const noexcept {
+    inline const std::optional<float>& confidence() const noexcept {
         return confidence_;
     }
 
@@ -126,7 +156,7 @@ class Robot {
      *
      * @return The `std::optional` value of the armor detections.
      */
-    inline std::optional<std::vector<Detection>> armors() const noexcept {
+    inline const std::optional<Armors>& armors() const noexcept {
         return armors_;
     }
 
@@ -136,7 +166,7 @@ class Robot {
      *
      * @return The `std::optional` value of the track state.
      */
-    inline std::optional<TrackState> track_state() const noexcept {
+    inline const std::optional<TrackState>& track_state() const noexcept {
         return track_state_;
     }
 
@@ -146,21 +176,29 @@ class Robot {
      *
      * @return The `std::optional` value of the location.
      */
-    inline std::optional<cv::Point3f> location() const noexcept {
+    inline const std::optional<cv::Point3f>& location() const noexcept {
         return location_;
     }
 
-    Eigen::VectorXf feature(int class_num) const noexcept;
+    /**
+     * @brief Gets the feature of the robot, which is a vector containing the
+     * normalized confidence of each class. It is computed when the detection
+     * is set, and is zero if the robot has not been detected.
+     *
+     * @return The feature vector.
+     */
+    inline const Feature& feature() const noexcept { return feature_; }
 
     friend std::ostream& operator<<(std::ostream& os, const Robot& robot);
 
    private:
-    std::optional<std::vector<Detection>> armors_ = std::nullopt;
+    std::optional<Armors> armors_ = std::nullopt;
     std::optional<TrackState> track_state_ = std::nullopt;
     std::optional<cv::Point3f> location_ = std::nullopt;
     std::optional<cv::Rect2f> rect_ = std::nullopt;
     std::optional<int> label_ = std::nullopt;
     std::optional<float> confidence_ = std::nullopt;
+    Feature feature_ = Feature::Zero();
 };
 
 }  // namespace radar
\ No newline at end of file
@@ -13,7 +13,10 @@
 
 #include <Eigen/Dense>
 #include <algorithm>
+#include <cassert>
 #include <limits>
+#include <numeric>
+#include <span>
 #include <vector>
 
 namespace radar::track {
@@ -46,7 +49,7 @@ constexpr int kNotMatched = -1;
  * for the assignment problem[J]. Annals of Operations Research, 1988,
  * 14(1):105-123.
  */
-std::vector<int> auction(Eigen::MatrixXf value_matrix, int max_iter) {
+inline std::vector<int> auction(Eigen::MatrixXf value_matrix, int max_iter) {
     int num_agents = value_matrix.rows();
     int num_tasks = value_matrix.cols();
     int num_tasks_real = num_tasks;
@@ -126,4 +129,263 @@ std::vector<int> auction(Eigen::MatrixXf value_matrix, int max_iter) {
     return assignment;
 }
 
-}  // namespace radar::track
\ No newline at end of file
+/**
+ * @brief A sparse value matrix stored in compressed rows, which only contains
+ * the pairs of agents and tasks that are possible to be assigned.
+ *
+ */
+class SparseValueMatrix {
+   public:
+    /**
+     * @brief Clears the matrix, keeping the capacity of its buffers.
+     *
+     * @param cols The number of tasks.
+     */
+    void reset(int cols) {
+        cols_ = cols;
+        offsets_.assign(1, 0);
+        tasks_.clear();
+        values_.clear();
+    }
+
+    /**
+     * @brief Starts a new row of an agent, to which the values are added.
+     *
+     */
+    inline void addRow() { offsets_.emplace_back(offsets_.back()); }
+
+    /**
+     * @brief Adds the value of a task to the last row.
+     *
+     * @param task The index of the task.
+     * @param value The value of the task to the agent.
+     */
+    inline void add(int task, float value) {
+        assert(rows() > 0 && task < cols_);
+        tasks_.emplace_back(task);
+        values_.emplace_back(value);
+        ++offsets_.back();
+    }
+
+    /**
+     * @brief Gets the number of agents.
+     *
+     * @return The number of rows.
+     */
+    inline int rows() const noexcept {
+        return static_cast<int>(offsets_.size()) - 1;
+    }
+
+    /**
+     * @brief Gets the number of tasks.
+     *
+     * @return The number of columns.
+     */
+    inline int cols() const noexcept { return cols_; }
+
+    /**
+     * @brief Gets the tasks possible to be assigned to an agent.
+     *
+     * @param row The index of the agent.
+     * @return The indices of the tasks.
+     */
+    inline std::span<const int> tasks(int row) const noexcept {
+        return std::span(tasks_).subspan(offsets_[row],
+                                         offsets_[row + 1] - offsets_[row]);
+    }
+
+    /**
+     * @brief Gets the values of the tasks possible to be assigned to an agent.
+     *
+     * @param row The index of the agent.
+     * @return The values of the tasks, in the same order as `tasks`.
+     */
+    inline std::span<const float> values(int row) const noexcept {
+        return std::span(values_).subspan(offsets_[row],
+                                          offsets_[row + 1] - offsets_[row]);
+    }
+
+   private:
+    int cols_{0};
+    std::vector<int> offsets_{0};
+    std::vector<int> tasks_;
+    std::vector<float> values_;
+};
+
+/**
+ * @brief A solver of the auction algorithm on sparse value matrices, whose
+ * prices are kept by the caller and reused as the initial prices of the next
+ * problem.
+ *
+ * Every agent may also stay unassigned with a value of zero, so agents are
+ * never forced to tasks they can not be assigned to. Each bid raises the price
+ * of the best task by the margin over the second best one plus `epsilon`,
+ * which makes the assignment optimal within `epsilon` per agent. When the
+ * problems of consecutive frames are similar, prices from the last frame are
+ * already close to the final ones, and only a few bids are needed.
+ *
+ * @ref Bertsekas D P . The auction algorithm: A distributed relaxation method
+ * for the assignment problem[J]. Annals of Operations Research, 1988,
+ * 14(1):105-123.
+ */
+class AuctionSolver {
+   public:
+    /**
+     * @brief Constructor of the solver.
+     *
+     * @param max_iter The maximum number of rounds of bidding.
+     * @param epsilon The minimum increment of prices.
+     */
+    explicit AuctionSolver(int max_iter = 100, float epsilon = 1e-3f)
+        : max_iter_{max_iter}, epsilon_{epsilon} {}
+
+    /**
+     * @brief Assigns tasks to agents maximizing the overall value.
+     *
+     * @param value_matrix The values of possible pairs of agents and tasks.
+     * @param prices The prices of tasks, which are the initial prices as input
+     * and the final prices as output. Tasks left unassigned get zero prices.
+     * @return A vector where element i is the task assigned to agent i, or
+     * `kNotMatched` if agent i is unassigned.
+     */
+    std::vector<int> solve(const SparseValueMatrix& value_matrix,
+                           std::span<float> prices) {
+        assert(static_cast<int>(prices.size()) == value_matrix.cols());
+        iterations_ = 0;
+        // Agents bidding last time keep a profit of at least `-epsilon`, so
+        // prices are lowered a little for them to prefer their tasks again
+        for (float& price : prices) {
+            price = std::max(price - 2 * epsilon_, 0.0f);
+        }
+        run(value_matrix, prices);
+
+        //! The unassigned tasks must have the lowest prices for the assignment
+        //! to be optimal, which may be broken by the initial prices. In that
+        //! case the problem is solved again from zero prices.
+        if (!isUnassignedPriceValid(value_matrix, prices)) {
+            std::fill(prices.begin(), prices.end(), 0.0f);
+            run(value_matrix, prices);
+        }
+        for (size_t task = 0; task < owners_.size(); ++task) {
+            if (owners_[task] == kNotMatched) {
+                prices[task] = 0.0f;
+            }
+        }
+        return assignment_;
+    }
+
+    /**
+     * @brief Gets the number of rounds of the last problem, including those
+     * of solving it again from zero prices.
+     *
+     * @return The number of rounds.
+     */
+    inline int iterations() const noexcept { return iterations_; }
+
+   private:
+    /**
+     * @brief Lets an agent bid for the best task, evicting its owner.
+     *
+     * @param value_matrix The values of possible pairs.
+     * @param prices The prices of tasks.
+     * @param agent The index of the agent.
+     */
+    void bid(const SparseValueMatrix& value_matrix, std::span<float> prices,
+             int agent) {
+        auto tasks = value_matrix.tasks(agent);
+        auto values = value_matrix.values(agent);
+        // Staying unassigned is the initial best with a profit of zero
+        int best_task = kNotMatched;
+        float best_profit = 0.0f;
+        float second_profit = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            const float profit = values[i] - prices[tasks[i]];
+            if (profit > best_profit) {
+                second_profit = best_profit;
+                best_profit = profit;
+                best_task = tasks[i];
+            } else if (profit > second_profit) {
+                second_profit = profit;
+            }
+        }
+        if (best_task == kNotMatched) {
+            assignment_[agent] = kNotMatched;
+            return;
+        }
+
+        prices[best_task] += best_profit - second_profit + epsilon_;
+        if (int owner = owners_[best_task]; owner != kNotMatched) {
+            assignment_[owner] = kNotMatched;
+            next_queue_.emplace_back(owner);
+        }
+        owners_[best_task] = agent;
+        assignment_[agent] = best_task;
+    }
+
+    /**
+     * @brief Runs the rounds of bidding until every agent is assigned or stays
+     * unassigned, or the maximum number of rounds is reached.
+     *
+     * Every run has its own budget of `max_iter_` rounds, so solving again
+     * from zero prices is never starved by the warm-started run, and the
+     * rounds of both runs are added to `iterations_`.
+     *
+     * @param value_matrix The values of possible pairs.
+     * @param prices The prices of tasks.
+     */
+    void run(const SparseValueMatrix& value_matrix, std::span<float> prices) {
+        const int num_agents = value_matrix.rows();
+        assignment_.assign(num_agents, kNotMatched);
+        owners_.assign(value_matrix.cols(), kNotMatched);
+        queue_.resize(num_agents);
+        std::iota(queue_.begin(), queue_.end(), 0);
+        for (int rounds = 0; !queue_.empty() && rounds < max_iter_; ++rounds) {
+            next_queue_.clear();
+            for (int agent : queue_) {
+                bid(value_matrix, prices, agent);
+            }
+            std::swap(queue_, next_queue_);
+            ++iterations_;
+        }
+    }
+
+    /**
+     * @brief Checks whether no agent gains more than `epsilon` from an
+     * unassigned task at zero price.
+     *
+     * @param value_matrix The values of possible pairs.
+     * @param prices The prices of tasks.
+     * @return `true` if the prices of unassigned tasks are valid, otherwise
+     * `false`.
+     */
+    bool isUnassignedPriceValid(const SparseValueMatrix& value_matrix,
+                                std::span<const float> prices) const {
+        for (int agent = 0; agent < value_matrix.rows(); ++agent) {
+            auto tasks = value_matrix.tasks(agent);
+            auto values = value_matrix.values(agent);
+            float profit = 0.0f;
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                if (tasks[i] == assignment_[agent]) {
+                    profit = values[i] - prices[tasks[i]];
+                }
+            }
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                if (owners_[tasks[i]] == kNotMatched && prices[tasks[i]] > 0 &&
+                    values[i] > profit + epsilon_) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    int max_iter_;
+    float epsilon_;
+    int iterations_{0};
+    std::vector<int> assignment_;
+    std::vector<int> owners_;
+    std::vector<int> queue_;
+    std::vector<int> next_queue_;
+};
+
+}  // namespace radar::track
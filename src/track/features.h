@@ -14,33 +14,65 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 
 namespace radar::track {
 
 /**
- * @class Features
+ * @class BasicFeatures
  * @brief A class to store and manage a collection of feature vectors.
  *
  * This class uses the Eigen library to handle feature vectors efficiently.
  * It allows dynamic resizing and provides methods to add new feature
  * vectors, access them, and manage the collection's capacity and size.
+ *
+ * The collection is unbounded by default. With a window, it keeps only the
+ * latest feature vectors in a ring buffer of fixed capacity. Vectors can also
+ * be weighted by a decay factor per append, so older vectors count less. The
+ * weighted sum of the vectors is maintained as they are appended and evicted,
+ * so `label()` and `feature()` cost O(rows) regardless of the number of
+ * vectors.
+ *
+ * @tparam Rows The size of each feature vector known at compile time, with
+ * which the vectors are fixed-size and stored without allocation, or
+ * `Eigen::Dynamic` if it is given at runtime.
  */
-class Features {
+template <int Rows = Eigen::Dynamic>
+class BasicFeatures {
    public:
-    Features() = default;
+    using Vector = Eigen::Matrix<float, Rows, 1>;
+    using Matrix = Eigen::Matrix<float, Rows, Eigen::Dynamic>;
+
+    BasicFeatures() = default;
 
     /**
      * @brief Parameterized constructor for creating a Features object with a
      * specified size and capacity.
      * @param feature_size The size of each feature vector.
      * @param capacity Initial capacity of the feature collection (default is
-     * 1).
+     * 1), which is ignored if the window is set.
+     * @param window The maximum number of latest feature vectors kept, or 0 to
+     * keep all of them.
+     * @param decay The factor by which the weights of stored vectors are
+     * multiplied on each append, in (0, 1].
+     * @throw std::invalid_argument if the window is negative, the decay is
+     * out of range, or the size differs from the fixed size.
      */
-    Features(int feature_size, int capacity = 1)
-        : features_(feature_size, capacity), capacity_(capacity), size_(0) {
-        features_.setZero();
+    BasicFeatures(int feature_size, int capacity = 1, int window = 0,
+                  float decay = 1.0f)
+        : capacity_(window > 0 ? window : capacity),
+          size_(0),
+          window_(window),
+          decay_(decay) {
+        if (Rows != Eigen::Dynamic && feature_size != Rows) {
+            throw std::invalid_argument("size of feature is not the same");
+        }
+        checkParams();
+        features_.setZero(feature_size, capacity_);
+        sum_.setZero(feature_size);
+        feature_.setZero(feature_size);
     }
 
     /**
@@ -48,88 +80,123 @@ class Features {
      * vector.
      * @param feature The feature vector to initialize the collection with.
      * @param capacity Initial capacity of the feature collection (default is
-     * 1).
+     * 1), which is ignored if the window is set.
+     * @param window The maximum number of latest feature vectors kept, or 0 to
+     * keep all of them.
+     * @param decay The factor by which the weights of stored vectors are
+     * multiplied on each append, in (0, 1].
+     * @throw std::invalid_argument if the window is negative or the decay is
+     * out of range.
      */
-    Features(const Eigen::VectorXf& feature, int capacity = 1)
-        : features_(feature.size(), capacity), capacity_(capacity), size_(1) {
+    BasicFeatures(const Eigen::Ref<const Vector>& feature, int capacity = 1,
+                  int window = 0, float decay = 1.0f)
+        : features_(feature.size(), window > 0 ? window : capacity),
+          capacity_(window > 0 ? window : capacity),
+          size_(1),
+          window_(window),
+          decay_(decay),
+          sum_(feature) {
+        checkParams();
         features_.setZero();
         features_.col(0) = feature;
+        updateFeature();
     }
 
-    Features(const Features& other)
-        : features_(other.features_),
-          capacity_(other.capacity_),
-          size_(other.size_) {}
+    BasicFeatures(const BasicFeatures& other) = default;
 
-    Features(Features&& other) noexcept
+    BasicFeatures(BasicFeatures&& other) noexcept
         : features_(std::move(other.features_)),
           capacity_(other.capacity_),
-          size_(other.size_) {
+          size_(other.size_),
+          head_(other.head_),
+          window_(other.window_),
+          decay_(other.decay_),
+          sum_(std::move(other.sum_)),
+          feature_(std::move(other.feature_)) {
         other.capacity_ = 0;
         other.size_ = 0;
+        other.head_ = 0;
     }
 
-    Features& operator=(const Features& other) {
-        if (this != &other) {
-            features_ = other.features_;
-            capacity_ = other.capacity_;
-            size_ = other.size_;
-        }
-        return *this;
-    }
+    BasicFeatures& operator=(const BasicFeatures& other) = default;
 
-    Features& operator=(Features&& other) noexcept {
+    BasicFeatures& operator=(BasicFeatures&& other) noexcept {
         if (this != &other) {
             features_ = std::move(other.features_);
             capacity_ = other.capacity_;
             size_ = other.size_;
+            head_ = other.head_;
+            window_ = other.window_;
+            decay_ = other.decay_;
+            sum_ = std::move(other.sum_);
+            feature_ = std::move(other.feature_);
 
             other.capacity_ = 0;
             other.size_ = 0;
+            other.head_ = 0;
         }
         return *this;
     }
 
     /**
-     * @brief Add a new feature vector to the collection.
+     * @brief Add a new feature vector to the collection. If the window is
+     * full, the oldest vector is replaced.
      * @param feature The feature vector to add.
      * @throw std::runtime_error if the new feature's size does not match the
      * size of existing features.
      */
-    void push_back(const Eigen::VectorXf& feature) {
+    void push_back(const Eigen::Ref<const Vector>& feature) {
         if (feature.rows() != features_.rows()) {
             throw std::runtime_error("row of feature is not the same");
         }
 
+        if (window_ > 0 && size_ == window_) {
+            // The oldest vector has been decayed by `size_ - 1` appends
+            sum_ -= features_.col(head_) * std::pow(decay_, size_ - 1);
+            features_.col(head_) = feature;
+            head_ = (head_ + 1) % window_;
+            sum_ = sum_ * decay_ + feature;
+            if (head_ == 0) {
+                // Recomputes the sum once per round against rounding drift
+                recomputeSum();
+            }
+            updateFeature();
+            return;
+        }
+
         if (size_ >= capacity_) {
             capacity_ *= 2;
-            Eigen::MatrixXf new_features(features_.rows(), capacity_);
+            Matrix new_features(features_.rows(), capacity_);
             new_features.setZero();
             new_features.block(0, 0, features_.rows(), features_.cols()) =
                 features_;
             std::swap(features_, new_features);
         }
         features_.col(size_++) = feature;
+        sum_ = sum_ * decay_ + feature;
+        updateFeature();
     }
 
     /**
      * @brief Get a feature vector by index.
-     * @param index The index of the feature vector to retrieve.
+     * @param index The index of the feature vector to retrieve, where 0 is the
+     * oldest one.
      * @return The feature vector at the specified index.
      * @throw std::out_of_range if the index is out of range.
      */
-    inline Eigen::VectorXf get(int index) const {
+    inline Vector get(int index) const {
         if (index < 0 || index >= size_) {
             throw std::out_of_range("index out of range");
         }
-        return features_.col(index);
+        return features_.col(window_ > 0 ? (head_ + index) % window_ : index);
     }
 
     /**
      * @brief Get the entire collection of feature vectors as a matrix.
-     * @return A constant reference to the internal matrix of feature vectors.
+     * @return A constant reference to the internal matrix of feature vectors,
+     * whose columns are rotated in the ring buffer if the window is set.
      */
-    inline const Eigen::MatrixXf& get() const { return features_; }
+    inline const Matrix& get() const { return features_; }
 
     /**
      * @brief Get the number of feature vectors currently stored.
@@ -143,6 +210,12 @@ class Features {
      */
     inline int capacity() const noexcept { return capacity_; }
 
+    /**
+     * @brief Get the window of the collection.
+     * @return The maximum number of vectors kept, or 0 if unbounded.
+     */
+    inline int window() const noexcept { return window_; }
+
     /**
      * @brief Clears all the feature vectors from the collection.
      *
@@ -151,7 +224,10 @@ class Features {
      */
     inline void clear() noexcept {
         size_ = 0;
+        head_ = 0;
         features_.setZero();
+        sum_.setZero(features_.rows());
+        feature_.setZero(features_.rows());
     }
 
     /**
@@ -174,38 +250,77 @@ class Features {
      * vectors.
      */
     inline int label() const noexcept {
-        Eigen::VectorXf sum = features_.rowwise().sum();
         int label;
-        sum.maxCoeff(&label);
+        sum_.maxCoeff(&label);
         return label;
     }
 
     /**
-     * @brief Gets the normalized feature of the feature vectors.
+     * @brief Gets the normalized feature of the feature vectors, which is
+     * computed once on each append.
      *
      * @return The normalized feature of the feature vectors.
      */
-    inline Eigen::VectorXf feature() const noexcept {
-        float sum = features_.sum();
-        Eigen::VectorXf feature(features_.rows());
-        if (iszero(sum)) {  // avoid division by zero
-            feature.setZero();
-        } else {
-            feature = features_.rowwise().sum() / sum;
-        }
-        return feature;
-    }
+    inline const Vector& feature() const noexcept { return feature_; }
 
     friend std::ostream& operator<<(std::ostream& os,
-                                    const Features& features) {
+                                    const BasicFeatures& features) {
         os << features.features_.block(0, 0, features.rows(), features.cols());
         return os;
     }
 
    private:
-    Eigen::MatrixXf features_;
+    /**
+     * @brief Checks the window and the decay.
+     *
+     * @throw std::invalid_argument if the window is negative or the decay is
+     * out of range.
+     */
+    void checkParams() const {
+        if (window_ < 0) {
+            throw std::invalid_argument("window is negative");
+        }
+        if (!(decay_ > 0.0f && decay_ <= 1.0f)) {
+            throw std::invalid_argument("decay is out of range");
+        }
+    }
+
+    /**
+     * @brief Recomputes the weighted sum from the stored vectors, whose
+     * oldest one is at `head_`.
+     *
+     */
+    void recomputeSum() {
+        sum_.setZero();
+        for (int i = 0; i < size_; ++i) {
+            sum_ = sum_ * decay_ + features_.col((head_ + i) % capacity_);
+        }
+    }
+
+    /**
+     * @brief Updates the normalized feature from the weighted sum.
+     *
+     */
+    void updateFeature() {
+        float sum = sum_.sum();
+        if (iszero(sum)) {  // avoid division by zero
+            feature_.setZero(sum_.size());
+        } else {
+            feature_ = sum_ / sum;
+        }
+    }
+
+    Matrix features_;
     int capacity_ = 0;
     int size_ = 0;
+    // The index of the oldest vector in the ring buffer if the window is set.
+    int head_ = 0;
+    int window_ = 0;
+    float decay_ = 1.0f;
+    Vector sum_ = Vector::Zero(Rows == Eigen::Dynamic ? 0 : Rows);
+    Vector feature_ = Vector::Zero(Rows == Eigen::Dynamic ? 0 : Rows);
 };
 
-}  // namespace radar::track
\ No newline at end of file
+using Features = BasicFeatures<Eigen::Dynamic>;
+
+}  // namespace radar::track
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <array>
 #include <functional>
 #include <stdexcept>
 #include <tuple>
@@ -160,7 +161,9 @@ class KalmanFilter final : public Kalman<StateSize, MeasurementSize> {
  * @brief Implementation of an extended Kalman filter.
  *
  * This class implements an extended Kalman filter (EKF) for nonlinear state
- * estimation.
+ * estimation. The functions of the model are template parameters of `predict`
+ * and `update`, so functors are inlined rather than called through
+ * `std::function`, which is still accepted.
  *
  * @tparam StateSize The size of the state vector.
  * @tparam MeasurementSize The size of the measurement vector.
@@ -206,13 +209,17 @@ class ExtendedKalmanFilter final : public Kalman<StateSize, MeasurementSize> {
      * This method predicts the next state based on the current state, the
      * process noise function and the state transition function.
      *
+     * @tparam StateTransition The type of the state transition function, which
+     * is a functor or a `StateTransitionFunction`.
+     * @tparam ProcessNoise The type of the process noise function, which is a
+     * functor or a `ProcessNoiseFunction`.
      * @param state_transition_function The state transition function.
      * @param process_noise_function The process noise function
      * @param args Additional arguments for the state transition function.
      */
-    void predict(const StateTransitionFunction& state_transition_function,
-                 const ProcessNoiseFunction& process_noise_function,
-                 Args... args) {
+    template <typename StateTransition, typename ProcessNoise>
+    void predict(const StateTransition& state_transition_function,
+                 const ProcessNoise& process_noise_function, Args... args) {
         transition_matrix_ = std::apply(state_transition_function,
                                         std::make_tuple(this->state_, args...));
         process_noise_ =
@@ -229,11 +236,14 @@ class ExtendedKalmanFilter final : public Kalman<StateSize, MeasurementSize> {
      * This method updates the filter state based on a new measurement and the
      observation function.
      *
+     * @tparam Observation The type of the observation function, which is a
+     * functor or an `ObservationFunction`.
      * @param measurement The new measurement vector.
      * @param observation_function The observation function.
      */
+    template <typename Observation>
     void update(const Eigen::Matrix<float, MeasurementSize, 1>& measurement,
-                const ObservationFunction& observation_function) {
+                const Observation& observation_function) {
         std::tie(predicted_measurement_, observation_matrix_) =
             observation_function(this->state_);
         update(measurement);
@@ -295,4 +305,180 @@ class ExtendedKalmanFilter final : public Kalman<StateSize, MeasurementSize> {
     Eigen::Matrix<float, MeasurementSize, 1> predicted_measurement_;
 };
 
+/**
+ * @class BlockDiagonalKalmanFilter
+ * @brief Implementation of a Kalman filter whose model is block diagonal with
+ * identical blocks.
+ *
+ * The state is made up of `Blocks` independent sub-states, such as the axes of
+ * a motion model, which share the same transition, process noise and
+ * observation. Each block is filtered on its own, so the covariance is kept as
+ * `Blocks` small matrices instead of a full one, which reduces the operations
+ * of predicting and updating by about `Blocks` squared times.
+ *
+ * @tparam Blocks The number of blocks.
+ * @tparam BlockStateSize The size of the state vector of a block.
+ * @tparam BlockMeasurementSize The size of the measurement vector of a block.
+ */
+template <int Blocks, int BlockStateSize, int BlockMeasurementSize>
+class BlockDiagonalKalmanFilter {
+   public:
+    static constexpr int kStateSize = Blocks * BlockStateSize;
+    static constexpr int kMeasurementSize = Blocks * BlockMeasurementSize;
+
+    using BlockState = Eigen::Matrix<float, BlockStateSize, 1>;
+    using BlockCovariance =
+        Eigen::Matrix<float, BlockStateSize, BlockStateSize>;
+    using BlockMeasurement = Eigen::Matrix<float, BlockMeasurementSize, 1>;
+    using BlockObservation =
+        Eigen::Matrix<float, BlockMeasurementSize, BlockStateSize>;
+    using BlockObservationNoise =
+        Eigen::Matrix<float, BlockMeasurementSize, BlockMeasurementSize>;
+
+    /**
+     * @brief Constructor of the filter.
+     *
+     * @param initial_state The initial state vector, in which the states of
+     * blocks are consecutive.
+     * @param initial_covariance The initial state covariance matrix.
+     * @param observation_noise The observation noise covariance matrix.
+     * @note Only the diagonal blocks of the covariance matrices are used, as
+     * the blocks are independent.
+     */
+    BlockDiagonalKalmanFilter(
+        const Eigen::Matrix<float, kStateSize, 1>& initial_state,
+        const Eigen::Matrix<float, kStateSize, kStateSize>& initial_covariance,
+        const Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>&
+            observation_noise)
+        : states_(initial_state.reshaped(BlockStateSize, Blocks)) {
+        for (int i = 0; i < Blocks; ++i) {
+            covariances_[i] =
+                initial_covariance.template block<BlockStateSize,
+                                                  BlockStateSize>(
+                    i * BlockStateSize, i * BlockStateSize);
+            observation_noises_[i] =
+                observation_noise.template block<BlockMeasurementSize,
+                                                 BlockMeasurementSize>(
+                    i * BlockMeasurementSize, i * BlockMeasurementSize);
+        }
+    }
+
+    /**
+     * @brief Predicts the next state of the filter.
+     *
+     * @tparam StateTransition The type of the function returning the state
+     * transition matrix of a block.
+     * @tparam ProcessNoise The type of the function returning the process
+     * noise matrix of a block.
+     * @param state_transition_function The state transition function.
+     * @param process_noise_function The process noise function.
+     * @param args Arguments for the functions.
+     */
+    template <typename StateTransition, typename ProcessNoise,
+              typename... Args>
+    void predict(const StateTransition& state_transition_function,
+                 const ProcessNoise& process_noise_function, Args... args) {
+        const BlockCovariance transition = state_transition_function(args...);
+        const BlockCovariance process_noise = process_noise_function(args...);
+        states_ = transition * states_;
+        for (auto& covariance : covariances_) {
+            predictBlock(covariance, transition, process_noise);
+        }
+    }
+
+    /**
+     * @brief Updates the filter with a new measurement.
+     *
+     * @param measurement The new measurement vector, in which the measurements
+     * of blocks are consecutive.
+     * @param observation The observation matrix of a block.
+     */
+    void update(const Eigen::Matrix<float, kMeasurementSize, 1>& measurement,
+                const BlockObservation& observation) {
+        for (int i = 0; i < Blocks; ++i) {
+            updateBlock(states_.col(i), covariances_[i],
+                        measurement.template segment<BlockMeasurementSize>(
+                            i * BlockMeasurementSize),
+                        observation, observation_noises_[i]);
+        }
+    }
+
+    /**
+     * @brief Gets the state vector.
+     *
+     * @return The state vector.
+     */
+    inline Eigen::Matrix<float, kStateSize, 1> state() const noexcept {
+        return states_.reshaped();
+    }
+
+    /**
+     * @brief Gets the covariance matrix.
+     *
+     * @return The block diagonal covariance matrix.
+     */
+    Eigen::Matrix<float, kStateSize, kStateSize> covariance() const noexcept {
+        Eigen::Matrix<float, kStateSize, kStateSize> covariance =
+            Eigen::Matrix<float, kStateSize, kStateSize>::Zero();
+        for (int i = 0; i < Blocks; ++i) {
+            covariance.template block<BlockStateSize, BlockStateSize>(
+                i * BlockStateSize, i * BlockStateSize) = covariances_[i];
+        }
+        return covariance;
+    }
+
+    /**
+     * @brief Predicts the covariance of a block.
+     *
+     * @param covariance The covariance of the block.
+     * @param transition The state transition matrix.
+     * @param process_noise The process noise matrix.
+     */
+    static void predictBlock(Eigen::Ref<BlockCovariance> covariance,
+                             const BlockCovariance& transition,
+                             const BlockCovariance& process_noise) {
+        const BlockCovariance predicted_covariance =
+            transition * covariance * transition.transpose() + process_noise;
+        covariance = predicted_covariance;
+    }
+
+    /**
+     * @brief Updates the state and the covariance of a block with a
+     * measurement.
+     *
+     * @param state The state of the block.
+     * @param covariance The covariance of the block.
+     * @param measurement The measurement of the block.
+     * @param observation The observation matrix.
+     * @param observation_noise The observation noise matrix.
+     */
+    static void updateBlock(Eigen::Ref<BlockState> state,
+                            Eigen::Ref<BlockCovariance> covariance,
+                            const BlockMeasurement& measurement,
+                            const BlockObservation& observation,
+                            const BlockObservationNoise& observation_noise) {
+        const BlockMeasurement measurement_residual =
+            measurement - observation * state;
+        const BlockObservationNoise innovation_covariance =
+            observation * covariance * observation.transpose() +
+            observation_noise;
+        const Eigen::Matrix<float, BlockStateSize, BlockMeasurementSize>
+            kalman_gain = covariance * observation.transpose() *
+                          innovation_covariance.inverse();
+
+        state += kalman_gain * measurement_residual;
+        const BlockCovariance updated_covariance =
+            (BlockCovariance::Identity() - kalman_gain * observation) *
+            covariance;
+        covariance = updated_covariance;
+    }
+
+   private:
+    BlockDiagonalKalmanFilter() = delete;
+
+    Eigen::Matrix<float, BlockStateSize, Blocks> states_;
+    std::array<BlockCovariance, Blocks> covariances_;
+    std::array<BlockObservationNoise, Blocks> observation_noises_;
+};
+
 }  // namespace radar::track
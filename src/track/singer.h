@@ -19,6 +19,62 @@ namespace radar::track {
 
 constexpr int kStateSize = 9;
 constexpr int kMeasurementSize = 3;
+// The number of axes, each of which is a block of [p, v, a] with observation
+// [p].
+constexpr int kAxisNum = 3;
+constexpr int kAxisStateSize = kStateSize / kAxisNum;
+constexpr int kAxisMeasurementSize = kMeasurementSize / kAxisNum;
+
+using SingerAxisFilter =
+    BlockDiagonalKalmanFilter<kAxisNum, kAxisStateSize, kAxisMeasurementSize>;
+
+/**
+ * @brief The functor computing the state transition matrix of one axis of the
+ * Singer model.
+ *
+ */
+struct SingerTransition {
+    // Correlation time constant.
+    float tau;
+
+    SingerAxisFilter::BlockCovariance operator()(float dt) const {
+        SingerAxisFilter::BlockCovariance transition_matrix;
+        transition_matrix << 1, dt, dt * dt / 2, 0, 1, dt, 0, 0,
+            std::exp(-dt / tau);
+        return transition_matrix;
+    }
+};
+
+/**
+ * @brief The functor computing the process noise covariance matrix of one axis
+ * of the Singer model.
+ *
+ */
+struct SingerProcessNoise {
+    // Maximum expected acceleration of the target.
+    float max_a;
+    // Correlation time constant.
+    float tau;
+
+    SingerAxisFilter::BlockCovariance operator()(float dt) const {
+        const float decay = 1 - std::exp(-dt / tau);
+        SingerAxisFilter::BlockCovariance process_noise;
+        process_noise << std::pow(dt, 3) / 3, std::pow(dt, 2) / 2, dt / 2,
+            std::pow(dt, 2) / 2, dt, decay, dt / 2, decay,
+            (1 - std::exp(-2 * dt / tau)) / 2;
+        process_noise *= std::pow(max_a, 2);
+        return process_noise;
+    }
+};
+
+/**
+ * @brief Gets the observation matrix of one axis of the Singer model.
+ *
+ * @return The observation matrix.
+ */
+inline SingerAxisFilter::BlockObservation singerObservation() noexcept {
+    return SingerAxisFilter::BlockObservation::UnitX();
+}
 
 /**
  * @class SingerEKF
@@ -29,11 +85,13 @@ constexpr int kMeasurementSize = 3;
  * that target acceleration is a random process. In this model, state is defined
  * as [x, vx, ax, y, vy, ay, z, vz, az], and observation is defined as [x, y,
  * z].
+ *
+ * As the axes are independent and share the same model, the filter runs as
+ * three 3-state filters through `BlockDiagonalKalmanFilter`, whose result is
+ * the same as the full 9-state filter with a block diagonal covariance.
  */
 class SingerEKF {
    public:
-    using EKF = ExtendedKalmanFilter<kStateSize, kMeasurementSize, float>;
-
     /**
      * @brief Constructor to initialize the Extended Kalman Filter.
      *
@@ -42,6 +100,7 @@ class SingerEKF {
      * @param max_a Maximum expected acceleration of the target.
      * @param tau Correlation time constant.
      * @param observation_noise Observation noise covariance matrix.
+     * @note Correlations between axes in the covariance matrices are ignored.
      */
     SingerEKF(
         const Eigen::Matrix<float, kStateSize, 1>& initial_state,
@@ -49,9 +108,9 @@ class SingerEKF {
         float max_a, float tau,
         const Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>&
             observation_noise)
-        : ekf_(initial_state, initial_covariance, observation_noise),
-          max_a_(max_a),
-          tau_(tau) {}
+        : filter_(initial_state, initial_covariance, observation_noise),
+          state_transition_{tau},
+          process_noise_{max_a, tau} {}
 
     /**
      * @brief Predict the state of the filter forward by a time increment.
@@ -59,7 +118,7 @@ class SingerEKF {
      * @param dt Time increment for prediction step.
      */
     inline void predict(float dt) {
-        ekf_.predict(state_transition_, process_noise_, dt);
+        filter_.predict(state_transition_, process_noise_, dt);
     }
 
     /**
@@ -69,7 +128,7 @@ class SingerEKF {
      */
     inline void update(
         const Eigen::Matrix<float, kMeasurementSize, 1>& measurement) {
-        ekf_.update(measurement, observation_);
+        filter_.update(measurement, singerObservation());
     }
 
     /**
@@ -77,58 +136,21 @@ class SingerEKF {
      *
      * @return The state of the filter.
      */
-    inline auto state() const { return ekf_.state(); }
+    inline auto state() const { return filter_.state(); }
+
+    /**
+     * @brief Get the covariance of the filter.
+     *
+     * @return The block diagonal covariance of the filter.
+     */
+    inline auto covariance() const { return filter_.covariance(); }
 
    private:
     SingerEKF() = delete;
 
-    EKF ekf_;
-    float max_a_;
-    float tau_;
-    EKF::StateTransitionFunction state_transition_ =
-        [this](
-            [[maybe_unused]] const Eigen::Matrix<float, kStateSize, 1>& state,
-            float dt) {
-            Eigen::Matrix<float, kStateSize, kStateSize> transition_matrix =
-                Eigen::Matrix<float, kStateSize, kStateSize>::Identity();
-            for (int i = 0; i < 3; ++i) {
-                transition_matrix(i * 3, i * 3 + 1) = dt;
-                transition_matrix(i * 3, i * 3 + 2) = dt * dt / 2;
-                transition_matrix(i * 3 + 1, i * 3 + 2) = dt;
-                transition_matrix(i * 3 + 2, i * 3 + 2) = std::exp(-dt / tau_);
-            }
-            return transition_matrix;
-        };
-    EKF::ProcessNoiseFunction process_noise_ = [this](float dt) {
-        Eigen::Matrix<float, kStateSize, kStateSize> process_noise =
-            Eigen::Matrix<float, kStateSize, kStateSize>::Zero();
-        for (int i = 0; i < 3; i++) {
-            process_noise(3 * i, 3 * i) = std::pow(dt, 3) / 3;
-            process_noise(3 * i + 1, 3 * i) = std::pow(dt, 2) / 2;
-            process_noise(3 * i + 2, 3 * i) = dt / 2;
-            process_noise(3 * i, 3 * i + 1) = std::pow(dt, 2) / 2;
-            process_noise(3 * i + 1, 3 * i + 1) = dt;
-            process_noise(3 * i + 2, 3 * i + 1) = 1 - std::exp(-dt / tau_);
-            process_noise(3 * i, 3 * i + 2) = dt / 2;
-            process_noise(3 * i + 1, 3 * i + 2) = 1 - std::exp(-dt / tau_);
-            process_noise(3 * i + 2, 3 * i + 2) =
-                (1 - std::exp(-2 * dt / tau_)) / 2;
-        }
-        process_noise *= std::pow(max_a_, 2);
-        return process_noise;
-    };
-    EKF::ObservationFunction observation_ =
-        [](const Eigen::Matrix<float, kStateSize, 1>& state) {
-            Eigen::Matrix<float, kMeasurementSize, 1> measurement;
-            Eigen::Matrix<float, kMeasurementSize, kStateSize>
-                measurement_jacobian =
-                    Eigen::Matrix<float, kMeasurementSize, kStateSize>::Zero();
-            for (int i = 0; i < kMeasurementSize; ++i) {
-                measurement(i) = state[i * 3];
-                measurement_jacobian(i, i * 3) = 1;
-            }
-            return std::make_pair(measurement, measurement_jacobian);
-        };
+    SingerAxisFilter filter_;
+    SingerTransition state_transition_;
+    SingerProcessNoise process_noise_;
 };
 
-}  // namespace radar::track
\ No newline at end of file
+}  // namespace radar::track
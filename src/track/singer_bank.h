@@ -0,0 +1,288 @@
+/**
+ * @file singer_bank.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief A file implementing a bank of Singer Extended Kalman Filters stored
+ * contiguously, which predicts all of them in one pass.
+ * @date 2024-05-12
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+#include "singer.h"
+#include "utils/thread_pool.h"
+
+namespace radar::track {
+
+/**
+ * @class SingerEKFBank
+ * @brief A bank of Extended Kalman Filters for the Singer model sharing the
+ * same parameters.
+ *
+ * The axis states of all filters are stored as the columns of one matrix, and
+ * their 3x3 axis covariances as consecutive blocks of another, so filters are
+ * referred to by their indices instead of being allocated one by one. As the
+ * state transition and the process noise only depend on the time increment,
+ * they are computed once for every prediction, which propagates all states
+ * with one matrix product and all covariances in one pass over the blocks. The
+ * results are the same as those of `SingerEKF`.
+ */
+class SingerEKFBank {
+   public:
+    // The minimum number of filters predicted by one task of a thread pool.
+    static constexpr int kParallelGrain = 64;
+
+    using State = Eigen::Matrix<float, kStateSize, 1>;
+    using Covariance = Eigen::Matrix<float, kStateSize, kStateSize>;
+    using Measurement = Eigen::Matrix<float, kMeasurementSize, 1>;
+    using ObservationNoise =
+        Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>;
+
+    /**
+     * @brief Constructor of the bank without filters.
+     *
+     * @param max_a Maximum expected acceleration of the target.
+     * @param tau Correlation time constant.
+     * @param observation_noise Observation noise covariance matrix, whose
+     * correlations between axes are ignored.
+     */
+    SingerEKFBank(float max_a, float tau,
+                  const ObservationNoise& observation_noise)
+        : state_transition_{tau}, process_noise_{max_a, tau} {
+        for (int i = 0; i < kAxisNum; ++i) {
+            observation_noises_[i] =
+                observation_noise.block<kAxisMeasurementSize,
+                                        kAxisMeasurementSize>(
+                    i * kAxisMeasurementSize, i * kAxisMeasurementSize);
+        }
+    }
+
+    /**
+     * @brief Adds a filter at the end of the bank.
+     *
+     * @param initial_state Initial state vector.
+     * @param initial_covariance Initial covariance matrix, whose correlations
+     * between axes are ignored.
+     * @return The index of the filter.
+     */
+    int add(const State& initial_state, const Covariance& initial_covariance) {
+        if (size_ * kAxisNum == states_.cols()) {
+            const int capacity = std::max(2 * size_, 8);
+            states_.conservativeResize(Eigen::NoChange, capacity * kAxisNum);
+            covariances_.conservativeResize(Eigen::NoChange,
+                                            capacity * kStateSize);
+        }
+        states_.middleCols<kAxisNum>(size_ * kAxisNum) =
+            initial_state.reshaped(kAxisStateSize, kAxisNum);
+        for (int i = 0; i < kAxisNum; ++i) {
+            covarianceBlock(size_, i) =
+                initial_covariance.block<kAxisStateSize, kAxisStateSize>(
+                    i * kAxisStateSize, i * kAxisStateSize);
+        }
+        return size_++;
+    }
+
+    /**
+     * @brief Moves a filter to another index, overwriting the filter there.
+     *
+     * @param from The index of the filter moved.
+     * @param to The index the filter is moved to.
+     */
+    void move(int from, int to) noexcept {
+        assert(from < size_ && to < size_);
+        if (from == to) {
+            return;
+        }
+        states_.middleCols<kAxisNum>(to * kAxisNum) =
+            states_.middleCols<kAxisNum>(from * kAxisNum);
+        covariances_.middleCols<kStateSize>(to * kStateSize) =
+            covariances_.middleCols<kStateSize>(from * kStateSize);
+    }
+
+    /**
+     * @brief Keeps the first filters of the bank and removes the others.
+     *
+     * @param size The number of filters kept.
+     */
+    void resize(int size) noexcept {
+        assert(size <= size_);
+        size_ = size;
+    }
+
+    /**
+     * @brief Gets the number of filters.
+     *
+     * @return The number of filters.
+     */
+    inline int size() const noexcept { return size_; }
+
+    /**
+     * @brief Predicts the states of all filters forward by a time increment.
+     *
+     * @param dt Time increment for prediction step.
+     * @param pool The thread pool over which the filters are predicted in
+     * chunks of at least `kParallelGrain` filters, or `nullptr` to predict them
+     * on the calling thread.
+     */
+    void predict(float dt, ThreadPool* pool = nullptr) {
+        if (size_ == 0) {
+            return;
+        }
+        const SingerAxisFilter::BlockCovariance transition =
+            state_transition_(dt);
+        const SingerAxisFilter::BlockCovariance process_noise =
+            process_noise_(dt);
+
+        products_.resize(Eigen::NoChange, size_ * kStateSize);
+        auto predict_range = [&](int begin, int end) {
+            const int axis_begin = begin * kAxisNum;
+            const int axes = (end - begin) * kAxisNum;
+            states_.middleCols(axis_begin, axes) =
+                transition * states_.middleCols(axis_begin, axes);
+
+            // F * P of all axes as one product, then (F * P) * F^T + Q for each
+            products_.middleCols(axis_begin * kAxisStateSize,
+                                 axes * kAxisStateSize)
+                .noalias() = transition *
+                             covariances_.middleCols(
+                                 axis_begin * kAxisStateSize,
+                                 axes * kAxisStateSize);
+            for (int i = axis_begin; i < axis_begin + axes; ++i) {
+                auto covariance =
+                    covariances_.middleCols<kAxisStateSize>(i * kAxisStateSize);
+                covariance.noalias() =
+                    products_.middleCols<kAxisStateSize>(i * kAxisStateSize) *
+                    transition.transpose();
+                covariance += process_noise;
+            }
+        };
+        if (pool == nullptr) {
+            predict_range(0, size_);
+        } else {
+            pool->parallelFor(0, size_, kParallelGrain, predict_range);
+        }
+    }
+
+    /**
+     * @brief Updates the state of a filter with a new measurement.
+     *
+     * @param index The index of the filter.
+     * @param measurement New measurement vector.
+     */
+    void update(int index, const Measurement& measurement) {
+        assert(index < size_);
+        for (int i = 0; i < kAxisNum; ++i) {
+            SingerAxisFilter::updateBlock(
+                states_.col(index * kAxisNum + i), covarianceBlock(index, i),
+                measurement.segment<kAxisMeasurementSize>(
+                    i * kAxisMeasurementSize),
+                singerObservation(), observation_noises_[i]);
+        }
+    }
+
+    /**
+     * @brief Computes the squared Mahalanobis distance between a measurement
+     * and the predicted measurement of a filter under the innovation
+     * covariance.
+     *
+     * @param index The index of the filter.
+     * @param measurement The measurement vector.
+     * @return The squared Mahalanobis distance.
+     */
+    float squaredMahalanobis(int index,
+                             const Measurement& measurement) const noexcept {
+        const auto observation = singerObservation();
+        float distance = 0.0f;
+        for (int i = 0; i < kAxisNum; ++i) {
+            const SingerAxisFilter::BlockMeasurement residual =
+                measurement.segment<kAxisMeasurementSize>(
+                    i * kAxisMeasurementSize) -
+                observation * states_.col(index * kAxisNum + i);
+            const SingerAxisFilter::BlockObservationNoise
+                innovation_covariance =
+                    observation *
+                        covariances_.middleCols<kAxisStateSize>(
+                            (index * kAxisNum + i) * kAxisStateSize) *
+                        observation.transpose() +
+                    observation_noises_[i];
+            distance += (residual.transpose() *
+                         innovation_covariance.inverse() * residual)(0);
+        }
+        return distance;
+    }
+
+    /**
+     * @brief Gets the state of a filter.
+     *
+     * @param index The index of the filter.
+     * @return The state of the filter.
+     */
+    inline State state(int index) const noexcept {
+        return states_.middleCols<kAxisNum>(index * kAxisNum).reshaped();
+    }
+
+    /**
+     * @brief Gets the state of a filter predicted forward by a time increment,
+     * without changing the filter.
+     *
+     * @param index The index of the filter.
+     * @param dt Time increment for prediction.
+     * @return The predicted state of the filter.
+     */
+    State predictState(int index, float dt) const {
+        const SingerAxisFilter::BlockCovariance transition =
+            state_transition_(dt);
+        const Eigen::Matrix<float, kAxisStateSize, kAxisNum> states =
+            transition * states_.middleCols<kAxisNum>(index * kAxisNum);
+        return states.reshaped();
+    }
+
+    /**
+     * @brief Gets the covariance of a filter.
+     *
+     * @param index The index of the filter.
+     * @return The block diagonal covariance of the filter.
+     */
+    Covariance covariance(int index) const noexcept {
+        Covariance covariance = Covariance::Zero();
+        for (int i = 0; i < kAxisNum; ++i) {
+            covariance.block<kAxisStateSize, kAxisStateSize>(
+                i * kAxisStateSize, i * kAxisStateSize) =
+                covariances_.middleCols<kAxisStateSize>(
+                    (index * kAxisNum + i) * kAxisStateSize);
+        }
+        return covariance;
+    }
+
+   private:
+    SingerEKFBank() = delete;
+
+    using Matrix = Eigen::Matrix<float, kAxisStateSize, Eigen::Dynamic>;
+
+    inline Eigen::Block<Matrix, kAxisStateSize, kAxisStateSize, true>
+    covarianceBlock(int index, int axis) noexcept {
+        return covariances_.middleCols<kAxisStateSize>(
+            (index * kAxisNum + axis) * kAxisStateSize);
+    }
+
+    SingerTransition state_transition_;
+    SingerProcessNoise process_noise_;
+    std::array<SingerAxisFilter::BlockObservationNoise, kAxisNum>
+        observation_noises_;
+    // Axis states, each column of which is [p, v, a] of an axis of a filter.
+    Matrix states_;
+    // Axis covariances, each 3 columns of which are the covariance of an axis.
+    Matrix covariances_;
+    Matrix products_;
+    int size_{0};
+};
+
+}  // namespace radar::track
@@ -12,12 +12,10 @@
 #pragma once
 
 #include <Eigen/Dense>
-#include <chrono>
-#include <memory>
 #include <opencv2/opencv.hpp>
 
 #include "features.h"
-#include "singer.h"
+#include "singer_bank.h"
 
 namespace radar {
 
@@ -27,51 +25,67 @@ namespace radar {
  */
 enum class TrackState { Tentative, Confirmed, Deleted };
 
+template <int ClassNum>
+class BasicTracker;
+
 /**
- * @class Track
+ * @class BasicTrack
  * @brief Represents a track in a tracking system.
  *
  * This class encapsulates a track which is defined by its state (tentative,
  * confirmed, deleted), a Kalman filter for state estimation, and various
- * counters and thresholds for track management.
+ * counters and thresholds for track management. The filter is stored in the
+ * filter bank of the tracker, which predicts the filters of all tracks
+ * together, and the track holds its index in the bank.
+ *
+ * @tparam ClassNum The number of classes known at compile time, or
+ * `Eigen::Dynamic` if it is given at runtime.
  */
-class Track {
+template <int ClassNum = Eigen::Dynamic>
+class BasicTrack {
    public:
-    friend class Tracker;
+    using Feature = typename track::BasicFeatures<ClassNum>::Vector;
+
+    friend class BasicTracker<ClassNum>;
+
+    // The velocity of a new track, which is at rest until it is updated.
+    static inline const cv::Point3f kInitialVelocity{0.0f, 0.0f, 0.0f};
+
     /**
-     * @brief Constructs a Track object with the given initial parameters.
+     * @brief Constructs a Track object with the given initial parameters,
+     * whose filter is added to the bank.
      *
      * @param location Initial location of the track.
      * @param feature Initial feature vector associated with the track.
-     * @param time Initial timestamp of the track.
      * @param track_id Unique identifier for the track.
-     * @param filter Singer EKF model for the track.
+     * @param filters The bank of Singer EKF models the filter is added to,
+     * which must outlive the track.
+     * @param feature_window The number of latest features kept, or 0 to keep
+     * all of them.
+     * @param feature_decay The decay factor of the weights of older features.
      */
-    Track(const cv::Point3f& location, const Eigen::VectorXf& feature,
-          const std::chrono::high_resolution_clock::time_point& time,
-          int track_id, float max_acc, float tau,
-          const cv::Point3f observe_noise)
-        : features_{feature},
-          timestamp_{time},
+    BasicTrack(const cv::Point3f& location,
+               const Eigen::Ref<const Feature>& feature, int track_id,
+               track::SingerEKFBank& filters, int feature_window = 0,
+               float feature_decay = 1.0f)
+        : features_{feature, 1, feature_window, feature_decay},
           track_id_{track_id},
           init_count_{0},
           miss_count_{0},
           state_{TrackState::Tentative},
-          filter_{nullptr} {
-        Eigen::Matrix<float, track::kStateSize, 1> initial_state;
-        initial_state << location.x, 0, 0, location.y, 0, 0, location.z, 0, 0;
-        const Eigen::Matrix<float, track::kStateSize, track::kStateSize>
-            initial_covariance = Eigen::Matrix<float, track::kStateSize,
-                                               track::kStateSize>::Identity() *
-                                 0.1f;
-        Eigen::Matrix<float, track::kMeasurementSize, track::kMeasurementSize>
-            observe_noise_mat;
-        observe_noise_mat << observe_noise.x, 0, 0, 0, observe_noise.y, 0, 0, 0,
-            observe_noise.z;
-        filter_ = std::make_unique<track::SingerEKF>(
-            initial_state, initial_covariance, max_acc, tau, observe_noise_mat);
+          filters_{&filters} {
+        track::SingerEKFBank::State initial_state;
+        initial_state << location.x, kInitialVelocity.x, 0, location.y,
+            kInitialVelocity.y, 0, location.z, kInitialVelocity.z, 0;
+        filter_index_ = filters_->add(
+            initial_state, track::SingerEKFBank::Covariance::Identity() * 0.1f);
     }
 
+    BasicTrack(const BasicTrack&) = delete;
+    BasicTrack& operator=(const BasicTrack&) = delete;
+    BasicTrack(BasicTrack&&) = default;
+    BasicTrack& operator=(BasicTrack&&) = default;
+
     /**
      * @brief Determines if the track is confirmed.
      * @return True if the track is confirmed, false otherwise.
@@ -109,37 +123,19 @@ class Track {
      */
     inline void setState(TrackState state) noexcept { state_ = state; }
 
-    /**
-     * @brief Predicts the next state of the track using the Kalman filter.
-     * @param current_timestamp The current timestamp to which the
-     * prediction is made.
-     */
-    void predict(const std::chrono::high_resolution_clock::time_point&
-                     current_timestamp) {
-        // update ekf
-        float dt = static_cast<float>(
-                       std::chrono::duration_cast<std::chrono::nanoseconds>(
-                           current_timestamp - timestamp_)
-                           .count()) *
-                   1e-9;
-        filter_->predict(dt);
-
-        // update timestamp
-        timestamp_ = current_timestamp;
-    }
-
     /**
      * @brief Updates the track with a new observation.
      * @param location The new observed location of the track.
      * @param feature The new observed feature associated with the track.
      */
-    void update(const cv::Point3f& location, const Eigen::VectorXf& feature) {
+    void update(const cv::Point3f& location,
+                const Eigen::Ref<const Feature>& feature) {
         // update feature
         features_.push_back(feature);
 
         Eigen::Matrix<float, track::kMeasurementSize, 1> measurement;
         measurement << location.x, location.y, location.z;
-        filter_->update(measurement);
+        filters_->update(filter_index_, measurement);
     }
 
     /**
@@ -155,7 +151,7 @@ class Track {
      *
      * @return The normalized feature of the track.
      */
-    inline Eigen::VectorXf feature() const noexcept {
+    inline const Feature& feature() const noexcept {
         return features_.feature();
     }
 
@@ -165,11 +161,35 @@ class Track {
      * @return the location of the track.
      */
     cv::Point3f location() const noexcept {
-        auto state = filter_->state();
+        auto state = filters_->state(filter_index_);
         return cv::Point3f(state(0), state(3), state(6));
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const Track& track) {
+    /**
+     * @brief Gets the velocity(x, y, z) of the track.
+     *
+     * @return the velocity of the track.
+     */
+    cv::Point3f velocity() const noexcept {
+        auto state = filters_->state(filter_index_);
+        return cv::Point3f(state(1), state(4), state(7));
+    }
+
+    /**
+     * @brief Gets the squared Mahalanobis distance between a location and the
+     * predicted location of the track, which is used in gating.
+     *
+     * @param location The location.
+     * @return The squared Mahalanobis distance.
+     */
+    float squaredMahalanobis(const cv::Point3f& location) const noexcept {
+        Eigen::Matrix<float, track::kMeasurementSize, 1> measurement;
+        measurement << location.x, location.y, location.z;
+        return filters_->squaredMahalanobis(filter_index_, measurement);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os,
+                                    const BasicTrack& track) {
         std::cout << "Track: { ";
         std::cout << "id: " << track.track_id_ << ", ";
         std::cout << "label: " << track.label() << ", ";
@@ -185,15 +205,19 @@ class Track {
     }
 
    private:
-    Track() = delete;
+    BasicTrack() = delete;
 
-    track::Features features_;
-    std::chrono::high_resolution_clock::time_point timestamp_;
+    track::BasicFeatures<ClassNum> features_;
     int track_id_;
     int init_count_;
     int miss_count_;
     TrackState state_;
-    std::unique_ptr<track::SingerEKF> filter_;
+    track::SingerEKFBank* filters_;
+    int filter_index_;
+    // The price of the track in the auction, reused in the next frame.
+    float price_{0.0f};
 };
 
+using Track = BasicTrack<Eigen::Dynamic>;
+
 }  // namespace radar
\ No newline at end of file
@@ -16,10 +16,13 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <limits>
 #include <numeric>
 #include <ranges>
+#include <stdexcept>
 
 #include "auction.h"
+#include "utils/metrics.h"
 
 namespace radar {
 
@@ -43,11 +46,24 @@ using namespace track;
  * matching.
  * @param max_iter The maximum iteration time of the auction algorithm.
  * @param distance_thresh The distance threshold(m) for scoring.
+ * @param feature_window The number of latest features kept by each track, or
+ * 0 to keep all of them.
+ * @param feature_decay The decay factor in (0, 1] of the weights of older
+ * features of each track.
+ * @param gate_thresh The threshold of the squared Mahalanobis distance under
+ * the innovation covariance, beyond which a robot of a different label can not
+ * be matched to a track. The default is the 99% quantile of chi-squared
+ * distribution with 3 degrees of freedom.
+ * @throws `std::invalid_argument` if the number of classes is not positive or
+ * exceeds `Robot::kClassNum`, or differs from the fixed number of classes.
  */
-Tracker::Tracker(const cv::Point3f& observation_noise, int class_num,
-                 int init_thresh, int miss_thresh, float max_acceleration,
-                 float acceleration_correlation_time, float distance_weight,
-                 float feature_weight, int max_iter, float distance_thresh)
+template <int ClassNum>
+BasicTracker<ClassNum>::BasicTracker(
+    const cv::Point3f& observation_noise, int class_num, int init_thresh,
+    int miss_thresh, float max_acceleration,
+    float acceleration_correlation_time, float distance_weight,
+    float feature_weight, int max_iter, float distance_thresh,
+    int feature_window, float feature_decay, float gate_thresh)
     : class_num_{class_num},
       init_thresh_{init_thresh},
       miss_thresh_{miss_thresh},
@@ -57,7 +73,21 @@ Tracker::Tracker(const cv::Point3f& observation_noise, int class_num,
       feature_weight_{feature_weight},
       measurement_noise_{observation_noise},
       max_iter_{max_iter},
-      distance_thresh_{distance_thresh} {}
+      distance_thresh_{distance_thresh},
+      feature_window_{feature_window},
+      feature_decay_{feature_decay},
+      gate_thresh_{gate_thresh},
+      solver_{max_iter_} {
+    SingerEKFBank::ObservationNoise observation_noise_mat;
+    observation_noise_mat << observation_noise.x, 0, 0, 0, observation_noise.y,
+        0, 0, 0, observation_noise.z;
+    filters_ = std::make_unique<SingerEKFBank>(max_acc_, tau_,
+                                               observation_noise_mat);
+    if (class_num_ <= 0 || class_num_ > Robot::kClassNum ||
+        (ClassNum != Eigen::Dynamic && class_num_ != ClassNum)) {
+        throw std::invalid_argument("invalid number of classes");
+    }
+}
 
 /**
  * @brief Calculate the weighted Euclidean distance between two points in 3D
@@ -67,7 +97,9 @@ Tracker::Tracker(const cv::Point3f& observation_noise, int class_num,
  * @param p2 The second point.
  * @return The Euclidean distance.
  */
-float Tracker::calculateDistance(const cv::Point3f& p1, const cv::Point3f& p2) {
+template <int ClassNum>
+float BasicTracker<ClassNum>::calculateDistance(const cv::Point3f& p1,
+                                                const cv::Point3f& p2) {
     float x1 = p1.x, y1 = p1.y, z1 = p1.z;
     float x2 = p2.x, y2 = p2.y, z2 = p2.z;
     return std::sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) +
@@ -80,9 +112,13 @@ float Tracker::calculateDistance(const cv::Point3f& p1, const cv::Point3f& p2) {
  *
  * @param track The track for which to calculate the cost.
  * @param robot The robot observation to be matched to the track.
+ * @param robot_feature The feature of the robot.
  * @return The calculated cost.
  */
-float Tracker::calculateCost(const Track& track, const Robot& robot) {
+template <int ClassNum>
+float BasicTracker<ClassNum>::calculateCost(
+    const Track& track, const Robot& robot,
+    const Eigen::Ref<const Feature>& robot_feature) const {
     if (!robot.isLocated() && !robot.isDetected()) {
         return 0.0f;
     }
@@ -92,8 +128,8 @@ float Tracker::calculateCost(const Track& track, const Robot& robot) {
     if (!robot.isLocated()) {
         distance_score = 0.0f;
     } else {
-        float distance =
-            calculateDistance(robot.location().value(), track.location());
+        float distance = calculateDistance(
+            compensate(track, robot.location().value()), track.location());
         distance_score = distance < distance_thresh_ ? 1.0f
                          : distance < 2 * distance_thresh_
                              ? -distance / distance_thresh_ + 2.0f
@@ -101,8 +137,8 @@ float Tracker::calculateCost(const Track& track, const Robot& robot) {
     }
 
     // calculate feature score
-    auto feature_robot = robot.feature(class_num_);
-    auto feature_track = track.feature();
+    const auto& feature_robot = robot_feature;
+    const auto& feature_track = track.feature();
     assert(feature_robot.size() == feature_track.size());
 
     float feature_score;
@@ -117,31 +153,181 @@ float Tracker::calculateCost(const Track& track, const Robot& robot) {
     return distance_score * distance_weight_ + feature_score * feature_weight_;
 }
 
+/**
+ * @brief Determines whether a located robot is possible to be matched to a
+ * track, which requires the same label or the location within the gate of the
+ * innovation covariance of the track.
+ *
+ * @param track The track.
+ * @param robot The located robot.
+ * @return `true` if the pair is possible, otherwise `false`.
+ */
+template <int ClassNum>
+bool BasicTracker<ClassNum>::isGated(const Track& track,
+                                     const Robot& robot) const {
+    if (robot.label().value_or(-1) == track.label()) {
+        return true;
+    }
+    return track.squaredMahalanobis(
+               compensate(track, robot.location().value())) <= gate_thresh_;
+}
+
+/**
+ * @brief Moves a location measured before the timestamp of the update to where
+ * the robot is at the timestamp, with the velocity of the track it is matched
+ * to.
+ *
+ * The locations of robots are measured at the capture time of the lidar sweep,
+ * while the tracks are predicted to the capture time of the camera frame. The
+ * motion of the track within that time is added to the location, so that it
+ * is compared with and updates the predicted state at the same time.
+ *
+ * @param track The track.
+ * @param location The location measured at the location timestamp.
+ * @return The location at the timestamp of the update.
+ */
+template <int ClassNum>
+cv::Point3f BasicTracker<ClassNum>::compensate(
+    const Track& track, const cv::Point3f& location) const noexcept {
+    return compensate(track.velocity(), location);
+}
+
+/**
+ * @brief Moves a location measured before the timestamp of the update to where
+ * the robot is at the timestamp, with a velocity.
+ *
+ * @param velocity The velocity of the robot.
+ * @param location The location measured at the location timestamp.
+ * @return The location at the timestamp of the update.
+ */
+template <int ClassNum>
+cv::Point3f BasicTracker<ClassNum>::compensate(
+    const cv::Point3f& velocity, const cv::Point3f& location) const noexcept {
+    if (iszero(location_lag_)) {
+        return location;
+    }
+    return location + velocity * location_lag_;
+}
+
+/**
+ * @brief Gets the value of matching a located robot to a track in the value
+ * matrix.
+ *
+ * @param track The track.
+ * @param robot The located robot.
+ * @return The cost of the pair if it is gated, otherwise NaN.
+ */
+template <int ClassNum>
+float BasicTracker<ClassNum>::pairValue(const Track& track,
+                                        const Robot& robot) const {
+    if (!isGated(track, robot)) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    return calculateCost(track, robot, robotFeature(robot));
+}
+
 /**
  * @brief Update all tracks based on a new set of robot observations.
  *
  * @param robots The new robot observations.
  * @param timestamp The timestamp of the observations.
  */
-void Tracker::update(
+template <int ClassNum>
+void BasicTracker<ClassNum>::update(
     std::vector<Robot>& robots,
     const std::chrono::high_resolution_clock::time_point& timestamp) {
-    // Predicts tracks
-    std::for_each(tracks_.begin(), tracks_.end(),
-                  [&](Track& track) { track.predict(timestamp); });
+    update(robots, timestamp, timestamp);
+}
 
-    // Sets the cost matrix and calculates min-cost matching
-    Eigen::MatrixXf cost_matrix(robots.size(), tracks_.size());
+/**
+ * @brief Update all tracks based on a new set of robot observations, whose
+ * locations are measured at another time than the detections.
+ *
+ * Tracks are predicted to the timestamp, which is the capture time of the
+ * camera frame. The location of a robot, which comes from the lidar sweep
+ * paired with the frame, is moved by the velocity of each track over the time
+ * between the sweep and the frame before it is gated, scored and filtered, so
+ * that both sensors can run at their own rates without biasing moving robots.
+ *
+ * @param robots The new robot observations.
+ * @param timestamp The timestamp of the observations.
+ * @param location_timestamp The timestamp at which the locations of the robots
+ * are measured.
+ */
+template <int ClassNum>
+void BasicTracker<ClassNum>::update(
+    std::vector<Robot>& robots,
+    const std::chrono::high_resolution_clock::time_point& timestamp,
+    const std::chrono::high_resolution_clock::time_point& location_timestamp) {
+    RADAR_PROFILE_SCOPE("track.update");
+    // Predicts tracks, which are all updated to the same timestamp
+    const float dt = static_cast<float>(
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             timestamp - timestamp_)
+                             .count()) *
+                     1e-9;
+    filters_->predict(dt, pool_);
+    timestamp_ = timestamp;
+    location_lag_ = static_cast<float>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            timestamp - location_timestamp)
+                            .count()) *
+                    1e-9;
+
+    // Scores all pairs in parallel over robots if there are enough of them
+    const size_t tracks_num = tracks_.size();
+    const bool parallel = pool_ != nullptr &&
+                          robots.size() * tracks_num >= kParallelPairs;
+    if (parallel) {
+        pair_values_.resize(robots.size() * tracks_num);
+        pool_->parallelFor(
+            0, static_cast<int>(robots.size()),
+            std::max(kParallelPairs / static_cast<int>(tracks_num), 1),
+            [&](int begin, int end) {
+                for (int robot_id = begin; robot_id < end; ++robot_id) {
+                    const auto& robot = robots[robot_id];
+                    if (!robot.isLocated()) {
+                        continue;
+                    }
+                    for (size_t track_id = 0; track_id < tracks_num;
+                         ++track_id) {
+                        pair_values_[robot_id * tracks_num + track_id] =
+                            pairValue(tracks_[track_id], robot);
+                    }
+                }
+            });
+    }
+
+    // Sets the costs of gated pairs and calculates max-cost matching, which
+    // starts from the prices of tracks in the last frame
+    value_matrix_.reset(tracks_num);
     for (size_t robot_id = 0; robot_id < robots.size(); ++robot_id) {
-        for (size_t track_id = 0; track_id < tracks_.size(); ++track_id) {
-            cost_matrix(robot_id, track_id) =
-                calculateCost(tracks_[track_id], robots[robot_id]);
+        const auto& robot = robots[robot_id];
+        value_matrix_.addRow();
+        if (!robot.isLocated()) {
+            continue;
+        }
+        for (size_t track_id = 0; track_id < tracks_num; ++track_id) {
+            const float value =
+                parallel ? pair_values_[robot_id * tracks_num + track_id]
+                         : pairValue(tracks_[track_id], robot);
+            if (!std::isnan(value)) {
+                value_matrix_.add(track_id, value);
+            }
         }
     }
+    prices_.resize(tracks_.size());
+    for (size_t track_id = 0; track_id < tracks_.size(); ++track_id) {
+        prices_[track_id] = tracks_[track_id].price_;
+    }
 
-    std::vector<int> unmatched_robot_indices;
-    std::vector<int> matched_track_indices;
-    auto match_result = auction(cost_matrix, max_iter_);
+    arena_->reset();
+    std::pmr::vector<int> unmatched_robot_indices(arena_->resource());
+    std::pmr::vector<int> matched_track_indices(arena_->resource());
+    auto match_result = solver_.solve(value_matrix_, prices_);
+    for (size_t track_id = 0; track_id < tracks_.size(); ++track_id) {
+        tracks_[track_id].price_ = prices_[track_id];
+    }
     for (size_t robot_id = 0; robot_id < match_result.size(); ++robot_id) {
         auto& robot = robots[robot_id];
         if (!robot.isLocated()) {
@@ -156,21 +342,10 @@ void Tracker::update(
             continue;
         }
 
-        auto& track = tracks_[track_id];
-        //! The auction algorithm operates by ensuring that each agent is
-        //! assigned a task, even if it means choosing tasks of very low
-        //! value. So it is necessary to confirm whether the agent and task
-        //! are appropriate to be assigned, otherwise the agent and task
-        //! should be seen unassociated.
-        if (calculateDistance(robot.location().value(), track.location()) >
-                2 * distance_thresh_ &&
-            robot.label().value_or(-1) != track.label()) {
-            unmatched_robot_indices.emplace_back(robot_id);
-            continue;
-        }
-
         // Updates track
-        track.update(robot.location().value(), robot.feature(class_num_));
+        auto& track = tracks_[track_id];
+        track.update(compensate(track, robot.location().value()),
+                     robotFeature(robot));
         if (track.isTentative()) {
             track.init_count_ += 1;
             if (track.init_count_ >= init_thresh_) {
@@ -200,23 +375,68 @@ void Tracker::update(
         }
     }
 
-    // Erases deleted tracks
-    tracks_.erase(
-        std::remove_if(tracks_.begin(), tracks_.end(),
-                       [](const Track& track) { return track.isDeleted(); }),
-        tracks_.end());
+    // Erases deleted tracks and their filters, keeping the index of the
+    // filter of each track the same as the index of the track
+    int kept_num = 0;
+    for (int i = 0; i < static_cast<int>(tracks_.size()); ++i) {
+        auto& track = tracks_[i];
+        if (track.isDeleted()) {
+            continue;
+        }
+        filters_->move(track.filter_index_, kept_num);
+        track.filter_index_ = kept_num;
+        if (i != kept_num) {
+            tracks_[kept_num] = std::move(track);
+        }
+        ++kept_num;
+    }
+    tracks_.erase(tracks_.begin() + kept_num, tracks_.end());
+    filters_->resize(kept_num);
 
     // Appends new tracks
     std::ranges::for_each(unmatched_robot_indices, [&](int index) {
         auto& robot = robots[index];
         if (robot.isDetected() && robot.isLocated()) {
-            Track track(robot.location().value(), robot.feature(class_num_),
-                        timestamp, latest_id_++, max_acc_, tau_,
-                        measurement_noise_);
+            // The state of a new track is at the timestamp of the update like
+            // the others, with the initial velocity of tracks
+            Track track(compensate(Track::kInitialVelocity,
+                                   robot.location().value()),
+                        robotFeature(robot), latest_id_++, *filters_,
+                        feature_window_, feature_decay_);
             robot.setTrack(track);
             tracks_.emplace_back(std::move(track));
         }
     });
 }
 
+/**
+ * @brief Predicts the locations of the confirmed tracks at a later time, such
+ * as the capture time of the next frame, without changing the tracks.
+ *
+ * @param timestamp The time the tracks are predicted to, which is usually not
+ * earlier than the timestamp of the latest update.
+ * @return The predicted locations of the confirmed tracks.
+ */
+template <int ClassNum>
+std::vector<cv::Point3f> BasicTracker<ClassNum>::predict(
+    const std::chrono::high_resolution_clock::time_point& timestamp) const {
+    const float dt = static_cast<float>(
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             timestamp - timestamp_)
+                             .count()) *
+                     1e-9;
+    std::vector<cv::Point3f> locations;
+    for (const auto& track : tracks_) {
+        if (!track.isConfirmed()) {
+            continue;
+        }
+        const auto state = filters_->predictState(track.filter_index_, dt);
+        locations.emplace_back(state(0), state(3), state(6));
+    }
+    return locations;
+}
+
+template class BasicTracker<Robot::kClassNum>;
+template class BasicTracker<Eigen::Dynamic>;
+
 }  // namespace radar
\ No newline at end of file
@@ -13,28 +13,100 @@
 
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <vector>
 
+#include "auction.h"
 #include "robot/robot.h"
 #include "track.h"
+#include "utils/frame_arena.h"
+#include "utils/thread_pool.h"
 
 namespace radar {
 
-class Tracker {
+/**
+ * @brief The tracker of robots, which associates robots with tracks and
+ * filters their locations.
+ *
+ * @tparam ClassNum The number of classes known at compile time, with which
+ * the features are fixed-size and the cost is computed without allocation, or
+ * `Eigen::Dynamic` if it is given at runtime.
+ * @note The tracker is instantiated for `Robot::kClassNum` and
+ * `Eigen::Dynamic` only.
+ */
+template <int ClassNum = Eigen::Dynamic>
+class BasicTracker {
+    static_assert(ClassNum == Eigen::Dynamic ||
+                      (ClassNum > 0 && ClassNum <= Robot::kClassNum),
+                  "invalid number of classes");
+
    public:
-    Tracker(const cv::Point3f& observation_noise, int class_num,
-            int init_thresh = 4, int miss_thresh = 10,
-            float max_acceleration = 2.0f,
-            float acceleration_correlation_time = 1.0f,
-            float distance_weight = 0.40f, float feature_weight = 0.60f,
-            int max_iter = 100, float distance_thresh = 0.8f);
+    using Track = BasicTrack<ClassNum>;
+    using Feature = typename Track::Feature;
+
+    // The minimum number of robot-track pairs scored by one task of the
+    // thread pool, below which the value matrix is filled serially.
+    static constexpr int kParallelPairs = 1024;
+
+    BasicTracker(const cv::Point3f& observation_noise, int class_num,
+                 int init_thresh = 4, int miss_thresh = 10,
+                 float max_acceleration = 2.0f,
+                 float acceleration_correlation_time = 1.0f,
+                 float distance_weight = 0.40f, float feature_weight = 0.60f,
+                 int max_iter = 100, float distance_thresh = 0.8f,
+                 int feature_window = 100, float feature_decay = 1.0f,
+                 float gate_thresh = 11.34f);
 
     void update(
         std::vector<Robot>& robots,
         const std::chrono::high_resolution_clock::time_point& timestamp);
 
+    void update(
+        std::vector<Robot>& robots,
+        const std::chrono::high_resolution_clock::time_point& timestamp,
+        const std::chrono::high_resolution_clock::time_point&
+            location_timestamp);
+
+    std::vector<cv::Point3f> predict(
+        const std::chrono::high_resolution_clock::time_point& timestamp) const;
+
+    /**
+     * @brief Sets the thread pool over which the filters are predicted and the
+     * value matrix is filled, which is usually shared with other stages.
+     *
+     * @param pool The thread pool, which must outlive its use by the tracker,
+     * or `nullptr` to run on the calling thread.
+     */
+    inline void setThreadPool(ThreadPool* pool) noexcept { pool_ = pool; }
+
    private:
-    float calculateCost(const Track& track, const Robot& robot);
+    float calculateCost(const Track& track, const Robot& robot,
+                        const Eigen::Ref<const Feature>& robot_feature) const;
+
+    float pairValue(const Track& track, const Robot& robot) const;
+
+    /**
+     * @brief Gets the feature of a robot with the number of classes.
+     *
+     * @param robot The robot.
+     * @return The leading segment of the feature of the robot.
+     */
+    inline auto robotFeature(const Robot& robot) const noexcept {
+        if constexpr (ClassNum == Eigen::Dynamic) {
+            return robot.feature().head(class_num_);
+        } else {
+            return robot.feature().template head<ClassNum>();
+        }
+    }
+
+    bool isGated(const Track& track, const Robot& robot) const;
+
+    cv::Point3f compensate(const Track& track,
+                           const cv::Point3f& location) const noexcept;
+
+    cv::Point3f compensate(const cv::Point3f& velocity,
+                           const cv::Point3f& location) const noexcept;
 
     static float calculateDistance(const cv::Point3f& p1,
                                    const cv::Point3f& p2);
@@ -48,9 +120,28 @@ class Tracker {
     float feature_weight_;
     const cv::Point3f measurement_noise_;
     std::vector<Track> tracks_;
+    // Filters of all tracks, whose address is stable when the tracker moves.
+    std::unique_ptr<track::SingerEKFBank> filters_;
+    std::chrono::high_resolution_clock::time_point timestamp_;
+    // The time in seconds from measuring the locations of the robots to the
+    // timestamp of the update.
+    float location_lag_{0.0f};
     const int max_iter_;
     const float distance_thresh_;
+    const int feature_window_;
+    const float feature_decay_;
+    const float gate_thresh_;
+    track::AuctionSolver solver_;
+    track::SparseValueMatrix value_matrix_;
+    std::vector<float> prices_;
+    // Values of all robot-track pairs filled in parallel, in row-major order.
+    std::vector<float> pair_values_;
+    ThreadPool* pool_{nullptr};
+    // Memory of the containers used in one update.
+    std::unique_ptr<FrameArena> arena_{std::make_unique<FrameArena>()};
     int latest_id_ = 0;
 };
 
+using Tracker = BasicTracker<Eigen::Dynamic>;
+
 }  // namespace radar
\ No newline at end of file
@@ -0,0 +1,181 @@
+/**
+ * @file bounded_queue.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a bounded blocking queue which is used to link
+ * the stages of the radar pipeline, with a configurable policy on overflow.
+ * @date 2024-05-06
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace radar {
+
+/**
+ * @brief Policy applied when pushing into a full queue.
+ *
+ * - `Block`: The producer waits until the consumer has made room.
+ * - `DropOldest`: The oldest element is discarded to make room, so that the
+ * consumer always sees the most recent data.
+ */
+enum class OverflowPolicy { Block, DropOldest };
+
+/**
+ * @brief A bounded queue linking one producer stage to one consumer stage.
+ *
+ * Elements are kept in a fixed-size ring which is allocated once at
+ * construction. Both `push` and `pop` wake the other side, and `close` releases
+ * every waiting thread so that stage threads can exit cleanly.
+ *
+ * @tparam T The element type, which must be default constructible and movable.
+ */
+template <typename T>
+class BoundedQueue {
+   public:
+    /**
+     * @brief Constructs a queue with the given capacity and overflow policy.
+     *
+     * @param capacity The maximum number of elements in the queue.
+     * @param policy The policy applied when pushing into a full queue.
+     * @throws `std::invalid_argument` if the capacity is zero.
+     */
+    explicit BoundedQueue(size_t capacity,
+                          OverflowPolicy policy = OverflowPolicy::Block)
+        : ring_(capacity), policy_{policy} {
+        if (capacity == 0) {
+            throw std::invalid_argument("capacity must be positive");
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Pushes an element into the queue.
+     *
+     * If the queue is full, the behavior depends on the overflow policy: with
+     * `Block` the caller waits for a free slot, with `DropOldest` the oldest
+     * element is discarded.
+     *
+     * @param value The element to push.
+     * @return `true` if the element is enqueued, `false` if the queue has been
+     * closed.
+     */
+    bool push(T value) {
+        std::unique_lock lock(mutex_);
+        if (policy_ == OverflowPolicy::Block) {
+            not_full_.wait(lock,
+                           [this] { return closed_ || size_ < ring_.size(); });
+        }
+        if (closed_) {
+            return false;
+        }
+        if (size_ == ring_.size()) {  // only reachable with `DropOldest`
+            ring_[head_] = T();
+            head_ = (head_ + 1) % ring_.size();
+            --size_;
+            ++dropped_;
+        }
+        ring_[(head_ + size_) % ring_.size()] = std::move(value);
+        ++size_;
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pops the oldest element, waiting until one is available.
+     *
+     * @return The oldest element, or `std::nullopt` if the queue is closed and
+     * has been drained.
+     */
+    std::optional<T> pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || size_ > 0; });
+        if (size_ == 0) {
+            return std::nullopt;
+        }
+        std::optional<T> value{std::move(ring_[head_])};
+        ring_[head_] = T();
+        head_ = (head_ + 1) % ring_.size();
+        --size_;
+        lock.unlock();
+        not_full_.notify_one();
+        return value;
+    }
+
+    /**
+     * @brief Closes the queue. Subsequent pushes fail, and pops return the
+     * remaining elements before returning `std::nullopt`.
+     */
+    void close() {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    /**
+     * @brief Reopens a closed queue and discards the remaining elements.
+     */
+    void reset() {
+        std::lock_guard lock(mutex_);
+        for (auto& element : ring_) {
+            element = T();
+        }
+        head_ = size_ = 0;
+        closed_ = false;
+    }
+
+    /**
+     * @brief Gets the number of elements currently in the queue.
+     *
+     * @return The size of the queue.
+     */
+    size_t size() const {
+        std::lock_guard lock(mutex_);
+        return size_;
+    }
+
+    /**
+     * @brief Gets the capacity of the queue.
+     *
+     * @return The capacity of the queue.
+     */
+    inline size_t capacity() const noexcept { return ring_.size(); }
+
+    /**
+     * @brief Gets the number of elements discarded by the `DropOldest` policy.
+     *
+     * @return The number of dropped elements.
+     */
+    size_t dropped() const {
+        std::lock_guard lock(mutex_);
+        return dropped_;
+    }
+
+   private:
+    std::vector<T> ring_;
+    const OverflowPolicy policy_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+    size_t dropped_ = 0;
+    bool closed_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+}  // namespace radar
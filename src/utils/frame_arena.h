@@ -0,0 +1,105 @@
+/**
+ * @file frame_arena.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements an arena of memory for the objects living in
+ * one frame, which is reset at the beginning of each frame.
+ * @date 2024-05-14
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace radar {
+
+/**
+ * @brief A memory arena for per-frame containers.
+ *
+ * Allocations are served by bumping a pointer in a buffer owned by the arena,
+ * and deallocations do nothing until `reset` releases everything at once.
+ * When a frame needs more memory than the buffer, the rest comes from the heap,
+ * and the buffer is enlarged on the next reset so that later frames fit in it.
+ *
+ * @note The arena is not thread-safe, so each stage owns its own arena.
+ */
+class FrameArena {
+   public:
+    /**
+     * @brief Constructs an arena with the initial size of its buffer.
+     *
+     * @param initial_size The initial size of the buffer in bytes.
+     */
+    explicit FrameArena(size_t initial_size = 64 * 1024)
+        : buffer_(initial_size),
+          resource_(buffer_.data(), buffer_.size(), &upstream_) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief Releases all memory allocated from the arena, which invalidates
+     * every container using it. The buffer grows if the last frame overflowed.
+     *
+     */
+    void reset() {
+        resource_.release();
+        if (upstream_.allocated > 0) {
+            buffer_.resize(2 * (buffer_.size() + upstream_.allocated));
+            upstream_.allocated = 0;
+        }
+        resource_.~monotonic_buffer_resource();
+        new (&resource_) std::pmr::monotonic_buffer_resource(
+            buffer_.data(), buffer_.size(), &upstream_);
+    }
+
+    /**
+     * @brief Gets the memory resource of the arena used by `std::pmr`
+     * containers.
+     *
+     * @return The memory resource.
+     */
+    inline std::pmr::memory_resource* resource() noexcept { return &resource_; }
+
+    /**
+     * @brief Gets the size of the buffer.
+     *
+     * @return The size of the buffer in bytes.
+     */
+    inline size_t capacity() const noexcept { return buffer_.size(); }
+
+   private:
+    /**
+     * @brief The upstream resource of the arena, which counts the bytes
+     * allocated beyond the buffer.
+     *
+     */
+    struct CountingResource : std::pmr::memory_resource {
+        size_t allocated{0};
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            allocated += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer_;
+    CountingResource upstream_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+}  // namespace radar
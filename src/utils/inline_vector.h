@@ -0,0 +1,105 @@
+/**
+ * @file inline_vector.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a vector of fixed capacity whose elements are
+ * stored inline, which is used for small per-object collections without heap
+ * allocation.
+ * @date 2024-05-14
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace radar {
+
+/**
+ * @brief A vector storing at most `N` elements inline.
+ *
+ * Copying and moving the vector copies its elements, so it is meant for small
+ * trivially copyable elements such as detections.
+ *
+ * @tparam T The element type, which must be trivially copyable.
+ * @tparam N The capacity of the vector.
+ */
+template <typename T, size_t N>
+class InlineVector {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "T must be trivially copyable");
+
+   public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    InlineVector() = default;
+
+    /**
+     * @brief Constructs the vector from a range of elements, keeping only the
+     * first `N` of them.
+     *
+     * @param elements The elements.
+     */
+    explicit InlineVector(std::span<const T> elements) noexcept
+        : size_{std::min(elements.size(), N)} {
+        std::copy_n(elements.begin(), size_, data_.begin());
+    }
+
+    /**
+     * @brief Appends an element.
+     *
+     * @param element The element.
+     * @throws `std::length_error` if the vector is full.
+     */
+    void push_back(const T& element) {
+        if (size_ == N) {
+            throw std::length_error("inline vector is full");
+        }
+        data_[size_++] = element;
+    }
+
+    /**
+     * @brief Removes all elements.
+     *
+     */
+    inline void clear() noexcept { size_ = 0; }
+
+    inline size_t size() const noexcept { return size_; }
+
+    inline bool empty() const noexcept { return size_ == 0; }
+
+    static constexpr size_t capacity() noexcept { return N; }
+
+    inline T& operator[](size_t index) noexcept { return data_[index]; }
+
+    inline const T& operator[](size_t index) const noexcept {
+        return data_[index];
+    }
+
+    inline iterator begin() noexcept { return data_.data(); }
+
+    inline iterator end() noexcept { return data_.data() + size_; }
+
+    inline const_iterator begin() const noexcept { return data_.data(); }
+
+    inline const_iterator end() const noexcept { return data_.data() + size_; }
+
+    inline operator std::span<const T>() const noexcept {
+        return std::span<const T>(data_.data(), size_);
+    }
+
+   private:
+    std::array<T, N> data_{};
+    size_t size_{0};
+};
+
+}  // namespace radar
@@ -0,0 +1,691 @@
+/**
+ * @file metrics.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements the latency instrumentation of the radar, which
+ * records scoped timers into per-thread histograms and exports them to
+ * pluggable sinks.
+ * @date 2024-05-16
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Times the rest of the enclosing scope as a sample of the named site.
+ *
+ * The name must be a string literal or have static storage duration. The macro
+ * expands to nothing unless `RADAR_ENABLE_METRICS` is defined, which is set by
+ * the CMake option `RADAR_METRICS`.
+ */
+#ifdef RADAR_ENABLE_METRICS
+#define RADAR_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RADAR_PROFILE_CONCAT(a, b) RADAR_PROFILE_CONCAT_IMPL(a, b)
+#define RADAR_PROFILE_SCOPE(name)                                         \
+    static const int RADAR_PROFILE_CONCAT(radar_profile_site_, __LINE__){ \
+        ::radar::metrics::registerSite(name)};                            \
+    const ::radar::metrics::ScopedTimer RADAR_PROFILE_CONCAT(             \
+        radar_profile_timer_,                                             \
+        __LINE__)(RADAR_PROFILE_CONCAT(radar_profile_site_, __LINE__))
+#else
+#define RADAR_PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
+
+namespace radar::metrics {
+
+constexpr int kMaxSites = 64;
+constexpr int kTraceCapacity = 8192;
+
+/**
+ * @brief A histogram of durations in nanoseconds written by one thread.
+ *
+ * Buckets are spaced logarithmically with 8 linear sub-buckets per power of
+ * two, so quantiles are accurate to 12.5%. The writer updates the counters
+ * with relaxed atomic stores instead of read-modify-write operations, and
+ * readers can snapshot them at any time without locking.
+ */
+class Histogram {
+   public:
+    static constexpr int kSubBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    /**
+     * @brief Records a duration, which must be called by the owner thread.
+     *
+     * @param nanoseconds The duration in nanoseconds.
+     */
+    void record(uint64_t nanoseconds) noexcept {
+        increase(buckets_[bucketOf(nanoseconds)], 1);
+        increase(count_, 1);
+        increase(sum_, nanoseconds);
+        if (nanoseconds > max_.load(std::memory_order_relaxed)) {
+            max_.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Gets the index of the bucket of a duration.
+     *
+     * @param nanoseconds The duration in nanoseconds.
+     * @return The index of the bucket.
+     */
+    static constexpr int bucketOf(uint64_t nanoseconds) noexcept {
+        if (nanoseconds < kSubBuckets) {
+            return static_cast<int>(nanoseconds);
+        }
+        const int exponent = std::bit_width(nanoseconds) - 1;
+        const int sub = static_cast<int>(nanoseconds >> (exponent - kSubBits)) &
+                        (kSubBuckets - 1);
+        return (exponent - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    /**
+     * @brief Gets the upper bound of the durations in a bucket.
+     *
+     * @param bucket The index of the bucket.
+     * @return The exclusive upper bound in nanoseconds.
+     */
+    static constexpr uint64_t upperBoundOf(int bucket) noexcept {
+        if (bucket < kSubBuckets) {
+            return bucket + 1;
+        }
+        const int exponent = bucket / kSubBuckets + kSubBits - 1;
+        const uint64_t sub = bucket % kSubBuckets;
+        return (kSubBuckets + sub + 1) << (exponent - kSubBits);
+    }
+
+    /**
+     * @brief Adds the counters of the histogram to the totals.
+     *
+     * @param buckets The totals of the buckets.
+     * @param count The total number of samples.
+     * @param sum The total duration.
+     * @param max The maximum duration.
+     */
+    void accumulate(std::span<uint64_t, kBuckets> buckets, uint64_t& count,
+                    uint64_t& sum, uint64_t& max) const noexcept {
+        for (int i = 0; i < kBuckets; ++i) {
+            buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+        }
+        count += count_.load(std::memory_order_relaxed);
+        sum += sum_.load(std::memory_order_relaxed);
+        max = std::max(max, max_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Clears the counters.
+     *
+     */
+    void reset() noexcept {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    static void increase(std::atomic<uint64_t>& counter,
+                         uint64_t value) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * @brief A complete event of the trace, whose times are in nanoseconds since
+ * the start of the process.
+ *
+ */
+struct TraceEvent {
+    std::string_view name;
+    int thread;
+    int64_t begin;
+    int64_t duration;
+};
+
+/**
+ * @brief The statistics of a site over all threads, whose times are in
+ * microseconds.
+ *
+ */
+struct SiteStats {
+    std::string_view name;
+    uint64_t count;
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+/**
+ * @brief The samples recorded by one thread.
+ *
+ * Histograms are allocated when a site is registered, or when the recorder
+ * is created for the sites registered before, so recording a sample neither
+ * allocates nor throws. The trace is a ring of the latest events which is only
+ * written while tracing is enabled.
+ */
+class ThreadRecorder {
+   public:
+    /**
+     * @brief Constructs a recorder with the histograms of the sites
+     * registered so far.
+     *
+     * @param thread The index of the thread.
+     * @param sites The number of sites registered so far.
+     */
+    ThreadRecorder(int thread, int sites) : thread_{thread} {
+        for (int site = 0; site < sites; ++site) {
+            reserve(site);
+        }
+    }
+
+    ThreadRecorder(const ThreadRecorder&) = delete;
+    ThreadRecorder& operator=(const ThreadRecorder&) = delete;
+
+    ~ThreadRecorder() {
+        for (auto& histogram : histograms_) {
+            delete histogram.load(std::memory_order_relaxed);
+        }
+        delete[] trace_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Clears the histograms and the trace.
+     *
+     */
+    void reset() noexcept {
+        for (auto& histogram : histograms_) {
+            if (auto* pointer = histogram.load(std::memory_order_acquire)) {
+                pointer->reset();
+            }
+        }
+        trace_size_.store(0, std::memory_order_release);
+    }
+
+    /**
+     * @brief Allocates the histogram of a site if it is not allocated yet,
+     * which may be called from any thread.
+     *
+     * @param site The index of the site.
+     * @throws `std::bad_alloc` if the histogram can not be allocated.
+     */
+    void reserve(int site) {
+        if (histograms_[site].load(std::memory_order_acquire) != nullptr) {
+            return;
+        }
+        auto histogram = std::make_unique<Histogram>();
+        Histogram* expected = nullptr;
+        if (histograms_[site].compare_exchange_strong(
+                expected, histogram.get(), std::memory_order_acq_rel)) {
+            histogram.release();
+        }
+    }
+
+    /**
+     * @brief Gets the histogram of a site, which must be called by the owner
+     * thread.
+     *
+     * @param site The index of the site.
+     * @return The histogram, or `nullptr` if it is neither allocated at
+     * registration nor can be allocated now, in which case the sample is
+     * dropped.
+     */
+    Histogram* histogram(int site) noexcept {
+        auto* histogram = histograms_[site].load(std::memory_order_acquire);
+        if (histogram != nullptr) {
+            return histogram;
+        }
+        try {
+            reserve(site);
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+        return histograms_[site].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Records an event of the trace, which must be called by the owner
+     * thread.
+     *
+     * @param site The index of the site.
+     * @param begin The beginning of the event.
+     * @param duration The duration of the event.
+     */
+    void trace(int site, int64_t begin, int64_t duration) noexcept {
+        auto* trace = trace_.load(std::memory_order_relaxed);
+        if (trace == nullptr) {
+            trace = new (std::nothrow) Slot[kTraceCapacity];
+            if (trace == nullptr) {
+                return;
+            }
+            trace_.store(trace, std::memory_order_release);
+        }
+        const uint64_t index = trace_size_.load(std::memory_order_relaxed);
+        auto& slot = trace[index % kTraceCapacity];
+        slot.site.store(site, std::memory_order_relaxed);
+        slot.begin.store(begin, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        trace_size_.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Finds the histogram of a site from any thread.
+     *
+     * @param site The index of the site.
+     * @return The histogram, or `nullptr` if the site has no sample.
+     */
+    const Histogram* find(int site) const noexcept {
+        return histograms_[site].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Appends the latest events of the thread, which may include an
+     * event being overwritten if the thread is still tracing.
+     *
+     * @param names The names of the sites.
+     * @param events The events appended to.
+     */
+    void collectTrace(std::span<const std::string> names,
+                      std::vector<TraceEvent>& events) const {
+        const uint64_t size = trace_size_.load(std::memory_order_acquire);
+        const auto* trace = trace_.load(std::memory_order_acquire);
+        if (trace == nullptr) {
+            return;
+        }
+        const uint64_t first =
+            size > kTraceCapacity ? size - kTraceCapacity : 0;
+        for (uint64_t i = first; i < size; ++i) {
+            const auto& slot = trace[i % kTraceCapacity];
+            events.emplace_back(TraceEvent{
+                .name = names[slot.site.load(std::memory_order_relaxed)],
+                .thread = thread_,
+                .begin = slot.begin.load(std::memory_order_relaxed),
+                .duration = slot.duration.load(std::memory_order_relaxed)});
+        }
+    }
+
+   private:
+    struct Slot {
+        std::atomic<int> site{0};
+        std::atomic<int64_t> begin{0};
+        std::atomic<int64_t> duration{0};
+    };
+
+    int thread_;
+    std::array<std::atomic<Histogram*>, kMaxSites> histograms_{};
+    std::atomic<Slot*> trace_{nullptr};
+    std::atomic<uint64_t> trace_size_{0};
+};
+
+/**
+ * @brief The registry of the sites and the recorders of all threads, which
+ * keeps the samples of threads that have exited until the process ends.
+ *
+ */
+class Registry {
+   public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    int site(std::string_view name) {
+        std::lock_guard lock(mutex_);
+        auto iter = std::ranges::find(names_, name);
+        if (iter != names_.end()) {
+            return static_cast<int>(iter - names_.begin());
+        }
+        if (names_.size() == kMaxSites) {
+            throw std::length_error("too many metric sites");
+        }
+        const int site = static_cast<int>(names_.size());
+        for (const auto& recorder : recorders_) {
+            recorder->reserve(site);
+        }
+        names_.emplace_back(name);
+        return site;
+    }
+
+    /**
+     * @brief Gets the recorder of the calling thread, which is created on the
+     * first call of the thread.
+     *
+     * @return The recorder, or `nullptr` if it can not be created, in which
+     * case the samples of the thread are dropped.
+     */
+    ThreadRecorder* recorder() noexcept {
+        thread_local ThreadRecorder* recorder = [this]() -> ThreadRecorder* {
+            try {
+                std::lock_guard lock(mutex_);
+                recorders_.emplace_back(std::make_unique<ThreadRecorder>(
+                    static_cast<int>(recorders_.size()),
+                    static_cast<int>(names_.size())));
+                return recorders_.back().get();
+            } catch (...) {
+                return nullptr;
+            }
+        }();
+        return recorder;
+    }
+
+    std::vector<SiteStats> stats() {
+        std::lock_guard lock(mutex_);
+        std::vector<SiteStats> stats;
+        std::array<uint64_t, Histogram::kBuckets> buckets;
+        for (size_t site = 0; site < names_.size(); ++site) {
+            buckets.fill(0);
+            uint64_t count = 0, sum = 0, max = 0;
+            for (const auto& recorder : recorders_) {
+                if (const auto* histogram = recorder->find(site)) {
+                    histogram->accumulate(buckets, count, sum, max);
+                }
+            }
+            if (count == 0) {
+                continue;
+            }
+            stats.emplace_back(SiteStats{
+                .name = names_[site],
+                .count = count,
+                .mean = sum * 1e-3 / count,
+                .p50 = quantile(buckets, count, 0.50) * 1e-3,
+                .p99 = quantile(buckets, count, 0.99) * 1e-3,
+                .max = max * 1e-3});
+        }
+        return stats;
+    }
+
+    void reset() {
+        std::lock_guard lock(mutex_);
+        for (const auto& recorder : recorders_) {
+            recorder->reset();
+        }
+    }
+
+    std::vector<TraceEvent> trace() {
+        std::lock_guard lock(mutex_);
+        std::vector<TraceEvent> events;
+        for (const auto& recorder : recorders_) {
+            recorder->collectTrace(names_, events);
+        }
+        std::ranges::sort(events, {}, &TraceEvent::begin);
+        return events;
+    }
+
+    std::atomic<bool> tracing{false};
+    const std::chrono::steady_clock::time_point start{
+        std::chrono::steady_clock::now()};
+
+   private:
+    Registry() { names_.reserve(kMaxSites); }
+
+    static uint64_t quantile(std::span<const uint64_t> buckets, uint64_t count,
+                             double q) noexcept {
+        const auto rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < Histogram::kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return Histogram::upperBoundOf(i);
+            }
+        }
+        return Histogram::upperBoundOf(Histogram::kBuckets - 1);
+    }
+
+    std::mutex mutex_;
+    // Names are reserved and never erased, so views of them stay valid
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<ThreadRecorder>> recorders_;
+};
+
+/**
+ * @brief Registers a site, or finds it if the name has been registered.
+ *
+ * @param name The name of the site.
+ * @return The index of the site.
+ * @throws `std::length_error` if there are already `kMaxSites` sites.
+ */
+inline int registerSite(std::string_view name) {
+    return Registry::instance().site(name);
+}
+
+/**
+ * @brief Records a duration of a site measured elsewhere, such as the elapsed
+ * time between CUDA events.
+ *
+ * @param site The index of the site.
+ * @param duration The duration.
+ */
+inline void record(int site, std::chrono::nanoseconds duration) noexcept {
+    auto* recorder = Registry::instance().recorder();
+    if (recorder == nullptr) {
+        return;
+    }
+    if (auto* histogram = recorder->histogram(site)) {
+        histogram->record(std::max<int64_t>(duration.count(), 0));
+    }
+}
+
+/**
+ * @brief Enables or disables recording the events of scoped timers for the
+ * trace, which keeps the latest `kTraceCapacity` events of each thread.
+ *
+ * @param enabled Whether the trace is recorded.
+ */
+inline void setTracing(bool enabled) noexcept {
+    Registry::instance().tracing.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief A timer recording the lifetime of its scope into the histogram of a
+ * site, and into the trace if tracing is enabled.
+ *
+ */
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(int site) noexcept
+        : site_{site}, begin_{std::chrono::steady_clock::now()} {}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        const auto end = std::chrono::steady_clock::now();
+        auto& registry = Registry::instance();
+        auto* recorder = registry.recorder();
+        if (recorder == nullptr) {
+            return;
+        }
+        const auto duration =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin_)
+                .count();
+        if (auto* histogram = recorder->histogram(site_)) {
+            histogram->record(duration);
+        }
+        if (registry.tracing.load(std::memory_order_relaxed)) {
+            recorder->trace(
+                site_,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    begin_ - registry.start)
+                    .count(),
+                duration);
+        }
+    }
+
+   private:
+    int site_;
+    std::chrono::steady_clock::time_point begin_;
+};
+
+/**
+ * @brief The interface of the destinations of metrics.
+ *
+ */
+class Sink {
+   public:
+    virtual ~Sink() = default;
+
+    /**
+     * @brief Writes the metrics.
+     *
+     * @param stats The statistics of each site with samples.
+     * @param events The events of the trace sorted by their beginning, which
+     * are empty if tracing has never been enabled.
+     */
+    virtual void write(std::span<const SiteStats> stats,
+                       std::span<const TraceEvent> events) = 0;
+};
+
+/**
+ * @brief A sink printing a summary table of the sites.
+ *
+ */
+class StreamSink : public Sink {
+   public:
+    explicit StreamSink(std::ostream& os = std::cout) : os_{os} {}
+
+    void write(std::span<const SiteStats> stats,
+               std::span<const TraceEvent>) override {
+        os_ << std::left << std::setw(28) << "site" << std::right
+            << std::setw(10) << "count" << std::setw(12) << "mean(us)"
+            << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+            << std::setw(12) << "max(us)" << '\n';
+        os_ << std::fixed << std::setprecision(1);
+        for (const auto& site : stats) {
+            os_ << std::left << std::setw(28) << site.name << std::right
+                << std::setw(10) << site.count << std::setw(12) << site.mean
+                << std::setw(12) << site.p50 << std::setw(12) << site.p99
+                << std::setw(12) << site.max << '\n';
+        }
+        os_.flush();
+    }
+
+   private:
+    std::ostream& os_;
+};
+
+/**
+ * @brief A sink writing the statistics of the sites as CSV.
+ *
+ */
+class CsvSink : public Sink {
+   public:
+    /**
+     * @brief Constructs the sink with the file written to.
+     *
+     * @param path The path of the CSV file, which is overwritten.
+     */
+    explicit CsvSink(std::string path) : path_{std::move(path)} {}
+
+    /**
+     * @brief Writes the statistics.
+     *
+     * @throws `std::runtime_error` if the file can not be opened.
+     */
+    void write(std::span<const SiteStats> stats,
+               std::span<const TraceEvent>) override {
+        std::ofstream file(path_);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open metrics file");
+        }
+        file << "site,count,mean_us,p50_us,p99_us,max_us\n";
+        for (const auto& site : stats) {
+            file << site.name << ',' << site.count << ',' << site.mean << ','
+                 << site.p50 << ',' << site.p99 << ',' << site.max << '\n';
+        }
+    }
+
+   private:
+    std::string path_;
+};
+
+/**
+ * @brief A sink writing the events as a Chrome trace in JSON, which can be
+ * opened by `chrome://tracing` or Perfetto.
+ *
+ */
+class ChromeTraceSink : public Sink {
+   public:
+    /**
+     * @brief Constructs the sink with the file written to.
+     *
+     * @param path The path of the JSON file, which is overwritten.
+     */
+    explicit ChromeTraceSink(std::string path) : path_{std::move(path)} {}
+
+    /**
+     * @brief Writes the events.
+     *
+     * @throws `std::runtime_error` if the file can not be opened.
+     */
+    void write(std::span<const SiteStats>,
+               std::span<const TraceEvent> events) override {
+        std::ofstream file(path_);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open trace file");
+        }
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); ++i) {
+            const auto& event = events[i];
+            file << (i == 0 ? "" : ",") << "\n{\"name\":\"" << event.name
+                 << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+                 << ",\"ts\":" << event.begin * 1e-3
+                 << ",\"dur\":" << event.duration * 1e-3 << '}';
+        }
+        file << "\n]}\n";
+    }
+
+   private:
+    std::string path_;
+};
+
+/**
+ * @brief Clears the samples of all threads, such as between runs of a
+ * benchmark.
+ *
+ * @note Samples recorded at the same time may be partially cleared, so this
+ * should be called while no site is being timed.
+ */
+inline void reset() { Registry::instance().reset(); }
+
+/**
+ * @brief Writes the metrics of all threads recorded so far to a sink.
+ *
+ * @param sink The sink.
+ */
+inline void report(Sink& sink) {
+    auto& registry = Registry::instance();
+    const auto stats = registry.stats();
+    const auto events = registry.trace();
+    sink.write(stats, events);
+}
+
+}  // namespace radar::metrics
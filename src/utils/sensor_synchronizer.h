@@ -0,0 +1,265 @@
+/**
+ * @file sensor_synchronizer.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a synchronizer of camera frames and lidar
+ * sweeps, which are captured at their own rates and paired by the nearest time
+ * stamps.
+ * @date 2024-05-19
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace radar {
+
+/**
+ * @brief Pairs camera frames with the lidar sweeps nearest to them in time.
+ *
+ * The camera and the lidar push their data with the capture time stamps from
+ * their own threads, and the consumer pops every camera frame in order with
+ * the sweep whose time stamp is the nearest to it. A frame is paired as soon
+ * as a sweep at or after its time stamp has arrived, since no later sweep can
+ * be nearer, or when it has waited for `max_wait` since it was pushed, so
+ * that a late or lost sweep delays the frame for a bounded time only.
+ *
+ * A sweep is paired with every frame it is the nearest to, so when the camera
+ * runs faster than the lidar consecutive pairs share the same sweep, which can
+ * be told by its time stamp. Sweeps farther than `max_offset` from the frame
+ * are not paired.
+ *
+ * @tparam Image The type of camera frames, which must be movable.
+ * @tparam Cloud The type of lidar sweeps, which must be copyable and is
+ * usually a shared pointer.
+ */
+template <typename Image, typename Cloud>
+class SensorSynchronizer {
+   public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    /**
+     * @brief A camera frame and the lidar sweep paired with it.
+     *
+     */
+    struct Pair {
+        Image image;
+        Clock::time_point image_timestamp;
+        // The nearest sweep, or `std::nullopt` if no sweep is within the
+        // maximum offset.
+        std::optional<Cloud> cloud;
+        Clock::time_point cloud_timestamp;
+    };
+
+    /**
+     * @brief Constructs a synchronizer.
+     *
+     * @param capacity The maximum number of frames and sweeps kept each, over
+     * which the oldest frame is dropped and the oldest sweep is forgotten.
+     * @param max_offset The maximum difference of the time stamps of a frame
+     * and its sweep.
+     * @param max_wait The maximum time a frame waits for a later sweep.
+     * @throws `std::invalid_argument` if the capacity is zero.
+     */
+    SensorSynchronizer(size_t capacity, std::chrono::nanoseconds max_offset,
+                       std::chrono::nanoseconds max_wait)
+        : capacity_{capacity}, max_offset_{max_offset}, max_wait_{max_wait} {
+        if (capacity == 0) {
+            throw std::invalid_argument("capacity must be positive");
+        }
+    }
+
+    SensorSynchronizer(const SensorSynchronizer&) = delete;
+    SensorSynchronizer& operator=(const SensorSynchronizer&) = delete;
+
+    /**
+     * @brief Pushes a camera frame, whose time stamp must not be earlier than
+     * those pushed before.
+     *
+     * @param image The frame.
+     * @param timestamp The capture time of the frame.
+     * @return `true` if the frame is pushed, `false` if the synchronizer is
+     * closed.
+     * @note If the consumer falls behind and `capacity` frames are waiting,
+     * the oldest one is dropped.
+     */
+    bool pushImage(Image image, Clock::time_point timestamp) {
+        {
+            std::lock_guard lock(mutex_);
+            if (closed_) {
+                return false;
+            }
+            if (images_.size() == capacity_) {
+                images_.pop_front();
+                ++dropped_;
+            }
+            images_.push_back({.image = std::move(image),
+                               .timestamp = timestamp,
+                               .deadline = std::chrono::steady_clock::now() +
+                                           max_wait_,
+                               .sequence = sequence_++});
+        }
+        cv_.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Pushes a lidar sweep, whose time stamp must not be earlier than
+     * those pushed before.
+     *
+     * @param cloud The sweep.
+     * @param timestamp The capture time of the sweep.
+     * @return `true` if the sweep is pushed, `false` if the synchronizer is
+     * closed.
+     */
+    bool pushCloud(Cloud cloud, Clock::time_point timestamp) {
+        {
+            std::lock_guard lock(mutex_);
+            if (closed_) {
+                return false;
+            }
+            if (clouds_.size() == capacity_) {
+                clouds_.pop_front();
+            }
+            clouds_.push_back({.cloud = std::move(cloud),
+                               .timestamp = timestamp});
+        }
+        cv_.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Pops the oldest camera frame with its sweep, waiting until the
+     * frame can be paired.
+     *
+     * @return The pair, or `std::nullopt` if the synchronizer is closed and
+     * every frame has been popped. Frames still waiting when it is closed are
+     * paired with the sweeps already pushed.
+     */
+    std::optional<Pair> pop() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return closed_ || !images_.empty(); });
+            if (images_.empty()) {
+                return std::nullopt;
+            }
+            const auto timestamp = images_.front().timestamp;
+            const auto deadline = images_.front().deadline;
+            const auto sequence = images_.front().sequence;
+            cv_.wait_until(lock, deadline, [&] {
+                return closed_ || images_.empty() ||
+                       images_.front().sequence != sequence ||
+                       (!clouds_.empty() &&
+                        clouds_.back().timestamp >= timestamp);
+            });
+            // The frame may have been dropped while waiting
+            if (!images_.empty() && images_.front().sequence == sequence) {
+                break;
+            }
+        }
+
+        auto& front = images_.front();
+        Pair pair{.image = std::move(front.image),
+                  .image_timestamp = front.timestamp,
+                  .cloud = std::nullopt,
+                  .cloud_timestamp = {}};
+        images_.pop_front();
+
+        // Sweeps are in order of time, so the nearest one is either the last
+        // sweep before the frame or the first one after it, and the sweeps
+        // before the nearest one are never the nearest to a later frame
+        if (clouds_.empty()) {
+            return pair;
+        }
+        auto nearest = clouds_.begin();
+        while (std::next(nearest) != clouds_.end() &&
+               gap(std::next(nearest)->timestamp, pair.image_timestamp) <=
+                   gap(nearest->timestamp, pair.image_timestamp)) {
+            ++nearest;
+        }
+        if (gap(nearest->timestamp, pair.image_timestamp) <= max_offset_) {
+            pair.cloud = nearest->cloud;
+            pair.cloud_timestamp = nearest->timestamp;
+        }
+        clouds_.erase(clouds_.begin(), nearest);
+        return pair;
+    }
+
+    /**
+     * @brief Closes the synchronizer. Subsequent pushes fail, and pops return
+     * the remaining frames without waiting before returning `std::nullopt`.
+     */
+    void close() {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    /**
+     * @brief Discards every frame and sweep and reopens the synchronizer.
+     *
+     * @note This must not be called while other threads use it.
+     */
+    void reset() {
+        std::lock_guard lock(mutex_);
+        images_.clear();
+        clouds_.clear();
+        closed_ = false;
+    }
+
+    /**
+     * @brief Gets the number of frames dropped because the consumer fell
+     * behind.
+     *
+     * @return The number of dropped frames.
+     */
+    size_t dropped() const {
+        std::lock_guard lock(mutex_);
+        return dropped_;
+    }
+
+   private:
+    struct PendingImage {
+        Image image;
+        Clock::time_point timestamp;
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence;
+    };
+
+    struct PendingCloud {
+        Cloud cloud;
+        Clock::time_point timestamp;
+    };
+
+    static std::chrono::nanoseconds gap(Clock::time_point lhs,
+                                        Clock::time_point rhs) noexcept {
+        return lhs > rhs ? lhs - rhs : rhs - lhs;
+    }
+
+    const size_t capacity_;
+    const std::chrono::nanoseconds max_offset_;
+    const std::chrono::nanoseconds max_wait_;
+    std::deque<PendingImage> images_;
+    std::deque<PendingCloud> clouds_;
+    uint64_t sequence_{0};
+    size_t dropped_{0};
+    bool closed_{false};
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+}  // namespace radar
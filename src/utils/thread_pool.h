@@ -0,0 +1,214 @@
+/**
+ * @file thread_pool.h
+ * @author zmsbruce (zmsbruce@163.com)
+ * @brief This file implements a pool of persistent worker threads, which runs
+ * loops over index ranges in parallel for the stages of the radar pipeline.
+ * @date 2024-05-15
+ *
+ * @copyright (c) 2024 HITCRT
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace radar {
+
+/**
+ * @brief A pool of worker threads started once at construction.
+ *
+ * `parallelFor` splits an index range into chunks, which are taken one by one
+ * by the calling thread and the workers. The calling thread always takes part,
+ * so the loop completes even if every worker is busy, and the pool can be used
+ * from several stage threads or inside another parallel loop.
+ *
+ */
+class ThreadPool {
+   public:
+    /**
+     * @brief Constructs a pool and starts its workers.
+     *
+     * @param threads The number of workers, where 0 means one less than the
+     * number of hardware threads, as the calling thread also works.
+     */
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) {
+            threads = std::max(
+                static_cast<int>(std::thread::hardware_concurrency()) - 1, 1);
+        }
+        workers_.reserve(threads);
+        for (int i = 0; i < threads; ++i) {
+            workers_.emplace_back(
+                [this](std::stop_token stop) { workerLoop(stop); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Stops the workers after the queued tasks are dropped.
+     *
+     */
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            std::queue<std::function<void()>>().swap(tasks_);
+        }
+        for (auto& worker : workers_) {
+            worker.request_stop();
+        }
+        not_empty_.notify_all();
+    }
+
+    /**
+     * @brief Gets the number of workers.
+     *
+     * @return The number of workers.
+     */
+    inline int size() const noexcept {
+        return static_cast<int>(workers_.size());
+    }
+
+    /**
+     * @brief Calls a function for the chunks of an index range in parallel and
+     * waits for all of them.
+     *
+     * The range is split into at most one chunk for each thread, each of which
+     * has at least `grain` indices. If the range is not larger than `grain`,
+     * the function is called once on the calling thread without waking any
+     * worker.
+     *
+     * @param begin The first index of the range.
+     * @param end One past the last index of the range.
+     * @param grain The minimum number of indices in one chunk.
+     * @param func The function called as `func(chunk_begin, chunk_end)`, which
+     * must be safe to call concurrently on disjoint chunks.
+     * @throws The first exception thrown by `func`, after all chunks end.
+     */
+    template <typename Func>
+    void parallelFor(int begin, int end, int grain, Func&& func) {
+        const int count = end - begin;
+        if (count <= 0) {
+            return;
+        }
+        grain = std::max(grain, 1);
+        const int chunks = std::min((count + grain - 1) / grain, size() + 1);
+        if (chunks <= 1) {
+            func(begin, end);
+            return;
+        }
+
+        // Helpers may start after the loop returns, so the state they share is
+        // owned by them as well and the function is only called for chunks
+        // taken before the last one is done
+        auto loop = std::make_shared<Loop>();
+        loop->begin = begin;
+        loop->end = end;
+        loop->chunks = chunks;
+        loop->context =
+            const_cast<void*>(static_cast<const void*>(std::addressof(func)));
+        loop->call = [](void* context, int chunk_begin, int chunk_end) {
+            (*static_cast<std::remove_reference_t<Func>*>(context))(
+                chunk_begin, chunk_end);
+        };
+        {
+            std::lock_guard lock(mutex_);
+            for (int i = 1; i < chunks; ++i) {
+                tasks_.emplace([loop] { loop->run(); });
+            }
+        }
+        not_empty_.notify_all();
+
+        loop->run();
+        for (int done = loop->done.load(); done < chunks;
+             done = loop->done.load()) {
+            loop->done.wait(done);
+        }
+        if (loop->error) {
+            std::rethrow_exception(loop->error);
+        }
+    }
+
+   private:
+    /**
+     * @brief The state of one parallel loop shared by the threads.
+     *
+     */
+    struct Loop {
+        /**
+         * @brief Takes and runs chunks until none is left.
+         *
+         */
+        void run() noexcept {
+            for (int chunk = next.fetch_add(1); chunk < chunks;
+                 chunk = next.fetch_add(1)) {
+                const long count = end - begin;
+                const int chunk_begin = begin + count * chunk / chunks;
+                const int chunk_end = begin + count * (chunk + 1) / chunks;
+                try {
+                    call(context, chunk_begin, chunk_end);
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (done.fetch_add(1) + 1 == chunks) {
+                    done.notify_all();
+                }
+            }
+        }
+
+        int begin;
+        int end;
+        int chunks;
+        void* context;
+        void (*call)(void*, int, int);
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    /**
+     * @brief Runs queued tasks until the worker is stopped.
+     *
+     * @param stop The stop token of the worker.
+     */
+    void workerLoop(std::stop_token stop) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                if (!not_empty_.wait(lock, stop,
+                                     [this] { return !tasks_.empty(); })) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable_any not_empty_;
+    std::queue<std::function<void()>> tasks_;
+    std::vector<std::jthread> workers_;
+};
+
+}  // namespace radar
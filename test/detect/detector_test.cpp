@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
 #include <opencv2/opencv.hpp>
+#include <span>
 #include <string_view>
 #include <vector>
 
@@ -9,6 +11,7 @@
 #define protected public
 
 #include "detect/detector.h"
+#include "utils/metrics.h"
 
 #undef private
 #undef protected
@@ -29,8 +32,9 @@ TEST_F(DetectTest, TestSingleBatchPreprocess) {
     std::string image_path{"../test/detect/bus.jpg"};
     cv::Mat image = cv::imread(image_path, cv::IMREAD_COLOR);
 
-    auto pparams = detector->preprocess(image);
-    CUDA_CHECK(cudaStreamSynchronize(detector->streams_[0]));
+    auto& slot{*detector->slots_[0]};
+    auto pparams = detector->preprocess(slot, image);
+    CUDA_CHECK(cudaStreamSynchronize(slot.streams[0]));
 
     ASSERT_EQ(pparams.size(), 1);
 
@@ -47,9 +51,10 @@ TEST_F(DetectTest, TestMultiBatchPreprocess) {
         cv::imread("../test/detect/zidane.jpg", cv::IMREAD_COLOR);
 
     std::vector<cv::Mat> images{image_bus, image_zidane};
-    auto pparams = detector->preprocess(images);
+    auto& slot{*detector->slots_[0]};
+    auto pparams = detector->preprocess(slot, images);
     for (size_t i = 0; i < images.size(); ++i) {
-        CUDA_CHECK(cudaStreamSynchronize(detector->streams_[i]));
+        CUDA_CHECK(cudaStreamSynchronize(slot.streams[i]));
     }
 
     ASSERT_EQ(pparams.size(), images.size());
@@ -87,4 +92,154 @@ TEST_F(DetectTest, TestMultiBatchDetect) {
 
     ASSERT_GT(detections[1].size(), 0);
     ASSERT_LT(detections[1].size(), 10);
-}
\ No newline at end of file
+}
+
+TEST_F(DetectTest, TestAsyncDetect) {
+    cv::Mat image_bus = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    cv::Mat image_zidane =
+        cv::imread("../test/detect/zidane.jpg", cv::IMREAD_COLOR);
+    auto detections_bus{detector->detect(image_bus)};
+    auto detections_zidane{detector->detect(image_zidane)};
+
+    // Keeps two frames in flight, and waits in reverse order
+    auto ticket_bus{detector->enqueue(image_bus)};
+    auto ticket_zidane{detector->enqueue(image_zidane)};
+    EXPECT_THROW(detector->enqueue(image_bus), std::runtime_error);
+    EXPECT_THROW(detector->detect(image_bus), std::runtime_error);
+
+    auto async_zidane{ticket_zidane.wait()};
+    auto async_bus{ticket_bus.wait()};
+    EXPECT_TRUE(ticket_bus.ready());
+    ASSERT_EQ(async_bus.size(), 1);
+    ASSERT_EQ(async_zidane.size(), 1);
+    EXPECT_EQ(async_bus[0].size(), detections_bus.size());
+    EXPECT_EQ(async_zidane[0].size(), detections_zidane.size());
+}
+
+TEST_F(DetectTest, TestReleaseSlot) {
+    cv::Mat image_bus = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    for (int i = 0; i < detector->numSlots() * 2; ++i) {
+        auto ticket{detector->enqueue(image_bus)};
+        EXPECT_TRUE(ticket.valid());
+    }
+    radar::DetectionTicket ticket{detector->enqueue(image_bus)};
+    auto moved{std::move(ticket)};
+    EXPECT_FALSE(ticket.valid());
+    EXPECT_GT(moved.wait()[0].size(), 0);
+}
+
+TEST_F(DetectTest, TestRegionDetect) {
+    cv::Mat image_bus = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    std::vector<cv::Rect> rois{cv::Rect(0, 0, 400, 800),
+                               cv::Rect(200, 300, 600, 700)};
+    std::vector<cv::Mat> crops;
+    for (const auto& roi : rois) {
+        crops.emplace_back(image_bus(roi).clone());
+    }
+    auto detections{detector->detect(crops)};
+
+    auto ticket{detector->enqueue(image_bus)};
+    ticket.wait();
+    auto image{ticket.image()};
+    ASSERT_EQ(image.width, image_bus.cols);
+    ASSERT_EQ(image.height, image_bus.rows);
+
+    auto region_detections{detector->enqueue(image, rois).wait()};
+    ASSERT_EQ(region_detections.size(), rois.size());
+    for (size_t i = 0; i < rois.size(); ++i) {
+        EXPECT_EQ(region_detections[i].size(), detections[i].size());
+    }
+
+    EXPECT_THROW(detector->enqueue(image, std::vector<cv::Rect>{}),
+                 std::invalid_argument);
+    EXPECT_THROW(detector->enqueue(
+                     image, std::vector<cv::Rect>{cv::Rect(0, 0, 2000, 10)}),
+                 std::invalid_argument);
+}
+
+TEST_F(DetectTest, TestMultiImageRegionDetect) {
+    cv::Mat image_bus = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    cv::Mat image_zidane =
+        cv::imread("../test/detect/zidane.jpg", cv::IMREAD_COLOR);
+    std::vector<cv::Mat> images{image_bus, image_zidane};
+    auto detections{detector->detect(images)};
+
+    auto ticket{detector->enqueue(images)};
+    ticket.wait();
+    std::vector<radar::detect::Region> regions;
+    for (size_t i = 0; i < images.size(); ++i) {
+        regions.emplace_back(radar::detect::Region{
+            .image = ticket.image(i),
+            .rect = cv::Rect(0, 0, images[i].cols, images[i].rows)});
+    }
+
+    auto region_detections{detector->enqueue(regions).wait()};
+    ASSERT_EQ(region_detections.size(), images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        EXPECT_EQ(region_detections[i].size(), detections[i].size());
+    }
+
+    regions[1].rect = cv::Rect(0, 0, image_bus.cols, image_bus.rows + 1);
+    EXPECT_THROW(detector->enqueue(regions), std::invalid_argument);
+}
+
+TEST_F(DetectTest, TestGraphDetect) {
+    cv::Mat image_bus = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    cv::Mat image_zidane =
+        cv::imread("../test/detect/zidane.jpg", cv::IMREAD_COLOR);
+    std::vector<cv::Mat> images{image_bus, image_zidane};
+    auto detections{detector->detect(images)};
+
+    auto graph_detector{std::make_unique<radar::Detector>(
+        model_path, 80, 10, std::nullopt, 1 << 24, 0.65f, 0.25f, 640, 640,
+        "images", 3, 0, 1, false, true)};
+    // The first batch of each size is captured, and the later ones replay it
+    for (int i = 0; i < 3; ++i) {
+        auto graph_detections{graph_detector->detect(images)};
+        ASSERT_EQ(graph_detections.size(), detections.size());
+        for (size_t j = 0; j < detections.size(); ++j) {
+            EXPECT_EQ(graph_detections[j].size(), detections[j].size());
+        }
+    }
+    EXPECT_TRUE(graph_detector->use_graph_);
+    EXPECT_NE(graph_detector->slots_[0]->graphs[images.size()], nullptr);
+}
+
+TEST_F(DetectTest, TestGraphTiming) {
+#ifndef RADAR_ENABLE_METRICS
+    GTEST_SKIP() << "metrics are disabled";
+#else
+    cv::Mat image = cv::imread("../test/detect/bus.jpg", cv::IMREAD_COLOR);
+    auto graph_detector{std::make_unique<radar::Detector>(
+        model_path, 80, 10, std::nullopt, 1 << 24, 0.65f, 0.25f, 640, 640,
+        "images", 3, 0, 1, false, true)};
+    // Captures the graph of the batch, then only counts the replays of it
+    graph_detector->detect(image);
+    ASSERT_NE(graph_detector->slots_[0]->graphs[1], nullptr);
+    radar::metrics::reset();
+    constexpr int replays{3};
+    for (int i = 0; i < replays; ++i) {
+        graph_detector->detect(image);
+    }
+
+    std::vector<radar::metrics::SiteStats> stats;
+    struct Collector : radar::metrics::Sink {
+        std::vector<radar::metrics::SiteStats>& stats;
+        explicit Collector(std::vector<radar::metrics::SiteStats>& stats)
+            : stats{stats} {}
+        void write(std::span<const radar::metrics::SiteStats> sites,
+                   std::span<const radar::metrics::TraceEvent>) override {
+            stats.assign(sites.begin(), sites.end());
+        }
+    } collector(stats);
+    radar::metrics::report(collector);
+    for (std::string_view name : {"detect.gpu.letterbox", "detect.gpu.infer",
+                                  "detect.gpu.postprocess"}) {
+        auto iter = std::ranges::find(stats, name,
+                                      &radar::metrics::SiteStats::name);
+        ASSERT_NE(iter, stats.end()) << name;
+        EXPECT_EQ(iter->count, replays) << name;
+        EXPECT_GT(iter->max, 0.0) << name;
+    }
+#endif
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "detect/calibrator.h"
+#include "detect/engine_cache.h"
+
+class EngineCacheTest : public ::testing::Test {
+   protected:
+    std::filesystem::path onnx_path{std::filesystem::temp_directory_path() /
+                                    "engine_cache_test.onnx"};
+    radar::detect::EngineProfile profile{1, 2, 4, 3, 640, 640, true, false, 3};
+
+    void writeModel(const std::string& content) {
+        std::ofstream ofs(onnx_path, std::ios::binary);
+        ofs << content;
+    }
+
+    virtual void SetUp() { writeModel("model"); }
+
+    virtual void TearDown() { std::filesystem::remove(onnx_path); }
+};
+
+TEST_F(EngineCacheTest, TestHash) {
+    EXPECT_EQ(radar::detect::fnv1a(""), 0xcbf29ce484222325ULL);
+    EXPECT_EQ(radar::detect::fnv1a("a"), 0xaf63dc4c8601ec8cULL);
+    EXPECT_EQ(radar::detect::hashFile(onnx_path.string()),
+              radar::detect::fnv1a("model"));
+}
+
+TEST_F(EngineCacheTest, TestKey) {
+    auto key{radar::detect::engineKey(onnx_path.string(), profile)};
+    ASSERT_EQ(key.size(), 16);
+    EXPECT_EQ(radar::detect::engineKey(onnx_path.string(), profile), key);
+
+    auto other_profile{profile};
+    other_profile.max_batch_size = 8;
+    EXPECT_NE(radar::detect::engineKey(onnx_path.string(), other_profile), key);
+    other_profile = profile;
+    other_profile.fp16 = false;
+    EXPECT_NE(radar::detect::engineKey(onnx_path.string(), other_profile), key);
+    other_profile = profile;
+    other_profile.input_name = "input";
+    EXPECT_NE(radar::detect::engineKey(onnx_path.string(), other_profile), key);
+
+    writeModel("another model");
+    EXPECT_NE(radar::detect::engineKey(onnx_path.string(), profile), key);
+}
+
+TEST_F(EngineCacheTest, TestCachedHash) {
+    EXPECT_EQ(radar::detect::cachedHashFile(onnx_path.string()),
+              radar::detect::fnv1a("model"));
+
+    // Content of the same size is hashed again once the file is modified
+    const auto mtime{std::filesystem::last_write_time(onnx_path)};
+    writeModel("other");
+    std::filesystem::last_write_time(onnx_path,
+                                     mtime + std::chrono::seconds(1));
+    EXPECT_EQ(radar::detect::cachedHashFile(onnx_path.string()),
+              radar::detect::fnv1a("other"));
+    EXPECT_THROW(radar::detect::cachedHashFile("not_exist.onnx"),
+                 std::runtime_error);
+}
+
+TEST_F(EngineCacheTest, TestCalibrationHash) {
+    const auto cache_path{std::filesystem::temp_directory_path() /
+                          "engine_cache_test.calib"};
+    const radar::detect::Int8Config config{.image_dir = "images",
+                                           .cache_path = cache_path.string()};
+    const auto hash{radar::detect::hashInt8Config(config)};
+
+    // The calibration cache is hashed once it is written, and a new cache
+    // changes the hash
+    std::ofstream(cache_path, std::ios::binary) << "calibration";
+    const auto cached_hash{radar::detect::hashInt8Config(config)};
+    EXPECT_NE(cached_hash, hash);
+    std::ofstream(cache_path, std::ios::binary) << "another calibration";
+    EXPECT_NE(radar::detect::hashInt8Config(config), cached_hash);
+    std::filesystem::remove(cache_path);
+    EXPECT_EQ(radar::detect::hashInt8Config(config), hash);
+}
+
+TEST_F(EngineCacheTest, TestPath) {
+    EXPECT_EQ(radar::detect::cachedEnginePath("models/car.engine", "0123"),
+              "models/car.0123.engine");
+    auto timing_path{radar::detect::timingCachePath("models/car.engine")};
+    EXPECT_EQ(std::filesystem::path(timing_path).parent_path(), "models");
+    EXPECT_EQ(radar::detect::timingCachePath("models/armor.engine"),
+              timing_path);
+}
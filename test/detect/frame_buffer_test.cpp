@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "detect/frame_buffer.h"
+
+TEST(FrameBufferTest, TestPool) {
+    EXPECT_THROW(radar::detect::FrameBufferPool(cv::Size(0, 480), CV_8UC3, 2),
+                 std::invalid_argument);
+    EXPECT_THROW(radar::detect::FrameBufferPool(cv::Size(640, 480), CV_8UC3, 0),
+                 std::invalid_argument);
+
+    radar::detect::FrameBufferPool pool(cv::Size(640, 480), CV_8UC3, 2);
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_EQ(pool.imageSize(), cv::Size(640, 480));
+
+    auto first = pool.acquire();
+    auto second = pool.acquire();
+    ASSERT_TRUE(first.valid());
+    ASSERT_TRUE(second.valid());
+    EXPECT_NE(first.image().data, second.image().data);
+    EXPECT_EQ(first.image().size(), cv::Size(640, 480));
+    EXPECT_EQ(first.image().type(), CV_8UC3);
+    EXPECT_TRUE(first.image().isContinuous());
+    EXPECT_THROW(pool.acquire(), std::runtime_error);
+
+    // A moved buffer is returned only once
+    auto moved = std::move(first);
+    EXPECT_FALSE(first.valid());
+    moved.release();
+    EXPECT_FALSE(moved.valid());
+    auto third = pool.acquire();
+    EXPECT_TRUE(third.valid());
+    EXPECT_THROW(pool.acquire(), std::runtime_error);
+}
+
+TEST(FrameBufferTest, TestPinned) {
+    radar::detect::FrameBufferPool pool(cv::Size(64, 64), CV_8UC3, 1);
+    auto buffer = pool.acquire();
+    EXPECT_TRUE(radar::detect::isPinned(buffer.image().data));
+
+    std::vector<unsigned char> pageable(64 * 64 * 3);
+    EXPECT_FALSE(radar::detect::isPinned(pageable.data()));
+    {
+        radar::detect::HostRegistration registration(pageable.data(),
+                                                     pageable.size());
+        EXPECT_TRUE(radar::detect::isPinned(pageable.data()));
+    }
+    EXPECT_FALSE(radar::detect::isPinned(pageable.data()));
+}
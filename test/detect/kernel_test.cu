@@ -1,6 +1,10 @@
+#include <cuda_fp16.h>
 #include <cuda_runtime.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <memory>
 #include <span>
@@ -172,6 +176,82 @@ TEST_F(BlobTest, Blob) {
     TestBlob(scale);
 }
 
+class LetterboxTest : public KernelTest<unsigned char, 8, 8, 3> {
+   protected:
+    void TestLetterbox(const cv::Rect& roi, int dst_w, int dst_h, bool half) {
+        radar::detect::DeviceImage image{h_src, src_w, src_h, channels,
+                                         src_w * channels};
+        radar::detect::PreParam pparam(roi.size(), cv::Size(dst_w, dst_h));
+        radar::detect::LetterboxParam* h_param;
+        CUDA_CHECK(cudaHostAlloc(&h_param,
+                                 sizeof(radar::detect::LetterboxParam),
+                                 cudaHostAllocMapped));
+        *h_param = radar::detect::LetterboxParam(image, roi, pparam);
+
+        // Runs resizing, making border and blobbing on the cropped region as
+        // the truth
+        auto src_mat = cv::Mat(cv::Size(src_w, src_h), CV_8UC3, h_src);
+        cv::Mat crop = src_mat(roi).clone();
+        unsigned char *h_crop, *h_resize, *h_border;
+        float* h_truth;
+        void* h_dst;
+        size_t dst_total = dst_w * dst_h * channels;
+        CUDA_CHECK(cudaHostAlloc(&h_crop, crop.total() * channels,
+                                 cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_resize, dst_total, cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_border, dst_total, cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_truth, dst_total * sizeof(float),
+                                 cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(
+            &h_dst, dst_total * (half ? sizeof(__half) : sizeof(float)),
+            cudaHostAllocMapped));
+        std::memcpy(h_crop, crop.data, crop.total() * channels);
+
+        const auto& param{*h_param};
+        dim3 block_size(16, 16);
+        dim3 grid_size((dst_w + block_size.x - 1) / block_size.x,
+                       (dst_h + block_size.y - 1) / block_size.y);
+        radar::detect::resizeKernel<<<grid_size, block_size>>>(
+            h_crop, h_resize, channels, roi.width, roi.height,
+            param.resized_width, param.resized_height);
+        radar::detect::copyMakeBorderKernel<<<grid_size, block_size>>>(
+            h_resize, h_border, channels, param.resized_width,
+            param.resized_height, param.top,
+            dst_h - param.resized_height - param.top, param.left,
+            dst_w - param.resized_width - param.left);
+        radar::detect::blobKernel<<<grid_size, block_size>>>(
+            h_border, h_truth, dst_w, dst_h, channels, 1 / 255.f);
+        radar::detect::letterboxKernel<<<grid_size, block_size>>>(
+            h_param, h_dst, dst_w, dst_h, channels, 1 / 255.f, half);
+        CUDA_CHECK(cudaGetLastError());
+        CUDA_CHECK(cudaDeviceSynchronize());
+
+        for (size_t i = 0; i < dst_total; ++i) {
+            if (half) {
+                ASSERT_NEAR(__half2float(static_cast<__half*>(h_dst)[i]),
+                            h_truth[i], 1e-3);
+            } else {
+                ASSERT_FLOAT_EQ(static_cast<float*>(h_dst)[i], h_truth[i]);
+            }
+        }
+
+        CUDA_CHECK(cudaFreeHost(h_param));
+        CUDA_CHECK(cudaFreeHost(h_crop));
+        CUDA_CHECK(cudaFreeHost(h_resize));
+        CUDA_CHECK(cudaFreeHost(h_border));
+        CUDA_CHECK(cudaFreeHost(h_truth));
+        CUDA_CHECK(cudaFreeHost(h_dst));
+    }
+};
+
+TEST_F(LetterboxTest, Whole) { TestLetterbox({0, 0, 8, 8}, 12, 12, false); }
+
+TEST_F(LetterboxTest, CropWide) { TestLetterbox({1, 2, 6, 3}, 8, 8, false); }
+
+TEST_F(LetterboxTest, CropTall) { TestLetterbox({3, 0, 2, 7}, 8, 8, false); }
+
+TEST_F(LetterboxTest, Half) { TestLetterbox({1, 2, 6, 3}, 8, 8, true); }
+
 class TransposeTest : public KernelTest<float, 36, 2, 1> {
     float* h_dst;
 
@@ -203,3 +283,68 @@ class TransposeTest : public KernelTest<float, 36, 2, 1> {
 };
 
 TEST_F(TransposeTest, Transpose) { TestTranspose(); }
+
+class NMSTest : public ::testing::Test {
+   protected:
+    static constexpr int anchors{5};
+    static constexpr int top_k{4};
+    static constexpr int num_attrs{sizeof(radar::Detection) / sizeof(float)};
+
+    void TestNMS() {
+        float *h_src, *h_dst;
+        int *h_indices, *h_ranges, *h_count;
+        unsigned long long* h_masks;
+        CUDA_CHECK(cudaHostAlloc(&h_src, anchors * num_attrs * sizeof(float),
+                                 cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_dst, top_k * num_attrs * sizeof(float),
+                                 cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_indices, anchors * sizeof(int),
+                                 cudaHostAllocMapped));
+        CUDA_CHECK(
+            cudaHostAlloc(&h_ranges, 2 * sizeof(int), cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_count, sizeof(int), cudaHostAllocMapped));
+        CUDA_CHECK(cudaHostAlloc(&h_masks, top_k * sizeof(unsigned long long),
+                                 cudaHostAllocMapped));
+
+        // Sorted by confidence, the second box overlaps the first one with
+        // the same label, the third overlaps it with another label, and the
+        // last one is beyond top-k
+        const std::vector<std::vector<float>> detections{
+            {0, 0, 10, 10, 0, 0.9}, {1, 1, 10, 10, 0, 0.8},
+            {0, 0, 10, 10, 1, 0.7}, {50, 50, 10, 10, 0, 0.6},
+            {0, 0, 10, 10, 2, 0.5}};
+        for (int i = 0; i < anchors; ++i) {
+            std::copy(detections[i].begin(), detections[i].end(),
+                      h_src + i * num_attrs);
+            h_indices[i] = i;
+        }
+        h_ranges[0] = 0;
+        h_ranges[1] = anchors;
+
+        radar::detect::NMSMaskKernel<<<dim3(1, 1, 1), 64>>>(
+            h_src, h_indices, h_ranges, h_ranges + 1, h_masks, anchors, top_k,
+            0.5f);
+        radar::detect::NMSSelectKernel<<<1, 64, sizeof(unsigned long long)>>>(
+            h_src, h_indices, h_ranges, h_ranges + 1, h_masks, h_dst, h_count,
+            anchors, top_k);
+        CUDA_CHECK(cudaGetLastError());
+        CUDA_CHECK(cudaDeviceSynchronize());
+
+        ASSERT_EQ(*h_count, 3);
+        for (int i : {0, 1, 2}) {
+            int truth{std::vector<int>{0, 2, 3}[i]};
+            for (int k = 0; k < num_attrs; ++k) {
+                ASSERT_FLOAT_EQ(h_dst[i * num_attrs + k], detections[truth][k]);
+            }
+        }
+
+        CUDA_CHECK(cudaFreeHost(h_src));
+        CUDA_CHECK(cudaFreeHost(h_dst));
+        CUDA_CHECK(cudaFreeHost(h_indices));
+        CUDA_CHECK(cudaFreeHost(h_ranges));
+        CUDA_CHECK(cudaFreeHost(h_count));
+        CUDA_CHECK(cudaFreeHost(h_masks));
+    }
+};
+
+TEST_F(NMSTest, SuppressSameLabel) { TestNMS(); }
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "detect/roi_scheduler.h"
+
+using radar::detect::RoiScheduler;
+
+TEST(RoiSchedulerTest, TestPeriod) {
+    EXPECT_THROW(RoiScheduler(0, cv::Size(640, 640), 4),
+                 std::invalid_argument);
+    EXPECT_THROW(RoiScheduler(3, cv::Size(640, 640), 0),
+                 std::invalid_argument);
+
+    RoiScheduler scheduler(3, cv::Size(640, 640), 4);
+    const std::vector<cv::Size> sizes{cv::Size(2592, 2048)};
+    const std::vector<std::vector<cv::Rect>> predictions{
+        {cv::Rect(1000, 1000, 100, 80)}};
+
+    // The first frame and every third frame are full passes
+    EXPECT_FALSE(scheduler.plan(sizes, predictions).has_value());
+    for (int t = 0; t < 2; ++t) {
+        for (int i = 0; i < 2; ++i) {
+            EXPECT_TRUE(scheduler.plan(sizes, predictions).has_value());
+        }
+        EXPECT_FALSE(scheduler.plan(sizes, predictions).has_value());
+    }
+
+    // A full pass is run when requested
+    EXPECT_TRUE(scheduler.plan(sizes, predictions).has_value());
+    scheduler.requestFullFrame();
+    EXPECT_FALSE(scheduler.plan(sizes, predictions).has_value());
+
+    // A full pass is run when nothing is predicted
+    const std::vector<std::vector<cv::Rect>> none(1);
+    EXPECT_FALSE(scheduler.plan(sizes, none).has_value());
+
+    EXPECT_THROW(scheduler.plan(sizes, std::vector<std::vector<cv::Rect>>(2)),
+                 std::invalid_argument);
+}
+
+TEST(RoiSchedulerTest, TestCrops) {
+    RoiScheduler scheduler(100, cv::Size(640, 640), 3);
+    const std::vector<cv::Size> sizes{cv::Size(2592, 2048),
+                                      cv::Size(1280, 1024)};
+    const std::vector<std::vector<cv::Rect>> predictions{
+        {cv::Rect(1000, 1000, 100, 80), cv::Rect(1100, 1050, 50, 50),
+         cv::Rect(2550, -30, 100, 100), cv::Rect(5000, 5000, 100, 100)},
+        {cv::Rect(-200, 100, 1000, 500)}};
+    ASSERT_FALSE(scheduler.plan(sizes, predictions).has_value());
+    auto crops = scheduler.plan(sizes, predictions);
+    ASSERT_TRUE(crops.has_value());
+
+    // The second box is inside the crop of the first one, and the box out of
+    // the image is ignored
+    ASSERT_EQ(crops->size(), 3);
+    EXPECT_EQ(crops->at(0).image, 0);
+    EXPECT_EQ(crops->at(0).rect, cv::Rect(730, 720, 640, 640));
+
+    // Crops at the border are shifted into the image
+    EXPECT_EQ(crops->at(1).image, 0);
+    EXPECT_EQ(crops->at(1).rect, cv::Rect(1952, 0, 640, 640));
+
+    // Boxes larger than the crop size are covered in whole
+    EXPECT_EQ(crops->at(2).image, 1);
+    EXPECT_EQ(crops->at(2).rect, cv::Rect(0, 30, 800, 640));
+    for (const auto& [image, rect] : crops.value()) {
+        EXPECT_EQ(rect & cv::Rect({0, 0}, sizes[image]), rect);
+    }
+
+    // More boxes than the maximum number of crops fall back to a full pass
+    const std::vector<std::vector<cv::Rect>> crowded{
+        {cv::Rect(0, 0, 10, 10), cv::Rect(800, 0, 10, 10),
+         cv::Rect(1600, 0, 10, 10), cv::Rect(0, 1200, 10, 10)},
+        {}};
+    EXPECT_FALSE(scheduler.plan(sizes, crowded).has_value());
+}
+
+TEST(RoiSchedulerTest, TestRestoreCrops) {
+    using radar::Detection;
+    using radar::detect::Crop;
+    using radar::detect::restoreCrops;
+
+    // The first two crops of image 0 overlap, and both of them see the car at
+    // (1000, 900) of the image
+    const std::vector<Crop> crops{
+        {.image = 0, .rect = cv::Rect(700, 600, 640, 640)},
+        {.image = 0, .rect = cv::Rect(900, 800, 640, 640)},
+        {.image = 1, .rect = cv::Rect(100, 50, 640, 640)}};
+    const std::vector<std::vector<Detection>> crop_detections{
+        {Detection(300, 300, 80, 60, 0, 0.6f),
+         Detection(10, 20, 30, 40, 0, 0.9f)},
+        {Detection(101, 99, 80, 60, 0, 0.8f)},
+        {Detection(300, 300, 80, 60, 0, 0.7f)}};
+    auto detections = restoreCrops(crops, crop_detections, 3, 0.75f);
+    ASSERT_EQ(detections.size(), 3);
+
+    // The overlapping detections are kept once with the higher confidence
+    ASSERT_EQ(detections[0].size(), 2);
+    EXPECT_FLOAT_EQ(detections[0][0].x, 1001);
+    EXPECT_FLOAT_EQ(detections[0][0].y, 899);
+    EXPECT_FLOAT_EQ(detections[0][0].confidence, 0.8f);
+    EXPECT_FLOAT_EQ(detections[0][1].x, 710);
+    EXPECT_FLOAT_EQ(detections[0][1].y, 620);
+
+    // The same box in crops of different images is not merged
+    ASSERT_EQ(detections[1].size(), 1);
+    EXPECT_FLOAT_EQ(detections[1][0].x, 400);
+    EXPECT_FLOAT_EQ(detections[1][0].y, 350);
+    EXPECT_TRUE(detections[2].empty());
+
+    EXPECT_THROW(restoreCrops(crops, crop_detections, 1, 0.75f),
+                 std::invalid_argument);
+    EXPECT_THROW(
+        restoreCrops(crops, std::span(crop_detections).first(2), 3, 0.75f),
+        std::invalid_argument);
+}
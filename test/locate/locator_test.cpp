@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <filesystem>
+#include <initializer_list>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <random>
 
@@ -8,10 +12,72 @@
 
 #include "locate/locator.h"
 #include "robot/robot.h"
+#include "track/tracker.h"
 
 #undef private
 #undef protected
 
+namespace {
+
+// Parameters of the locators of the depth tests, whose transforms are all
+// identities, so that a point (u * d / zoom, v * d / zoom, d) falls on the
+// pixel (u, v) of the zoomed depth image with depth d
+constexpr int kImageWidth = 640;
+constexpr int kImageHeight = 480;
+constexpr float kZoomFactor = 0.5f;
+constexpr size_t kQueueSize = 3;
+constexpr float kMinDepthDiff = 0.5f;
+constexpr float kMaxDepthDiff = 5.0f;
+constexpr float kClusterTolerance = 100.0f;
+constexpr int kMinClusterSize = 10;
+constexpr int kMaxClusterSize = 1000;
+constexpr float kMaxDistance = 1e6f;
+// The pixel of the zoomed depth image hit by the clouds of `makePixelCloud`
+constexpr int kPixelU = 100;
+constexpr int kPixelV = 50;
+
+std::unique_ptr<radar::Locator> makeDepthLocator(bool use_cuda = false) {
+    return std::make_unique<radar::Locator>(
+        kImageWidth, kImageHeight, cv::Matx33f::eye(), cv::Matx44f::eye(),
+        cv::Matx44f::eye(), kZoomFactor, kQueueSize, kMinDepthDiff,
+        kMaxDepthDiff, kClusterTolerance, kMinClusterSize, kMaxClusterSize,
+        kMaxDistance, use_cuda);
+}
+
+cv::Point3f pointAt(float u, float v, float depth) {
+    return cv::Point3f(u * depth / kZoomFactor, v * depth / kZoomFactor,
+                       depth);
+}
+
+// Makes a cloud on every 4th pixel of the zoomed depth image from an offset,
+// so that every point falls on its own pixel and no collision is resolved
+pcl::PointCloud<pcl::PointXYZ>::Ptr makeGridCloud(float depth, int offset) {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(
+        new pcl::PointCloud<pcl::PointXYZ>());
+    for (int v = offset; v < kImageHeight * kZoomFactor; v += 4) {
+        for (int u = offset; u < kImageWidth * kZoomFactor; u += 4) {
+            const auto point{pointAt(u + 0.5f, v + 0.5f, depth)};
+            cloud->emplace_back(point.x, point.y, point.z);
+        }
+    }
+    return cloud;
+}
+
+// Makes a cloud of points with the given depths on the pixel (kPixelU,
+// kPixelV) of the zoomed depth image
+pcl::PointCloud<pcl::PointXYZ>::Ptr makePixelCloud(
+    std::initializer_list<float> depths) {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(
+        new pcl::PointCloud<pcl::PointXYZ>());
+    for (float depth : depths) {
+        const auto point{pointAt(kPixelU + 0.5f, kPixelV + 0.5f, depth)};
+        cloud->emplace_back(point.x, point.y, point.z);
+    }
+    return cloud;
+}
+
+}  // namespace
+
 class LocatorTest : public ::testing::Test {
    private:
     int image_width = 640;
@@ -165,4 +231,386 @@ TEST_F(LocatorTest, TestRobotSearch) {
     robot.rect_ = cv::Rect2f(140, 100, 40, 40);
     locator->search(robot);
     EXPECT_TRUE(robot.location().has_value());
-}
\ No newline at end of file
+}
+
+TEST(LocatorCudaTest, TestCudaUpdate) {
+    auto cpu_locator{makeDepthLocator(false)};
+    auto cuda_locator{makeDepthLocator(true)};
+
+    // The CPU and CUDA paths resolve no collisions on the grid clouds
+    auto background{makeGridCloud(10.0f, 0)};
+    auto foreground{makeGridCloud(8.0f, 0)};
+    auto other{makeGridCloud(8.0f, 2)};
+
+    for (const auto& cloud : {background, foreground, other}) {
+        cpu_locator->update(cloud);
+        cuda_locator->update(cloud);
+        EXPECT_EQ(cv::countNonZero(cpu_locator->diff_depth_image_ !=
+                                   cuda_locator->diff_depth_image_),
+                  0);
+    }
+    EXPECT_GT(cv::countNonZero(cuda_locator->diff_depth_image_), 0);
+}
+
+TEST(LocatorCudaTest, TestCudaUpdateUnfrozenBackground) {
+    auto cpu_locator{makeDepthLocator(false)};
+    auto cuda_locator{makeDepthLocator(true)};
+    const auto expectSame = [&] {
+        EXPECT_EQ(cv::countNonZero(cpu_locator->diff_depth_image_ !=
+                                   cuda_locator->diff_depth_image_),
+                  0);
+    };
+
+    // The foreground is found against the running maximum of the background
+    for (const auto& cloud : {makeGridCloud(10.0f, 0), makeGridCloud(8.0f, 0),
+                              makeGridCloud(12.0f, 2)}) {
+        cpu_locator->update(cloud);
+        cuda_locator->update(cloud);
+        expectSame();
+    }
+    EXPECT_GT(cv::countNonZero(cpu_locator->diff_depth_image_), 0);
+
+    // The depths still in the window are checked against the background after
+    // it is reset, although the next frame hits none of their pixels
+    cpu_locator->resetBackground();
+    cuda_locator->resetBackground();
+    const auto other{makeGridCloud(8.0f, 1)};
+    cpu_locator->update(other);
+    cuda_locator->update(other);
+    expectSame();
+    EXPECT_EQ(cv::countNonZero(cpu_locator->diff_depth_image_), 0);
+}
+
+TEST(LocatorSpanTest, TestSpanUpdate) {
+    const std::vector clouds{makeGridCloud(10.0f, 0), makeGridCloud(8.0f, 0),
+                             makeGridCloud(8.0f, 2)};
+
+    for (bool use_cuda : {false, true}) {
+        auto cloud_locator{makeDepthLocator(use_cuda)};
+        auto span_locator{makeDepthLocator(use_cuda)};
+
+        for (const auto& cloud : clouds) {
+            std::vector<float> x, y, z;
+            for (const auto& point : *cloud) {
+                x.emplace_back(point.x);
+                y.emplace_back(point.y);
+                z.emplace_back(point.z);
+            }
+            cloud_locator->update(cloud);
+            span_locator->update(x, y, z);
+            EXPECT_EQ(cv::countNonZero(cloud_locator->diff_depth_image_ !=
+                                       span_locator->diff_depth_image_),
+                      0);
+        }
+        EXPECT_GT(cv::countNonZero(span_locator->diff_depth_image_), 0);
+
+        // Points beyond the shortest array are ignored
+        std::vector<float> x{pointAt(100.5f, 0.5f, 8.0f).x}, y{}, z{8.0f};
+        span_locator->update(x, y, z);
+        EXPECT_EQ(span_locator->depth_count_, kQueueSize);
+    }
+}
+
+TEST(LocatorWindowTest, TestDepthExpiry) {
+    auto locator{makeDepthLocator()};
+    auto depth_at = [&] {
+        return locator->diff_depth_image_.at<float>(kPixelV, kPixelU);
+    };
+    auto empty_cloud{makePixelCloud({})};
+
+    locator->update(makePixelCloud({10.0f}));
+    EXPECT_FLOAT_EQ(depth_at(), 0.0f);
+
+    // The foreground stays within the window for `kQueueSize` frames
+    locator->update(makePixelCloud({8.0f}));
+    for (size_t i = 1; i < kQueueSize; ++i) {
+        EXPECT_FLOAT_EQ(depth_at(), 8.0f);
+        locator->update(empty_cloud);
+    }
+    EXPECT_FLOAT_EQ(depth_at(), 8.0f);
+    locator->update(empty_cloud);
+    EXPECT_FLOAT_EQ(depth_at(), 0.0f);
+
+    // A newer point of the background hides the foreground at once
+    locator->update(makePixelCloud({8.0f}));
+    EXPECT_FLOAT_EQ(depth_at(), 8.0f);
+    locator->update(makePixelCloud({10.0f}));
+    EXPECT_FLOAT_EQ(depth_at(), 0.0f);
+}
+
+TEST(LocatorClusterTest, TestClusterMethods) {
+    std::mt19937 gen(42);
+    std::normal_distribution<> x_dist(0.0, 40.0), y_dist(0.0, 30.0);
+    std::uniform_real_distribution<> depth_dist(0.0, 300.0);
+    const cv::Point2f centers[]{{300, 250}, {700, 250}, {500, 600}};
+    const float depths[]{8000, 9000, 12000};
+
+    cv::Mat diff_depth_image = cv::Mat::zeros(1024, 1296, CV_32F);
+    for (int k = 0; k < 3; ++k) {
+        for (int i = 0; i < 300; ++i) {
+            int x = std::clamp(static_cast<int>(centers[k].x + x_dist(gen)), 0,
+                               diff_depth_image.cols - 1);
+            int y = std::clamp(static_cast<int>(centers[k].y + y_dist(gen)), 0,
+                               diff_depth_image.rows - 1);
+            diff_depth_image.at<float>(y, x) = depths[k] + depth_dist(gen);
+        }
+    }
+
+    auto cluster_sizes = [&](radar::ClusterMethod method) {
+        const cv::Matx33f intrinsic(1685.5f, 0, 1279.0f, 0, 1685.3f, 1037.2f,
+                                    0, 0, 1);
+        radar::Locator locator(2592, 2048, intrinsic, cv::Matx44f::eye(),
+                               cv::Matx44f::eye(), 0.5f, 3, 500, 4000, 400,
+                               8, 1000, 29300, false, method);
+        diff_depth_image.copyTo(locator.diff_depth_image_);
+        locator.cluster();
+        std::vector<size_t> sizes;
+        for (const auto& cluster : locator.clusters_) {
+            sizes.emplace_back(cluster.indices.size());
+        }
+        return sizes;
+    };
+
+    auto expected{cluster_sizes(radar::ClusterMethod::Euclidean)};
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(cluster_sizes(radar::ClusterMethod::Grid), expected);
+    EXPECT_EQ(cluster_sizes(radar::ClusterMethod::Voxel), expected);
+}
+
+TEST_F(LocatorTest, TestSearchLargestCluster) {
+    // Two clusters far apart, the first of which has more points
+    // within the region
+    for (int v = 50; v < 56; ++v) {
+        for (int u = 50; u < 56; ++u) {
+            locator->diff_depth_image_.at<float>(v, u) = 1.0f;
+        }
+    }
+    for (int v = 120; v < 124; ++v) {
+        for (int u = 120; u < 124; ++u) {
+            locator->diff_depth_image_.at<float>(v, u) = 0.05f;
+        }
+    }
+    locator->cluster();
+    ASSERT_EQ(locator->clusters_.size(), 2);
+
+    radar::Robot robot;
+    robot.rect_ = cv::Rect2f(80, 80, 200, 200);
+    locator->search(robot);
+    ASSERT_TRUE(robot.location().has_value());
+    auto expected{locator->cameraToLidar(cv::Point3f(52.5f, 52.5f, 1.0f))};
+    EXPECT_NEAR(robot.location()->x, expected.x, 1e-3);
+    EXPECT_NEAR(robot.location()->y, expected.y, 1e-3);
+    EXPECT_NEAR(robot.location()->z, expected.z, 1e-3);
+
+    // Labels of the last frame are cleared by clustering again
+    locator->diff_depth_image_.setTo(0);
+    locator->cluster();
+    EXPECT_EQ(cv::countNonZero(locator->label_image_ >= 0), 0);
+}
+
+TEST(LocatorTransformTest, TestBatchTransform) {
+    const cv::Matx33f intrinsic(1685.5f, 0, 1279.0f, 0, 1685.3f, 1037.2f, 0, 0,
+                                1);
+    const cv::Matx44f lidar_to_camera(0, -1, 0, 0.85f, 0, 0, -1, -37.7f, 1, 0,
+                                      0, 12.3f, 0, 0, 0, 1);
+    const cv::Matx44f world_to_camera(0.06f, 0.998f, 0.017f, -7179.7f, 0.29f,
+                                      -0.001f, -0.957f, -4671.3f, -0.955f,
+                                      0.062f, -0.289f, 28286.9f, 0, 0, 0, 1);
+    radar::Locator locator(2592, 2048, intrinsic, lidar_to_camera,
+                           world_to_camera);
+
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<float> dist(-5000.0f, 5000.0f);
+    const size_t n = 100;
+    std::vector<float> x(n), y(n), z(n), u(n), v(n), d(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = 15000.0f + dist(gen);
+        y[i] = dist(gen);
+        z[i] = dist(gen);
+    }
+    locator.lidarToCamera(x, y, z, u, v, d);
+    std::vector<float> rx(n), ry(n), rz(n);
+    locator.cameraToLidar(u, v, d, rx, ry, rz);
+
+    for (size_t i = 0; i < n; ++i) {
+        auto uvd{locator.lidarToCamera(cv::Point3f(x[i], y[i], z[i]))};
+        EXPECT_NEAR(u[i], uvd.x, 1e-2);
+        EXPECT_NEAR(v[i], uvd.y, 1e-2);
+        EXPECT_NEAR(d[i], uvd.z, 1e-2);
+        EXPECT_NEAR(rx[i], x[i], 1.0);
+        EXPECT_NEAR(ry[i], y[i], 1.0);
+        EXPECT_NEAR(rz[i], z[i], 1.0);
+    }
+
+    // The cached transform to the world is the composition of the extrinsics
+    cv::Point3f point(x[0], y[0], z[0]);
+    cv::Matx41f expected{world_to_camera.inv() * lidar_to_camera *
+                         cv::Matx41f(point.x, point.y, point.z, 1.0f)};
+    auto world{locator.lidarToWorld(point)};
+    EXPECT_NEAR(world.x, expected(0), 1.0);
+    EXPECT_NEAR(world.y, expected(1), 1.0);
+    EXPECT_NEAR(world.z, expected(2), 1.0);
+}
+
+TEST(LocatorTransformTest, TestCameraToLidarTranslation) {
+    const cv::Matx33f intrinsic(1685.5f, 0, 1279.0f, 0, 1685.3f, 1037.2f, 0, 0,
+                                1);
+    const cv::Matx44f lidar_to_camera(0, -1, 0, 0.85f, 0, 0, -1, -37.7f, 1, 0,
+                                      0, 12.3f, 0, 0, 0, 1);
+    const float zoom_factor = 0.5f;
+    radar::Locator locator(2592, 2048, intrinsic, lidar_to_camera,
+                           cv::Matx44f::eye(), zoom_factor);
+
+    // The inverse extrinsics rotate the point of the camera and then
+    // translate it, so the translation is not rotated again
+    const cv::Point3f lidar_point(15000.0f, 1000.0f, -500.0f);
+    const cv::Matx41f camera{lidar_to_camera * cv::Matx41f(lidar_point.x,
+                                                           lidar_point.y,
+                                                           lidar_point.z, 1)};
+    const cv::Matx31f pixel{intrinsic *
+                            cv::Matx31f(camera(0), camera(1), camera(2))};
+    const cv::Point3f uvd(pixel(0) / pixel(2) * zoom_factor,
+                          pixel(1) / pixel(2) * zoom_factor, camera(2));
+    const cv::Matx41f expected{lidar_to_camera.inv() * camera};
+    const auto point{locator.cameraToLidar(uvd)};
+    EXPECT_NEAR(point.x, expected(0), 1.0);
+    EXPECT_NEAR(point.y, expected(1), 1.0);
+    EXPECT_NEAR(point.z, expected(2), 1.0);
+
+    // Rotating the translation again would be off by (R - I) * t
+    const cv::Matx33f rotate{lidar_to_camera.inv().get_minor<3, 3>(0, 0)};
+    const cv::Vec3f translate{lidar_to_camera.inv().get_minor<3, 1>(0, 3)};
+    const cv::Vec3f offset{rotate * translate - translate};
+    ASSERT_GT(cv::norm(offset), 10.0);
+    EXPECT_GT(cv::norm(cv::Vec3f(point.x, point.y, point.z) -
+                       cv::Vec3f(expected(0), expected(1), expected(2)) -
+                       offset),
+              10.0);
+}
+
+TEST(LocatorBackgroundTest, TestFreezeAndPersist) {
+    auto background_at = [](const radar::Locator& locator) {
+        return locator.background_depth_image_.at<float>(kPixelV, kPixelU);
+    };
+
+    auto locator{makeDepthLocator()};
+    EXPECT_THROW(locator->freezeBackground(), std::logic_error);
+    EXPECT_THROW(locator->saveBackground("unused"), std::logic_error);
+
+    // The farthest depth is an outlier rejected in freezing
+    locator->accumulateBackground(makePixelCloud({10.0f, 10.2f}));
+    locator->accumulateBackground(makePixelCloud({10.1f}));
+    locator->accumulateBackground(makePixelCloud({25.0f}));
+    EXPECT_THROW(
+        locator->freezeBackground(2, radar::Locator::kBackgroundSamples),
+        std::invalid_argument);
+    locator->freezeBackground(2, 1);
+    ASSERT_TRUE(locator->backgroundFrozen());
+    EXPECT_FLOAT_EQ(background_at(*locator), 10.2f);
+    EXPECT_FLOAT_EQ(cv::sum(locator->background_depth_image_)[0], 10.2f);
+
+    // The frozen background is not changed by updating
+    locator->update(makePixelCloud({12.0f}));
+    EXPECT_FLOAT_EQ(background_at(*locator), 10.2f);
+    EXPECT_FLOAT_EQ(locator->diff_depth_image_.at<float>(kPixelV, kPixelU),
+                    0.0f);
+    locator->update(makePixelCloud({8.0f}));
+    EXPECT_FLOAT_EQ(locator->diff_depth_image_.at<float>(kPixelV, kPixelU),
+                    8.0f);
+
+    const auto path{std::filesystem::temp_directory_path() /
+                    "locator_test_background.depth"};
+    locator->saveBackground(path.string());
+    auto loaded{makeDepthLocator()};
+    loaded->loadBackground(path.string());
+    EXPECT_TRUE(loaded->backgroundFrozen());
+    EXPECT_EQ(cv::countNonZero(loaded->background_depth_image_ !=
+                               locator->background_depth_image_),
+              0);
+
+    radar::Locator other(320, 240, cv::Matx33f::eye(), cv::Matx44f::eye(),
+                         cv::Matx44f::eye(), 0.5f);
+    EXPECT_THROW(other.loadBackground(path.string()), std::runtime_error);
+    EXPECT_THROW(other.loadBackground("not_exist.depth"), std::runtime_error);
+
+    // A background projected with other extrinsics is stale
+    radar::Locator moved(kImageWidth, kImageHeight, cv::Matx33f::eye(),
+                         cv::Matx44f(1, 0, 0, 100.0f, 0, 1, 0, 0, 0, 0, 1, 0,
+                                     0, 0, 0, 1),
+                         cv::Matx44f::eye(), kZoomFactor);
+    EXPECT_THROW(moved.loadBackground(path.string()), std::runtime_error);
+    std::filesystem::remove(path);
+
+    loaded->resetBackground();
+    EXPECT_FALSE(loaded->backgroundFrozen());
+    EXPECT_EQ(cv::countNonZero(loaded->background_depth_image_), 0);
+}
+
+TEST(LocatorTransformTest, TestProject) {
+    const cv::Matx33f intrinsic(1685.5f, 0, 1279.0f, 0, 1685.3f, 1037.2f, 0, 0,
+                                1);
+    const cv::Matx44f world_to_camera(0.06f, 0.998f, 0.017f, -7179.7f, 0.29f,
+                                      -0.001f, -0.957f, -4671.3f, -0.955f,
+                                      0.062f, -0.289f, 28286.9f, 0, 0, 0, 1);
+    radar::Locator locator(2592, 2048, intrinsic, cv::Matx44f::eye(),
+                           world_to_camera);
+
+    // The box covers the projection of the location at its center, which is
+    // in meters and projected through the extrinsics in millimeters
+    const cv::Point3f location(10.0f, 5.0f, 0.3f);
+    cv::Matx31f pixel{intrinsic * world_to_camera.get_minor<3, 4>(0, 0) *
+                      cv::Matx41f(10000.0f, 5000.0f, 300.0f, 1.0f)};
+    const cv::Point2f center(pixel(0) / pixel(2), pixel(1) / pixel(2));
+    auto rect{locator.project(location, 0.4f)};
+    ASSERT_TRUE(rect.has_value());
+    EXPECT_TRUE(rect->contains(center));
+    EXPECT_GT(rect->width, 0);
+    EXPECT_GT(rect->height, 0);
+
+    // A larger box covers the smaller one
+    auto larger{locator.project(location, 0.8f)};
+    ASSERT_TRUE(larger.has_value());
+    EXPECT_EQ(larger.value() & rect.value(), rect.value());
+
+    // Boxes behind the camera are not projected
+    const cv::Matx44f camera_to_world{world_to_camera.inv()};
+    cv::Matx41f behind{camera_to_world * cv::Matx41f(0, 0, -1000.0f, 1.0f)};
+    const cv::Point3f behind_location{
+        cv::Point3f(behind(0), behind(1), behind(2)) * 1e-3f};
+    EXPECT_FALSE(locator.project(behind_location, 0.4f).has_value());
+}
+
+TEST(LocatorTransformTest, TestProjectTrackerPrediction) {
+    const cv::Matx33f intrinsic(1685.5f, 0, 1279.0f, 0, 1685.3f, 1037.2f, 0, 0,
+                                1);
+    const cv::Matx44f world_to_camera(0.06f, 0.998f, 0.017f, -7179.7f, 0.29f,
+                                      -0.001f, -0.957f, -4671.3f, -0.955f,
+                                      0.062f, -0.289f, 28286.9f, 0, 0, 0, 1);
+    radar::Locator locator(2592, 2048, intrinsic, cv::Matx44f::eye(),
+                           world_to_camera);
+    radar::BasicTracker<radar::Robot::kClassNum> tracker(
+        cv::Point3f(0.05f, 0.05f, 0.05f), radar::Robot::kClassNum);
+
+    // A still robot located in millimeters of the world like the locator does
+    const cv::Point3f location(10000.0f, 5000.0f, 300.0f);
+    const std::vector armors{radar::Detection(1270, 1030, 20, 10, 0, 0.9f)};
+    auto timestamp{std::chrono::high_resolution_clock::now()};
+    for (int i = 0; i < 10; ++i) {
+        std::vector robots{
+            radar::Robot(radar::Detection(1250, 1000, 60, 60, 0, 0.9f),
+                         armors)};
+        robots.front().setLocation(location);
+        tracker.update(robots, timestamp);
+        timestamp += std::chrono::milliseconds(100);
+    }
+
+    // The box around the predicted track covers the projection of the robot
+    cv::Matx31f pixel{intrinsic * world_to_camera.get_minor<3, 4>(0, 0) *
+                      cv::Matx41f(location.x, location.y, location.z, 1.0f)};
+    const cv::Point2f center(pixel(0) / pixel(2), pixel(1) / pixel(2));
+    const auto predictions{tracker.predict(timestamp)};
+    ASSERT_EQ(predictions.size(), 1);
+    auto rect{locator.project(predictions.front(), 0.4f)};
+    ASSERT_TRUE(rect.has_value());
+    EXPECT_TRUE(rect->contains(center));
+}
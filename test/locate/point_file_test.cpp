@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "locate/point_file.h"
+
+class PointFileTest : public ::testing::Test {
+   protected:
+    std::filesystem::path path{std::filesystem::temp_directory_path() /
+                               "point_file_test.bin"};
+
+    virtual void TearDown() { std::filesystem::remove(path); }
+};
+
+TEST_F(PointFileTest, TestWriteRead) {
+    const std::vector<float> x{1, 2, 3}, y{4, 5, 6}, z{7, 8, 9};
+    {
+        radar::locate::PointFileWriter writer(path.string());
+        writer.append(100, {.x = x, .y = y, .z = z});
+        writer.append(200, {});
+        writer.append(300, {.x = std::span(x).first(1),
+                            .y = std::span(y).first(1),
+                            .z = std::span(z).first(1)});
+        EXPECT_THROW(writer.append(400, {.x = x, .y = y, .z = {}}),
+                     std::invalid_argument);
+    }
+
+    radar::locate::PointFile file(path.string());
+    ASSERT_EQ(file.size(), 3u);
+    EXPECT_EQ(file.timestamp(0), 100);
+    EXPECT_EQ(file.timestamp(2), 300);
+
+    const auto points = file.points(0);
+    ASSERT_EQ(points.size(), 3u);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_FLOAT_EQ(points.x[i], x[i]);
+        EXPECT_FLOAT_EQ(points.y[i], y[i]);
+        EXPECT_FLOAT_EQ(points.z[i], z[i]);
+    }
+    EXPECT_EQ(file.points(1).size(), 0u);
+    EXPECT_EQ(file.points(2).size(), 1u);
+    EXPECT_FLOAT_EQ(file.points(2).z[0], 7);
+
+    // The points of every frame are aligned for vectorized reads
+    for (size_t i = 0; i < file.size(); ++i) {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(file.points(i).x.data()) %
+                      radar::locate::kPointFileAlignment,
+                  0u);
+    }
+}
+
+TEST_F(PointFileTest, TestInvalidFile) {
+    EXPECT_THROW(radar::locate::PointFile(path.string()), std::runtime_error);
+
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << "not a point file, but long enough for a header";
+    }
+    EXPECT_THROW(radar::locate::PointFile(path.string()), std::runtime_error);
+
+    // A frame running past the index is rejected
+    {
+        radar::locate::PointFileWriter writer(path.string());
+        const std::vector<float> x{1, 2, 3};
+        writer.append(0, {.x = x, .y = x, .z = x});
+    }
+    {
+        std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+        radar::locate::PointFileHeader header;
+        fs.read(reinterpret_cast<char*>(&header), sizeof(header));
+        radar::locate::PointFileEntry entry;
+        fs.seekg(header.index_offset);
+        fs.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+        entry.count = 1000;
+        fs.seekp(header.index_offset);
+        fs.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    EXPECT_THROW(radar::locate::PointFile(path.string()), std::runtime_error);
+}
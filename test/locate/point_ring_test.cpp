@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <thread>
+
+#include "locate/point_ring.h"
+
+TEST(PointRingTest, TestWriteRead) {
+    EXPECT_THROW(radar::locate::PointRing(0, 16), std::invalid_argument);
+    EXPECT_THROW(radar::locate::PointRing(2, 0), std::invalid_argument);
+
+    radar::locate::PointRing ring(2, 16);
+    EXPECT_EQ(ring.capacity(), 2u);
+    EXPECT_EQ(ring.beginRead(), nullptr);
+
+    for (int i = 0; i < 2; ++i) {
+        auto* buffer = ring.beginWrite();
+        ASSERT_NE(buffer, nullptr);
+        EXPECT_EQ(buffer->capacity(), 16u);
+        buffer->x[0] = buffer->y[0] = buffer->z[0] = static_cast<float>(i);
+        buffer->size = 1;
+        buffer->timestamp = i;
+        ring.endWrite();
+    }
+    EXPECT_EQ(ring.size(), 2u);
+
+    // The ring is full, so the next cloud is dropped
+    EXPECT_EQ(ring.beginWrite(), nullptr);
+    EXPECT_EQ(ring.dropped(), 1u);
+
+    for (int i = 0; i < 2; ++i) {
+        const auto* buffer = ring.beginRead();
+        ASSERT_NE(buffer, nullptr);
+        EXPECT_EQ(buffer->timestamp, i);
+        const auto points = buffer->points();
+        ASSERT_EQ(points.size(), 1u);
+        EXPECT_FLOAT_EQ(points.x[0], static_cast<float>(i));
+        ring.endRead();
+    }
+    EXPECT_EQ(ring.beginRead(), nullptr);
+    EXPECT_NE(ring.beginWrite(), nullptr);
+}
+
+TEST(PointRingTest, TestConcurrency) {
+    constexpr int kClouds = 10000;
+    radar::locate::PointRing ring(4, 64);
+
+    std::jthread writer([&] {
+        for (int i = 0; i < kClouds;) {
+            auto* buffer = ring.beginWrite();
+            if (buffer == nullptr) {
+                std::this_thread::yield();
+                continue;
+            }
+            buffer->size = i % 64 + 1;
+            for (size_t j = 0; j < buffer->size; ++j) {
+                buffer->x[j] = buffer->y[j] = buffer->z[j] =
+                    static_cast<float>(i);
+            }
+            buffer->timestamp = i++;
+            ring.endWrite();
+        }
+    });
+
+    // Every cloud is read in order and complete, as the writer retries
+    // instead of dropping it
+    for (int i = 0; i < kClouds;) {
+        const auto* buffer = ring.beginRead();
+        if (buffer == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(buffer->timestamp, i);
+        const auto points = buffer->points();
+        ASSERT_EQ(points.size(), static_cast<size_t>(i % 64 + 1));
+        for (size_t j = 0; j < points.size(); ++j) {
+            ASSERT_FLOAT_EQ(points.z[j], static_cast<float>(i));
+        }
+        ring.endRead();
+        ++i;
+    }
+}
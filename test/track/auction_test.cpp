@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include <Eigen/Dense>
+#include <functional>
+#include <random>
 #include <vector>
 
 using namespace radar::track;
@@ -61,4 +63,102 @@ TEST(AuctionTest, HandlesZeroIterations) {
     for (int agent : result) {
         EXPECT_EQ(agent, kNotMatched);
     }
-}
\ No newline at end of file
+}
+
+TEST(AuctionSolverTest, SparseOptimalAndWarmStart) {
+    constexpr int num_agents = 6, num_tasks = 5;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    // Brute force of the best total value, where agents may be unassigned
+    auto best_total = [&](const Eigen::MatrixXf& values) {
+        float best = 0.0f;
+        std::function<void(int, std::vector<bool>&, float)> search =
+            [&](int agent, std::vector<bool>& used, float total) {
+                if (agent == num_agents) {
+                    best = std::max(best, total);
+                    return;
+                }
+                search(agent + 1, used, total);
+                for (int task = 0; task < num_tasks; ++task) {
+                    if (!used[task] && values(agent, task) > 0) {
+                        used[task] = true;
+                        search(agent + 1, used, total + values(agent, task));
+                        used[task] = false;
+                    }
+                }
+            };
+        std::vector<bool> used(num_tasks, false);
+        search(0, used, 0.0f);
+        return best;
+    };
+
+    AuctionSolver solver(100, 1e-4f);
+    std::vector<float> prices(num_tasks, 0.0f);
+    Eigen::MatrixXf values = Eigen::MatrixXf::Zero(num_agents, num_tasks);
+    for (int agent = 0; agent < num_agents; ++agent) {
+        for (int task = 0; task < num_tasks; ++task) {
+            // Pairs that are gated out are left out
+            if (dist(gen) < 0.6f) {
+                values(agent, task) = dist(gen);
+            }
+        }
+    }
+
+    SparseValueMatrix value_matrix;
+    int cold_iterations = 0;
+    for (int frame = 0; frame < 2; ++frame) {
+        value_matrix.reset(num_tasks);
+        for (int agent = 0; agent < num_agents; ++agent) {
+            value_matrix.addRow();
+            for (int task = 0; task < num_tasks; ++task) {
+                if (values(agent, task) > 0) {
+                    value_matrix.add(task, values(agent, task));
+                }
+            }
+        }
+        auto assignment = solver.solve(value_matrix, prices);
+
+        float total = 0.0f;
+        std::vector<bool> used(num_tasks, false);
+        for (int agent = 0; agent < num_agents; ++agent) {
+            const int task = assignment[agent];
+            if (task == kNotMatched) {
+                continue;
+            }
+            ASSERT_GT(values(agent, task), 0.0f);
+            ASSERT_FALSE(used[task]);
+            used[task] = true;
+            total += values(agent, task);
+        }
+        EXPECT_NEAR(total, best_total(values), num_agents * 1e-4f);
+
+        if (frame == 0) {
+            cold_iterations = solver.iterations();
+        } else {
+            // The same problem is solved at once from the last prices
+            EXPECT_LE(solver.iterations(), cold_iterations);
+            EXPECT_LE(solver.iterations(), 1);
+        }
+    }
+}
+
+TEST(AuctionSolverTest, FallbackAfterExhaustedWarmStart) {
+    SparseValueMatrix value_matrix;
+    value_matrix.reset(2);
+    value_matrix.addRow();
+    value_matrix.add(0, 10.0f);
+    value_matrix.add(1, 1.0f);
+    value_matrix.addRow();
+    value_matrix.add(0, 1.0f);
+    value_matrix.add(1, 10.0f);
+
+    // Stale prices above every value leave the agents unassigned in the only
+    // round of the warm start, which is then solved again from zero prices
+    // with a budget of its own
+    AuctionSolver solver(1);
+    std::vector<float> prices{100.0f, 100.0f};
+    auto assignment = solver.solve(value_matrix, prices);
+    EXPECT_EQ(assignment, (std::vector<int>{0, 1}));
+    EXPECT_EQ(solver.iterations(), 2);
+}
@@ -109,3 +109,59 @@ TEST(FeaturesTest, MoveAssignment) {
     EXPECT_EQ(features1.size(), 0);
     EXPECT_EQ(features1.capacity(), 0);
 }
+
+// Test the window keeping the latest vectors with running sums
+TEST(FeaturesTest, WindowAndDecay) {
+    auto one_hot = [](int index) {
+        Eigen::VectorXf vec = Eigen::VectorXf::Zero(3);
+        vec(index) = 1.0f;
+        return vec;
+    };
+    Features features(one_hot(0), 1, 3);
+    EXPECT_EQ(features.capacity(), 3);
+    features.push_back(one_hot(0));
+    features.push_back(one_hot(1));
+    EXPECT_EQ(features.label(), 0);
+
+    // The oldest vectors are evicted, so the label follows the latest ones
+    for (int i = 0; i < 7; ++i) {
+        features.push_back(one_hot(i % 2 == 0 ? 2 : 1));
+        EXPECT_EQ(features.size(), 3);
+        EXPECT_EQ(features.capacity(), 3);
+    }
+    EXPECT_TRUE(features.get(0).isApprox(one_hot(2)));
+    EXPECT_TRUE(features.get(2).isApprox(one_hot(2)));
+    EXPECT_EQ(features.label(), 2);
+    Eigen::VectorXf expected(3);
+    expected << 0.0f, 1.0f / 3, 2.0f / 3;
+    EXPECT_TRUE(features.feature().isApprox(expected));
+
+    // The latest vector outweighs older ones with decay
+    Features decayed(one_hot(0), 1, 0, 0.5f);
+    decayed.push_back(one_hot(0));
+    decayed.push_back(one_hot(1));
+    expected << 0.75f, 1.0f, 0.0f;
+    EXPECT_TRUE(decayed.feature().isApprox(expected / expected.sum()));
+    EXPECT_EQ(decayed.label(), 1);
+
+    EXPECT_THROW(Features(3, 1, -1), std::invalid_argument);
+    EXPECT_THROW(Features(3, 1, 0, 0.0f), std::invalid_argument);
+}
+
+// Test fixed-size features against dynamic-size features
+TEST(FeaturesTest, FixedSize) {
+    using FixedFeatures = BasicFeatures<3>;
+    FixedFeatures::Vector vec(1, 2, 3);
+    FixedFeatures fixed(vec, 1, 2, 0.5f);
+    Features dynamic(Eigen::VectorXf(vec), 1, 2, 0.5f);
+    for (int i = 0; i < 5; ++i) {
+        const FixedFeatures::Vector next(i, 1, 3 - i);
+        fixed.push_back(next);
+        dynamic.push_back(Eigen::VectorXf(next));
+        EXPECT_TRUE(fixed.feature().isApprox(dynamic.feature()));
+        EXPECT_EQ(fixed.label(), dynamic.label());
+    }
+    EXPECT_EQ(fixed.size(), 2);
+
+    EXPECT_THROW(FixedFeatures(4), std::invalid_argument);
+}
@@ -0,0 +1,118 @@
+#include "track/singer_bank.h"
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+using namespace radar::track;
+
+TEST(SingerBankTest, TestSameAsSingerEKF) {
+    constexpr float max_a = 2;  // m/s^2
+    constexpr float tau = 1;    // s
+    constexpr int filter_num = 20;
+    constexpr int times = 10;
+    const Eigen::Matrix<float, kStateSize, kStateSize> initial_covariance =
+        Eigen::Matrix<float, kStateSize, kStateSize>::Identity() * 0.5f;
+    Eigen::Matrix<float, kMeasurementSize, kMeasurementSize> observation_noise;
+    observation_noise << 0.2f, 0, 0, 0, 0.2f, 0, 0, 0, 0.2f;
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    SingerEKFBank bank(max_a, tau, observation_noise);
+    std::vector<SingerEKF> filters;
+    for (int i = 0; i < filter_num; ++i) {
+        Eigen::Matrix<float, kStateSize, 1> initial_state;
+        initial_state.setZero();
+        initial_state << dist(gen), 0, 0, dist(gen), 0, 0, dist(gen), 0, 0;
+        EXPECT_EQ(bank.add(initial_state, initial_covariance), i);
+        filters.emplace_back(initial_state, initial_covariance, max_a, tau,
+                             observation_noise);
+    }
+    ASSERT_EQ(bank.size(), filter_num);
+
+    for (int t = 0; t < times; ++t) {
+        const float dt = 0.1f * (t + 1);
+        bank.predict(dt);
+        for (int i = 0; i < filter_num; ++i) {
+            filters[i].predict(dt);
+            // Leaves some filters without measurements
+            if ((i + t) % 3 == 0) {
+                continue;
+            }
+            Eigen::Matrix<float, kMeasurementSize, 1> measurement;
+            measurement << dist(gen), dist(gen), dist(gen);
+            bank.update(i, measurement);
+            filters[i].update(measurement);
+        }
+    }
+    for (int i = 0; i < filter_num; ++i) {
+        EXPECT_TRUE(bank.state(i).isApprox(filters[i].state(), 1e-4));
+    }
+
+    // Removing filters keeps the others unchanged
+    bank.move(filter_num - 1, 0);
+    bank.resize(filter_num - 1);
+    EXPECT_EQ(bank.size(), filter_num - 1);
+    EXPECT_TRUE(bank.state(0).isApprox(filters.back().state(), 1e-4));
+    bank.predict(0.1f);
+    filters.back().predict(0.1f);
+    EXPECT_TRUE(bank.state(0).isApprox(filters.back().state(), 1e-4));
+}
+
+TEST(SingerBankTest, TestParallelPredict) {
+    constexpr int filter_num = 4 * SingerEKFBank::kParallelGrain + 3;
+    const Eigen::Matrix<float, kStateSize, kStateSize> initial_covariance =
+        Eigen::Matrix<float, kStateSize, kStateSize>::Identity() * 0.5f;
+    const Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>
+        observation_noise =
+            Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>::
+                Identity() *
+            0.2f;
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    SingerEKFBank serial(2.0f, 1.0f, observation_noise);
+    SingerEKFBank parallel(2.0f, 1.0f, observation_noise);
+    for (int i = 0; i < filter_num; ++i) {
+        Eigen::Matrix<float, kStateSize, 1> initial_state;
+        initial_state << dist(gen), dist(gen), 0, dist(gen), dist(gen), 0,
+            dist(gen), dist(gen), 0;
+        serial.add(initial_state, initial_covariance);
+        parallel.add(initial_state, initial_covariance);
+    }
+
+    radar::ThreadPool pool(3);
+    for (int t = 0; t < 5; ++t) {
+        serial.predict(0.1f);
+        parallel.predict(0.1f, &pool);
+    }
+    for (int i = 0; i < filter_num; ++i) {
+        EXPECT_TRUE(serial.state(i).isApprox(parallel.state(i)));
+        EXPECT_TRUE(serial.covariance(i).isApprox(parallel.covariance(i)));
+    }
+}
+
+TEST(SingerBankTest, TestPredictState) {
+    const Eigen::Matrix<float, kStateSize, kStateSize> initial_covariance =
+        Eigen::Matrix<float, kStateSize, kStateSize>::Identity() * 0.5f;
+    const Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>
+        observation_noise =
+            Eigen::Matrix<float, kMeasurementSize, kMeasurementSize>::
+                Identity() *
+            0.2f;
+
+    SingerEKFBank bank(2.0f, 1.0f, observation_noise);
+    Eigen::Matrix<float, kStateSize, 1> initial_state;
+    initial_state << 1, 2, 0.5f, -3, 1, 0, 4, -1, 0.2f;
+    bank.add(initial_state, initial_covariance);
+
+    // Predicting the state leaves the filter unchanged
+    const auto predicted = bank.predictState(0, 0.3f);
+    EXPECT_TRUE(bank.state(0).isApprox(initial_state));
+    bank.predict(0.3f);
+    EXPECT_TRUE(predicted.isApprox(bank.state(0), 1e-5));
+}
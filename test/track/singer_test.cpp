@@ -119,4 +119,50 @@ TEST_F(SingerTest, TestAcceleratedMotion) {
 
     EXPECT_TRUE(state_pos.isApprox(state_pos_gt, 1e-1));
     EXPECT_TRUE(state_vel.isApprox(state_vel_gt, 1e-1));
-}
\ No newline at end of file
+}
+
+TEST_F(SingerTest, TestSameAsFullFilter) {
+    // The full 9-state model built from the blocks of the axes
+    auto full = [](const SingerAxisFilter::BlockCovariance& block) {
+        Eigen::Matrix<float, kStateSize, kStateSize> matrix =
+            Eigen::Matrix<float, kStateSize, kStateSize>::Zero();
+        for (int i = 0; i < kAxisNum; ++i) {
+            matrix.block<kAxisStateSize, kAxisStateSize>(
+                i * kAxisStateSize, i * kAxisStateSize) = block;
+        }
+        return matrix;
+    };
+    auto transition =
+        [&]([[maybe_unused]] const Eigen::Matrix<float, kStateSize, 1>& state,
+            float dt) { return full(SingerTransition{tau}(dt)); };
+    auto process_noise = [&](float dt) {
+        return full(SingerProcessNoise{max_a, tau}(dt));
+    };
+    auto observation = [](const Eigen::Matrix<float, kStateSize, 1>& state) {
+        Eigen::Matrix<float, kMeasurementSize, kStateSize> jacobian =
+            Eigen::Matrix<float, kMeasurementSize, kStateSize>::Zero();
+        for (int i = 0; i < kMeasurementSize; ++i) {
+            jacobian(i, i * 3) = 1;
+        }
+        return std::make_pair(
+            Eigen::Matrix<float, kMeasurementSize, 1>(jacobian * state),
+            jacobian);
+    };
+    ExtendedKalmanFilter<kStateSize, kMeasurementSize, float> full_filter(
+        initial_state, initial_covariance, observation_noise);
+
+    for (int i = 0; i < 10; ++i) {
+        Eigen::Matrix<float, kMeasurementSize, 1> measurement;
+        measurement << 1.0f * i, 2.0f * i + 0.1f * i * i, 3.0f - i;
+        const float dt = 0.05f * (i + 1);
+
+        filter->predict(dt);
+        full_filter.predict(transition, process_noise, dt);
+        filter->update(measurement);
+        full_filter.update(measurement, observation);
+    }
+
+    EXPECT_TRUE(filter->state().isApprox(full_filter.state(), 1e-4));
+    EXPECT_TRUE(
+        filter->covariance().isApprox(full_filter.covariance(), 1e-4));
+}
@@ -0,0 +1,68 @@
+#include "utils/bounded_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace radar;
+
+TEST(BoundedQueueTest, FirstInFirstOut) {
+    BoundedQueue<int> queue(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_EQ(queue.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(queue.pop().value(), i);
+    }
+    EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(BoundedQueueTest, DropOldest) {
+    BoundedQueue<int> queue(2, OverflowPolicy::DropOldest);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_EQ(queue.dropped(), 3);
+    EXPECT_EQ(queue.pop().value(), 3);
+    EXPECT_EQ(queue.pop().value(), 4);
+}
+
+TEST(BoundedQueueTest, CloseDrainsRemaining) {
+    BoundedQueue<int> queue(2);
+    queue.push(1);
+    queue.close();
+    EXPECT_FALSE(queue.push(2));
+    EXPECT_EQ(queue.pop().value(), 1);
+    EXPECT_FALSE(queue.pop().has_value());
+
+    queue.reset();
+    EXPECT_TRUE(queue.push(3));
+    EXPECT_EQ(queue.pop().value(), 3);
+}
+
+TEST(BoundedQueueTest, BlockingProducerConsumer) {
+    constexpr int num_elements = 1000;
+    BoundedQueue<int> queue(3, OverflowPolicy::Block);
+
+    std::thread producer([&] {
+        for (int i = 0; i < num_elements; ++i) {
+            queue.push(i);
+        }
+        queue.close();
+    });
+
+    std::vector<int> received;
+    while (auto value = queue.pop()) {
+        received.emplace_back(value.value());
+    }
+    producer.join();
+
+    ASSERT_EQ(received.size(), num_elements);
+    for (int i = 0; i < num_elements; ++i) {
+        EXPECT_EQ(received[i], i);
+    }
+    EXPECT_EQ(queue.dropped(), 0);
+}
@@ -0,0 +1,34 @@
+#include "utils/frame_arena.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace radar;
+
+TEST(FrameArenaTest, ResetReusesBuffer) {
+    FrameArena arena(1024);
+    for (int frame = 0; frame < 3; ++frame) {
+        arena.reset();
+        std::pmr::vector<int> values(arena.resource());
+        values.reserve(16);
+        const auto* data = values.data();
+        for (int i = 0; i < 16; ++i) {
+            values.push_back(i);
+        }
+        EXPECT_EQ(values.data(), data);
+        EXPECT_EQ(values[15], 15);
+    }
+    EXPECT_EQ(arena.capacity(), 1024);
+}
+
+TEST(FrameArenaTest, GrowsAfterOverflow) {
+    FrameArena arena(256);
+    {
+        std::pmr::vector<int> values(arena.resource());
+        values.resize(1024, 1);
+        EXPECT_EQ(values[1023], 1);
+    }
+    arena.reset();
+    EXPECT_GE(arena.capacity(), 1024 * sizeof(int));
+}
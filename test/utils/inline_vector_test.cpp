@@ -0,0 +1,27 @@
+#include "utils/inline_vector.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+using namespace radar;
+
+TEST(InlineVectorTest, PushAndIterate) {
+    InlineVector<int, 4> vector;
+    EXPECT_TRUE(vector.empty());
+    for (int i = 0; i < 4; ++i) {
+        vector.push_back(i);
+    }
+    EXPECT_EQ(vector.size(), 4);
+    int expected = 0;
+    for (int value : vector) {
+        EXPECT_EQ(value, expected++);
+    }
+    EXPECT_THROW(vector.push_back(4), std::length_error);
+
+    std::vector<int> values{1, 2, 3, 4, 5, 6};
+    InlineVector<int, 4> truncated(values);
+    EXPECT_EQ(truncated.size(), 4);
+    EXPECT_EQ(truncated[3], 4);
+}
@@ -0,0 +1,116 @@
+#ifndef RADAR_ENABLE_METRICS
+#define RADAR_ENABLE_METRICS
+#endif
+#include "utils/metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace radar::metrics;
+
+TEST(MetricsTest, HistogramBuckets) {
+    for (uint64_t value : {0UL, 1UL, 7UL, 8UL, 9UL, 100UL, 12345UL,
+                           987654321UL, 1UL << 62}) {
+        const int bucket = Histogram::bucketOf(value);
+        ASSERT_LT(bucket, Histogram::kBuckets);
+        EXPECT_LT(value, Histogram::upperBoundOf(bucket));
+        if (bucket > 0) {
+            EXPECT_GE(value, Histogram::upperBoundOf(bucket - 1));
+        }
+    }
+}
+
+TEST(MetricsTest, QuantilesAcrossThreads) {
+    const int site = registerSite("test.quantiles");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([site] {
+            for (int i = 1; i <= 1000; ++i) {
+                record(site, std::chrono::microseconds(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<SiteStats> stats;
+    struct Collector : Sink {
+        std::vector<SiteStats>& stats;
+        explicit Collector(std::vector<SiteStats>& stats) : stats{stats} {}
+        void write(std::span<const SiteStats> sites,
+                   std::span<const TraceEvent>) override {
+            stats.assign(sites.begin(), sites.end());
+        }
+    } collector(stats);
+    report(collector);
+
+    auto iter = std::ranges::find(stats, "test.quantiles", &SiteStats::name);
+    ASSERT_NE(iter, stats.end());
+    EXPECT_EQ(iter->count, 4000);
+    EXPECT_NEAR(iter->mean, 500.5, 1e-3);
+    EXPECT_NEAR(iter->p50, 500.0, 500.0 * 0.125);
+    EXPECT_NEAR(iter->p99, 990.0, 990.0 * 0.125);
+    EXPECT_NEAR(iter->max, 1000.0, 1e-3);
+}
+
+TEST(MetricsTest, HistogramsReservedAtRegistration) {
+    auto& registry = Registry::instance();
+    auto* recorder = registry.recorder();
+    ASSERT_NE(recorder, nullptr);
+    const int site = registerSite("test.reserved");
+    EXPECT_NE(recorder->find(site), nullptr);
+
+    std::thread thread([&registry, site] {
+        auto* recorder = registry.recorder();
+        ASSERT_NE(recorder, nullptr);
+        EXPECT_NE(recorder->find(site), nullptr);
+    });
+    thread.join();
+}
+
+TEST(MetricsTest, ScopeAndSinks) {
+    setTracing(true);
+    for (int i = 0; i < 3; ++i) {
+        RADAR_PROFILE_SCOPE("test.scope");
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    setTracing(false);
+
+    std::ostringstream summary;
+    StreamSink stream_sink(summary);
+    report(stream_sink);
+    EXPECT_NE(summary.str().find("test.scope"), std::string::npos);
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto csv_path = (directory / "radar_metrics_test.csv").string();
+    const auto trace_path = (directory / "radar_metrics_test.json").string();
+    CsvSink csv_sink(csv_path);
+    ChromeTraceSink trace_sink(trace_path);
+    report(csv_sink);
+    report(trace_sink);
+
+    std::ifstream csv(csv_path);
+    std::string header;
+    std::getline(csv, header);
+    EXPECT_EQ(header, "site,count,mean_us,p50_us,p99_us,max_us");
+
+    std::ifstream trace(trace_path);
+    const std::string json{std::istreambuf_iterator<char>(trace), {}};
+    size_t events = 0;
+    for (size_t pos = json.find("\"test.scope\""); pos != std::string::npos;
+         pos = json.find("\"test.scope\"", pos + 1)) {
+        ++events;
+    }
+    EXPECT_EQ(events, 3);
+
+    std::filesystem::remove(csv_path);
+    std::filesystem::remove(trace_path);
+}
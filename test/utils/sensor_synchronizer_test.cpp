@@ -0,0 +1,135 @@
+#include "utils/sensor_synchronizer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace radar;
+using namespace std::chrono_literals;
+
+using Synchronizer = SensorSynchronizer<int, int>;
+
+TEST(SensorSynchronizerTest, NearestCloud) {
+    Synchronizer synchronizer(8, 60ms, 1s);
+    const Synchronizer::Clock::time_point base{};
+    for (int i = 0; i < 3; ++i) {
+        synchronizer.pushCloud(i, base + i * 100ms);
+    }
+    synchronizer.pushImage(0, base + 40ms);
+    synchronizer.pushImage(1, base + 60ms);
+    synchronizer.pushImage(2, base + 160ms);
+
+    // Every frame has a later sweep, so none of them waits
+    auto pair = synchronizer.pop();
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_EQ(pair->image, 0);
+    EXPECT_EQ(pair->cloud.value(), 0);
+    EXPECT_EQ(pair->cloud_timestamp, base);
+    pair = synchronizer.pop();
+    EXPECT_EQ(pair->image, 1);
+    EXPECT_EQ(pair->cloud.value(), 1);
+    pair = synchronizer.pop();
+    EXPECT_EQ(pair->image, 2);
+    EXPECT_EQ(pair->image_timestamp, base + 160ms);
+    EXPECT_EQ(pair->cloud.value(), 2);
+    EXPECT_EQ(pair->cloud_timestamp, base + 200ms);
+}
+
+TEST(SensorSynchronizerTest, SharedCloud) {
+    // The camera runs three times as fast as the lidar
+    Synchronizer synchronizer(8, 50ms, 1s);
+    const Synchronizer::Clock::time_point base{};
+    synchronizer.pushCloud(0, base);
+    synchronizer.pushCloud(1, base + 99ms);
+    for (int i = 0; i < 3; ++i) {
+        synchronizer.pushImage(i, base + i * 33ms);
+    }
+    EXPECT_EQ(synchronizer.pop()->cloud.value(), 0);
+    EXPECT_EQ(synchronizer.pop()->cloud.value(), 0);
+    EXPECT_EQ(synchronizer.pop()->cloud.value(), 1);
+}
+
+TEST(SensorSynchronizerTest, MaxOffset) {
+    Synchronizer synchronizer(8, 60ms, 1s);
+    const Synchronizer::Clock::time_point base{};
+    synchronizer.pushCloud(0, base + 500ms);
+    synchronizer.pushImage(0, base);
+    auto pair = synchronizer.pop();
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_FALSE(pair->cloud.has_value());
+}
+
+TEST(SensorSynchronizerTest, BoundedWait) {
+    Synchronizer synchronizer(8, 60ms, 20ms);
+    const Synchronizer::Clock::time_point base{};
+    synchronizer.pushCloud(0, base);
+    synchronizer.pushImage(0, base + 50ms);
+
+    // No later sweep arrives, so the frame is paired after waiting
+    const auto begin = std::chrono::steady_clock::now();
+    auto pair = synchronizer.pop();
+    EXPECT_GE(std::chrono::steady_clock::now() - begin, 15ms);
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_EQ(pair->cloud.value(), 0);
+
+    // The sweep is kept for later frames, until it is out of the offset
+    synchronizer.pushImage(1, base + 55ms);
+    synchronizer.pushImage(2, base + 100ms);
+    pair = synchronizer.pop();
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_EQ(pair->image, 1);
+    EXPECT_EQ(pair->cloud.value(), 0);
+    pair = synchronizer.pop();
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_EQ(pair->image, 2);
+    EXPECT_FALSE(pair->cloud.has_value());
+}
+
+TEST(SensorSynchronizerTest, LateCloud) {
+    Synchronizer synchronizer(8, 60ms, 10s);
+    const Synchronizer::Clock::time_point base{};
+    synchronizer.pushCloud(0, base);
+    synchronizer.pushImage(0, base + 90ms);
+
+    std::jthread lidar([&] {
+        std::this_thread::sleep_for(10ms);
+        synchronizer.pushCloud(1, base + 100ms);
+    });
+    const auto begin = std::chrono::steady_clock::now();
+    auto pair = synchronizer.pop();
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, 5s);
+    ASSERT_TRUE(pair.has_value());
+    EXPECT_EQ(pair->cloud.value(), 1);
+}
+
+TEST(SensorSynchronizerTest, DropAndClose) {
+    Synchronizer synchronizer(2, 60ms, 10s);
+    const Synchronizer::Clock::time_point base{};
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(synchronizer.pushImage(i, base + i * 10ms));
+    }
+    EXPECT_EQ(synchronizer.dropped(), 1u);
+
+    // Frames left when closed are popped without waiting
+    synchronizer.close();
+    EXPECT_FALSE(synchronizer.pushImage(3, base + 30ms));
+    EXPECT_FALSE(synchronizer.pushCloud(0, base));
+    EXPECT_EQ(synchronizer.pop()->image, 1);
+    EXPECT_EQ(synchronizer.pop()->image, 2);
+    EXPECT_FALSE(synchronizer.pop().has_value());
+
+    synchronizer.reset();
+    EXPECT_TRUE(synchronizer.pushImage(4, base));
+    synchronizer.close();
+    EXPECT_FALSE(synchronizer.pop()->cloud.has_value());
+}
+
+TEST(SensorSynchronizerTest, CloseWakesConsumer) {
+    Synchronizer synchronizer(2, 60ms, 10s);
+    std::jthread closer([&] {
+        std::this_thread::sleep_for(10ms);
+        synchronizer.close();
+    });
+    EXPECT_FALSE(synchronizer.pop().has_value());
+}
@@ -0,0 +1,57 @@
+#include "utils/thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace radar;
+
+TEST(ThreadPoolTest, CoversRangeOnce) {
+    ThreadPool pool(3);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(0, 1000, 10, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+    });
+    for (int hit : hits) {
+        EXPECT_EQ(hit, 1);
+    }
+}
+
+TEST(ThreadPoolTest, SmallRangeRunsOnCaller) {
+    ThreadPool pool(2);
+    const auto caller = std::this_thread::get_id();
+    int calls = 0;
+    pool.parallelFor(0, 8, 16, [&](int begin, int end) {
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+        EXPECT_EQ(begin, 0);
+        EXPECT_EQ(end, 8);
+        ++calls;
+    });
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(ThreadPoolTest, NestedAndException) {
+    ThreadPool pool(2);
+    std::atomic<int> sum{0};
+    pool.parallelFor(0, 4, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            pool.parallelFor(0, 100, 1, [&](int inner_begin, int inner_end) {
+                sum += inner_end - inner_begin;
+            });
+        }
+    });
+    EXPECT_EQ(sum, 400);
+
+    EXPECT_THROW(pool.parallelFor(0, 4, 1,
+                                  [](int begin, int) {
+                                      if (begin == 0) {
+                                          throw std::runtime_error("failed");
+                                      }
+                                  }),
+                 std::runtime_error);
+}